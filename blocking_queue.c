@@ -2,6 +2,15 @@
 #include "utilities.h"
 #include <stdio.h>
 #include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+//rough cost of one pause iteration, used to turn park times into spins
+#define SPIN_NS 40
+//floor for the adaptive spin budget so it can grow back
+#define MIN_SPIN_BUDGET 16
+
+BlockingQueueWaitT const blocking_queue_default_wait = { 4096, 4, 1 };
 
 
 void blocking_queue_terminate(BlockingQueueT* queue) {
@@ -16,6 +25,7 @@ void blocking_queue_terminate(BlockingQueueT* queue) {
 
 void blocking_queue_create(BlockingQueueT* queue) {
   queue->front = queue->rear = NULL;
+  queue->size = 0;
   
   //set to unterminated
   queue->terminated = 0;
@@ -23,6 +33,107 @@ void blocking_queue_create(BlockingQueueT* queue) {
   //init mutex and semaphore
   pthread_mutex_init(&queue->lock, NULL);
   sem_init(&queue->queue_sem,0,0);
+  
+  //spin then park by default
+  blocking_queue_set_wait(queue, &blocking_queue_default_wait);
+  queue->stats = (BlockingQueueStatsT){ 0, 0, 0, 0, 0 };
+}
+
+void blocking_queue_set_wait(BlockingQueueT* queue, BlockingQueueWaitT const* wait) {
+  queue->wait = *wait;
+  //adaptive queues start at a quarter of the limit and tune from there
+  unsigned int budget = wait->adaptive ? wait->spin_limit / 4 : wait->spin_limit;
+  __atomic_store_n(&queue->spin_budget, budget, __ATOMIC_RELAXED);
+}
+
+void blocking_queue_stats(BlockingQueueT* queue, BlockingQueueStatsT* stats) {
+  stats->spins = __atomic_load_n(&queue->stats.spins, __ATOMIC_RELAXED);
+  stats->spin_hits = __atomic_load_n(&queue->stats.spin_hits, __ATOMIC_RELAXED);
+  stats->yields = __atomic_load_n(&queue->stats.yields, __ATOMIC_RELAXED);
+  stats->parks = __atomic_load_n(&queue->stats.parks, __ATOMIC_RELAXED);
+  stats->wakeups = __atomic_load_n(&queue->stats.wakeups, __ATOMIC_RELAXED);
+}
+
+// Only called with the lock held, the atomic store lets readers skip it
+static void resize(BlockingQueueT* queue, int delta) {
+  __atomic_store_n(&queue->size, queue->size + delta, __ATOMIC_RELAXED);
+}
+
+static void stat_add(unsigned long* counter, unsigned long amount) {
+  __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+}
+
+// Move the spin budget an eighth of the way towards the observed need
+static void adapt(BlockingQueueWaitT const* wait, unsigned int* spin_budget, unsigned long target) {
+  if (!wait->adaptive) return;
+  
+  if (target > wait->spin_limit) target = wait->spin_limit;
+  if (target < MIN_SPIN_BUDGET) target = MIN_SPIN_BUDGET;
+  
+  long budget = __atomic_load_n(spin_budget, __ATOMIC_RELAXED);
+  budget += ((long)target - budget) / 8;
+  __atomic_store_n(spin_budget, (unsigned int)budget, __ATOMIC_RELAXED);
+}
+
+static unsigned long elapsed_ns(struct timespec const* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000000ul + (now.tv_nsec - start->tv_nsec);
+}
+
+void blocking_queue_wait_on(sem_t* sem, BlockingQueueWaitT const* wait, unsigned int* spin_budget,
+			    BlockingQueueStatsT* stats) {
+  unsigned int const budget = __atomic_load_n(spin_budget, __ATOMIC_RELAXED);
+  
+  //spin in user space, a push arriving now costs no syscall
+  for (unsigned int i = 0; i < budget; i++) {
+    if (sem_trywait(sem) == 0) {
+      stat_add(&stats->spins, i + 1);
+      stat_add(&stats->spin_hits, 1);
+      adapt(wait, spin_budget, 2ul * (i + 1)); //leave headroom over the observed wait
+      return;
+    }
+    cpu_relax();
+  }
+  stat_add(&stats->spins, budget);
+  
+  //give the core away but stay runnable
+  for (unsigned int i = 0; i < wait->yield_limit; i++) {
+    stat_add(&stats->yields, 1);
+    sched_yield();
+    if (sem_trywait(sem) == 0) {
+      adapt(wait, spin_budget, 2ul * budget); //nearly caught it, spin longer
+      return;
+    }
+  }
+  
+  //park on the semaphore
+  stat_add(&stats->parks, 1);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  
+  while (sem_wait(sem) != 0) ;
+  
+  stat_add(&stats->wakeups, 1);
+  //short parks mean spinning a little longer would have avoided the sleep,
+  //long parks mean the queue was idle and spinning was wasted
+  unsigned long const waited = elapsed_ns(&start) / SPIN_NS;
+  adapt(wait, spin_budget, waited <= wait->spin_limit ? 2 * waited : 0);
+}
+
+// Wait for a signal on the queue semaphore - called with the lock released
+static void blocking_queue_wait(BlockingQueueT* queue) {
+  blocking_queue_wait_on(&queue->queue_sem, &queue->wait, &queue->spin_budget, &queue->stats);
+}
+
+// Take a count for each popped value beyond the counted ones a wait took,
+// with the lock held, so the semaphore never runs ahead of the queue. A
+// count may not be posted yet if its push is still in flight, that only
+// leaves a spare wakeup behind.
+static void consume(BlockingQueueT* queue, size_t counted, size_t popped) {
+  for (size_t i = counted; i < popped; i++) {
+    if (sem_trywait(&queue->queue_sem) != 0) break;
+  }
 }
 
 void blocking_queue_destroy(BlockingQueueT* queue) {
@@ -38,6 +149,7 @@ void blocking_queue_destroy(BlockingQueueT* queue) {
       current = next;
   }
   queue->front = queue->rear = NULL;
+  queue->size = 0;
 
   pthread_mutex_unlock(&queue->lock); // unlock the mutex
   pthread_mutex_destroy(&queue->lock); // destroy the mutex
@@ -67,6 +179,7 @@ void blocking_queue_push(BlockingQueueT* queue, unsigned int value) {
     queue->rear->succ = new_node;
   }
   queue->rear = new_node;
+  resize(queue, 1);
   
   //unlock
   pthread_mutex_unlock(&queue->lock);
@@ -89,13 +202,15 @@ int blocking_queue_pop(BlockingQueueT* queue, unsigned int* value) {
   }
   
    // If the queue is empty, block until an item is pushed
+   size_t counted = 0;
    while (blocking_queue_empty(queue) && !queue->terminated) {
     
     // unlock the mutex before waiting on the semaphore
     pthread_mutex_unlock(&queue->lock);
     
-    // block and wait for a signal that an item is available in the queue
-    sem_wait(&queue->queue_sem);  // wait on the semaphore
+    // spin, yield then block until a signal that an item is available
+    blocking_queue_wait(queue);
+    counted = 1;
    
     // re-lock the mutex after being signaled
     pthread_mutex_lock(&queue->lock);
@@ -120,6 +235,9 @@ int blocking_queue_pop(BlockingQueueT* queue, unsigned int* value) {
   if(queue->front == NULL){
     queue->rear = NULL;
   }
+  resize(queue, -1);
+  consume(queue, counted, 1);
+  
   //free previous front
   checked_free(prevFront);
   
@@ -128,17 +246,128 @@ int blocking_queue_pop(BlockingQueueT* queue, unsigned int* value) {
   return 0;
 }
 
+int blocking_queue_try_pop(BlockingQueueT* queue, unsigned int* value) {
+  
+  pthread_mutex_lock(&queue->lock);
+  
+  //never wait, an empty queue is a failure
+  if (queue->front == NULL) {
+    pthread_mutex_unlock(&queue->lock);
+    return 1;
+  }
+  
+  *value = queue->front->value;
+  ListT* prevFront = queue->front;
+  queue->front = queue->front->succ;
+  if(queue->front == NULL){
+    queue->rear = NULL;
+  } else {
+    queue->front->pred = NULL;
+  }
+  resize(queue, -1);
+  consume(queue, 0, 1);
+  
+  checked_free(prevFront);
+  pthread_mutex_unlock(&queue->lock);
+  return 0;
+}
+
+void blocking_queue_push_many(BlockingQueueT* queue, unsigned int const* values, size_t n) {
+  if (n == 0) return;
+  
+  //build the chain before taking the lock
+  ListT* first = NULL;
+  ListT* last = NULL;
+  for (size_t i = 0; i < n; i++) {
+    ListT* new_node = (ListT*)checked_malloc(sizeof(ListT));
+    new_node->value = values[i];
+    new_node->succ = NULL;
+    new_node->pred = last;
+    if (last == NULL) {
+      first = new_node;
+    } else {
+      last->succ = new_node;
+    }
+    last = new_node;
+  }
+  
+  //lock mutex and splice the chain onto the rear
+  pthread_mutex_lock(&queue->lock);
+  
+  first->pred = queue->rear;
+  if (queue->rear == NULL) {
+    queue->front = first;
+  } else {
+    queue->rear->succ = first;
+  }
+  queue->rear = last;
+  resize(queue, (int)n);
+  
+  //unlock
+  pthread_mutex_unlock(&queue->lock);
+  
+  //a post per value, as a semaphore cannot be raised by n at once - each
+  //sleeping popper gets its wakeup while the lock was only taken once
+  for (size_t i = 0; i < n; i++) {
+    sem_post(&queue->queue_sem);
+  }
+}
+
+static size_t pop_many(BlockingQueueT* queue, unsigned int* values, size_t max, int wait) {
+  if (max == 0) return 0;
+  
+  pthread_mutex_lock(&queue->lock);
+  
+  // block until an item is pushed, same as single pop
+  size_t counted = 0;
+  while (wait && blocking_queue_empty(queue) && !queue->terminated) {
+    pthread_mutex_unlock(&queue->lock);
+    blocking_queue_wait(queue);
+    counted = 1;
+    pthread_mutex_lock(&queue->lock);
+  }
+  
+  //detach up to max nodes from the front
+  ListT* chain = queue->front;
+  ListT* node = chain;
+  size_t popped = 0;
+  while (node != NULL && popped < max) {
+    values[popped++] = node->value;
+    node = node->succ;
+  }
+  
+  queue->front = node;
+  if (node == NULL) {
+    queue->rear = NULL;
+  } else {
+    node->pred = NULL;
+  }
+  resize(queue, -(int)popped);
+  consume(queue, counted, popped);
+  
+  //unlock before freeing the detached nodes
+  pthread_mutex_unlock(&queue->lock);
+  
+  for (size_t i = 0; i < popped; i++) {
+    ListT* next = chain->succ;
+    checked_free(chain);
+    chain = next;
+  }
+  return popped;
+}
+
+size_t blocking_queue_pop_many(BlockingQueueT* queue, unsigned int* values, size_t max) {
+  return pop_many(queue, values, max, 1);
+}
+
+size_t blocking_queue_try_pop_many(BlockingQueueT* queue, unsigned int* values, size_t max) {
+  return pop_many(queue, values, max, 0);
+}
+
 int blocking_queue_empty(BlockingQueueT* queue) {
   return queue->front == NULL;
 }
 
 int blocking_queue_length(BlockingQueueT* queue) {
-  int size = 0;
-  ListT* current = queue->front;
-  //searches until end of queue
-  while(current != NULL){
-    size++;
-    current = current->succ;
-  }
-  return size;
+  return __atomic_load_n(&queue->size, __ATOMIC_RELAXED);
 }
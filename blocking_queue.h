@@ -5,23 +5,63 @@
 #include <pthread.h>
 #include <semaphore.h>
 
+// How pop waits on an empty queue - spin with pause, then yield, then park
+typedef struct BlockingQueueWait {
+  unsigned int spin_limit; //upper bound on the spin budget, 0 parks straight away
+  unsigned int yield_limit; //sched_yield rounds before parking
+  int adaptive; //tune the spin budget from observed wait times
+} BlockingQueueWaitT;
+
+typedef struct BlockingQueueStats {
+  unsigned long spins; //pause iterations spent waiting
+  unsigned long spin_hits; //waits satisfied while spinning
+  unsigned long yields; //sched_yield calls
+  unsigned long parks; //waits that went to sleep on the semaphore
+  unsigned long wakeups; //parked waits that were woken
+} BlockingQueueStatsT;
+
 typedef struct BlockingQueue {
   ListT* front;
   ListT* rear;
   pthread_mutex_t lock;
   int terminated;
   sem_t queue_sem;
+  int size; //written under the lock, safe to read without it
+  BlockingQueueWaitT wait;
+  unsigned int spin_budget; //current spin budget when adaptive
+  BlockingQueueStatsT stats; //updated atomically outside the lock
 } BlockingQueueT;
 
+extern BlockingQueueWaitT const blocking_queue_default_wait;
+
 void blocking_queue_create(BlockingQueueT* queue);
 void blocking_queue_destroy(BlockingQueueT* queue);
 
 void blocking_queue_push(BlockingQueueT* queue, unsigned int value);
 int blocking_queue_pop(BlockingQueueT* queue, unsigned int* value);
+// Pop without waiting, returns 1 if the queue is empty
+int blocking_queue_try_pop(BlockingQueueT* queue, unsigned int* value);
+
+// Push n values under a single lock acquisition
+void blocking_queue_push_many(BlockingQueueT* queue, unsigned int const* values, size_t n);
+// Move up to max values in one critical section, blocks until at least one
+// is available and returns 0 once terminated and empty
+size_t blocking_queue_pop_many(BlockingQueueT* queue, unsigned int* values, size_t max);
+// Same without waiting, returns 0 if the queue is empty
+size_t blocking_queue_try_pop_many(BlockingQueueT* queue, unsigned int* values, size_t max);
 
 int blocking_queue_empty(BlockingQueueT* queue);
+// Constant time and lock free, so monitoring never contends with workers
 int blocking_queue_length(BlockingQueueT* queue);
 
 void blocking_queue_terminate(BlockingQueueT* queue);
 
+void blocking_queue_set_wait(BlockingQueueT* queue, BlockingQueueWaitT const* wait);
+// Take one post of sem the way pop waits on an empty queue, for callers
+// that count their wakeups on a semaphore of their own. spin_budget starts
+// as blocking_queue_set_wait sets it and is tuned here when adaptive.
+void blocking_queue_wait_on(sem_t* sem, BlockingQueueWaitT const* wait, unsigned int* spin_budget,
+			    BlockingQueueStatsT* stats);
+void blocking_queue_stats(BlockingQueueT* queue, BlockingQueueStatsT* stats);
+
 #endif
@@ -154,11 +154,253 @@ void test_pop(){
   
 }
 
+void test_park_counters() {
+  printf("Testing parking is counted\n");
+  
+  global_queue = setup();
+  
+  //never spin or yield
+  BlockingQueueWaitT const park_only = { 0, 0, 0 };
+  blocking_queue_set_wait(global_queue, &park_only);
+  
+  pthread_t consumer_thread;
+  pthread_create(&consumer_thread, NULL, consumer_routine, NULL);
+  sleep(1);
+  blocking_queue_push(global_queue, 42);
+  pthread_join(consumer_thread, NULL);
+  
+  BlockingQueueStatsT stats;
+  blocking_queue_stats(global_queue, &stats);
+  assert(stats.spins == 0);
+  assert(stats.yields == 0);
+  assert(stats.parks >= 1);
+  assert(stats.wakeups == stats.parks);
+  
+  teardown(global_queue);
+}
+
+void test_spin_hit() {
+  printf("Testing a push during the spin phase avoids parking\n");
+  
+  global_queue = setup();
+  
+  //spin for a long time so the push always lands while spinning
+  BlockingQueueWaitT const spin_only = { 1u << 30, 0, 0 };
+  blocking_queue_set_wait(global_queue, &spin_only);
+  
+  pthread_t consumer_thread;
+  pthread_create(&consumer_thread, NULL, consumer_routine, NULL);
+  usleep(100000);
+  blocking_queue_push(global_queue, 42);
+  pthread_join(consumer_thread, NULL);
+  
+  BlockingQueueStatsT stats;
+  blocking_queue_stats(global_queue, &stats);
+  assert(stats.parks == 0);
+  assert(stats.spin_hits == 1);
+  assert(stats.spins > 0);
+  
+  teardown(global_queue);
+}
+
+void test_adaptive_budget_bounded() {
+  printf("Testing the adaptive spin budget stays within its limit\n");
+  
+  global_queue = setup();
+  
+  BlockingQueueWaitT const adaptive = { 256, 1, 1 };
+  blocking_queue_set_wait(global_queue, &adaptive);
+  
+  //long idle waits should shrink the budget
+  for (int i = 0; i < 3; i++) {
+    pthread_t consumer_thread;
+    pthread_create(&consumer_thread, NULL, consumer_routine, NULL);
+    usleep(100000);
+    blocking_queue_push(global_queue, 42);
+    pthread_join(consumer_thread, NULL);
+    assert(global_queue->spin_budget <= adaptive.spin_limit);
+  }
+  assert(global_queue->spin_budget < adaptive.spin_limit / 4);
+  
+  teardown(global_queue);
+}
+
+void test_push_pop_many(){
+  printf("testing push many/pop many\n");
+  
+  //alloc queue
+  BlockingQueueT* queue = setup();
+  
+  unsigned int const values[] = { 1, 2, 3, 4, 5 };
+  blocking_queue_push(queue, 0);
+  blocking_queue_push_many(queue, values, 5);
+  blocking_queue_push_many(queue, values, 0);
+  
+  //check order across single and batch pushes
+  assert(blocking_queue_length(queue) == 6);
+  assert(queue->front->value == 0);
+  assert(queue->rear->value == 5);
+  assert(queue->rear->pred->value == 4);
+  
+  //pop fewer than queued
+  unsigned int popped[8];
+  assert(blocking_queue_pop_many(queue, popped, 4) == 4);
+  for (unsigned int i = 0; i < 4; i++) {
+    assert(popped[i] == i);
+  }
+  assert(queue->front->value == 4);
+  assert(queue->front->pred == NULL);
+  
+  //pop more than queued
+  assert(blocking_queue_pop_many(queue, popped, 8) == 2);
+  assert(popped[0] == 4);
+  assert(popped[1] == 5);
+  assert(blocking_queue_empty(queue));
+  assert(queue->rear == NULL);
+  
+  //queue still usable after being drained
+  blocking_queue_push(queue, 9);
+  assert(queue->front->value == 9);
+  assert(queue->rear->value == 9);
+  
+  teardown(queue);
+}
+
+void* batch_consumer_routine(void* arg) {
+  unsigned int values[8];
+  
+  // blocks until the batch is pushed
+  size_t popped = blocking_queue_pop_many(global_queue, values, 8);
+  
+  assert(popped >= 1);
+  assert(values[0] == 7);
+  return NULL;
+}
+
+void test_pop_many_blocking() {
+  printf("Testing pop many blocks and terminates\n");
+  
+  global_queue = setup();
+  
+  pthread_t consumer_thread;
+  pthread_create(&consumer_thread, NULL, batch_consumer_routine, NULL);
+  sleep(1);
+  
+  unsigned int const values[] = { 7, 8, 9 };
+  blocking_queue_push_many(global_queue, values, 3);
+  pthread_join(consumer_thread, NULL);
+  
+  //drain whatever the consumer left then check termination
+  unsigned int rest[8];
+  while (!blocking_queue_empty(global_queue)) {
+    blocking_queue_pop_many(global_queue, rest, 8);
+  }
+  blocking_queue_terminate(global_queue);
+  assert(blocking_queue_pop_many(global_queue, rest, 8) == 0);
+  
+  teardown(global_queue);
+}
+
+void test_try_pop() {
+  printf("testing try pop\n");
+  
+  BlockingQueueT* queue = setup();
+  unsigned int value = 42;
+  
+  //empty queue fails straight away and leaves value alone
+  assert(blocking_queue_try_pop(queue, &value) == 1);
+  assert(value == 42);
+  
+  blocking_queue_push(queue, 1);
+  blocking_queue_push(queue, 2);
+  assert(blocking_queue_try_pop(queue, &value) == 0);
+  assert(value == 1);
+  assert(queue->front->pred == NULL);
+  assert(blocking_queue_try_pop(queue, &value) == 0);
+  assert(value == 2);
+  assert(blocking_queue_empty(queue));
+  assert(blocking_queue_length(queue) == 0);
+  assert(blocking_queue_try_pop(queue, &value) == 1);
+  
+  teardown(queue);
+}
+
+void test_try_pop_many() {
+  printf("testing try pop many\n");
+  
+  BlockingQueueT* queue = setup();
+  unsigned int values[4];
+  
+  //empty queue returns straight away
+  assert(blocking_queue_try_pop_many(queue, values, 4) == 0);
+  
+  unsigned int const pushed[] = { 1, 2, 3 };
+  blocking_queue_push_many(queue, pushed, 3);
+  assert(blocking_queue_try_pop_many(queue, values, 2) == 2);
+  assert(values[0] == 1 && values[1] == 2);
+  
+  //the blocking pop still sees exactly the one left
+  assert(blocking_queue_pop_many(queue, values, 4) == 1);
+  assert(values[0] == 3);
+  assert(blocking_queue_empty(queue));
+  assert(blocking_queue_try_pop_many(queue, values, 4) == 0);
+  
+  teardown(queue);
+}
+
+void test_no_stale_counts() {
+  printf("Testing values taken leave no counts behind for a later wait\n");
+  
+  global_queue = setup();
+  
+  //every way of taking values, none of them waiting
+  unsigned int values[64];
+  for (unsigned int i = 0; i < 64; i++) values[i] = i;
+  for (int round = 0; round < 10; round++) {
+    blocking_queue_push_many(global_queue, values, 64);
+    for (unsigned int i = 0; i < 8; i++) blocking_queue_push(global_queue, i);
+    unsigned int value;
+    unsigned int popped[64];
+    assert(blocking_queue_pop(global_queue, &value) == 0);
+    assert(blocking_queue_try_pop(global_queue, &value) == 0);
+    assert(blocking_queue_pop_many(global_queue, popped, 30) == 30);
+    assert(blocking_queue_try_pop_many(global_queue, popped, 64) == 40);
+  }
+  assert(blocking_queue_empty(global_queue));
+  int count;
+  sem_getvalue(&global_queue->queue_sem, &count);
+  assert(count == 0);
+  
+  //so the wait spins out, yields and parks until the push
+  BlockingQueueWaitT const wait = { 1000, 1, 0 };
+  blocking_queue_set_wait(global_queue, &wait);
+  pthread_t consumer_thread;
+  pthread_create(&consumer_thread, NULL, consumer_routine, NULL);
+  usleep(100000);
+  blocking_queue_push(global_queue, 42);
+  pthread_join(consumer_thread, NULL);
+  
+  BlockingQueueStatsT stats;
+  blocking_queue_stats(global_queue, &stats);
+  assert(stats.spin_hits == 0);
+  assert(stats.parks == 1 && stats.wakeups == 1);
+  
+  teardown(global_queue);
+}
+
 int main() {
   test_empty_creation();
   test_push();
   test_pop_failure();
   test_pop();
+  test_try_pop();
+  test_try_pop_many();
+  test_push_pop_many();
+  test_pop_many_blocking();
   test_blocking_behavior();
+  test_park_counters();
+  test_spin_hit();
+  test_adaptive_budget_bounded();
+  test_no_stale_counts();
   return 0;
 }
@@ -0,0 +1,158 @@
+#include "cfs.h"
+#include "scheduler.h"
+#include "simulator.h"
+#include "utilities.h"
+
+//keys computed on the stack per queue operation
+#define CFS_PUSH_BATCH 64
+
+//weight per nice level, each step is about a 10% share of cpu - the same
+//table linux uses
+static unsigned int const nice_to_weight[40] = {
+  /* -20 */ 88761, 71755, 56483, 46273, 36291,
+  /* -15 */ 29154, 23254, 18705, 14949, 11916,
+  /* -10 */  9548,  7620,  6100,  4904,  3906,
+  /*  -5 */  3121,  2501,  1991,  1586,  1277,
+  /*   0 */  1024,   820,   655,   526,   423,
+  /*   5 */   335,   272,   215,   172,   137,
+  /*  10 */   110,    87,    70,    56,    45,
+  /*  15 */    36,    29,    23,    18,    15,
+};
+
+void cfs_create(CfsT* cfs, ProcessTableT* table) {
+  priority_queue_create(&cfs->queue, table->size);
+  cfs->table = table;
+  cfs->min_vruntime = 0;
+}
+
+void cfs_destroy(CfsT* cfs) {
+  priority_queue_destroy(&cfs->queue);
+}
+
+unsigned int cfs_nice_weight(int nice) {
+  if (nice < -20) nice = -20;
+  if (nice > 19) nice = 19;
+  return nice_to_weight[nice + 20];
+}
+
+uint64_t cfs_charge(unsigned int cpu_time, int nice) {
+  return (uint64_t)cpu_time * CFS_NICE_0_WEIGHT / cfs_nice_weight(nice);
+}
+
+uint64_t cfs_place_new(CfsT* cfs) {
+  //start a slice behind, so a stream of new processes cannot keep the
+  //ones already running from being picked
+  return __atomic_load_n(&cfs->min_vruntime, __ATOMIC_RELAXED) + TIME_SLICE_LENGTH;
+}
+
+uint64_t cfs_place_woken(CfsT* cfs, uint64_t vruntime) {
+  uint64_t const min = __atomic_load_n(&cfs->min_vruntime, __ATOMIC_RELAXED);
+  uint64_t const floor = min > CFS_SLEEPER_CREDIT ? min - CFS_SLEEPER_CREDIT : 0;
+  return vruntime > floor ? vruntime : floor;
+}
+
+// Queue pids at their current vruntimes, a fixed number of keys at a time
+// so the stack stays bounded whatever the caller's batch
+static void push(CfsT* cfs, ProcessIdT const* pids, size_t n) {
+  uint64_t vruntimes[CFS_PUSH_BATCH];
+  for (size_t done = 0; done < n; done += CFS_PUSH_BATCH) {
+    size_t const count = n - done < CFS_PUSH_BATCH ? n - done : CFS_PUSH_BATCH;
+    for (size_t i = 0; i < count; i++) {
+      vruntimes[i] = cfs->table->vruntime[pids[done + i] - 1];
+    }
+    priority_queue_push_many(&cfs->queue, pids + done, vruntimes, count);
+  }
+}
+
+static void charge(CfsT* cfs, ProcessIdT pid, EvaluatorResultT const* result) {
+  int const nice = __atomic_load_n(&cfs->table->nice[pid - 1], __ATOMIC_RELAXED);
+  cfs->table->vruntime[pid - 1] += cfs_charge(result->cpu_time, nice);
+}
+
+// Keys come out in order, the first is the smallest runnable vruntime
+static size_t picked(CfsT* cfs, uint64_t const* vruntimes, size_t count) {
+  if (count > 0) {
+    uint64_t const latest = vruntimes[0];
+    uint64_t current = __atomic_load_n(&cfs->min_vruntime, __ATOMIC_RELAXED);
+    while (current < latest &&
+	   !__atomic_compare_exchange_n(&cfs->min_vruntime, &current, latest, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) ;
+  }
+  return count;
+}
+
+static void* policy_create(SimulatorT* simulator) {
+  CfsT* cfs = (CfsT*)checked_malloc(sizeof(CfsT));
+  cfs_create(cfs, &simulator->process_table);
+  return cfs;
+}
+
+static void policy_destroy(void* state) {
+  cfs_destroy((CfsT*)state);
+  checked_free(state);
+}
+
+static void policy_enqueue(void* state, ProcessIdT const* pids, size_t n) {
+  CfsT* cfs = (CfsT*)state;
+  for (size_t i = 0; i < n; i++) {
+    cfs->table->vruntime[pids[i] - 1] = cfs_place_new(cfs);
+  }
+  push(cfs, pids, n);
+}
+
+//one at a time so every pick sees the latest vruntimes
+static size_t policy_try_pick(void* state, ProcessIdT* pids, size_t max) {
+  CfsT* cfs = (CfsT*)state;
+  uint64_t vruntime;
+  return picked(cfs, &vruntime, priority_queue_try_pop_many(&cfs->queue, pids, &vruntime, 1));
+}
+
+static size_t policy_pick_next(void* state, ProcessIdT* pids, size_t max) {
+  CfsT* cfs = (CfsT*)state;
+  uint64_t vruntime;
+  return picked(cfs, &vruntime, priority_queue_pop_many(&cfs->queue, pids, &vruntime, 1));
+}
+
+static void policy_on_preempt(void* state, ProcessIdT const* pids, EvaluatorResultT const* results, size_t n) {
+  CfsT* cfs = (CfsT*)state;
+  for (size_t i = 0; i < n; i++) {
+    charge(cfs, pids[i], &results[i]);
+  }
+  push(cfs, pids, n);
+}
+
+static void policy_on_block(void* state, ProcessIdT pid, EvaluatorResultT const* result) {
+  charge((CfsT*)state, pid, result);
+}
+
+static void policy_on_wake(void* state, ProcessIdT const* pids, size_t n) {
+  CfsT* cfs = (CfsT*)state;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t* vruntime = &cfs->table->vruntime[pids[i] - 1];
+    *vruntime = cfs_place_woken(cfs, *vruntime);
+  }
+  push(cfs, pids, n);
+}
+
+static size_t policy_length(void* state) {
+  return priority_queue_length(&((CfsT*)state)->queue);
+}
+
+static void policy_terminate(void* state, int waiters) {
+  priority_queue_terminate(&((CfsT*)state)->queue);
+}
+
+SchedulerOpsT const scheduler_cfs = {
+  .name = "cfs",
+  .create = policy_create,
+  .destroy = policy_destroy,
+  .enqueue = policy_enqueue,
+  .try_pick = policy_try_pick,
+  .pick_next = policy_pick_next,
+  .on_preempt = policy_on_preempt,
+  .on_block = policy_on_block,
+  .on_wake = policy_on_wake,
+  .on_exit = NULL,
+  .length = policy_length,
+  .terminate = policy_terminate,
+};
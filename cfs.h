@@ -0,0 +1,38 @@
+#ifndef _CFS_H_
+#define _CFS_H_
+
+#include "priority_queue.h"
+#include "process_table.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CFS_NICE_0_WEIGHT 1024
+
+//a process waking from a block may be up to this far behind min_vruntime,
+//half a scheduling period of six time slices
+#define CFS_SLEEPER_CREDIT (3 * TIME_SLICE_LENGTH)
+
+// Completely fair run queue - runnable pids ordered by virtual runtime,
+// the process that has had the least weighted cpu time runs next. Used
+// through scheduler_cfs.
+typedef struct Cfs {
+  PriorityQueueT queue;
+  ProcessTableT* table; //vruntime and nice of every process
+  uint64_t min_vruntime; //smallest vruntime picked so far, never decreases
+} CfsT;
+
+void cfs_create(CfsT* cfs, ProcessTableT* table);
+void cfs_destroy(CfsT* cfs);
+
+// Load weight of a nice level, clamped to -20..19
+unsigned int cfs_nice_weight(int nice);
+// Virtual time charged for running cpu_time cycles at the given nice level
+uint64_t cfs_charge(unsigned int cpu_time, int nice);
+
+// Starting vruntime of a new process - one slice after the current minimum
+uint64_t cfs_place_new(CfsT* cfs);
+// Vruntime of a process that slept, so it neither loses its place nor
+// builds up credit that would let it starve everyone else
+uint64_t cfs_place_woken(CfsT* cfs, uint64_t vruntime);
+
+#endif
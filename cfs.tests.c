@@ -0,0 +1,156 @@
+#include "cfs.h"
+#include "scheduler.h"
+#include "simulator.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+SimulatorT simulator;
+ProcessTableT* table;
+CfsT* cfs;
+
+// Just what the policy reads of a simulator
+void setup() {
+  memset(&simulator, 0, sizeof(simulator));
+  config_defaults(&simulator.config);
+  process_table_create(&simulator.process_table, 16);
+  table = &simulator.process_table;
+  cfs = (CfsT*)scheduler_cfs.create(&simulator);
+}
+
+void teardown() {
+  scheduler_cfs.destroy(cfs);
+  process_table_destroy(&simulator.process_table);
+}
+
+ProcessIdT pick() {
+  ProcessIdT picked[4];
+  //one at a time however many are asked for
+  assert(scheduler_cfs.try_pick(cfs, picked, 4) == 1);
+  return picked[0];
+}
+
+// Run pid for a whole slice and put it back
+void run(ProcessIdT pid) {
+  EvaluatorResultT const result = { 0, TIME_SLICE_LENGTH, reason_timeslice_ended };
+  scheduler_cfs.on_preempt(cfs, &pid, &result, 1);
+}
+
+void test_weights() {
+  printf("testing nice levels weigh the virtual time charged\n");
+  assert(cfs_nice_weight(0) == CFS_NICE_0_WEIGHT);
+  assert(cfs_nice_weight(-20) == 88761 && cfs_nice_weight(19) == 15);
+  //out of range levels are clamped
+  assert(cfs_nice_weight(-30) == cfs_nice_weight(-20));
+  assert(cfs_nice_weight(25) == cfs_nice_weight(19));
+  for (int nice = -20; nice < 19; nice++) {
+    assert(cfs_nice_weight(nice) > cfs_nice_weight(nice + 1));
+  }
+  assert(cfs_charge(1000, 0) == 1000);
+  assert(cfs_charge(1000, -5) < 1000);
+  assert(cfs_charge(1000, 5) > 1000);
+  assert(cfs_charge(1000, 5) == 1000ull * CFS_NICE_0_WEIGHT / 335);
+}
+
+void test_vruntime_order() {
+  printf("testing the least virtual time runs next and moves the minimum\n");
+  setup();
+  ProcessIdT const pids[] = { 1, 2, 3 };
+  scheduler_cfs.enqueue(cfs, pids, 3);
+  //new processes start a slice past the minimum
+  for (int i = 0; i < 3; i++) {
+    assert(table->vruntime[pids[i] - 1] == TIME_SLICE_LENGTH);
+  }
+  ProcessIdT const first = pick(), second = pick(), third = pick();
+  assert(cfs->min_vruntime == TIME_SLICE_LENGTH);
+
+  //charged different amounts, they come back least charged first
+  EvaluatorResultT const results[] = {
+    { 0, 3 * TIME_SLICE_LENGTH, reason_timeslice_ended },
+    { 0, TIME_SLICE_LENGTH, reason_timeslice_ended },
+    { 0, 2 * TIME_SLICE_LENGTH, reason_timeslice_ended },
+  };
+  ProcessIdT const ran[] = { first, second, third };
+  scheduler_cfs.on_preempt(cfs, ran, results, 3);
+  assert(pick() == second);
+  assert(cfs->min_vruntime == 2 * TIME_SLICE_LENGTH);
+  assert(pick() == third);
+  assert(pick() == first);
+  assert(cfs->min_vruntime == 4 * TIME_SLICE_LENGTH);
+
+  //a late arrival starts near the minimum instead of far ahead of it
+  ProcessIdT const late = 4;
+  scheduler_cfs.enqueue(cfs, &late, 1);
+  assert(table->vruntime[late - 1] == 5 * TIME_SLICE_LENGTH);
+  teardown();
+}
+
+void test_sleeper_credit() {
+  printf("testing a woken process keeps its place but no more than its credit\n");
+  setup();
+  cfs->min_vruntime = 100 * TIME_SLICE_LENGTH;
+  //slept through a long stretch, it is brought up to the credit
+  table->vruntime[1 - 1] = 10 * TIME_SLICE_LENGTH;
+  //barely behind, it keeps what it had
+  table->vruntime[2 - 1] = 99 * TIME_SLICE_LENGTH;
+  ProcessIdT const pids[] = { 1, 2 };
+  scheduler_cfs.on_wake(cfs, pids, 2);
+  assert(table->vruntime[1 - 1] == 100 * TIME_SLICE_LENGTH - CFS_SLEEPER_CREDIT);
+  assert(table->vruntime[2 - 1] == 99 * TIME_SLICE_LENGTH);
+  assert(pick() == 1);
+  assert(pick() == 2);
+  teardown();
+}
+
+void test_nice_share() {
+  printf("testing cpu is shared in proportion to the weights\n");
+  setup();
+  ProcessIdT const pids[] = { 1, 2, 3 };
+  table->nice[2 - 1] = 5;
+  table->nice[3 - 1] = -5;
+  scheduler_cfs.enqueue(cfs, pids, 3);
+  unsigned int runs[4] = { 0 };
+  for (int i = 0; i < 30000; i++) {
+    ProcessIdT const pid = pick();
+    runs[pid]++;
+    run(pid);
+  }
+  //1024 against 335 and 3121, within a few percent
+  double const lighter = (double)runs[1] / runs[2];
+  double const heavier = (double)runs[3] / runs[1];
+  assert(lighter > 1024.0 / 335 * 0.97 && lighter < 1024.0 / 335 * 1.03);
+  assert(heavier > 3121.0 / 1024 * 0.97 && heavier < 3121.0 / 1024 * 1.03);
+  teardown();
+}
+
+void test_large_batch() {
+  printf("testing batches larger than the key buffer are all queued\n");
+  memset(&simulator, 0, sizeof(simulator));
+  config_defaults(&simulator.config);
+  process_table_create(&simulator.process_table, 1000);
+  table = &simulator.process_table;
+  cfs = (CfsT*)scheduler_cfs.create(&simulator);
+  ProcessIdT pids[1000];
+  for (ProcessIdT pid = 1; pid <= 1000; pid++) {
+    pids[pid - 1] = pid;
+    table->vruntime[pid - 1] = 2000 - pid;
+  }
+  EvaluatorResultT results[1000];
+  memset(results, 0, sizeof(results));
+  scheduler_cfs.on_preempt(cfs, pids, results, 1000);
+  assert(scheduler_cfs.length(cfs) == 1000);
+  for (ProcessIdT pid = 1000; pid >= 1; pid--) {
+    assert(pick() == pid);
+  }
+  teardown();
+}
+
+int main() {
+  test_weights();
+  test_vruntime_order();
+  test_sleeper_credit();
+  test_nice_share();
+  test_large_batch();
+  return 0;
+}
@@ -0,0 +1,414 @@
+#include "checkpoint.h"
+#include "utilities.h"
+#include "logger.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static char const magic[8] = "SIMCKPT";
+
+_Static_assert(sizeof(CheckpointHeaderT) <= CHECKPOINT_HEADER_SIZE, "checkpoint header outgrew its page");
+
+void checkpoint_instance_path(char const* path, ConfigT const* config, int id, char* buffer, size_t size) {
+  if (config->instances > 1) {
+    snprintf(buffer, size, "%s.%i", path, id);
+  } else {
+    snprintf(buffer, size, "%s", path);
+  }
+}
+
+// Bytes of one slot of a table of size, whole pages so each can be synced
+static size_t slot_length(uint32_t size) {
+  size_t const length = CHECKPOINT_HEADER_SIZE + (size_t)size * sizeof(CheckpointProcessT);
+  return (length + CHECKPOINT_HEADER_SIZE - 1) / CHECKPOINT_HEADER_SIZE * CHECKPOINT_HEADER_SIZE;
+}
+
+static CheckpointHeaderT* slot_header(void* map, size_t slot_length, unsigned int slot) {
+  return (CheckpointHeaderT*)((char*)map + slot * slot_length);
+}
+
+static CheckpointProcessT* records(CheckpointHeaderT* header) {
+  return (CheckpointProcessT*)((char*)header + CHECKPOINT_HEADER_SIZE);
+}
+
+// Time relative to the file being opened, keeping 0 as 0
+static int64_t relative(uint64_t time, uint64_t origin) {
+  return time == 0 ? 0 : (int64_t)(time - origin);
+}
+
+static uint64_t absolute(int64_t time, uint64_t origin) {
+  return time == 0 ? 0 : origin + time;
+}
+
+// Where the first checkpoint is written before it takes the place of path
+static void temporary_path(char const* path, char* buffer, size_t size) {
+  snprintf(buffer, size, "%s.tmp", path);
+}
+
+// Map a fresh file for the simulator's table, returns NULL on failure. It
+// is written under a temporary name, so a checkpoint already at path stays
+// whole until the first one into the new file is.
+static CheckpointT* checkpoint_open(SimulatorT* simulator, char const* path) {
+  ProcessTableT* table = &simulator->process_table;
+  size_t const slot_size = slot_length(table->size);
+  size_t const length = CHECKPOINT_SLOTS * slot_size;
+  char temporary[CONFIG_PATH_LENGTH + 16];
+  temporary_path(path, temporary, sizeof(temporary));
+  int const fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("Failed to open checkpoint");
+    return NULL;
+  }
+  if (ftruncate(fd, length) != 0) {
+    perror("Failed to size checkpoint");
+    close(fd);
+    unlink(temporary);
+    return NULL;
+  }
+  void* map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    perror("Failed to map checkpoint");
+    close(fd);
+    unlink(temporary);
+    return NULL;
+  }
+
+  CheckpointT* checkpoint = (CheckpointT*)checked_malloc(sizeof(CheckpointT));
+  snprintf(checkpoint->path, sizeof(checkpoint->path), "%s", path);
+  checkpoint->fd = fd;
+  checkpoint->map = map;
+  checkpoint->length = length;
+  checkpoint->slot_length = slot_size;
+  checkpoint->opened = process_table_now();
+  checkpoint->sequence = 0;
+
+  //both slots read as torn until written, and everything is due in each
+  for (unsigned int slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+    CheckpointHeaderT* header = slot_header(map, slot_size, slot);
+    memcpy(header->magic, magic, sizeof(magic));
+    header->version = CHECKPOINT_VERSION;
+    header->size = table->size;
+    header->writing = 1;
+    checkpoint->stale[slot] = (uint64_t*)checked_malloc(table->dirty_words * sizeof(uint64_t));
+    memset(checkpoint->stale[slot], 0xff, table->dirty_words * sizeof(uint64_t));
+  }
+  return checkpoint;
+}
+
+void simulator_checkpoint_close(SimulatorT* simulator) {
+  CheckpointT* checkpoint = simulator->checkpoint;
+  if (checkpoint == NULL) return;
+  //a file that never got a whole checkpoint is no use to anyone
+  if (checkpoint->sequence == 0) {
+    char temporary[CONFIG_PATH_LENGTH + 16];
+    temporary_path(checkpoint->path, temporary, sizeof(temporary));
+    unlink(temporary);
+  }
+  munmap(checkpoint->map, checkpoint->length);
+  close(checkpoint->fd);
+  for (unsigned int slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+    checked_free(checkpoint->stale[slot]);
+  }
+  checked_free(checkpoint);
+  simulator->checkpoint = NULL;
+}
+
+// Copy one process into its record, returns 0 if its code has no id
+static int save_process(SimulatorT* simulator, ProcessIdT pid, CheckpointProcessT* record, uint64_t opened) {
+  ProcessTableT* table = &simulator->process_table;
+  ProcessHotT const* process = process_table_hot(table, pid);
+  memset(record, 0, sizeof(CheckpointProcessT));
+  record->state = __atomic_load_n(&process->state, __ATOMIC_ACQUIRE);
+  if (record->state == unallocated) return 1;
+
+  record->code_id = evaluator_code_id(process->eval_code);
+  record->parameter = process->eval_code.parameter;
+  record->pc = process->pc;
+  record->dispatches = table->dispatches[pid - 1];
+  record->completed = table->completed[pid - 1];
+  record->nice = table->nice[pid - 1];
+  record->density = table->density[pid - 1];
+  record->created = relative(table->created[pid - 1], opened);
+  record->ready_since = relative(table->ready_since[pid - 1], opened);
+  record->deadline = relative(table->deadline[pid - 1], opened);
+  record->vruntime = table->vruntime[pid - 1];
+  record->cpu_time = table->cpu_time[pid - 1];
+  return record->code_id != EVALUATOR_UNKNOWN_CODE;
+}
+
+static void sum_workers(SimulatorT* simulator, WorkerMetricsT* totals) {
+  memset(totals, 0, sizeof(WorkerMetricsT));
+  simulator_worker_metrics_add(totals, &simulator->carried);
+  for (int w = 0; w < simulator->thread_count; w++) {
+    simulator_worker_metrics_add(totals, &simulator->worker_metrics[w]);
+  }
+}
+
+// Copy every chunk with a bit set in dirty into records, returns how many
+static unsigned int copy_chunks(SimulatorT* simulator, CheckpointProcessT* records, uint64_t const* dirty,
+				uint64_t opened, int* failed) {
+  ProcessTableT* table = &simulator->process_table;
+  unsigned int chunks = 0;
+  for (unsigned int word = 0; word < table->dirty_words; word++) {
+    for (uint64_t bits = dirty[word]; bits != 0; bits &= bits - 1) {
+      unsigned int const chunk = word * 64 + __builtin_ctzll(bits);
+      ProcessIdT const first = chunk * PROCESS_TABLE_CHUNK + 1;
+      if (first > table->size) break;
+      chunks++;
+      for (ProcessIdT pid = first; pid < first + PROCESS_TABLE_CHUNK && pid <= table->size; pid++) {
+	if (!save_process(simulator, pid, &records[pid - 1], opened)) {
+	  //try again next time in case it was a one off
+	  process_table_touch(table, pid);
+	  *failed = 1;
+	}
+      }
+    }
+  }
+  return chunks;
+}
+
+// Take the table's dirty bits into dirty for the slot being written, the
+// other slots get them once it is their turn
+static void take_dirty(ProcessTableT* table, CheckpointT* checkpoint, unsigned int written, uint64_t* dirty) {
+  for (unsigned int word = 0; word < table->dirty_words; word++) {
+    dirty[word] = process_table_take_dirty(table, word);
+    for (unsigned int slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+      if (slot != written) checkpoint->stale[slot][word] |= dirty[word];
+    }
+  }
+}
+
+int simulator_checkpoint(SimulatorT* simulator, char const* path) {
+  pthread_mutex_lock(&simulator->checkpoint_lock);
+
+  //a new path starts over with everything
+  if (simulator->checkpoint == NULL || strcmp(simulator->checkpoint->path, path) != 0) {
+    simulator_checkpoint_close(simulator);
+    simulator->checkpoint = checkpoint_open(simulator, path);
+    if (simulator->checkpoint == NULL) {
+      pthread_mutex_unlock(&simulator->checkpoint_lock);
+      return 1;
+    }
+  }
+  CheckpointT* checkpoint = simulator->checkpoint;
+  ProcessTableT* table = &simulator->process_table;
+  //the other slot keeps the last checkpoint whole while this one is written
+  unsigned int const slot = checkpoint->sequence % CHECKPOINT_SLOTS;
+  CheckpointHeaderT* header = slot_header(checkpoint->map, checkpoint->slot_length, slot);
+  CheckpointProcessT* slot_records = records(header);
+  uint64_t* stale = checkpoint->stale[slot];
+  uint64_t dirty[table->dirty_words];
+  header->writing = 1;
+
+  //copy what changed before the last checkpoint while the workers carry
+  //on - all of it for a new file. A record changing under the copy is
+  //left dirty and copied once more below, as the dirty bits are only
+  //taken with the workers held.
+  int failed = 0;
+  unsigned int const chunks = copy_chunks(simulator, slot_records, stale, checkpoint->opened, &failed);
+  memset(stale, 0, table->dirty_words * sizeof(uint64_t));
+
+  //hold workers between batches, and creation, so no process is half way
+  //through a change - they only wait for what changed during the copy
+  uint64_t const paused = process_table_now();
+  pthread_rwlock_wrlock(&simulator->pause_lock);
+  pthread_mutex_lock(&simulator->table_lock);
+
+  uint64_t const now = process_table_now();
+  take_dirty(table, checkpoint, slot, dirty);
+  unsigned int const held_chunks = copy_chunks(simulator, slot_records, dirty, checkpoint->opened, &failed);
+
+  header->elapsed = now - checkpoint->opened;
+  header->throttles = __atomic_load_n(&simulator->throttles, __ATOMIC_RELAXED);
+  edf_stats((EdfT*)simulator->scheduler_state, &header->realtime);
+  sum_workers(simulator, &header->totals);
+  header->sequence = ++checkpoint->sequence;
+
+  pthread_mutex_unlock(&simulator->table_lock);
+  pthread_rwlock_unlock(&simulator->pause_lock);
+  header->pause_ns = process_table_now() - paused;
+
+  //the records reach the disk before the header says they are whole, the
+  //process dying at any point loses nothing as the pages are in the cache
+  msync(header, checkpoint->slot_length, MS_SYNC);
+  header->writing = 0;
+  msync(header, CHECKPOINT_HEADER_SIZE, MS_SYNC);
+
+  //the first whole checkpoint replaces whatever was at path
+  if (checkpoint->sequence == 1) {
+    char temporary[CONFIG_PATH_LENGTH + 16];
+    temporary_path(path, temporary, sizeof(temporary));
+    if (rename(temporary, path) != 0) {
+      perror("Failed to replace checkpoint");
+      failed = 1;
+    }
+  }
+
+  LOG(log_debug, log_general, "Simulator %i - Checkpoint %lu: %u chunks, %u with workers held for %.3fms",
+      simulator->id, (unsigned long)header->sequence, chunks + held_chunks, held_chunks, header->pause_ns / 1e6);
+  if (failed) {
+    LOG(log_warning, log_general, "Simulator %i - Checkpoint %lu left out processes or was not saved",
+	simulator->id, (unsigned long)header->sequence);
+  }
+
+  pthread_mutex_unlock(&simulator->checkpoint_lock);
+  return failed;
+}
+
+// Mapped checkpoint if usable, NULL otherwise - header is set to the
+// newest whole slot
+static void* map_checkpoint(char const* path, size_t* length, CheckpointHeaderT** header) {
+  int const fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror("Failed to open checkpoint");
+    return NULL;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || (size_t)status.st_size < CHECKPOINT_HEADER_SIZE) {
+    fprintf(stderr, "Checkpoint %s is too short\n", path);
+    close(fd);
+    return NULL;
+  }
+  *length = status.st_size;
+  void* map = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror("Failed to map checkpoint");
+    return NULL;
+  }
+
+  //the first slot says how long every slot is
+  CheckpointHeaderT const* first = (CheckpointHeaderT const*)map;
+  size_t const slot_size = slot_length(first->size);
+  char const* problem = NULL;
+  *header = NULL;
+  if (memcmp(first->magic, magic, sizeof(magic)) != 0) {
+    problem = "is not a checkpoint";
+  } else if (first->version != CHECKPOINT_VERSION) {
+    problem = "has another version";
+  } else if (*length < CHECKPOINT_SLOTS * slot_size) {
+    problem = "is truncated";
+  } else {
+    //the newest whole slot, a crash while writing one leaves the other
+    problem = "was torn while being written";
+    for (unsigned int slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+      CheckpointHeaderT* candidate = slot_header(map, slot_size, slot);
+      if (candidate->writing || candidate->size != first->size) continue;
+      if (*header == NULL || candidate->sequence > (*header)->sequence) {
+	*header = candidate;
+      }
+    }
+  }
+  if (*header == NULL) {
+    fprintf(stderr, "Checkpoint %s %s\n", path, problem);
+    munmap(map, *length);
+    return NULL;
+  }
+  return map;
+}
+
+SimulatorT* simulator_restore(ConfigT const* config, cpu_set_t const* cpus, char const* path) {
+  uint64_t const start = process_table_now();
+  size_t length;
+  CheckpointHeaderT* header;
+  void* map = map_checkpoint(path, &length, &header);
+  if (map == NULL) return NULL;
+
+  //room for every saved process
+  ConfigT restored = *config;
+  if (restored.max_processes < header->size) {
+    restored.max_processes = header->size;
+  }
+  SimulatorT* simulator = simulator_start(&restored, cpus);
+  ProcessTableT* table = &simulator->process_table;
+  simulator->restored = (ProcessIdT*)checked_malloc(header->size * sizeof(ProcessIdT));
+
+  //nothing runs yet, but creation may start as soon as this returns
+  pthread_mutex_lock(&simulator->table_lock);
+
+  //the allocator starts out with every pid, keep only the unused ones
+  ProcessIdT pid;
+  while (blocking_queue_try_pop(&simulator->pid_queue, &pid) == 0) ;
+
+  ProcessIdT* runnable = (ProcessIdT*)checked_malloc(header->size * sizeof(ProcessIdT));
+  size_t runnable_count = 0;
+  //the last checkpoint becomes now, so deadlines keep the slack they had
+  uint64_t const now = process_table_now();
+  uint64_t const opened = now - header->elapsed;
+  for (pid = 1; pid <= table->size; pid++) {
+    CheckpointProcessT const* record = &records(header)[pid - 1];
+    ProcessHotT* process = process_table_hot(table, pid);
+    if (pid > header->size || record->state == unallocated || record->state > terminated ||
+	evaluator_code_from_id(record->code_id, record->parameter, &process->eval_code) != 0) {
+      blocking_queue_push(&simulator->pid_queue, pid);
+      continue;
+    }
+
+    process->pc = record->pc;
+    table->dispatches[pid - 1] = record->dispatches;
+    table->completed[pid - 1] = record->completed;
+    table->nice[pid - 1] = record->nice;
+    table->density[pid - 1] = record->density;
+    table->created[pid - 1] = absolute(record->created, opened);
+    table->deadline[pid - 1] = absolute(record->deadline, opened);
+    table->vruntime[pid - 1] = record->vruntime;
+    table->cpu_time[pid - 1] = record->cpu_time;
+    table->ready_since[pid - 1] = now;
+    process_table_touch(table, pid);
+
+    //admission counted the share when it was created
+    if (record->density > 0) {
+      __atomic_fetch_add(&((EdfT*)simulator->scheduler_state)->load, record->density, __ATOMIC_RELAXED);
+    }
+
+    if (record->state == terminated) {
+      process->state = terminated;
+      process_table_signal(table, pid);
+    } else {
+      process->state = ready;
+      runnable[runnable_count++] = pid;
+    }
+    simulator->restored[simulator->restored_count++] = pid;
+  }
+
+  pthread_mutex_unlock(&simulator->table_lock);
+
+  //statistics carry on from where they were - nothing has run yet, so
+  //only the counters the workers write as they go need care
+  simulator->carried = header->totals;
+  __atomic_fetch_add(&simulator->throttles, header->throttles, __ATOMIC_RELAXED);
+  EdfStatsT* realtime = &((EdfT*)simulator->scheduler_state)->stats;
+  __atomic_fetch_add(&realtime->admitted, header->realtime.admitted, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&realtime->refused, header->realtime.refused, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&realtime->met, header->realtime.met, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&realtime->missed, header->realtime.missed, __ATOMIC_RELAXED);
+  for (int b = 0; b < EDF_LATENESS_BUCKETS; b++) {
+    __atomic_fetch_add(&realtime->lateness[b], header->realtime.lateness[b], __ATOMIC_RELAXED);
+  }
+
+  if (runnable_count > 0) {
+    simulator->scheduler->enqueue(simulator->scheduler_state, runnable, runnable_count);
+  }
+  checked_free(runnable);
+
+  LOG(log_info, log_general, "Simulator %i - Restored %u processes from checkpoint %lu of %s in %.3fms",
+      simulator->id, simulator->restored_count, (unsigned long)header->sequence, path,
+      (process_table_now() - start) / 1e6);
+  munmap(map, length);
+  return simulator;
+}
+
+void simulator_wait_restored(SimulatorT* simulator) {
+  for (unsigned int i = 0; i < simulator->restored_count; i++) {
+    ProcessIdT const pid = simulator->restored[i];
+    EvaluatorCodeT const code = process_table_hot(&simulator->process_table, pid)->eval_code;
+    if (evaluator_remaining_steps(code, 0) == EVALUATOR_UNKNOWN_STEPS) {
+      simulator_kill(simulator, pid);
+    }
+    simulator_wait(simulator, pid);
+  }
+  simulator->restored_count = 0;
+}
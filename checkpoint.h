@@ -0,0 +1,81 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include "simulator.h"
+#include <stdint.h>
+
+#define CHECKPOINT_VERSION 3
+//each slot's header has a page to itself, process records follow it
+#define CHECKPOINT_HEADER_SIZE 4096
+//checkpoints alternate between the slots, so one is always whole
+#define CHECKPOINT_SLOTS 2
+
+// One process, with no pointers and times relative to when the file was
+// opened so it can be loaded by another run or build
+typedef struct CheckpointProcess {
+  uint32_t code_id; //evaluator_code_id, 0 for an unallocated entry
+  uint32_t parameter;
+  uint32_t pc;
+  uint32_t dispatches;
+  uint8_t state; //ProcessStateT
+  uint8_t completed;
+  int8_t nice;
+  uint8_t unused;
+  uint32_t density;
+  int64_t created; //nanoseconds from the file being opened, negative before
+  int64_t ready_since;
+  int64_t deadline; //0 for best effort processes
+  uint64_t vruntime;
+  uint64_t cpu_time;
+} CheckpointProcessT;
+
+// Start of each slot
+typedef struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t size; //process records that follow
+  uint32_t writing; //set while a checkpoint is being copied in, the slot is torn
+  uint32_t unused;
+  uint64_t sequence; //of the checkpoint in the slot, the newer slot is restored
+  uint64_t pause_ns; //how long the last checkpoint held the workers
+  uint64_t elapsed; //from the file being opened to the last checkpoint, records only change when dirty
+  uint64_t throttles;
+  EdfStatsT realtime;
+  WorkerMetricsT totals; //summed over the workers
+} CheckpointHeaderT;
+
+// Open checkpoint file, kept mapped so later checkpoints only copy the
+// chunks of the process table that changed since the slot they go into
+// was last written
+typedef struct Checkpoint {
+  char path[CONFIG_PATH_LENGTH + 12];
+  int fd;
+  void* map;
+  size_t length;
+  size_t slot_length;
+  uint64_t opened; //origin of the times in the records
+  uint64_t sequence; //checkpoints written so far
+  uint64_t* stale[CHECKPOINT_SLOTS]; //dirty bits per slot, of chunks changed since it was written
+} CheckpointT;
+
+// Path of instance id's own checkpoint when a run has several instances
+void checkpoint_instance_path(char const* path, ConfigT const* config, int id, char* buffer, size_t size);
+
+// Write the process table, pid allocator and statistics to path. The
+// first checkpoint to a path writes everything to a new file that only
+// replaces the old one once complete, later ones only what changed since.
+// Most of the copy is made while the workers run, they are only held to
+// copy again what changed meanwhile. Returns 0 on success.
+int simulator_checkpoint(SimulatorT* simulator, char const* path);
+// Unmap the file of the last checkpoint, done by simulator_stop
+void simulator_checkpoint_close(SimulatorT* simulator);
+
+// Start a simulator with the processes and statistics saved in path.
+// Processes that were running or blocked come back ready, and groups are
+// not restored as the clients owning them are gone. Returns NULL if the
+// file cannot be used.
+SimulatorT* simulator_restore(ConfigT const* config, cpu_set_t const* cpus, char const* path);
+// Kill restored processes that never finish and wait for all of them
+void simulator_wait_restored(SimulatorT* simulator);
+
+#endif
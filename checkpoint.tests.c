@@ -0,0 +1,181 @@
+#include "checkpoint.h"
+#include "logger.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+char path[64];
+ConfigT config;
+
+void setup() {
+  snprintf(path, sizeof(path), "/tmp/checkpoint.tests.%i", (int)getpid());
+  config_defaults(&config);
+  config.simulator_threads = 2;
+  config.max_processes = 200;
+}
+
+// Wait for pid to finish without releasing it, so it stays in the table
+void finished(SimulatorT* simulator, ProcessIdT pid) {
+  while (!process_table_signalled(&simulator->process_table, pid)) {
+    usleep(1000);
+  }
+}
+
+void test_round_trip() {
+  printf("testing a checkpoint restores the processes it saved\n");
+  setup();
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  //spread over several chunks of the table
+  ProcessIdT forever[100];
+  for (int i = 0; i < 100; i++) {
+    forever[i] = simulator_create_process(simulator, evaluator_infinite_loop);
+    simulator_set_nice(simulator, forever[i], i % 40 - 20);
+  }
+  ProcessIdT done[10];
+  for (int i = 0; i < 10; i++) {
+    done[i] = simulator_create_process(simulator, evaluator_terminates_after(2));
+  }
+  for (int i = 0; i < 10; i++) {
+    finished(simulator, done[i]);
+  }
+  assert(simulator_checkpoint(simulator, path) == 0);
+  //the new file took the place of the path once complete
+  char temporary[80];
+  snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+  assert(access(path, F_OK) == 0);
+  assert(access(temporary, F_OK) != 0);
+
+  SimulatorT* restored = simulator_restore(&config, NULL, path);
+  assert(restored != NULL);
+  assert(restored->restored_count == 110);
+  ProcessTableT* table = &restored->process_table;
+  for (int i = 0; i < 100; i++) {
+    ProcessHotT* process = process_table_hot(table, forever[i]);
+    assert(evaluator_code_id(process->eval_code) == evaluator_code_id(evaluator_infinite_loop));
+    assert(table->nice[forever[i] - 1] == i % 40 - 20);
+    assert(process->state != terminated && process->state != unallocated);
+    //it only ran on in the first simulator after the copy
+    assert(process->pc <= process_table_hot(&simulator->process_table, forever[i])->pc);
+  }
+  for (int i = 0; i < 10; i++) {
+    ProcessHotT* process = process_table_hot(table, done[i]);
+    assert(process->state == terminated);
+    assert(table->completed[done[i] - 1] == 1);
+    assert(process->pc == process_table_hot(&simulator->process_table, done[i])->pc);
+  }
+  simulator_wait_restored(restored);
+  simulator_stop(restored);
+
+  for (int i = 0; i < 100; i++) {
+    simulator_kill(simulator, forever[i]);
+  }
+  for (int i = 0; i < 100; i++) {
+    simulator_wait(simulator, forever[i]);
+  }
+  for (int i = 0; i < 10; i++) {
+    simulator_wait(simulator, done[i]);
+  }
+  simulator_stop(simulator);
+  unlink(path);
+}
+
+// Mark the slot holding the newest whole checkpoint as torn, as a crash half way
+// through writing it would
+void tear_newest(void) {
+  int const fd = open(path, O_RDWR);
+  assert(fd >= 0);
+  CheckpointHeaderT headers[CHECKPOINT_SLOTS];
+  off_t const slot_length = lseek(fd, 0, SEEK_END) / CHECKPOINT_SLOTS;
+  int newest = -1;
+  for (int slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+    assert(pread(fd, &headers[slot], sizeof(CheckpointHeaderT), slot * slot_length) == sizeof(CheckpointHeaderT));
+    if (!headers[slot].writing && (newest < 0 || headers[slot].sequence > headers[newest].sequence)) {
+      newest = slot;
+    }
+  }
+  assert(newest >= 0);
+  headers[newest].writing = 1;
+  assert(pwrite(fd, &headers[newest], sizeof(CheckpointHeaderT), newest * slot_length) == sizeof(CheckpointHeaderT));
+  close(fd);
+}
+
+void test_torn_slot() {
+  printf("testing a torn checkpoint falls back to the one before\n");
+  setup();
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  ProcessIdT first = simulator_create_process(simulator, evaluator_terminates_after(1));
+  finished(simulator, first);
+  assert(simulator_checkpoint(simulator, path) == 0);
+  ProcessIdT second = simulator_create_process(simulator, evaluator_terminates_after(1));
+  finished(simulator, second);
+  assert(simulator_checkpoint(simulator, path) == 0);
+  simulator_wait(simulator, first);
+  simulator_wait(simulator, second);
+  simulator_stop(simulator);
+
+  //both processes are in the newest checkpoint, only the first before it
+  SimulatorT* restored = simulator_restore(&config, NULL, path);
+  assert(restored->restored_count == 2);
+  simulator_wait_restored(restored);
+  simulator_stop(restored);
+
+  tear_newest();
+  restored = simulator_restore(&config, NULL, path);
+  assert(restored != NULL);
+  assert(restored->restored_count == 1);
+  assert(process_table_hot(&restored->process_table, first)->state == terminated);
+  simulator_wait_restored(restored);
+  simulator_stop(restored);
+
+  //with both torn there is nothing left to restore
+  tear_newest();
+  assert(simulator_restore(&config, NULL, path) == NULL);
+  unlink(path);
+}
+
+void test_old_file_replaced() {
+  printf("testing a new checkpoint file replaces the old one whole\n");
+  setup();
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  ProcessIdT pid = simulator_create_process(simulator, evaluator_terminates_after(1));
+  finished(simulator, pid);
+  assert(simulator_checkpoint(simulator, path) == 0);
+  simulator_wait(simulator, pid);
+  simulator_stop(simulator);
+  struct stat before;
+  assert(stat(path, &before) == 0);
+
+  //another simulator writes a file of its own and renames it over the old
+  //one, which is never truncated or written in place
+  simulator = simulator_start(&config, NULL);
+  assert(simulator_checkpoint(simulator, path) == 0);
+  struct stat after;
+  assert(stat(path, &after) == 0);
+  assert(after.st_ino != before.st_ino);
+  //later checkpoints go into the same file
+  assert(simulator_checkpoint(simulator, path) == 0);
+  struct stat again;
+  assert(stat(path, &again) == 0);
+  assert(again.st_ino == after.st_ino);
+  simulator_stop(simulator);
+
+  SimulatorT* restored = simulator_restore(&config, NULL, path);
+  assert(restored != NULL && restored->restored_count == 0);
+  simulator_stop(restored);
+  unlink(path);
+}
+
+int main() {
+  //per process events would bury the test output
+  logger_configure(log_warning, ~0u, 1);
+  logger_start();
+  test_round_trip();
+  test_torn_slot();
+  test_old_file_replaced();
+  logger_stop();
+  return 0;
+}
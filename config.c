@@ -0,0 +1,459 @@
+#include "config.h"
+#include "evaluator.h"
+#include "logger.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+
+#ifndef SIMULATOR_THREADS
+#define SIMULATOR_THREADS 2
+#endif
+
+//elastic pool cap, 0 keeps simulator threads fixed
+#ifndef SIMULATOR_MAX_THREADS
+#define SIMULATOR_MAX_THREADS 0
+#endif
+
+#ifndef SIMULATOR_MAX_PROCESSES
+#define SIMULATOR_MAX_PROCESSES 2048
+#endif
+
+#ifndef ENVIRONMENT_THREADS
+#define ENVIRONMENT_THREADS 2
+#endif
+
+#ifndef ENVIRONMENT_CLIENTS
+#define ENVIRONMENT_CLIENTS 2
+#endif
+
+#ifndef ITERATIONS
+#define ITERATIONS 5
+#endif
+
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 10
+#endif
+
+#ifndef EVENT_SOURCE_INTERVAL
+#define EVENT_SOURCE_INTERVAL 10
+#endif
+
+//how evaluations take up their time, evaluator_sleep or evaluator_spin
+#ifndef EVALUATOR_MODE
+#define EVALUATOR_MODE evaluator_sleep
+#endif
+
+//independent simulators run side by side, each on its own share of the cpus
+#ifndef SIMULATOR_INSTANCES
+#define SIMULATOR_INSTANCES 1
+#endif
+
+//forked processes that each run a shard and hand processes to each other
+#ifndef SIMULATOR_SHARDS
+#define SIMULATOR_SHARDS 1
+#endif
+
+//define as a socket path to serve live metrics, e.g. -DMETRICS_SOCKET='"/tmp/sim.sock"'
+#ifndef METRICS_SOCKET
+#define METRICS_SOCKET ""
+#endif
+
+//run queue ordering, rr, cfs or srtf
+#ifndef SCHEDULER_POLICY
+#define SCHEDULER_POLICY policy_round_robin
+#endif
+
+#ifndef SRTF_AGING_US
+#define SRTF_AGING_US 1000
+#endif
+
+//0 keeps every client process the same length
+#ifndef LONG_JOB_PERCENT
+#define LONG_JOB_PERCENT 0
+#endif
+
+//terminating clients ask for real time scheduling with this deadline,
+//falling back to best effort when admission refuses
+#ifndef REALTIME_DEADLINE_US
+#define REALTIME_DEADLINE_US 0
+#endif
+
+#ifndef SIMULATOR_MAX_GROUPS
+#define SIMULATOR_MAX_GROUPS 1024
+#endif
+
+//each client's processes form a group, 0 leaves them unthrottled
+#ifndef GROUP_QUOTA_US
+#define GROUP_QUOTA_US 0
+#endif
+
+#ifndef GROUP_PERIOD_US
+#define GROUP_PERIOD_US 100000
+#endif
+
+//simulated devices blocked processes wait on, with none a blocked
+//process becomes ready on the next event source tick
+#ifndef DISKS
+#define DISKS 0
+#endif
+
+#ifndef DISK_SERVICE_US
+#define DISK_SERVICE_US 200
+#endif
+
+#ifndef DISK_CONCURRENCY
+#define DISK_CONCURRENCY 1
+#endif
+
+#ifndef NETWORKS
+#define NETWORKS 0
+#endif
+
+#ifndef NETWORK_SERVICE_US
+#define NETWORK_SERVICE_US 500
+#endif
+
+#ifndef NETWORK_CONCURRENCY
+#define NETWORK_CONCURRENCY 16
+#endif
+
+//physical page frames shared by every process, 0 runs without virtual memory
+#ifndef FRAMES
+#define FRAMES 0
+#endif
+
+//pages each process touches as it runs
+#ifndef WORKING_SET
+#define WORKING_SET 16
+#endif
+
+//time to bring a faulted page in from swap
+#ifndef FAULT_US
+#define FAULT_US 1000
+#endif
+
+#ifndef SWAP_CONCURRENCY
+#define SWAP_CONCURRENCY 4
+#endif
+
+//debug writes every process event, info only summaries
+#ifndef LOG_LEVEL
+#define LOG_LEVEL log_debug
+#endif
+
+//1 writes every process event
+#ifndef LOG_SAMPLE
+#define LOG_SAMPLE 1
+#endif
+
+//how often a simulator writes its checkpoint, when it has a path
+#ifndef CHECKPOINT_MS
+#define CHECKPOINT_MS 1000
+#endif
+
+#define LOG_ALL_EVENTS ((1u << log_category_count) - 1)
+
+char const* const config_policy_names[policy_count] = { "rr", "cfs", "srtf" };
+
+typedef enum SettingType {
+  setting_unsigned,
+  setting_positive, //unsigned and at least 1
+  setting_path,
+  setting_policy, //one of config_policy_names
+  setting_evaluator, //one of evaluator_mode_names
+  setting_log_level, //one of logger_level_names
+  setting_log_events, //comma separated logger_category_names, all or none
+} SettingTypeT;
+
+typedef struct Setting {
+  char const* name;
+  size_t offset;
+  SettingTypeT type;
+  unsigned int maximum; //largest number or longest path accepted, 0 for no limit
+} SettingT;
+
+static SettingT const settings[] = {
+  { "threads", offsetof(ConfigT, simulator_threads), setting_positive },
+  { "max-threads", offsetof(ConfigT, max_threads), setting_unsigned },
+  { "max-processes", offsetof(ConfigT, max_processes), setting_positive },
+  { "environment-threads", offsetof(ConfigT, environment_threads), setting_positive },
+  { "clients", offsetof(ConfigT, environment_clients), setting_positive },
+  { "iterations", offsetof(ConfigT, iterations), setting_unsigned },
+  { "batch-size", offsetof(ConfigT, batch_size), setting_unsigned },
+  { "event-interval", offsetof(ConfigT, event_source_interval), setting_positive },
+  { "sleep-per-cycle", offsetof(ConfigT, sleep_per_cpu_cycle), setting_unsigned },
+  { "evaluator", offsetof(ConfigT, evaluator), setting_evaluator },
+  { "instances", offsetof(ConfigT, instances), setting_positive },
+  { "shards", offsetof(ConfigT, shards), setting_positive, CONFIG_MAX_SHARDS },
+  { "metrics-socket", offsetof(ConfigT, metrics_socket), setting_path, CONFIG_SOCKET_PATH_LENGTH },
+  { "policy", offsetof(ConfigT, policy), setting_policy },
+  { "aging-us", offsetof(ConfigT, aging_us), setting_positive },
+  { "long-jobs", offsetof(ConfigT, long_jobs), setting_unsigned },
+  { "deadline-us", offsetof(ConfigT, deadline_us), setting_unsigned },
+  { "max-groups", offsetof(ConfigT, max_groups), setting_positive },
+  { "group-quota-us", offsetof(ConfigT, group_quota_us), setting_unsigned },
+  { "group-period-us", offsetof(ConfigT, group_period_us), setting_positive },
+  { "disks", offsetof(ConfigT, disks), setting_unsigned },
+  { "disk-service-us", offsetof(ConfigT, disk_service_us), setting_positive },
+  { "disk-concurrency", offsetof(ConfigT, disk_concurrency), setting_positive },
+  { "networks", offsetof(ConfigT, networks), setting_unsigned },
+  { "network-service-us", offsetof(ConfigT, network_service_us), setting_positive },
+  { "network-concurrency", offsetof(ConfigT, network_concurrency), setting_positive },
+  { "frames", offsetof(ConfigT, frames), setting_unsigned },
+  { "working-set", offsetof(ConfigT, working_set), setting_positive },
+  { "fault-us", offsetof(ConfigT, fault_us), setting_positive },
+  { "swap-concurrency", offsetof(ConfigT, swap_concurrency), setting_positive },
+  { "log-level", offsetof(ConfigT, log_level), setting_log_level },
+  { "log-events", offsetof(ConfigT, log_events), setting_log_events },
+  { "log-sample", offsetof(ConfigT, log_sample), setting_positive },
+  { "checkpoint", offsetof(ConfigT, checkpoint), setting_path },
+  { "checkpoint-ms", offsetof(ConfigT, checkpoint_ms), setting_positive },
+  { "restore", offsetof(ConfigT, restore), setting_path },
+  { "trace", offsetof(ConfigT, trace), setting_path },
+  { "replay", offsetof(ConfigT, replay), setting_path },
+  { "perf-counters", offsetof(ConfigT, perf_counters), setting_unsigned },
+};
+
+#define SETTING_COUNT (sizeof(settings) / sizeof(settings[0]))
+
+static SettingT const* find_setting(char const* key) {
+  for (size_t i = 0; i < SETTING_COUNT; i++) {
+    if (strcmp(settings[i].name, key) == 0) return &settings[i];
+  }
+  return NULL;
+}
+
+// Comma separated category names into a mask, returns 0 on success
+static int parse_log_events(char const* value, unsigned int* mask) {
+  if (strcmp(value, "all") == 0) {
+    *mask = LOG_ALL_EVENTS;
+    return 0;
+  }
+  if (strcmp(value, "none") == 0) {
+    *mask = 0;
+    return 0;
+  }
+
+  unsigned int parsed = 0;
+  char const* name = value;
+  while (1) {
+    size_t const length = strcspn(name, ",");
+    unsigned int category = 0;
+    while (category < log_category_count &&
+	   (strlen(logger_category_names[category]) != length ||
+	    strncmp(name, logger_category_names[category], length) != 0)) {
+      category++;
+    }
+    if (category == log_category_count) {
+      fprintf(stderr, "Unknown log event %.*s\n", (int)length, name);
+      return 1;
+    }
+    parsed |= 1u << category;
+    if (name[length] == '\0') break;
+    name += length + 1;
+  }
+  *mask = parsed;
+  return 0;
+}
+
+void config_defaults(ConfigT* config) {
+  memset(config, 0, sizeof(ConfigT));
+  config->simulator_threads = SIMULATOR_THREADS;
+  config->max_threads = SIMULATOR_MAX_THREADS;
+  config->max_processes = SIMULATOR_MAX_PROCESSES;
+  config->environment_threads = ENVIRONMENT_THREADS;
+  config->environment_clients = ENVIRONMENT_CLIENTS;
+  config->iterations = ITERATIONS;
+  config->batch_size = BATCH_SIZE;
+  config->event_source_interval = EVENT_SOURCE_INTERVAL;
+  config->sleep_per_cpu_cycle = SLEEP_PER_CPU_CYCLE;
+  config->evaluator = EVALUATOR_MODE;
+  config->instances = SIMULATOR_INSTANCES;
+  config->shards = SIMULATOR_SHARDS;
+  config->policy = SCHEDULER_POLICY;
+  config->aging_us = SRTF_AGING_US;
+  config->long_jobs = LONG_JOB_PERCENT;
+  config->deadline_us = REALTIME_DEADLINE_US;
+  config->max_groups = SIMULATOR_MAX_GROUPS;
+  config->group_quota_us = GROUP_QUOTA_US;
+  config->group_period_us = GROUP_PERIOD_US;
+  config->disks = DISKS;
+  config->disk_service_us = DISK_SERVICE_US;
+  config->disk_concurrency = DISK_CONCURRENCY;
+  config->networks = NETWORKS;
+  config->network_service_us = NETWORK_SERVICE_US;
+  config->network_concurrency = NETWORK_CONCURRENCY;
+  config->frames = FRAMES;
+  config->working_set = WORKING_SET;
+  config->fault_us = FAULT_US;
+  config->swap_concurrency = SWAP_CONCURRENCY;
+  config->log_level = LOG_LEVEL;
+  config->log_events = LOG_ALL_EVENTS;
+  config->log_sample = LOG_SAMPLE;
+  config->checkpoint_ms = CHECKPOINT_MS;
+  strncpy(config->metrics_socket, METRICS_SOCKET, CONFIG_PATH_LENGTH - 1);
+}
+
+int config_parse_number(char const* key, char const* value, int positive, unsigned int* number) {
+  //whole non negative numbers only
+  char* end;
+  errno = 0;
+  unsigned long parsed = strtoul(value, &end, 10);
+  if (errno != 0 || end == value || *end != '\0' || value[0] == '-' || parsed > 0xffffffffu ||
+      (positive && parsed == 0)) {
+    fprintf(stderr, "Invalid value %s for %s\n", value, key);
+    return 1;
+  }
+  *number = (unsigned int)parsed;
+  return 0;
+}
+
+int config_set(ConfigT* config, char const* key, char const* value) {
+  SettingT const* setting = find_setting(key);
+  if (setting == NULL) {
+    fprintf(stderr, "Unknown setting %s\n", key);
+    return 1;
+  }
+
+  char* field = (char*)config + setting->offset;
+  if (setting->type == setting_path) {
+    if (strlen(value) >= CONFIG_PATH_LENGTH || (setting->maximum != 0 && strlen(value) > setting->maximum)) {
+      fprintf(stderr, "Value for %s is too long\n", key);
+      return 1;
+    }
+    strcpy(field, value);
+    return 0;
+  }
+
+  if (setting->type == setting_policy) {
+    for (unsigned int policy = 0; policy < policy_count; policy++) {
+      if (strcmp(value, config_policy_names[policy]) == 0) {
+	*(unsigned int*)field = policy;
+	return 0;
+      }
+    }
+    fprintf(stderr, "Unknown policy %s\n", value);
+    return 1;
+  }
+
+  if (setting->type == setting_evaluator) {
+    for (unsigned int mode = 0; mode < evaluator_mode_count; mode++) {
+      if (strcmp(value, evaluator_mode_names[mode]) == 0) {
+	*(unsigned int*)field = mode;
+	return 0;
+      }
+    }
+    fprintf(stderr, "Unknown evaluator %s\n", value);
+    return 1;
+  }
+
+  if (setting->type == setting_log_level) {
+    for (unsigned int level = 0; level < log_level_count; level++) {
+      if (strcmp(value, logger_level_names[level]) == 0) {
+	*(unsigned int*)field = level;
+	return 0;
+      }
+    }
+    fprintf(stderr, "Unknown log level %s\n", value);
+    return 1;
+  }
+
+  if (setting->type == setting_log_events) {
+    return parse_log_events(value, (unsigned int*)field);
+  }
+
+  unsigned int number;
+  if (config_parse_number(key, value, setting->type == setting_positive, &number) != 0) return 1;
+  if (setting->maximum != 0 && number > setting->maximum) {
+    fprintf(stderr, "Value %s for %s is above %u\n", value, key, setting->maximum);
+    return 1;
+  }
+  *(unsigned int*)field = number;
+  return 0;
+}
+
+int config_get(ConfigT const* config, char const* key, char* buffer, size_t size) {
+  SettingT const* setting = find_setting(key);
+  if (setting == NULL) return 1;
+
+  char const* field = (char const*)config + setting->offset;
+  if (setting->type == setting_path) {
+    snprintf(buffer, size, "%s", field);
+  } else if (setting->type == setting_policy) {
+    snprintf(buffer, size, "%s", config_policy_names[*(unsigned int const*)field]);
+  } else if (setting->type == setting_evaluator) {
+    snprintf(buffer, size, "%s", evaluator_mode_names[*(unsigned int const*)field]);
+  } else if (setting->type == setting_log_level) {
+    snprintf(buffer, size, "%s", logger_level_names[*(unsigned int const*)field]);
+  } else if (setting->type == setting_log_events) {
+    unsigned int const mask = *(unsigned int const*)field;
+    if (mask == LOG_ALL_EVENTS || mask == 0) {
+      snprintf(buffer, size, "%s", mask ? "all" : "none");
+      return 0;
+    }
+    size_t used = 0;
+    buffer[0] = '\0';
+    for (unsigned int category = 0; category < log_category_count && used < size; category++) {
+      if (!(mask & (1u << category))) continue;
+      used += snprintf(buffer + used, size - used, "%s%s", used ? "," : "", logger_category_names[category]);
+    }
+  } else {
+    snprintf(buffer, size, "%u", *(unsigned int const*)field);
+  }
+  return 0;
+}
+
+static char* trim(char* text) {
+  while (isspace((unsigned char)*text)) text++;
+  char* end = text + strlen(text);
+  while (end > text && isspace((unsigned char)end[-1])) end--;
+  *end = '\0';
+  return text;
+}
+
+int config_load_file(ConfigT* config, char const* path) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    perror("Failed to open config file");
+    return 1;
+  }
+
+  char line[256];
+  int line_number = 0;
+  int failed = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    line_number++;
+
+    //drop comments and blank lines
+    char* comment = strchr(line, '#');
+    if (comment != NULL) *comment = '\0';
+    char* text = trim(line);
+    if (*text == '\0') continue;
+
+    char* equals = strchr(text, '=');
+    if (equals == NULL) {
+      fprintf(stderr, "%s:%i: expected key = value\n", path, line_number);
+      failed = 1;
+      continue;
+    }
+    *equals = '\0';
+    if (config_set(config, trim(text), trim(equals + 1)) != 0) {
+      fprintf(stderr, "%s:%i: invalid setting\n", path, line_number);
+      failed = 1;
+    }
+  }
+
+  fclose(file);
+  return failed;
+}
+
+void config_print(ConfigT const* config, FILE* out) {
+  char value[CONFIG_PATH_LENGTH];
+  for (size_t i = 0; i < SETTING_COUNT; i++) {
+    config_get(config, settings[i].name, value, sizeof(value));
+    fprintf(out, "  --%s=%s\n", settings[i].name, value);
+  }
+}
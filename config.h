@@ -0,0 +1,84 @@
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include <stdio.h>
+
+#define CONFIG_PATH_LENGTH 108
+//a unix socket path fits in 107 bytes, this leaves room for the .N of each instance
+#define CONFIG_SOCKET_PATH_LENGTH 100
+//every pair of shards shares a pair of rings, so the memory grows with the square
+#define CONFIG_MAX_SHARDS 64
+
+// How the simulator orders its ready processes
+typedef enum SchedulerPolicy {
+  policy_round_robin, //fifo ready queue
+  policy_cfs, //completely fair, least weighted cpu time first
+  policy_srtf, //shortest remaining time first, with aging
+  policy_count,
+} SchedulerPolicyT;
+
+// Names accepted by the policy setting, indexed by SchedulerPolicyT
+extern char const* const config_policy_names[policy_count];
+
+// Run time settings - the compile time defines only provide the defaults
+typedef struct Config {
+  unsigned int simulator_threads; //workers always running
+  unsigned int max_threads; //the pool grows up to this under load, 0 keeps it fixed
+  unsigned int max_processes;
+  unsigned int environment_threads; //carrier threads running the clients
+  unsigned int environment_clients; //clients of each kind, run as coroutines
+  unsigned int iterations;
+  unsigned int batch_size;
+  unsigned int event_source_interval; //microseconds
+  unsigned int sleep_per_cpu_cycle; //microseconds
+  unsigned int evaluator; //EvaluatorModeT, how that time is taken up
+  unsigned int instances;
+  unsigned int shards; //processes the run is split across, exchanging processes to balance
+  unsigned int policy; //SchedulerPolicyT
+  unsigned int aging_us; //srtf - waiting this long is worth one step
+  unsigned int long_jobs; //percent of client processes that run ten times longer
+  unsigned int deadline_us; //relative deadline of terminating client processes, 0 for best effort
+  unsigned int max_groups; //process groups in use at once
+  unsigned int group_quota_us; //worker time each client group gets per period, 0 for unlimited
+  unsigned int group_period_us;
+  unsigned int disks; //blocked processes queue for a device, 0 with no devices at all
+  unsigned int disk_service_us; //mean service time of one request
+  unsigned int disk_concurrency; //requests a device serves at once
+  unsigned int networks;
+  unsigned int network_service_us;
+  unsigned int network_concurrency;
+  unsigned int frames; //physical pages shared by every process, 0 for no virtual memory
+  unsigned int working_set; //pages of each process
+  unsigned int fault_us; //time to load a faulted page
+  unsigned int swap_concurrency; //faults loaded at once
+  unsigned int log_level; //LogLevelT, lower messages are dropped
+  unsigned int log_events; //bit per LogCategoryT that is written
+  unsigned int log_sample; //1 in this many process events is written
+  char metrics_socket[CONFIG_PATH_LENGTH]; //empty to disable
+  char checkpoint[CONFIG_PATH_LENGTH]; //file the simulator saves itself to, empty to disable
+  unsigned int checkpoint_ms;
+  char restore[CONFIG_PATH_LENGTH]; //checkpoint to start from, empty for a fresh start
+  char trace[CONFIG_PATH_LENGTH]; //file every scheduling decision is recorded to, empty to disable
+  char replay[CONFIG_PATH_LENGTH]; //trace to replay instead of running the clients
+  unsigned int perf_counters; //non zero to break worker time down by phase at stop
+} ConfigT;
+
+void config_defaults(ConfigT* config);
+
+// Parse a whole number the way numeric settings are, positive rejects 0,
+// returns 0 on success
+int config_parse_number(char const* key, char const* value, int positive, unsigned int* number);
+
+// Set one setting by name, returns 0 on success
+int config_set(ConfigT* config, char const* key, char const* value);
+
+// Read "key = value" lines, # starts a comment, returns 0 on success
+int config_load_file(ConfigT* config, char const* path);
+
+// Format the value of a setting into buffer, returns 0 on success
+int config_get(ConfigT const* config, char const* key, char* buffer, size_t size);
+
+// Print every setting name with its current value
+void config_print(ConfigT const* config, FILE* out);
+
+#endif
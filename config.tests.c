@@ -0,0 +1,133 @@
+#include "config.h"
+#include "logger.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+void test_numbers() {
+  printf("testing numbers are whole, in range and positive where they must be\n");
+  ConfigT config;
+  config_defaults(&config);
+  assert(config_set(&config, "threads", "7") == 0 && config.simulator_threads == 7);
+  assert(config_set(&config, "max-threads", "0") == 0 && config.max_threads == 0);
+  //a zero interval would spin the event and device loops
+  assert(config_set(&config, "event-interval", "0") != 0);
+  assert(config.event_source_interval > 0);
+  assert(config_set(&config, "event-interval", "1") == 0 && config.event_source_interval == 1);
+  assert(config_set(&config, "iterations", "4294967295") == 0 && config.iterations == 4294967295u);
+  //a rejected value leaves the setting alone
+  assert(config_set(&config, "threads", "0") != 0);
+  assert(config_set(&config, "threads", "-1") != 0);
+  assert(config_set(&config, "threads", "") != 0);
+  assert(config_set(&config, "threads", "3x") != 0);
+  assert(config_set(&config, "threads", "x3") != 0);
+  assert(config_set(&config, "threads", "4294967296") != 0);
+  assert(config_set(&config, "threads", "99999999999999999999999") != 0);
+  assert(config.simulator_threads == 7);
+  assert(config_set(&config, "no-such-setting", "1") != 0);
+  //bounded settings take up to their limit
+  assert(config_set(&config, "shards", "64") == 0 && config.shards == CONFIG_MAX_SHARDS);
+  assert(config_set(&config, "shards", "65") != 0 && config.shards == CONFIG_MAX_SHARDS);
+  assert(config_set(&config, "shards", "1000") != 0);
+
+  unsigned int number = 5;
+  assert(config_parse_number("parallel", "12", 1, &number) == 0 && number == 12);
+  assert(config_parse_number("parallel", "0", 0, &number) == 0 && number == 0);
+  assert(config_parse_number("parallel", "0", 1, &number) != 0);
+  assert(config_parse_number("parallel", "-2", 1, &number) != 0);
+  assert(config_parse_number("parallel", "2.5", 1, &number) != 0);
+  assert(number == 0);
+}
+
+void test_names() {
+  printf("testing named settings only take the names they list\n");
+  ConfigT config;
+  config_defaults(&config);
+  assert(config_set(&config, "policy", "cfs") == 0 && config.policy == policy_cfs);
+  assert(config_set(&config, "policy", "fifo") != 0 && config.policy == policy_cfs);
+  assert(config_set(&config, "log-level", "warning") == 0 && config.log_level == log_warning);
+  assert(config_set(&config, "log-level", "loud") != 0 && config.log_level == log_warning);
+  assert(config_set(&config, "log-events", "none") == 0 && config.log_events == 0);
+  assert(config_set(&config, "log-events", "all") == 0 && config.log_events == (1u << log_category_count) - 1);
+  assert(config_set(&config, "log-events", "create,wait") == 0);
+  assert(config.log_events == ((1u << log_create) | (1u << log_wait)));
+  assert(config_set(&config, "log-events", "create,") != 0);
+  assert(config_set(&config, "log-events", "create,bogus") != 0);
+  assert(config.log_events == ((1u << log_create) | (1u << log_wait)));
+
+  char path[CONFIG_PATH_LENGTH + 1];
+  memset(path, 'a', CONFIG_PATH_LENGTH);
+  path[CONFIG_PATH_LENGTH] = '\0';
+  assert(config_set(&config, "trace", path) != 0 && config.trace[0] == '\0');
+  path[CONFIG_PATH_LENGTH - 1] = '\0';
+  assert(config_set(&config, "trace", path) == 0 && strcmp(config.trace, path) == 0);
+  //a socket path keeps room for an instance suffix
+  assert(config_set(&config, "metrics-socket", path) != 0 && config.metrics_socket[0] == '\0');
+  path[CONFIG_SOCKET_PATH_LENGTH] = '\0';
+  assert(config_set(&config, "metrics-socket", path) == 0 && strcmp(config.metrics_socket, path) == 0);
+}
+
+void test_round_trip() {
+  printf("testing every value read back sets the same value\n");
+  ConfigT config;
+  config_defaults(&config);
+  assert(config_set(&config, "policy", "srtf") == 0);
+  assert(config_set(&config, "log-events", "create,wait") == 0);
+  assert(config_set(&config, "metrics-socket", "/tmp/sim.sock") == 0);
+  assert(config_set(&config, "disks", "3") == 0);
+
+  char const* const keys[] = { "policy", "log-events", "metrics-socket", "disks", "threads", "evaluator", "log-level" };
+  ConfigT copy;
+  config_defaults(&copy);
+  copy.simulator_threads = 9;
+  for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+    char value[CONFIG_PATH_LENGTH];
+    assert(config_get(&config, keys[i], value, sizeof(value)) == 0);
+    assert(config_set(&copy, keys[i], value) == 0);
+  }
+  assert(memcmp(&copy, &config, sizeof(ConfigT)) == 0);
+  char value[16];
+  assert(config_get(&config, "no-such-setting", value, sizeof(value)) != 0);
+}
+
+void test_load_file() {
+  printf("testing config files skip comments and report every bad line\n");
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/config.tests.%i", (int)getpid());
+  FILE* file = fopen(path, "w");
+  assert(file != NULL);
+  fputs("# whole line comment\n"
+	"\n"
+	"  threads = 3  # trailing comment\n"
+	"policy=cfs\n",
+	file);
+  fclose(file);
+  ConfigT config;
+  config_defaults(&config);
+  assert(config_load_file(&config, path) == 0);
+  assert(config.simulator_threads == 3 && config.policy == policy_cfs);
+
+  //the good lines around the bad ones still apply
+  file = fopen(path, "w");
+  fputs("threads = 0\n"
+	"no equals here\n"
+	"clients = 5\n"
+	"bogus = 1\n",
+	file);
+  fclose(file);
+  assert(config_load_file(&config, path) != 0);
+  assert(config.simulator_threads == 3 && config.environment_clients == 5);
+
+  unlink(path);
+  assert(config_load_file(&config, path) != 0);
+}
+
+int main() {
+  test_numbers();
+  test_names();
+  test_round_trip();
+  test_load_file();
+  return 0;
+}
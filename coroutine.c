@@ -0,0 +1,80 @@
+#include "coroutine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+//the coroutine running on this thread and where to return to when it yields
+static __thread CoroutineT* current;
+static __thread ucontext_t* resumer;
+
+static void coroutine_entry() {
+  CoroutineT* coroutine = current;
+  coroutine->routine(coroutine->arg);
+  coroutine->finished = 1;
+  //never resumed again, so the saved context is never used
+  swapcontext(&coroutine->context, resumer);
+}
+
+void coroutine_create(CoroutineT* coroutine, void (*routine)(void*), void* arg, size_t stack_size) {
+  size_t const page = sysconf(_SC_PAGESIZE);
+  stack_size = (stack_size + page - 1) / page * page;
+
+  //one extra page below the stack so an overflow faults instead of corrupting
+  coroutine->stack_size = stack_size + page;
+  coroutine->stack = mmap(NULL, coroutine->stack_size, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (coroutine->stack == MAP_FAILED) {
+    perror("Failed to map coroutine stack");
+    abort();
+  }
+  mprotect(coroutine->stack, page, PROT_NONE);
+
+  coroutine->routine = routine;
+  coroutine->arg = arg;
+  coroutine->finished = 0;
+
+  getcontext(&coroutine->context);
+  coroutine->context.uc_stack.ss_sp = (char*)coroutine->stack + page;
+  coroutine->context.uc_stack.ss_size = stack_size;
+  coroutine->context.uc_link = NULL;
+  makecontext(&coroutine->context, coroutine_entry, 0);
+}
+
+void coroutine_destroy(CoroutineT* coroutine) {
+  munmap(coroutine->stack, coroutine->stack_size);
+  coroutine->stack = NULL;
+}
+
+int coroutine_resume(CoroutineT* coroutine) {
+  if (coroutine->finished) return 1;
+
+  //save the outer coroutine, if any, so coroutines can nest
+  CoroutineT* const outer = current;
+  ucontext_t* const outer_resumer = resumer;
+  ucontext_t here;
+
+  current = coroutine;
+  resumer = &here;
+  swapcontext(&here, &coroutine->context);
+  current = outer;
+  resumer = outer_resumer;
+
+  return coroutine->finished;
+}
+
+void coroutine_yield() {
+  CoroutineT* coroutine = current;
+  if (coroutine == NULL) {
+    //not in a coroutine, just let other threads run
+    sched_yield();
+    return;
+  }
+  swapcontext(&coroutine->context, resumer);
+}
+
+CoroutineT* coroutine_current() {
+  return current;
+}
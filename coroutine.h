@@ -0,0 +1,37 @@
+#ifndef _COROUTINE_H_
+#define _COROUTINE_H_
+
+#include <stddef.h>
+#include <ucontext.h>
+
+//default stack per coroutine, pages are only committed when touched
+#ifndef COROUTINE_STACK_SIZE
+#define COROUTINE_STACK_SIZE (64 * 1024)
+#endif
+
+// A stackful coroutine - runs routine(arg) on its own stack, giving its
+// thread back at every coroutine_yield
+typedef struct Coroutine {
+  ucontext_t context;
+  void* stack; //mapping including a guard page at the bottom
+  size_t stack_size;
+  void (*routine)(void*);
+  void* arg;
+  int finished;
+} CoroutineT;
+
+void coroutine_create(CoroutineT* coroutine, void (*routine)(void*), void* arg, size_t stack_size);
+void coroutine_destroy(CoroutineT* coroutine);
+
+// Run coroutine on the calling thread until it yields or returns, returns
+// whether it has finished. A coroutine can move between threads but must
+// only be resumed by one thread at a time.
+int coroutine_resume(CoroutineT* coroutine);
+
+// Switch back to whoever resumed the current coroutine
+void coroutine_yield();
+
+// The running coroutine, or NULL on a plain thread stack
+CoroutineT* coroutine_current();
+
+#endif
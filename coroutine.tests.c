@@ -0,0 +1,136 @@
+#include "coroutine.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <pthread.h>
+
+int trace[16];
+int traced;
+
+void record_twice(void* arg) {
+  int const value = *(int*)arg;
+  trace[traced++] = value;
+  coroutine_yield();
+  trace[traced++] = value + 10;
+}
+
+void test_interleaving() {
+  printf("testing coroutines interleave at yields\n");
+  traced = 0;
+  int one = 1, two = 2;
+  CoroutineT first, second;
+  coroutine_create(&first, record_twice, &one, COROUTINE_STACK_SIZE);
+  coroutine_create(&second, record_twice, &two, COROUTINE_STACK_SIZE);
+
+  assert(coroutine_current() == NULL);
+  assert(coroutine_resume(&first) == 0);
+  assert(coroutine_resume(&second) == 0);
+  assert(coroutine_resume(&first) == 1);
+  assert(coroutine_resume(&second) == 1);
+  //resuming a finished coroutine does nothing
+  assert(coroutine_resume(&first) == 1);
+  assert(coroutine_current() == NULL);
+
+  int const expected[] = { 1, 2, 11, 12 };
+  assert(traced == 4);
+  for (int i = 0; i < 4; i++) {
+    assert(trace[i] == expected[i]);
+  }
+
+  coroutine_destroy(&first);
+  coroutine_destroy(&second);
+}
+
+void check_current(void* arg) {
+  assert(coroutine_current() == (CoroutineT*)arg);
+  coroutine_yield();
+  assert(coroutine_current() == (CoroutineT*)arg);
+}
+
+void resume_inner(void* arg) {
+  CoroutineT* inner = (CoroutineT*)arg;
+  CoroutineT* self = coroutine_current();
+  //an inner yield comes back here, not to the thread
+  assert(coroutine_resume(inner) == 0);
+  assert(coroutine_current() == self);
+  coroutine_yield();
+  assert(coroutine_resume(inner) == 1);
+  assert(coroutine_current() == self);
+}
+
+void test_nesting() {
+  printf("testing nested resume\n");
+  CoroutineT outer, inner;
+  coroutine_create(&inner, check_current, &inner, COROUTINE_STACK_SIZE);
+  coroutine_create(&outer, resume_inner, &inner, COROUTINE_STACK_SIZE);
+
+  assert(coroutine_resume(&outer) == 0);
+  assert(coroutine_resume(&outer) == 1);
+  assert(inner.finished);
+
+  coroutine_destroy(&outer);
+  coroutine_destroy(&inner);
+}
+
+void count_up(void* arg) {
+  int* counter = (int*)arg;
+  for (int i = 0; i < 1000; i++) {
+    (*counter)++;
+    coroutine_yield();
+  }
+}
+
+void* resume_from_thread(void* arg) {
+  CoroutineT* coroutine = (CoroutineT*)arg;
+  while (!coroutine_resume(coroutine)) ;
+  return NULL;
+}
+
+void test_thread_migration() {
+  printf("testing a coroutine can be finished by another thread\n");
+  int counter = 0;
+  CoroutineT coroutine;
+  coroutine_create(&coroutine, count_up, &counter, COROUTINE_STACK_SIZE);
+
+  for (int i = 0; i < 10; i++) {
+    coroutine_resume(&coroutine);
+  }
+  assert(counter == 10);
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, resume_from_thread, &coroutine);
+  pthread_join(thread, NULL);
+  assert(counter == 1000);
+  assert(coroutine.finished);
+
+  coroutine_destroy(&coroutine);
+}
+
+void test_many() {
+  printf("testing thousands of coroutines\n");
+  enum { count = 10000 };
+  static CoroutineT coroutines[count];
+  static int counters[count];
+
+  for (int i = 0; i < count; i++) {
+    counters[i] = 0;
+    coroutine_create(&coroutines[i], count_up, &counters[i], COROUTINE_STACK_SIZE);
+  }
+  for (int live = count; live > 0; ) {
+    for (int i = 0; i < count; i++) {
+      if (!coroutines[i].finished && coroutine_resume(&coroutines[i])) live--;
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    assert(counters[i] == 1000);
+    coroutine_destroy(&coroutines[i]);
+  }
+}
+
+int main() {
+  test_interleaving();
+  test_nesting();
+  test_thread_migration();
+  test_many();
+  return 0;
+}
@@ -1,42 +1,365 @@
 #include "simulator.h"
+#include "checkpoint.h"
+#include "trace.h"
 #include "environment.h"
 #include "event_source.h"
 #include "logger.h"
+#include "metrics.h"
+#include "shard.h"
+#include "utilities.h"
 
-#ifndef SIMULATOR_THREADS
-#define SIMULATOR_THREADS 2
-#endif
+#include "config.h"
+#include "sweep.h"
 
-#ifndef SIMULATOR_MAX_PROCESSES
-#define SIMULATOR_MAX_PROCESSES 2048
-#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
 
-#ifndef ENVIRONMENT_THREADS
-#define ENVIRONMENT_THREADS 2
-#endif
+//how often the coordinator of a sharded run looks in on the shards
+#define SHARD_REPORT_US 100000
 
-#ifndef ITERATIONS
-#define ITERATIONS 5
-#endif
+static void usage(char const* program, ConfigT const* config) {
+  fprintf(stderr,
+	  "Usage: %s [--setting=value ...] [--config=file] [--sweep=setting=value,value,...]\n"
+	  "          [--parallel=points] [--output=file]\n"
+	  "Settings are applied in order, so later ones override a config file.\n"
+	  "Each --sweep adds an axis - every combination is run and tabulated.\n"
+	  "Settings and their current values:\n", program);
+  config_print(config, stderr);
+}
+
+// Apply the command line to config and sweep, returns 0 on success
+static int parse_arguments(int argc, char** argv, ConfigT* config, SweepT* sweep, char const** output) {
+  unsigned int parallel = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--", 2) != 0) {
+      fprintf(stderr, "Unexpected argument %s\n", argv[i]);
+      return 1;
+    }
+    if (strcmp(argv[i], "--help") == 0) {
+      return 1;
+    }
+
+    //--name=value or --name value
+    char name[64];
+    char const* value;
+    char const* equals = strchr(argv[i], '=');
+    if (equals != NULL) {
+      snprintf(name, sizeof(name), "%.*s", (int)(equals - argv[i] - 2), argv[i] + 2);
+      value = equals + 1;
+    } else if (i + 1 < argc) {
+      snprintf(name, sizeof(name), "%s", argv[i] + 2);
+      value = argv[++i];
+    } else {
+      fprintf(stderr, "Missing value for %s\n", argv[i]);
+      return 1;
+    }
+
+    int failed;
+    if (strcmp(name, "config") == 0) {
+      failed = config_load_file(config, value);
+    } else if (strcmp(name, "sweep") == 0) {
+      failed = sweep_add_axis(sweep, value);
+    } else if (strcmp(name, "parallel") == 0) {
+      failed = config_parse_number(name, value, 1, &parallel);
+    } else if (strcmp(name, "output") == 0) {
+      *output = value;
+      failed = 0;
+    } else {
+      failed = config_set(config, name, value);
+    }
+    if (failed) return 1;
+  }
+
+  //sweep points are run side by side in this process, never forked as shards
+  int sharded = config->shards > 1;
+  for (int i = 0; i < sweep->axis_count; i++) {
+    sharded |= strcmp(sweep->axes[i].key, "shards") == 0;
+  }
+  if (sweep->axis_count > 0 && sharded) {
+    fprintf(stderr, "Sharded runs cannot be swept\n");
+    return 1;
+  }
+
+  //axes were validated against the settings at the time, keep the final base
+  sweep->base = *config;
+  sweep->parallel = parallel;
+  return 0;
+}
+
+static int run_sweep(SweepT* sweep, char const* output) {
+  FILE* out = stdout;
+  if (strcmp(output, "-") != 0) {
+    out = fopen(output, "w");
+    if (out == NULL) {
+      perror("Failed to open sweep output");
+      return 1;
+    }
+  }
 
-#ifndef BATCH_SIZE
-#define BATCH_SIZE 10
-#endif
+  LOG(log_info, log_general, "Sweeping %i configurations", sweep_point_count(sweep));
+  int const failed = sweep_run(sweep, out);
 
-#ifndef EVENT_SOURCE_INTERVAL
-#define EVENT_SOURCE_INTERVAL 10
-#endif
+  if (out != stdout) fclose(out);
+  return failed;
+}
+
+// Make the recorded calls of one simulator again, with nothing evaluated
+static int run_replay(ConfigT const* config) {
+  TraceReplayT* replay = trace_load(config->replay);
+  if (replay == NULL) return 1;
+  
+  ConfigT replayed = *config;
+  trace_replay_config(replay, &replayed);
+  SimulatorT* simulator = simulator_start_replay(&replayed, NULL, replay);
+  event_source_start(simulator, replayed.event_source_interval);
+  trace_replay_wait(simulator);
+  event_source_stop(simulator);
+  simulator_stop(simulator);
+  return 0;
+}
+
+// One shard of a sharded run, in its forked process - never returns
+static void run_shard(ConfigT const* config, ShardRegionT* region, int index) {
+  logger_start();
+  cpu_set_t cpus;
+  simulator_cpu_share(index, region->count, &cpus);
+  SimulatorT* simulator = simulator_start(config, &cpus);
+  simulator->id = index + 1; //each process would otherwise number its only simulator 1
+  ShardT shard;
+  shard_start(&shard, region, index, simulator);
+  
+  MetricsT* metrics = NULL;
+  if (config->metrics_socket[0] != '\0') {
+    char path[CONFIG_PATH_LENGTH + 12];
+    snprintf(path, sizeof(path), "%s.%i", config->metrics_socket, simulator->id);
+    metrics = metrics_start(simulator, path);
+  }
+  event_source_start(simulator, config->event_source_interval);
+  
+  uint64_t const start = process_table_now();
+  environment_stop(environment_start(simulator));
+  double const elapsed = (process_table_now() - start) / 1e9;
+  
+  //keep running what the others send until every shard's clients are done
+  ShardStatsT* stats = region->stats;
+  __atomic_store_n(&stats[index].finished, 1, __ATOMIC_RELEASE);
+  for (unsigned int i = 0; i < region->count; i++) {
+    while (!__atomic_load_n(&stats[i].finished, __ATOMIC_ACQUIRE)) {
+      usleep(SHARD_INTERVAL_US);
+    }
+  }
+  shard_publish(&shard, elapsed);
+  
+  shard_stop(&shard);
+  event_source_stop(simulator);
+  metrics_stop(metrics);
+  simulator_stop(simulator);
+  logger_stop();
+  _exit(0);
+}
+
+// Sum what the shards have published so far
+static void shard_totals(ShardRegionT const* region, unsigned long* exits, unsigned long* migrated) {
+  *exits = 0;
+  *migrated = 0;
+  for (unsigned int i = 0; i < region->count; i++) {
+    *exits += __atomic_load_n(&region->stats[i].exits, __ATOMIC_RELAXED);
+    *migrated += __atomic_load_n(&region->stats[i].migrated, __ATOMIC_RELAXED);
+  }
+}
+
+// Fork a process per shard and aggregate their statistics as they run
+static int run_shards(ConfigT const* config) {
+  unsigned int const shards = config->shards;
+  ConfigT sharded = *config;
+  sharded.instances = 1;
+  //files written and read per simulator would be shared by every shard
+  int const ignored = sharded.trace[0] != '\0' || sharded.replay[0] != '\0' ||
+    sharded.checkpoint[0] != '\0' || sharded.restore[0] != '\0';
+  sharded.trace[0] = sharded.replay[0] = sharded.checkpoint[0] = sharded.restore[0] = '\0';
+  
+  ShardRegionT region;
+  if (shard_region_create(&region, shards) != 0) return 1;
+  pid_t children[shards];
+  int exited[shards];
+  unsigned int started = 0;
+  for (; started < shards; started++) {
+    children[started] = fork();
+    if (children[started] == 0) {
+      run_shard(&sharded, &region, started);
+    }
+    if (children[started] < 0) {
+      perror("Failed to fork a shard");
+      break;
+    }
+    exited[started] = 0;
+  }
+  
+  //every shard was forked before this process started any thread, as worker,
+  //event and metrics threads would not be carried into the children. Logging
+  //starts after the forks so no unflushed output is copied into every shard.
+  logger_start();
+  LOG(log_info, log_general, "Starting %u shards", started);
+  if (ignored) {
+    LOG(log_warning, log_general, "Sharded runs have no trace, replay, checkpoint or restore, ignoring them");
+  }
+  
+  int failed = started < shards;
+  unsigned int running = started;
+  if (failed) {
+    for (unsigned int i = 0; i < started; i++) kill(children[i], SIGTERM);
+  }
+  uint64_t const start = process_table_now();
+  uint64_t last_report = start;
+  while (running > 0) {
+    int status;
+    pid_t const child = waitpid(-1, &status, WNOHANG);
+    if (child > 0) {
+      running--;
+      for (unsigned int i = 0; i < started; i++) {
+	if (children[i] == child) exited[i] = 1;
+      }
+      //the rest would wait forever for the failed shard to finish
+      if (!failed && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+	LOG(log_warning, log_general, "A shard failed, stopping the rest");
+	failed = 1;
+	for (unsigned int i = 0; i < started; i++) {
+	  if (!exited[i]) kill(children[i], SIGTERM);
+	}
+      }
+      continue;
+    }
+    usleep(SHARD_REPORT_US);
+    if (process_table_now() - last_report >= 1000000000ull) {
+      last_report = process_table_now();
+      unsigned long exits, migrated;
+      shard_totals(&region, &exits, &migrated);
+      LOG(log_info, log_general, "%lu processes completed so far, %lu migrated between shards", exits, migrated);
+    }
+  }
+  
+  double turnaround_ns = 0;
+  for (unsigned int i = 0; i < started && !failed; i++) {
+    ShardStatsT const* stats = &region.stats[i];
+    turnaround_ns += stats->mean_turnaround_ns * stats->exits;
+    LOG(log_info, log_general, "Shard %u ran %lu processes in %.3fs, %lu sent away, %lu taken in, %.1fns per decision",
+	i + 1, stats->exits, stats->seconds, stats->migrated, stats->adopted, stats->sched_ns_per_decision);
+  }
+  unsigned long exits, migrated;
+  shard_totals(&region, &exits, &migrated);
+  double const elapsed = (process_table_now() - start) / 1e9;
+  LOG(log_info, log_general, "%u shards completed %lu processes in %.3fs (%.1f processes/s), %lu migrations",
+      started, exits, elapsed, exits / elapsed, migrated);
+  if (exits > 0 && !failed) {
+    LOG(log_info, log_general, "Mean turnaround across shards %.3fms", turnaround_ns / exits / 1e6);
+  }
+  
+  shard_region_destroy(&region);
+  LOG(log_info, log_general, "Stopping simulator");
+  logger_stop();
+  return failed;
+}
 
-int main() {
+int main(int argc, char** argv) {
+  ConfigT config;
+  config_defaults(&config);
+  SweepT sweep;
+  sweep_create(&sweep, &config);
+  char const* output = "-";
+  if (parse_arguments(argc, argv, &config, &sweep, &output) != 0) {
+    usage(argv[0], &config);
+    return 1;
+  }
+  
+  logger_configure(config.log_level, config.log_events, config.log_sample);
+  //shards are forked before any thread is started
+  if (config.shards > 1) {
+    return run_shards(&config);
+  }
   logger_start();
-  logger_write("Starting simulator");
-  simulator_start(SIMULATOR_THREADS, SIMULATOR_MAX_PROCESSES);
-  event_source_start(EVENT_SOURCE_INTERVAL);
-  environment_start(ENVIRONMENT_THREADS, ITERATIONS, BATCH_SIZE);
-  environment_stop();
-  event_source_stop();
-  simulator_stop();
-  logger_write("Stopping simulator");
+  LOG(log_info, log_general, "Starting simulator");
+  
+  if (sweep.axis_count > 0) {
+    int const failed = run_sweep(&sweep, output);
+    LOG(log_info, log_general, "Stopping simulator");
+    logger_stop();
+    return failed;
+  }
+  
+  if (config.replay[0] != '\0') {
+    int const failed = run_replay(&config);
+    LOG(log_info, log_general, "Stopping simulator");
+    logger_stop();
+    return failed;
+  }
+  
+  int const instances = config.instances;
+  SimulatorT* simulators[instances];
+  EnvironmentT* environments[instances];
+  MetricsT* metrics[instances];
+  uint64_t const start = process_table_now();
+  
+  for (int i = 0; i < instances; i++) {
+    //a single instance keeps the whole machine
+    cpu_set_t cpus;
+    simulator_cpu_share(i, instances, &cpus);
+    if (config.restore[0] != '\0') {
+      //simulators are numbered from 1 in start order, like the checkpoints
+      char path[CONFIG_PATH_LENGTH + 12];
+      checkpoint_instance_path(config.restore, &config, i + 1, path, sizeof(path));
+      simulators[i] = simulator_restore(&config, instances > 1 ? &cpus : NULL, path);
+      if (simulators[i] == NULL) {
+	logger_stop();
+	return 1;
+      }
+    } else {
+      simulators[i] = simulator_start(&config, instances > 1 ? &cpus : NULL);
+    }
+    
+    metrics[i] = NULL;
+    if (config.metrics_socket[0] != '\0') {
+      char path[CONFIG_PATH_LENGTH + 12];
+      if (instances > 1) {
+	snprintf(path, sizeof(path), "%s.%i", config.metrics_socket, simulators[i]->id);
+      } else {
+	snprintf(path, sizeof(path), "%s", config.metrics_socket);
+      }
+      metrics[i] = metrics_start(simulators[i], path);
+    }
+    
+    event_source_start(simulators[i], config.event_source_interval);
+  }
+  
+  //environments start once every simulator is up so they run concurrently
+  for (int i = 0; i < instances; i++) {
+    environments[i] = environment_start(simulators[i]);
+  }
+  
+  unsigned long completed = 0;
+  for (int i = 0; i < instances; i++) {
+    environment_stop(environments[i]);
+    simulator_wait_restored(simulators[i]);
+    event_source_stop(simulators[i]);
+    metrics_stop(metrics[i]);
+    
+    SimulatorMetricsT totals;
+    simulator_metrics(simulators[i], &totals);
+    completed += totals.exits;
+    checked_free(totals.workers);
+    
+    simulator_stop(simulators[i]);
+  }
+  
+  //aggregate throughput across every instance
+  double const elapsed = (process_table_now() - start) / 1e9;
+  LOG(log_info, log_general, "%i simulator instances completed %lu processes in %.3fs (%.1f processes/s)",
+      instances, completed, elapsed, completed / elapsed);
+  
+  LOG(log_info, log_general, "Stopping simulator");
   logger_stop();
   return 0;
 }
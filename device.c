@@ -0,0 +1,141 @@
+#include "device.h"
+#include "utilities.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+char const* const device_kind_names[device_kind_count] = { "disk", "network", "swap" };
+
+void device_create(DeviceT* device, DeviceKindT kind, unsigned int service_us, unsigned int concurrency,
+		   size_t max_processes, unsigned int seed,
+		   void (*complete)(void* context, ProcessIdT const* pids, size_t count), void* context) {
+  memset(device, 0, sizeof(DeviceT));
+  device->kind = kind;
+  device->service_ns = (uint64_t)service_us * 1000;
+  device->concurrency = concurrency;
+  mpsc_queue_create(&device->requests);
+
+  //a process has at most one request pending, so nothing can overflow
+  device->issued = (uint64_t*)checked_malloc(max_processes * sizeof(uint64_t));
+  device->queued = (ProcessIdT*)checked_malloc(max_processes * sizeof(ProcessIdT));
+  device->capacity = max_processes;
+  device->slots = (DeviceSlotT*)checked_malloc(concurrency * sizeof(DeviceSlotT));
+  memset(device->slots, 0, concurrency * sizeof(DeviceSlotT));
+
+  device->seed = seed;
+  device->created = process_table_now();
+  for (unsigned int i = 0; i < concurrency; i++) {
+    device->slots[i].free_at = device->created;
+  }
+  device->complete = complete;
+  device->context = context;
+}
+
+void device_destroy(DeviceT* device) {
+  mpsc_queue_destroy(&device->requests);
+  checked_free(device->issued);
+  checked_free(device->queued);
+  checked_free(device->slots);
+}
+
+void device_submit(DeviceT* device, ProcessTableT* table, ProcessIdT pid, uint64_t now) {
+  //published to the servicing thread by the push
+  device->issued[pid - 1] = now;
+  __atomic_fetch_add(&device->stats.submitted, 1, __ATOMIC_RELAXED);
+  mpsc_queue_push(&device->requests, process_table_event_node(table, pid));
+}
+
+// Service time of one request
+static uint64_t draw(DeviceT* device) {
+  if (device->kind == device_swap) {
+    return device->service_ns;
+  }
+  double const uniform = (rand_r(&device->seed) + 1.0) / ((double)RAND_MAX + 1.0); //(0, 1]
+  if (device->kind == device_network) {
+    return (uint64_t)(-log(uniform) * device->service_ns);
+  }
+  return (uint64_t)((0.5 + uniform) * device->service_ns);
+}
+
+static void stat_add(unsigned long* counter, unsigned long amount) {
+  __atomic_store_n(counter, *counter + amount, __ATOMIC_RELAXED);
+}
+
+uint64_t device_service(DeviceT* device, ProcessTableT* table, uint64_t now) {
+  //new requests join the back of the ring in arrival order
+  for (MpscNodeT* node = mpsc_queue_pop_all(&device->requests); node != NULL; ) {
+    MpscNodeT* next = node->next;
+    device->queued[(device->head + device->count++) % device->capacity] = process_table_event_pid(table, node);
+    node = next;
+  }
+  if (device->count > device->stats.max_queued) {
+    __atomic_store_n(&device->stats.max_queued, device->count, __ATOMIC_RELAXED);
+  }
+
+  ProcessIdT finished[DEVICE_COMPLETION_BATCH];
+  size_t done = 0;
+
+  //a slot may finish and start several requests in one call when the
+  //thread was late, so keep going until nothing changes
+  int progress = 1;
+  while (progress) {
+    progress = 0;
+    for (unsigned int i = 0; i < device->concurrency; i++) {
+      DeviceSlotT* slot = &device->slots[i];
+      if (slot->pid != 0 && slot->done <= now) {
+	finished[done++] = slot->pid;
+	stat_add(&device->stats.completed, 1);
+	stat_add(&device->stats.busy_ns, slot->done - slot->started);
+	slot->free_at = slot->done;
+	slot->pid = 0;
+	progress = 1;
+	if (done == DEVICE_COMPLETION_BATCH) {
+	  device->complete(device->context, finished, done);
+	  done = 0;
+	}
+      }
+      if (slot->pid == 0 && device->count > 0) {
+	ProcessIdT const pid = device->queued[device->head];
+	device->head = (device->head + 1) % device->capacity;
+	device->count--;
+
+	//the slot was free before the request came in, or it waited
+	uint64_t const issued = device->issued[pid - 1];
+	slot->pid = pid;
+	slot->started = slot->free_at > issued ? slot->free_at : issued;
+	slot->done = slot->started + draw(device);
+	stat_add(&device->stats.started, 1);
+	stat_add(&device->stats.queue_ns, slot->started - issued);
+	progress = 1;
+      }
+    }
+  }
+
+  if (done > 0) {
+    device->complete(device->context, finished, done);
+  }
+
+  uint64_t next = 0;
+  for (unsigned int i = 0; i < device->concurrency; i++) {
+    DeviceSlotT const* slot = &device->slots[i];
+    if (slot->pid != 0 && (next == 0 || slot->done < next)) {
+      next = slot->done;
+    }
+  }
+  return next;
+}
+
+void device_stats(DeviceT* device, DeviceStatsT* stats) {
+  stats->submitted = __atomic_load_n(&device->stats.submitted, __ATOMIC_RELAXED);
+  stats->started = __atomic_load_n(&device->stats.started, __ATOMIC_RELAXED);
+  stats->completed = __atomic_load_n(&device->stats.completed, __ATOMIC_RELAXED);
+  stats->busy_ns = __atomic_load_n(&device->stats.busy_ns, __ATOMIC_RELAXED);
+  stats->queue_ns = __atomic_load_n(&device->stats.queue_ns, __ATOMIC_RELAXED);
+  stats->max_queued = __atomic_load_n(&device->stats.max_queued, __ATOMIC_RELAXED);
+}
+
+double device_utilisation(DeviceT* device, DeviceStatsT const* stats, uint64_t now) {
+  uint64_t const elapsed = now - device->created;
+  return elapsed ? (double)stats->busy_ns / ((double)elapsed * device->concurrency) : 0;
+}
@@ -0,0 +1,81 @@
+#ifndef _DEVICE_H_
+#define _DEVICE_H_
+
+#include "process_table.h"
+#include "mpsc_queue.h"
+#include <stdint.h>
+
+//completions handed back per call of the completion function
+#define DEVICE_COMPLETION_BATCH 64
+
+// What a device models, which also decides how service times vary
+typedef enum DeviceKind {
+  device_disk, //uniform between half and one and a half times the mean
+  device_network, //exponential around the mean
+  device_swap, //always the mean, pages faulted in from backing store
+  device_kind_count,
+} DeviceKindT;
+
+// Names shown in the reports, indexed by DeviceKindT
+extern char const* const device_kind_names[device_kind_count];
+
+// Totals since the device was created, only the servicing thread writes
+// them apart from submitted
+typedef struct DeviceStats {
+  unsigned long submitted; //requests issued by workers
+  unsigned long started; //requests given a slot
+  unsigned long completed;
+  unsigned long busy_ns; //service time, summed over completed requests
+  unsigned long queue_ns; //issue to start of service, summed over started requests
+  unsigned long max_queued; //most requests waiting for a slot at once
+} DeviceStatsT;
+
+// A request in service, pid 0 when the slot is free since free_at
+typedef struct DeviceSlot {
+  ProcessIdT pid;
+  uint64_t started;
+  uint64_t done;
+  uint64_t free_at;
+} DeviceSlotT;
+
+// Simulated device serving up to concurrency requests at once. Workers
+// submit blocked processes without locking, a single thread services the
+// device and hands finished ones to complete. Service runs on the
+// device's own clock - a request starts as soon as a slot frees up, not
+// when the servicing thread next looks - so how often it is serviced
+// only delays wakeups, not the modelled throughput.
+typedef struct Device {
+  DeviceKindT kind;
+  uint64_t service_ns; //mean service time
+  unsigned int concurrency;
+  MpscQueueT requests; //linked through the process table's event nodes
+  uint64_t* issued; //per pid, when its pending request was submitted
+  ProcessIdT* queued; //ring of requests waiting for a slot, oldest first
+  size_t capacity;
+  size_t head;
+  size_t count;
+  DeviceSlotT* slots;
+  unsigned int seed;
+  uint64_t created;
+  DeviceStatsT stats;
+  void (*complete)(void* context, ProcessIdT const* pids, size_t count);
+  void* context;
+} DeviceT;
+
+void device_create(DeviceT* device, DeviceKindT kind, unsigned int service_us, unsigned int concurrency,
+		   size_t max_processes, unsigned int seed,
+		   void (*complete)(void* context, ProcessIdT const* pids, size_t count), void* context);
+// Requests still inside are dropped
+void device_destroy(DeviceT* device);
+
+// Queue a request for a process that has just blocked, from any thread
+void device_submit(DeviceT* device, ProcessTableT* table, ProcessIdT pid, uint64_t now);
+// Start and complete everything due by now, from one thread at a time.
+// Returns when the next request in service finishes, 0 if none is.
+uint64_t device_service(DeviceT* device, ProcessTableT* table, uint64_t now);
+
+void device_stats(DeviceT* device, DeviceStatsT* stats);
+// Fraction of slot time spent serving requests since the device was created
+double device_utilisation(DeviceT* device, DeviceStatsT const* stats, uint64_t now);
+
+#endif
@@ -0,0 +1,110 @@
+#include "device.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+ProcessTableT table;
+DeviceT device;
+ProcessIdT completed[16];
+size_t completed_count;
+
+void record(void* context, ProcessIdT const* pids, size_t count) {
+  assert(context == &device);
+  for (size_t i = 0; i < count; i++) {
+    completed[completed_count++] = pids[i];
+  }
+}
+
+void test_empty_creation() {
+  printf("testing empty creation/destruction of devices\n");
+  process_table_create(&table, 8);
+  device_create(&device, device_disk, 100, 2, 8, 1, record, &device);
+  assert(device_service(&device, &table, device.created + 1000000) == 0);
+  DeviceStatsT stats;
+  device_stats(&device, &stats);
+  assert(stats.submitted == 0 && stats.completed == 0);
+  assert(device_utilisation(&device, &stats, device.created + 1000000) == 0);
+  device_destroy(&device);
+  process_table_destroy(&table);
+}
+
+void test_fifo_single_slot() {
+  printf("testing one slot serves requests in order, back to back\n");
+  process_table_create(&table, 8);
+  device_create(&device, device_disk, 100, 1, 8, 1, record, &device);
+  completed_count = 0;
+  uint64_t const t0 = device.created;
+
+  device_submit(&device, &table, 5, t0);
+  device_submit(&device, &table, 2, t0);
+  device_submit(&device, &table, 7, t0);
+  uint64_t const first = device_service(&device, &table, t0);
+  //disk service is within half to one and a half times the mean
+  assert(first >= t0 + 50000 && first <= t0 + 150000);
+  assert(completed_count == 0);
+
+  //nothing finishes early
+  assert(device_service(&device, &table, first - 1) == first);
+  assert(completed_count == 0);
+
+  //the next request starts when the first finished, not when serviced
+  uint64_t const second = device_service(&device, &table, first);
+  assert(completed_count == 1 && completed[0] == 5);
+  assert(second >= first + 50000 && second <= first + 150000);
+
+  //a late call catches up on everything that finished meanwhile
+  assert(device_service(&device, &table, t0 + 10000000) == 0);
+  assert(completed_count == 3 && completed[1] == 2 && completed[2] == 7);
+
+  DeviceStatsT stats;
+  device_stats(&device, &stats);
+  assert(stats.submitted == 3 && stats.started == 3 && stats.completed == 3);
+  assert(stats.max_queued == 3);
+  //the second waited for the first and the third for both
+  assert(stats.queue_ns >= 3 * 50000);
+  assert(stats.busy_ns >= 3 * 50000 && stats.busy_ns <= 3 * 150000);
+  double const utilisation = device_utilisation(&device, &stats, t0 + stats.busy_ns);
+  assert(utilisation > 0.99 && utilisation <= 1.0);
+
+  device_destroy(&device);
+  process_table_destroy(&table);
+}
+
+void test_concurrency() {
+  printf("testing slots serve requests side by side\n");
+  process_table_create(&table, 8);
+  device_create(&device, device_network, 100, 4, 8, 1, record, &device);
+  completed_count = 0;
+  uint64_t const t0 = device.created + 1000;
+
+  for (ProcessIdT pid = 1; pid <= 6; pid++) {
+    device_submit(&device, &table, pid, t0);
+  }
+  device_service(&device, &table, t0);
+  //four in service straight away, two waiting
+  DeviceStatsT stats;
+  device_stats(&device, &stats);
+  assert(stats.started == 4 && stats.queue_ns == 0);
+  assert(device.count == 2);
+
+  //a request arriving at an idle slot starts when it was issued
+  assert(device_service(&device, &table, t0 + 100000000) == 0);
+  assert(completed_count == 6);
+  device_submit(&device, &table, 8, t0 + 200000000);
+  device_service(&device, &table, t0 + 200000000);
+  device_stats(&device, &stats);
+  assert(stats.started == 7);
+  for (unsigned int i = 0; i < device.concurrency; i++) {
+    if (device.slots[i].pid == 8) assert(device.slots[i].started == t0 + 200000000);
+  }
+
+  device_destroy(&device);
+  process_table_destroy(&table);
+}
+
+int main() {
+  test_empty_creation();
+  test_fifo_single_slot();
+  test_concurrency();
+  return 0;
+}
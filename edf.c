@@ -0,0 +1,246 @@
+#include "edf.h"
+#include "simulator.h"
+#include "logger.h"
+#include "utilities.h"
+
+#include <string.h>
+
+unsigned int edf_admit(EdfT* edf, uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns) {
+  //density rather than utilisation, a deadline shorter than the period
+  //needs the cpu time sooner
+  uint64_t const window = deadline_ns < period_ns ? deadline_ns : period_ns;
+  if (window == 0) {
+    __atomic_fetch_add(&edf->stats.refused, 1, __ATOMIC_RELAXED);
+    return 0;
+  }
+  uint64_t share = runtime_ns * EDF_WORKER_SHARE / window;
+  if (share == 0) share = 1;
+
+  unsigned long load = __atomic_load_n(&edf->load, __ATOMIC_RELAXED);
+  do {
+    if (share > edf->capacity - load) {
+      __atomic_fetch_add(&edf->stats.refused, 1, __ATOMIC_RELAXED);
+      return 0;
+    }
+  } while (!__atomic_compare_exchange_n(&edf->load, &load, load + share, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  __atomic_fetch_add(&edf->stats.admitted, 1, __ATOMIC_RELAXED);
+  return (unsigned int)share;
+}
+
+void edf_release(EdfT* edf, unsigned int share) {
+  __atomic_fetch_sub(&edf->load, share, __ATOMIC_RELAXED);
+}
+
+void edf_stats(EdfT* edf, EdfStatsT* stats) {
+  stats->admitted = __atomic_load_n(&edf->stats.admitted, __ATOMIC_RELAXED);
+  stats->refused = __atomic_load_n(&edf->stats.refused, __ATOMIC_RELAXED);
+  stats->met = __atomic_load_n(&edf->stats.met, __ATOMIC_RELAXED);
+  stats->missed = __atomic_load_n(&edf->stats.missed, __ATOMIC_RELAXED);
+  for (int b = 0; b < EDF_LATENESS_BUCKETS; b++) {
+    stats->lateness[b] = __atomic_load_n(&edf->stats.lateness[b], __ATOMIC_RELAXED);
+  }
+}
+
+static int realtime(EdfT* edf, ProcessIdT pid) {
+  return edf->table->deadline[pid - 1] != 0;
+}
+
+// Count newly queued pids of either class, after they are queued - one post
+// each, as take consumes a count for every pid it hands out
+static void posted(EdfT* edf, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    sem_post(&edf->runnable);
+  }
+}
+
+// Queue real time pids by deadline
+static void push(EdfT* edf, ProcessIdT const* pids, size_t n) {
+  uint64_t deadlines[n];
+  for (size_t i = 0; i < n; i++) {
+    deadlines[i] = edf->table->deadline[pids[i] - 1];
+  }
+  priority_queue_push_many(&edf->queue, pids, deadlines, n);
+  posted(edf, n);
+}
+
+// Earliest deadline if any, else whatever the best effort policy picks.
+// counted is how many runnable counts the caller already took.
+static size_t take(EdfT* edf, ProcessIdT* pids, size_t max, size_t counted) {
+  //one real time process at a time so the next pick sees new deadlines
+  size_t picked = priority_queue_try_pop_many(&edf->queue, pids, NULL, 1);
+  if (picked == 0) {
+    picked = edf->best_effort->try_pick(edf->best_effort_state, pids, max);
+  }
+  //a count may not be posted yet if the push is still in flight, that
+  //only leaves a spare wakeup behind
+  for (size_t i = counted; i < picked; i++) {
+    if (sem_trywait(&edf->runnable) != 0) break;
+  }
+  return picked;
+}
+
+static void* policy_create(SimulatorT* simulator) {
+  EdfT* edf = (EdfT*)checked_malloc(sizeof(EdfT));
+  memset(edf, 0, sizeof(EdfT));
+  priority_queue_create(&edf->queue, simulator->process_table.size);
+  edf->table = &simulator->process_table;
+  edf->best_effort = simulator->best_effort;
+  edf->best_effort_state = edf->best_effort->create(simulator);
+  sem_init(&edf->runnable, 0, 0);
+  //idle workers spin, yield then park, like on a ready queue of their own
+  edf->wait = blocking_queue_default_wait;
+  edf->spin_budget = edf->wait.adaptive ? edf->wait.spin_limit / 4 : edf->wait.spin_limit;
+  edf->simulator_id = simulator->id;
+  //only the workers that are always running can be counted on
+  edf->capacity = (unsigned long)simulator->config.simulator_threads * EDF_WORKER_SHARE;
+  return edf;
+}
+
+static void policy_destroy(void* state) {
+  EdfT* edf = (EdfT*)state;
+
+  //report how the workers waited for processes
+  BlockingQueueStatsT const* stats = &edf->wait_stats;
+  LOG(log_info, log_general, "Simulator %i - Ready queue waits: %lu spins, %lu spin hits, %lu yields, %lu parks, %lu wakeups",
+      edf->simulator_id, stats->spins, stats->spin_hits, stats->yields, stats->parks, stats->wakeups);
+
+  edf->best_effort->destroy(edf->best_effort_state);
+  priority_queue_destroy(&edf->queue);
+  sem_destroy(&edf->runnable);
+  checked_free(edf);
+}
+
+// Split pids into the real time ones, queued here, and the rest -
+// returns how many are left for the best effort policy in rest
+static size_t split(EdfT* edf, ProcessIdT const* pids, size_t n, ProcessIdT* rest) {
+  ProcessIdT urgent[n];
+  size_t urgent_count = 0;
+  size_t rest_count = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (realtime(edf, pids[i])) {
+      urgent[urgent_count++] = pids[i];
+    } else {
+      rest[rest_count++] = pids[i];
+    }
+  }
+  if (urgent_count > 0) push(edf, urgent, urgent_count);
+  return rest_count;
+}
+
+static void policy_enqueue(void* state, ProcessIdT const* pids, size_t n) {
+  EdfT* edf = (EdfT*)state;
+  ProcessIdT rest[n];
+  size_t const count = split(edf, pids, n, rest);
+  if (count > 0) {
+    edf->best_effort->enqueue(edf->best_effort_state, rest, count);
+    posted(edf, count);
+  }
+}
+
+static size_t policy_try_pick(void* state, ProcessIdT* pids, size_t max) {
+  return take((EdfT*)state, pids, max, 0);
+}
+
+static size_t policy_pick_next(void* state, ProcessIdT* pids, size_t max) {
+  EdfT* edf = (EdfT*)state;
+  size_t picked = take(edf, pids, max, 0);
+  while (picked == 0 && !__atomic_load_n(&edf->terminated, __ATOMIC_ACQUIRE)) {
+    blocking_queue_wait_on(&edf->runnable, &edf->wait, &edf->spin_budget, &edf->wait_stats);
+    picked = take(edf, pids, max, 1);
+  }
+  return picked;
+}
+
+static void policy_on_preempt(void* state, ProcessIdT const* pids, EvaluatorResultT const* results, size_t n) {
+  EdfT* edf = (EdfT*)state;
+  ProcessIdT urgent[n];
+  ProcessIdT rest[n];
+  EvaluatorResultT rest_results[n];
+  size_t urgent_count = 0;
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (realtime(edf, pids[i])) {
+      urgent[urgent_count++] = pids[i];
+    } else {
+      rest_results[count] = results[i];
+      rest[count++] = pids[i];
+    }
+  }
+  if (urgent_count > 0) push(edf, urgent, urgent_count);
+  if (count > 0) {
+    edf->best_effort->on_preempt(edf->best_effort_state, rest, rest_results, count);
+    posted(edf, count);
+  }
+}
+
+static void policy_on_block(void* state, ProcessIdT pid, EvaluatorResultT const* result) {
+  EdfT* edf = (EdfT*)state;
+  if (!realtime(edf, pid) && edf->best_effort->on_block != NULL) {
+    edf->best_effort->on_block(edf->best_effort_state, pid, result);
+  }
+}
+
+static void policy_on_wake(void* state, ProcessIdT const* pids, size_t n) {
+  EdfT* edf = (EdfT*)state;
+  ProcessIdT rest[n];
+  size_t const count = split(edf, pids, n, rest);
+  if (count > 0) {
+    edf->best_effort->on_wake(edf->best_effort_state, rest, count);
+    posted(edf, count);
+  }
+}
+
+static void policy_on_exit(void* state, ProcessIdT pid, EvaluatorResultT const* result) {
+  EdfT* edf = (EdfT*)state;
+  if (!realtime(edf, pid)) {
+    if (edf->best_effort->on_exit != NULL) {
+      edf->best_effort->on_exit(edf->best_effort_state, pid, result);
+    }
+    return;
+  }
+
+  uint64_t const now = process_table_now();
+  uint64_t const deadline = edf->table->deadline[pid - 1];
+  if (now <= deadline) {
+    __atomic_fetch_add(&edf->stats.met, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  uint64_t const late_us = (now - deadline) / 1000;
+  unsigned int bucket = late_us ? 64 - __builtin_clzll(late_us) : 0;
+  if (bucket >= EDF_LATENESS_BUCKETS) bucket = EDF_LATENESS_BUCKETS - 1;
+  __atomic_fetch_add(&edf->stats.missed, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&edf->stats.lateness[bucket], 1, __ATOMIC_RELAXED);
+}
+
+static size_t policy_length(void* state) {
+  EdfT* edf = (EdfT*)state;
+  return priority_queue_length(&edf->queue) + edf->best_effort->length(edf->best_effort_state);
+}
+
+static void policy_terminate(void* state, int waiters) {
+  EdfT* edf = (EdfT*)state;
+  __atomic_store_n(&edf->terminated, 1, __ATOMIC_RELEASE);
+  edf->best_effort->terminate(edf->best_effort_state, waiters);
+  priority_queue_terminate(&edf->queue);
+  //every worker waits here rather than in the best effort policy
+  for (int i = 0; i < waiters; i++) {
+    sem_post(&edf->runnable);
+  }
+}
+
+SchedulerOpsT const scheduler_edf = {
+  .name = "edf",
+  .create = policy_create,
+  .destroy = policy_destroy,
+  .enqueue = policy_enqueue,
+  .try_pick = policy_try_pick,
+  .pick_next = policy_pick_next,
+  .on_preempt = policy_on_preempt,
+  .on_block = policy_on_block,
+  .on_wake = policy_on_wake,
+  .on_exit = policy_on_exit,
+  .length = policy_length,
+  .terminate = policy_terminate,
+};
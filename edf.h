@@ -0,0 +1,58 @@
+#ifndef _EDF_H_
+#define _EDF_H_
+
+#include "blocking_queue.h"
+#include "priority_queue.h"
+#include "process_table.h"
+#include "scheduler.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <semaphore.h>
+
+//power of two microsecond buckets for how late missed deadlines were
+#define EDF_LATENESS_BUCKETS 32
+
+//admission reserves shares of a worker in parts per million
+#define EDF_WORKER_SHARE 1000000u
+
+// Deadline outcomes of real time processes, read with edf_stats
+typedef struct EdfStats {
+  unsigned long admitted;
+  unsigned long refused; //would have overloaded the workers
+  unsigned long met; //exited on or before their deadline
+  unsigned long missed;
+  unsigned long lateness[EDF_LATENESS_BUCKETS]; //of the missed ones
+} EdfStatsT;
+
+// Real time scheduling class - processes with a deadline wait in a heap
+// ordered by absolute deadline and are always picked before the best
+// effort processes, which are left to the configured policy. Used through
+// scheduler_edf, which runs the policy in simulator->best_effort below it.
+typedef struct Edf {
+  PriorityQueueT queue; //real time pids keyed by absolute deadline
+  ProcessTableT* table; //deadline of every process
+  SchedulerOpsT const* best_effort;
+  void* best_effort_state;
+  sem_t runnable; //roughly one count per pid queued in either class
+  BlockingQueueWaitT wait; //how idle workers wait on runnable
+  unsigned int spin_budget;
+  BlockingQueueStatsT wait_stats;
+  int simulator_id; //for the wait report
+  int terminated;
+  unsigned long capacity; //a worker share for every worker
+  unsigned long load; //shares reserved by live real time processes
+  EdfStatsT stats; //updated atomically
+} EdfT;
+
+// Reserve a share for a process needing runtime_ns of cpu within
+// deadline_ns, released at most once every period_ns. Returns the share,
+// never 0, or 0 when the reserved total would exceed the workers.
+unsigned int edf_admit(EdfT* edf, uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns);
+// Give back a share from edf_admit once its process is gone
+void edf_release(EdfT* edf, unsigned int share);
+
+void edf_stats(EdfT* edf, EdfStatsT* stats);
+
+extern SchedulerOpsT const scheduler_edf;
+
+#endif
@@ -0,0 +1,161 @@
+#include "edf.h"
+#include "simulator.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+SimulatorT simulator;
+EdfT* edf;
+
+// Just what the real time class reads of a simulator, round robin below it
+void setup() {
+  memset(&simulator, 0, sizeof(simulator));
+  config_defaults(&simulator.config);
+  simulator.config.simulator_threads = 2;
+  process_table_create(&simulator.process_table, 16);
+  simulator.best_effort = &scheduler_round_robin;
+  edf = (EdfT*)scheduler_edf.create(&simulator);
+}
+
+void teardown() {
+  scheduler_edf.destroy(edf);
+  process_table_destroy(&simulator.process_table);
+}
+
+void test_admit_density() {
+  printf("testing admission by density up to the worker count\n");
+  setup();
+  //a quarter of a worker within the deadline, the period is longer
+  unsigned int const share = edf_admit(edf, 250, 1000, 4000);
+  assert(share == EDF_WORKER_SHARE / 4);
+  //half a worker over the period - the shorter deadline counts
+  assert(edf_admit(edf, 500, 4000, 1000) == EDF_WORKER_SHARE / 2);
+  assert(edf_admit(edf, 1000, 1000, 1000) == EDF_WORKER_SHARE);
+  //a quarter is left of the two workers
+  assert(edf_admit(edf, 300, 1000, 1000) == 0);
+  assert(edf_admit(edf, 250, 1000, 1000) == EDF_WORKER_SHARE / 4);
+  assert(edf_admit(edf, 1, 1000000, 1000000) == 0);
+
+  EdfStatsT stats;
+  edf_stats(edf, &stats);
+  assert(stats.admitted == 4);
+  assert(stats.refused == 2);
+
+  //released shares can be taken again
+  edf_release(edf, share);
+  assert(edf_admit(edf, 250, 1000, 1000) == EDF_WORKER_SHARE / 4);
+  teardown();
+}
+
+void test_admit_refusals() {
+  printf("testing admission refuses empty windows and rounds shares up\n");
+  setup();
+  assert(edf_admit(edf, 1, 0, 1000) == 0);
+  assert(edf_admit(edf, 1, 1000, 0) == 0);
+  //too small to count still takes a share
+  assert(edf_admit(edf, 0, 1000, 1000) == 1);
+  assert(edf_admit(edf, 3 * 1000, 1000, 1000) == 0);
+  EdfStatsT stats;
+  edf_stats(edf, &stats);
+  assert(stats.refused == 3);
+  assert(stats.admitted == 1);
+  teardown();
+}
+
+void test_earliest_deadline_first() {
+  printf("testing real time processes go first, earliest deadline first\n");
+  setup();
+  ProcessTableT* table = &simulator.process_table;
+  uint64_t const now = process_table_now();
+  table->deadline[3 - 1] = now + 3000000;
+  table->deadline[4 - 1] = now + 1000000;
+  table->deadline[5 - 1] = now + 2000000;
+  ProcessIdT const pids[] = { 1, 3, 2, 4, 5 };
+  scheduler_edf.enqueue(edf, pids, 5);
+  assert(scheduler_edf.length(edf) == 5);
+
+  ProcessIdT picked[4];
+  ProcessIdT const expected[] = { 4, 5, 3 };
+  for (int i = 0; i < 3; i++) {
+    assert(scheduler_edf.try_pick(edf, picked, 4) == 1);
+    assert(picked[0] == expected[i]);
+  }
+  //then the best effort ones, as many as asked for
+  assert(scheduler_edf.try_pick(edf, picked, 4) == 2);
+  assert(picked[0] == 1 && picked[1] == 2);
+  assert(scheduler_edf.try_pick(edf, picked, 4) == 0);
+  teardown();
+}
+
+void test_lateness_buckets() {
+  printf("testing missed deadlines land in power of two buckets\n");
+  setup();
+  ProcessTableT* table = &simulator.process_table;
+  EvaluatorResultT const result = { 0, 0, reason_terminated };
+  uint64_t const now = process_table_now();
+  //met, late by under a microsecond, by 5us and by about 100us
+  table->deadline[1 - 1] = now + 1000000000ull;
+  table->deadline[2 - 1] = now - 100;
+  table->deadline[3 - 1] = now - 5000;
+  table->deadline[4 - 1] = now - 100000;
+  //far enough past to fall in the last bucket
+  table->deadline[5 - 1] = 1;
+  for (ProcessIdT pid = 1; pid <= 5; pid++) {
+    scheduler_edf.on_exit(edf, pid, &result);
+  }
+  //a best effort exit is not counted either way
+  scheduler_edf.on_exit(edf, 6, &result);
+
+  EdfStatsT stats;
+  edf_stats(edf, &stats);
+  assert(stats.met == 1);
+  assert(stats.missed == 4);
+  assert(stats.lateness[0] == 1);
+  assert(stats.lateness[3] == 1); //5us, under 8
+  assert(stats.lateness[7] == 1); //100us and a little, under 128
+  assert(stats.lateness[EDF_LATENESS_BUCKETS - 1] == 1);
+  unsigned long total = 0;
+  for (int b = 0; b < EDF_LATENESS_BUCKETS; b++) total += stats.lateness[b];
+  assert(total == stats.missed);
+  teardown();
+}
+
+void* late_enqueue(void* arg) {
+  usleep(20000);
+  ProcessIdT const pid = 7;
+  scheduler_edf.enqueue(edf, &pid, 1);
+  return NULL;
+}
+
+void test_pick_waits_adaptively() {
+  printf("testing an idle pick spins, yields then parks\n");
+  setup();
+  pthread_t thread;
+  pthread_create(&thread, NULL, late_enqueue, NULL);
+  ProcessIdT picked[4];
+  assert(scheduler_edf.pick_next(edf, picked, 4) == 1);
+  assert(picked[0] == 7);
+  pthread_join(thread, NULL);
+  //20ms is far longer than any spin, so the wait went to sleep
+  assert(edf->wait_stats.spins > 0);
+  assert(edf->wait_stats.yields == edf->wait.yield_limit);
+  assert(edf->wait_stats.parks == 1);
+  assert(edf->wait_stats.wakeups == 1);
+
+  //terminate lets a parked pick go with nothing
+  scheduler_edf.terminate(edf, 1);
+  assert(scheduler_edf.pick_next(edf, picked, 4) == 0);
+  teardown();
+}
+
+int main() {
+  test_admit_density();
+  test_admit_refusals();
+  test_earliest_deadline_first();
+  test_lateness_buckets();
+  test_pick_waits_adaptively();
+  return 0;
+}
@@ -3,169 +3,231 @@
 #include "utilities.h"
 #include "evaluator.h"
 #include "list.h"
+#include "coroutine.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-static pthread_t* threads;
-static pthread_t* blocking_threads;
-static pthread_t* infinite_threads;
-static int* thread_ids;
-static int* blocking_thread_ids;
-static int* infinite_thread_ids;
-static int count; 
-static int iters;
-static int batch;
 
+// Group for a client's processes, letting other clients run while every
+// group is in use
+static GroupIdT client_group(EnvironmentT* environment) {
+  GroupIdT group;
+  while((group = simulator_create_group(environment->simulator, environment->group_quota_us,
+					environment->group_period_us)) == 0){
+    coroutine_yield();
+  }
+  return group;
+}
+
+// Create a process in the group, letting other clients run while every
+// pid is in use
+static ProcessIdT client_create(SimulatorT* simulator, GroupIdT group, EvaluatorCodeT const code) {
+  ProcessIdT pid;
+  while((pid = simulator_try_create_process_in_group(simulator, group, code)) == 0){
+    coroutine_yield();
+  }
+  return pid;
+}
+
+// Create a process with a deadline, running it best effort instead when
+// admission refuses it
+static void client_create_realtime(SimulatorT* simulator, GroupIdT group, EvaluatorCodeT const code,
+				   unsigned int deadline_us) {
+  //in the group before the policy sees it, so a group kill or wait cannot miss it
+  if (simulator_try_create_realtime_process_in_group(simulator, group, code, deadline_us, deadline_us) == 0) {
+    client_create(simulator, group, code);
+  }
+}
+
+// Wait for the whole group, letting other clients run until it is empty
+static void client_wait(SimulatorT* simulator, GroupIdT group) {
+  while(!simulator_try_wait_group(simulator, group)){
+    coroutine_yield();
+  }
+}
+
+// Steps for the next process of a client - mostly short jobs, with the
+// configured share of long ones
+static unsigned int client_steps(EnvironmentClientT* client) {
+  unsigned int const percent = client->environment->long_jobs;
+  if (percent > 0 && rand_r(&client->seed) % 100 < percent) {
+    return ENVIRONMENT_LONG_JOB_STEPS;
+  }
+  return ENVIRONMENT_JOB_STEPS;
+}
 
-void *terminating_routine(void *arg){
-  //retrive thread id
-  int thread_id = *(int*)arg;
+void terminating_routine(void *arg){
+  //retrive environment and client id
+  EnvironmentClientT* client = (EnvironmentClientT*)arg;
+  EnvironmentT* environment = client->environment;
+  SimulatorT* simulator = environment->simulator;
+  int const iters = environment->iters;
+  int const batch = environment->batch;
   
-  EvaluatorCodeT const code = evaluator_terminates_after(5);
+  //each batch goes into the client's group and is waited for in one go
+  GroupIdT const group = client_group(environment);
   
   for(int i=0; i<iters; i++){ //loop through iterations
     
-    ProcessIdT pids[batch];
-    
     for(int y=0; y<batch; y++){ //loop through batch
       //create process using code 
-      pids[y] = simulator_create_process(code);
-      
+      EvaluatorCodeT const code = evaluator_terminates_after(client_steps(client));
+      if (environment->deadline_us > 0) {
+	client_create_realtime(simulator, group, code, environment->deadline_us);
+      } else {
+	client_create(simulator, group, code);
+      }
     }
     
-    //iterate through processes and wait for termination
-    for(int j = 0 ; j<batch;j++)
-    { 
-       if(pids[j] > 0){
-       
-        simulator_wait(pids[j]);
-       }
-    }
+    client_wait(simulator, group);
   }
   
-  //printf("thread exiting\n");
-  return NULL; //exit thread
+  simulator_destroy_group(simulator, group);
 }
 
-void *blocking_routine(void *arg){
-  //retrive thread id
-  int thread_id = *(int*)arg;
+void blocking_routine(void *arg){
+  //retrive environment and client id
+  EnvironmentClientT* client = (EnvironmentClientT*)arg;
+  EnvironmentT* environment = client->environment;
+  SimulatorT* simulator = environment->simulator;
+  int const iters = environment->iters;
+  int const batch = environment->batch;
   
-  EvaluatorCodeT const code = evaluator_blocking_terminates_after(5);
+  GroupIdT const group = client_group(environment);
   
   for(int i=0; i<iters; i++){ //loop through iterations
     
-    ProcessIdT pids[batch];
-    
     for(int y=0; y<batch; y++){ //loop through batch
-
-      pids[y] = simulator_create_process(code);
-      
+      client_create(simulator, group, evaluator_blocking_terminates_after(client_steps(client)));
     }
     
-    //iterate through processes and wait for termination
-    for(int j = 0 ; j<batch;j++)
-    { 
-       if(pids[j] > 0){
-       
-        simulator_wait(pids[j]);
-       }
-       
-    }
+    client_wait(simulator, group);
   }
   
-  //printf("thread exiting\n");
-  return NULL; //exit thread
+  simulator_destroy_group(simulator, group);
 }
 
-void *infinite_routine(void *arg){
-  //retrive thread id
-  int thread_id = *(int*)arg;
+void infinite_routine(void *arg){
+  //retrive environment and client id
+  EnvironmentClientT* client = (EnvironmentClientT*)arg;
+  EnvironmentT* environment = client->environment;
+  SimulatorT* simulator = environment->simulator;
+  int const iters = environment->iters;
+  int const batch = environment->batch;
   
   EvaluatorCodeT const code = evaluator_infinite_loop;
+  GroupIdT const group = client_group(environment);
   
   for(int i=0; i<iters; i++){ //loop through iterations
     
-    ProcessIdT pids[batch];
-    
     for(int y=0; y<batch; y++){ //loop through batch
-
-      pids[y] = simulator_create_process(code);
-      simulator_kill(pids[y]);
-      
-    }
-    
-    //iterate through processes and wait for termination
-    for(int j = 0 ; j<batch;j++)
-    { 
-       if(pids[j] > 0){
-       
-        simulator_wait(pids[j]);
-       }
+      simulator_kill(simulator, client_create(simulator, group, code));
     }
     
+    //wait for the whole batch at once
+    client_wait(simulator, group);
   }
   
-  //printf("thread exiting\n");
-  return NULL; //exit thread
+  simulator_destroy_group(simulator, group);
 }
 
-
-
-void environment_start(unsigned int thread_count, unsigned int iterations,unsigned int batch_size) {
-
-  count = thread_count;
-  iters = iterations;
-  batch = batch_size;
-  
-  threads = (pthread_t*)checked_malloc(thread_count * sizeof(pthread_t));
-  blocking_threads = (pthread_t*)checked_malloc(thread_count * sizeof(pthread_t));
-  infinite_threads = (pthread_t*)checked_malloc(thread_count * sizeof(pthread_t));
-  
-  thread_ids = (int*)checked_malloc(thread_count * sizeof(int));
-  blocking_thread_ids = (int*)checked_malloc(thread_count * sizeof(int));
-  infinite_thread_ids = (int*)checked_malloc(thread_count * sizeof(int));
-  		       
-  for(int i = 0; i<thread_count ; i++){
-    //save thread id into array
-    thread_ids[i] = i+1;
-    blocking_thread_ids[i] = i+1;
-    infinite_thread_ids[i] = i+1;
-    pthread_create( (&threads[i]), NULL, terminating_routine, &thread_ids[i] );
-    pthread_create( (&blocking_threads[i]), NULL, blocking_routine, &blocking_thread_ids[i]);
-    pthread_create( (&infinite_threads[i]), NULL, infinite_routine, &infinite_thread_ids[i]);
-    
+static void *carrier_routine(void *arg){
+  EnvironmentCarrierT* carrier = (EnvironmentCarrierT*)arg;
+  EnvironmentT* environment = carrier->environment;
+  
+  int live = 0;
+  for(int i = carrier->id; i < environment->client_count; i += environment->carrier_count){
+    live++;
   }
-
-}
-
-void environment_stop() {
-  //join each thread
-  for(int i=0; i<count; i++){
-    if (pthread_join(threads[i], NULL) != 0) {
-        perror("Failed to join terminating thread");
+  
+  //round robin over this carrier's clients until all have returned
+  while(live > 0){
+    unsigned int const seen = simulator_progress_seen(environment->simulator);
+    int returned = 0;
+    for(int i = carrier->id; i < environment->client_count; i += environment->carrier_count){
+      CoroutineT* coroutine = &environment->clients[i].coroutine;
+      if(coroutine->finished){
+        continue;
+      }
+      if(coroutine_resume(coroutine)){
+        live--;
+        returned = 1;
+      }
     }
-
-    if (pthread_join(blocking_threads[i], NULL) != 0) {
-        perror("Failed to join blocking thread");
-    }
-    
-    if (pthread_join(infinite_threads[i], NULL) != 0) {
-        perror("Failed to join infinite thread");
+    //every client left is waiting, sleep until something it may be waiting
+    //for has happened since the round began
+    if(live > 0 && !returned){
+      simulator_wait_progress(environment->simulator, seen, &blocking_queue_default_wait,
+			      &carrier->spin_budget, &carrier->wait_stats);
     }
   }
- 
-  checked_free(threads);
-  checked_free(thread_ids);
   
-  checked_free(blocking_threads);
-  checked_free(blocking_thread_ids);
+  return NULL;
+}
+
+EnvironmentT* environment_start(SimulatorT* simulator) {
+  
+  ConfigT const* config = &simulator->config;
+  unsigned int const carrier_count = config->environment_threads;
+  
+  static void (*const routines[])(void*) = { terminating_routine, blocking_routine, infinite_routine };
   
-  checked_free(infinite_thread_ids);
-  checked_free(infinite_threads);
+  EnvironmentT* environment = (EnvironmentT*)checked_malloc(sizeof(EnvironmentT));
+  environment->simulator = simulator;
+  environment->carrier_count = carrier_count;
+  environment->client_count = 3 * config->environment_clients;
+  environment->iters = config->iterations;
+  environment->batch = config->batch_size;
+  environment->long_jobs = config->long_jobs;
+  environment->deadline_us = config->deadline_us;
+  environment->group_quota_us = config->group_quota_us;
+  environment->group_period_us = config->group_period_us;
   
-  threads = NULL;
-  thread_ids = NULL;
-  blocking_threads = NULL;
-  infinite_threads = NULL;
-  infinite_thread_ids = NULL;
+  //one client of each kind per index, neighbours land on different carriers
+  environment->clients = (EnvironmentClientT*)checked_malloc(environment->client_count * sizeof(EnvironmentClientT));
+  for(int i = 0; i<environment->client_count; i++){
+    EnvironmentClientT* client = &environment->clients[i];
+    client->environment = environment;
+    client->kind = (ClientKindT)(i % 3);
+    client->id = i / 3 + 1;
+    client->seed = i + 1;
+    coroutine_create(&client->coroutine, routines[client->kind], client, COROUTINE_STACK_SIZE);
+  }
+  
+  environment->threads = (pthread_t*)checked_malloc(carrier_count * sizeof(pthread_t));
+  environment->carriers = (EnvironmentCarrierT*)checked_malloc(carrier_count * sizeof(EnvironmentCarrierT));
+  
+  //carriers run on the same cpus as their simulator
+  pthread_attr_t attr;
+  simulator_thread_attr(simulator, &attr);
+  
+  for(int i = 0; i<carrier_count ; i++){
+    environment->carriers[i].environment = environment;
+    environment->carriers[i].id = i;
+    environment->carriers[i].spin_budget = blocking_queue_default_wait.spin_limit / 4;
+    memset(&environment->carriers[i].wait_stats, 0, sizeof(BlockingQueueStatsT));
+    pthread_create( (&environment->threads[i]), &attr, carrier_routine, &environment->carriers[i]);
+  }
+  pthread_attr_destroy(&attr);
+  
+  return environment;
+}
+
+void environment_stop(EnvironmentT* environment) {
+  //join each carrier, they return once all of their clients have
+  for(int i=0; i<environment->carrier_count; i++){
+    if (pthread_join(environment->threads[i], NULL) != 0) {
+        perror("Failed to join carrier thread");
+    }
+  }
+  
+  for(int i=0; i<environment->client_count; i++){
+    coroutine_destroy(&environment->clients[i].coroutine);
+  }
+ 
+  checked_free(environment->threads);
+  checked_free(environment->carriers);
+  checked_free(environment->clients);
+  checked_free(environment);
 }
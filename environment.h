@@ -1,10 +1,63 @@
 #ifndef _ENVIRONMENT_H_
 #define _ENVIRONMENT_H_
 
-void environment_start(unsigned int thread_count,
-		       unsigned int iterations,
-		       unsigned int batch_size);
-void environment_stop();
-void *terminating_routine(void *arg);
+#include "coroutine.h"
+#include "blocking_queue.h"
+#include <pthread.h>
+
+//length of client processes, long ones make up the long-jobs percentage
+#define ENVIRONMENT_JOB_STEPS 5
+#define ENVIRONMENT_LONG_JOB_STEPS 50
+
+struct Simulator;
+struct Environment;
+
+typedef enum ClientKind {
+  client_terminating,
+  client_blocking,
+  client_infinite,
+} ClientKindT;
+
+// One simulated submitter, running as a coroutine on a carrier thread
+typedef struct EnvironmentClient {
+  struct Environment* environment;
+  CoroutineT coroutine;
+  ClientKindT kind;
+  int id; //ids start from 1, the three kinds of one index share an id
+  unsigned int seed; //picks which of its processes are long
+} EnvironmentClientT;
+
+// Argument handed to each carrier thread
+typedef struct EnvironmentCarrier {
+  struct Environment* environment;
+  int id; //ids start from 0, runs every client whose index matches modulo count
+  unsigned int spin_budget; //of the wait while every client is waiting
+  BlockingQueueStatsT wait_stats;
+} EnvironmentCarrierT;
+
+// Clients driving one simulator - a few carrier threads multiplex every
+// client, a client waiting on a pid yields to the next one instead of
+// blocking its thread
+typedef struct Environment {
+  struct Simulator* simulator;
+  pthread_t* threads;
+  EnvironmentCarrierT* carriers;
+  int carrier_count;
+  EnvironmentClientT* clients;
+  int client_count; //three per client index, one of each kind
+  int iters;
+  int batch;
+  unsigned int long_jobs; //percent of processes that are long
+  unsigned int deadline_us; //terminating processes ask for this deadline, 0 for none
+  unsigned int group_quota_us; //worker time each client's group gets per period, 0 for unlimited
+  unsigned int group_period_us;
+} EnvironmentT;
+
+// Sized by the settings the simulator was started with
+EnvironmentT* environment_start(struct Simulator* simulator);
+void environment_stop(EnvironmentT* environment);
+void terminating_routine(void *arg);
+void blocking_routine(void *arg);
+void infinite_routine(void *arg);
 
 #endif
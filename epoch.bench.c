@@ -0,0 +1,79 @@
+#include "epoch.h"
+#include "utilities.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#define OPERATIONS_PER_THREAD 2000000
+#define MAX_THREADS 8
+
+EpochDomainT domain;
+unsigned int thread_count;
+
+double seconds_since(struct timespec const* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void* enter_exit(void* arg) {
+  (void)arg;
+  EpochRecordT* record = epoch_register(&domain);
+  for (unsigned int i = 0; i < OPERATIONS_PER_THREAD; i++) {
+    epoch_enter(record);
+    epoch_exit(record);
+  }
+  epoch_unregister(record);
+  return NULL;
+}
+
+void* retire(void* arg) {
+  (void)arg;
+  EpochRecordT* record = epoch_register(&domain);
+  for (unsigned int i = 0; i < OPERATIONS_PER_THREAD / 8; i++) {
+    epoch_enter(record);
+    epoch_retire(record, checked_malloc(64), checked_free);
+    epoch_exit(record);
+  }
+  epoch_unregister(record);
+  return NULL;
+}
+
+void* direct_free(void* arg) {
+  (void)arg;
+  for (unsigned int i = 0; i < OPERATIONS_PER_THREAD / 8; i++) {
+    checked_free(checked_malloc(64));
+  }
+  return NULL;
+}
+
+// Run the loop on every thread and return ns per operation per thread
+double run(void* (*loop)(void*), unsigned int operations) {
+  pthread_t threads[MAX_THREADS];
+  epoch_create(&domain);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned int i = 0; i < thread_count; i++) {
+    pthread_create(&threads[i], NULL, loop, NULL);
+  }
+  for (unsigned int i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  double const seconds = seconds_since(&start);
+
+  epoch_destroy(&domain);
+  return seconds * 1e9 / operations;
+}
+
+int main() {
+  printf("%7s %12s %14s %12s  (ns/op)\n", "threads", "enter+exit", "retire+free", "free");
+  for (thread_count = 1; thread_count <= MAX_THREADS; thread_count *= 2) {
+    double const section = run(enter_exit, OPERATIONS_PER_THREAD);
+    double const deferred = run(retire, OPERATIONS_PER_THREAD / 8);
+    double const direct = run(direct_free, OPERATIONS_PER_THREAD / 8);
+    printf("%7u %12.1f %14.1f %12.1f\n", thread_count, section, deferred, direct);
+  }
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include "epoch.h"
+#include "utilities.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define ACTIVE 1ul
+
+void epoch_create(EpochDomainT* domain) {
+  memset(domain, 0, sizeof(EpochDomainT));
+}
+
+// Free every entry of a limbo list, returns how many
+static size_t limbo_free(EpochDomainT* domain, EpochLimboT* limbo) {
+  size_t const count = limbo->count;
+  for (size_t i = 0; i < count; i++) {
+    limbo->entries[i].free_fn(limbo->entries[i].pointer);
+  }
+  limbo->count = 0;
+  if (count > 0) {
+    __atomic_fetch_add(&domain->freed, count, __ATOMIC_RELAXED);
+  }
+  return count;
+}
+
+void epoch_destroy(EpochDomainT* domain) {
+  EpochRecordT* record = domain->records;
+  while (record != NULL) {
+    EpochRecordT* next = record->next;
+    assert(!(record->state & ACTIVE));
+    for (int i = 0; i < 3; i++) {
+      limbo_free(domain, &record->limbo[i]);
+      if (record->limbo[i].entries != NULL) checked_free(record->limbo[i].entries);
+    }
+    checked_free(record);
+    record = next;
+  }
+  domain->records = NULL;
+}
+
+EpochRecordT* epoch_register(EpochDomainT* domain) {
+  //take over a record left by a thread that has gone
+  for (EpochRecordT* record = __atomic_load_n(&domain->records, __ATOMIC_ACQUIRE);
+       record != NULL; record = record->next) {
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&record->in_use, &expected, 1, 0,
+				    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      return record;
+    }
+  }
+
+  EpochRecordT* record = (EpochRecordT*)checked_aligned_malloc(64, sizeof(EpochRecordT));
+  memset(record, 0, sizeof(EpochRecordT));
+  record->in_use = 1;
+  record->domain = domain;
+
+  //records are only ever added, so a plain push is enough
+  record->next = __atomic_load_n(&domain->records, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&domain->records, &record->next, record, 1,
+				      __ATOMIC_RELEASE, __ATOMIC_RELAXED)) ;
+  return record;
+}
+
+void epoch_unregister(EpochRecordT* record) {
+  assert(record->depth == 0);
+  __atomic_store_n(&record->in_use, 0, __ATOMIC_RELEASE);
+}
+
+void epoch_enter(EpochRecordT* record) {
+  if (record->depth++ > 0) return;
+  unsigned long const epoch = __atomic_load_n(&record->domain->epoch, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&record->state, (epoch << 1) | ACTIVE, __ATOMIC_RELAXED);
+  //be seen as inside before reading any shared node
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(EpochRecordT* record) {
+  assert(record->depth > 0);
+  if (--record->depth > 0) return;
+  __atomic_store_n(&record->state, record->state & ~ACTIVE, __ATOMIC_RELEASE);
+}
+
+// Move the global epoch on if every thread inside has seen the current
+// one, returns the epoch afterwards
+static unsigned long try_advance(EpochDomainT* domain) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  unsigned long epoch = __atomic_load_n(&domain->epoch, __ATOMIC_SEQ_CST);
+  for (EpochRecordT* record = __atomic_load_n(&domain->records, __ATOMIC_ACQUIRE);
+       record != NULL; record = record->next) {
+    unsigned long const state = __atomic_load_n(&record->state, __ATOMIC_ACQUIRE);
+    if ((state & ACTIVE) && (state >> 1) != epoch) {
+      return epoch;
+    }
+  }
+
+  //losing the race means someone else moved it on
+  if (__atomic_compare_exchange_n(&domain->epoch, &epoch, epoch + 1, 0,
+				  __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+    __atomic_fetch_add(&domain->advances, 1, __ATOMIC_RELAXED);
+    return epoch + 1;
+  }
+  return epoch;
+}
+
+size_t epoch_reclaim(EpochRecordT* record) {
+  EpochDomainT* domain = record->domain;
+  unsigned long const epoch = try_advance(domain);
+  record->retired_since = 0;
+
+  //two advances after retiring, every thread inside then has entered
+  //since the pointer was unlinked
+  size_t freed = 0;
+  for (int i = 0; i < 3; i++) {
+    EpochLimboT* limbo = &record->limbo[i];
+    if (limbo->count > 0 && limbo->epoch + 2 <= epoch) {
+      freed += limbo_free(domain, limbo);
+    }
+  }
+  return freed;
+}
+
+void epoch_retire(EpochRecordT* record, void* pointer, void (*free_fn)(void*)) {
+  EpochDomainT* domain = record->domain;
+
+  //the global epoch now, even inside a critical section - the one seen on
+  //entry can be a step behind, and a thread that entered since could
+  //still be reading the pointer when that older epoch comes up for freeing
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  unsigned long const epoch = __atomic_load_n(&domain->epoch, __ATOMIC_SEQ_CST);
+
+  //a list still holding an older epoch is at least three behind, long safe
+  EpochLimboT* limbo = &record->limbo[epoch % 3];
+  if (limbo->epoch != epoch) {
+    limbo_free(domain, limbo);
+    limbo->epoch = epoch;
+  }
+
+  if (limbo->count == limbo->capacity) {
+    size_t const capacity = limbo->capacity ? 2 * limbo->capacity : EPOCH_RECLAIM_BATCH;
+    EpochRetiredT* entries = (EpochRetiredT*)checked_malloc(capacity * sizeof(EpochRetiredT));
+    if (limbo->entries != NULL) {
+      memcpy(entries, limbo->entries, limbo->count * sizeof(EpochRetiredT));
+      checked_free(limbo->entries);
+    }
+    limbo->entries = entries;
+    limbo->capacity = capacity;
+  }
+  limbo->entries[limbo->count].pointer = pointer;
+  limbo->entries[limbo->count].free_fn = free_fn;
+  limbo->count++;
+  __atomic_fetch_add(&domain->retired, 1, __ATOMIC_RELAXED);
+
+  if (++record->retired_since >= EPOCH_RECLAIM_BATCH) {
+    epoch_reclaim(record);
+  }
+}
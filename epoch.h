@@ -0,0 +1,71 @@
+#ifndef _EPOCH_H_
+#define _EPOCH_H_
+
+#include <stddef.h>
+
+//retires between attempts to move the epoch on and free what is safe
+#ifndef EPOCH_RECLAIM_BATCH
+#define EPOCH_RECLAIM_BATCH 64
+#endif
+
+// Memory retired while the epoch was epoch, freed with free_fn
+typedef struct EpochRetired {
+  void* pointer;
+  void (*free_fn)(void*);
+} EpochRetiredT;
+
+// Retired memory of one epoch, one list per epoch still in flight
+typedef struct EpochLimbo {
+  unsigned long epoch;
+  EpochRetiredT* entries;
+  size_t count;
+  size_t capacity;
+} EpochLimboT;
+
+// Per thread state - a thread registers once and passes its record to
+// every call. Records are never freed before the domain, a thread that
+// unregisters leaves its record and anything still retired in it to the
+// next thread that registers.
+typedef struct EpochRecord {
+  unsigned long state; //epoch seen on entry shifted left, low bit set while inside
+  int in_use;
+  int depth; //nested enters
+  size_t retired_since; //retires since the last reclaim attempt
+  EpochLimboT limbo[3];
+  struct EpochRecord* next; //every record of the domain
+  struct EpochDomain* domain;
+} __attribute__((aligned(64))) EpochRecordT;
+
+// Epoch based reclamation for lock free structures. Readers bracket every
+// access to shared nodes with enter and exit. A node unlinked from the
+// structure is retired rather than freed, and is only freed once every
+// thread has left the critical sections it might have been read in -
+// two epoch advances later.
+typedef struct EpochDomain {
+  unsigned long epoch; //global epoch, only ever increases
+  EpochRecordT* records; //registered threads, pushed at the head
+  unsigned long retired; //totals, for tests and monitoring
+  unsigned long freed;
+  unsigned long advances;
+} EpochDomainT;
+
+void epoch_create(EpochDomainT* domain);
+// Free everything still retired, no thread may be inside or register again
+void epoch_destroy(EpochDomainT* domain);
+
+EpochRecordT* epoch_register(EpochDomainT* domain);
+void epoch_unregister(EpochRecordT* record);
+
+// Critical section around reads of shared nodes, may nest
+void epoch_enter(EpochRecordT* record);
+void epoch_exit(EpochRecordT* record);
+
+// Free pointer with free_fn once no thread can still be reading it. The
+// pointer must already be unreachable for threads entering from now on.
+void epoch_retire(EpochRecordT* record, void* pointer, void (*free_fn)(void*));
+// Try to move the epoch on and free what this thread retired that is
+// now safe, returns how many were freed. Called every
+// EPOCH_RECLAIM_BATCH retires, call it directly to flush sooner.
+size_t epoch_reclaim(EpochRecordT* record);
+
+#endif
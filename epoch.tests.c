@@ -0,0 +1,236 @@
+#include "epoch.h"
+#include "utilities.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#define THREADS 4
+#define OPERATIONS_PER_THREAD 100000
+
+#define LIVE 0x1157u
+#define POISON 0xdeadu
+
+typedef struct Node {
+  struct Node* next;
+  unsigned int magic;
+} NodeT;
+
+EpochDomainT domain;
+unsigned long poisoned;
+
+// Stands in for free - nodes are poisoned rather than handed back, so any
+// read after the "free" is caught by the magic check instead of being
+// hidden by the allocator reusing the memory
+void poison(void* pointer) {
+  NodeT* node = (NodeT*)pointer;
+  assert(node->magic == LIVE);
+  node->magic = POISON;
+  __atomic_fetch_add(&poisoned, 1, __ATOMIC_RELAXED);
+}
+
+void test_empty_creation() {
+  printf("testing empty creation/destruction of epoch domains\n");
+  epoch_create(&domain);
+  assert(domain.epoch == 0);
+  EpochRecordT* record = epoch_register(&domain);
+  assert(record->domain == &domain);
+  assert(epoch_reclaim(record) == 0);
+  epoch_unregister(record);
+  epoch_destroy(&domain);
+}
+
+void test_two_advances() {
+  printf("testing retired memory is freed two epochs later\n");
+  epoch_create(&domain);
+  poisoned = 0;
+  EpochRecordT* record = epoch_register(&domain);
+  NodeT node = { NULL, LIVE };
+
+  epoch_retire(record, &node, poison);
+  assert(domain.retired == 1);
+  assert(epoch_reclaim(record) == 0);
+  assert(domain.epoch == 1);
+  assert(node.magic == LIVE);
+  assert(epoch_reclaim(record) == 1);
+  assert(domain.epoch == 2);
+  assert(node.magic == POISON);
+  assert(domain.freed == 1);
+
+  epoch_unregister(record);
+  epoch_destroy(&domain);
+}
+
+void test_reader_holds_epoch() {
+  printf("testing a thread inside keeps what it may read\n");
+  epoch_create(&domain);
+  poisoned = 0;
+  EpochRecordT* reader = epoch_register(&domain);
+  EpochRecordT* writer = epoch_register(&domain);
+  assert(reader != writer);
+  NodeT node = { NULL, LIVE };
+
+  epoch_enter(reader);
+  epoch_retire(writer, &node, poison);
+  for (int i = 0; i < 10; i++) {
+    assert(epoch_reclaim(writer) == 0);
+  }
+  //the reader can only let the epoch move once
+  assert(domain.epoch == 1);
+
+  //nested sections leave the thread inside until the outermost exit
+  epoch_enter(reader);
+  epoch_exit(reader);
+  assert(epoch_reclaim(writer) == 0);
+  assert(node.magic == LIVE);
+
+  epoch_exit(reader);
+  assert(epoch_reclaim(writer) == 1);
+  assert(node.magic == POISON);
+
+  epoch_unregister(reader);
+  epoch_unregister(writer);
+  epoch_destroy(&domain);
+}
+
+void test_retire_inside_late_epoch() {
+  printf("testing a retire inside an old epoch waits for later readers\n");
+  epoch_create(&domain);
+  poisoned = 0;
+  EpochRecordT* retirer = epoch_register(&domain);
+  EpochRecordT* reader = epoch_register(&domain);
+  EpochRecordT* other = epoch_register(&domain);
+  NodeT node = { NULL, LIVE };
+
+  //the retirer enters at 0 and the epoch moves on under it
+  epoch_enter(retirer);
+  assert(epoch_reclaim(other) == 0);
+  assert(domain.epoch == 1);
+  //a reader entering now can still reach the node
+  epoch_enter(reader);
+  epoch_retire(retirer, &node, poison);
+  epoch_exit(retirer);
+  for (int i = 0; i < 10; i++) {
+    epoch_reclaim(retirer);
+    epoch_reclaim(other);
+  }
+  assert(domain.epoch == 2);
+  assert(node.magic == LIVE);
+
+  epoch_exit(reader);
+  epoch_reclaim(other);
+  assert(epoch_reclaim(retirer) == 1);
+  assert(node.magic == POISON);
+
+  epoch_unregister(retirer);
+  epoch_unregister(reader);
+  epoch_unregister(other);
+  epoch_destroy(&domain);
+}
+
+void test_batches_and_reuse() {
+  printf("testing batched reclaim and record reuse\n");
+  epoch_create(&domain);
+  poisoned = 0;
+  unsigned int const count = 4 * EPOCH_RECLAIM_BATCH;
+  NodeT* nodes = (NodeT*)checked_malloc(count * sizeof(NodeT));
+  EpochRecordT* record = epoch_register(&domain);
+
+  //every batch moves the epoch on once, so all but the last two get freed
+  for (unsigned int i = 0; i < count; i++) {
+    nodes[i].magic = LIVE;
+    epoch_retire(record, &nodes[i], poison);
+  }
+  assert(domain.freed > 0);
+  assert(domain.freed == poisoned);
+
+  //a record handed back is taken over along with what it still holds
+  epoch_unregister(record);
+  EpochRecordT* again = epoch_register(&domain);
+  assert(again == record);
+  epoch_unregister(again);
+
+  epoch_destroy(&domain);
+  assert(domain.freed == count);
+  assert(poisoned == count);
+  checked_free(nodes);
+}
+
+// Treiber stack whose popped nodes are retired, the classic case where
+// freeing straight away would let a concurrent pop read freed memory
+NodeT* top;
+NodeT* nodes;
+
+void stack_push(NodeT* node) {
+  node->next = __atomic_load_n(&top, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&top, &node->next, node, 1,
+				      __ATOMIC_RELEASE, __ATOMIC_RELAXED)) ;
+}
+
+NodeT* stack_pop(EpochRecordT* record) {
+  epoch_enter(record);
+  NodeT* node = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+  while (node != NULL) {
+    assert(node->magic == LIVE);
+    NodeT* next = node->next;
+    if (__atomic_compare_exchange_n(&top, &node, next, 1,
+				    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+  }
+  epoch_exit(record);
+  return node;
+}
+
+void* stress_thread(void* arg) {
+  NodeT* mine = &nodes[*(unsigned int*)arg * OPERATIONS_PER_THREAD];
+  EpochRecordT* record = epoch_register(&domain);
+  for (unsigned int i = 0; i < OPERATIONS_PER_THREAD; i++) {
+    mine[i].magic = LIVE;
+    stack_push(&mine[i]);
+    NodeT* node = stack_pop(record);
+    if (node != NULL) {
+      epoch_retire(record, node, poison);
+    }
+  }
+  epoch_unregister(record);
+  return NULL;
+}
+
+void test_stress() {
+  printf("testing concurrent push/pop never reads a freed node\n");
+  epoch_create(&domain);
+  poisoned = 0;
+  top = NULL;
+  unsigned long const total = (unsigned long)THREADS * OPERATIONS_PER_THREAD;
+  nodes = (NodeT*)checked_malloc(total * sizeof(NodeT));
+
+  pthread_t threads[THREADS];
+  unsigned int ids[THREADS];
+  for (unsigned int i = 0; i < THREADS; i++) {
+    ids[i] = i;
+    pthread_create(&threads[i], NULL, stress_thread, &ids[i]);
+  }
+  for (unsigned int i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  //every thread pops after it pushes, so the stack ends up empty
+  assert(top == NULL);
+  assert(domain.retired == total);
+  assert(domain.advances > 0);
+  epoch_destroy(&domain);
+  assert(domain.freed == total);
+  assert(poisoned == total);
+  checked_free(nodes);
+}
+
+int main() {
+  test_empty_creation();
+  test_two_advances();
+  test_reader_holds_epoch();
+  test_retire_inside_late_epoch();
+  test_batches_and_reuse();
+  test_stress();
+  return 0;
+}
@@ -2,14 +2,89 @@
 #include "simulator.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 
 #define SMALL_DURATION (unsigned int)(TIME_SLICE_LENGTH / 10)
 #define MEDIUM_DURATION (unsigned int)(TIME_SLICE_LENGTH / 2)
 
-#ifndef SLEEP_PER_CPU_CYCLE
-#define SLEEP_PER_CPU_CYCLE 5
-#endif
+//per thread so simulators with different settings can share a process
+static __thread unsigned int sleep_per_cpu_cycle = SLEEP_PER_CPU_CYCLE;
+
+void evaluator_set_sleep_per_cpu_cycle(unsigned int microseconds) {
+  sleep_per_cpu_cycle = microseconds;
+}
+
+char const* const evaluator_mode_names[evaluator_mode_count] = { "sleep", "spin" };
+
+static __thread EvaluatorModeT mode = evaluator_sleep;
+
+//shortest run timed by the calibration, long enough for the clock and
+//the frequency to settle
+#define CALIBRATION_NS 20000000ul
+#define CALIBRATION_RUNS 3
+
+static pthread_once_t calibrated = PTHREAD_ONCE_INIT;
+static double iterations_per_us;
+
+//result of every kernel run, so the compiler cannot drop the work
+static volatile uint64_t spin_sink;
+
+// Deterministic arithmetic that depends on its previous step, so it can
+// neither be vectorised away nor finish early
+static void spin_kernel(unsigned long iterations) {
+  uint64_t x = 0x9e3779b97f4a7c15ull;
+  for (unsigned long i = 0; i < iterations; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+  }
+  spin_sink = x;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void calibrate(void) {
+  //double the run until it takes long enough, then keep the fastest of a
+  //few - anything slower was interrupted
+  unsigned long iterations = 1024;
+  uint64_t elapsed;
+  do {
+    iterations *= 2;
+    uint64_t const start = now_ns();
+    spin_kernel(iterations);
+    elapsed = now_ns() - start;
+  } while (elapsed < CALIBRATION_NS);
+
+  double best = (double)iterations * 1000 / elapsed;
+  for (int run = 1; run < CALIBRATION_RUNS; run++) {
+    uint64_t const start = now_ns();
+    spin_kernel(iterations);
+    double const rate = (double)iterations * 1000 / (now_ns() - start);
+    if (rate > best) best = rate;
+  }
+  iterations_per_us = best;
+}
+
+double evaluator_calibrate(void) {
+  pthread_once(&calibrated, calibrate);
+  return iterations_per_us;
+}
+
+void evaluator_burn(unsigned long nanoseconds) {
+  spin_kernel((unsigned long)(evaluator_calibrate() * nanoseconds / 1000));
+}
+
+void evaluator_set_mode(EvaluatorModeT value) {
+  if (value == evaluator_spin) evaluator_calibrate();
+  mode = value;
+}
 
 EvaluatorResultT evaluator_evaluate(EvaluatorCodeT const code, unsigned int PC) {
   EvaluatorResultT const result = code.implementation(PC, code.parameter);
@@ -17,7 +92,12 @@ EvaluatorResultT evaluator_evaluate(EvaluatorCodeT const code, unsigned int PC)
 	 result.reason == reason_timeslice_ended ||
 	 result.reason == reason_blocked);
   assert(result.cpu_time);
-  usleep(SLEEP_PER_CPU_CYCLE * result.cpu_time); // time proportional to CPU usage
+  // time proportional to CPU usage
+  if (mode == evaluator_spin) {
+    evaluator_burn((unsigned long)sleep_per_cpu_cycle * result.cpu_time * 1000);
+  } else {
+    usleep(sleep_per_cpu_cycle * result.cpu_time);
+  }
   return result;
 }
 
@@ -73,3 +153,36 @@ EvaluatorCodeT evaluator_blocking_terminates_after(unsigned int steps) {
   EvaluatorCodeT code = { implementation_blocking, steps };
   return code;
 }
+
+unsigned int evaluator_remaining_steps(EvaluatorCodeT const code, unsigned int PC) {
+  //both terminating kinds keep their total step count in the parameter
+  if (code.implementation == implementation_cpu_bound ||
+      code.implementation == implementation_blocking) {
+    return PC < code.parameter ? code.parameter - PC : 0;
+  }
+  return EVALUATOR_UNKNOWN_STEPS;
+}
+
+//never reorder, ids are stored in checkpoints
+static EvaluatorResultT (*const implementations[])(unsigned int, unsigned int) = {
+  NULL,
+  implementation_cpu_bound,
+  implementation_infinite_loop,
+  implementation_blocking,
+};
+
+#define IMPLEMENTATION_COUNT (sizeof(implementations) / sizeof(implementations[0]))
+
+unsigned int evaluator_code_id(EvaluatorCodeT const code) {
+  for (unsigned int id = 0; id < IMPLEMENTATION_COUNT; id++) {
+    if (implementations[id] == code.implementation) return id;
+  }
+  return EVALUATOR_UNKNOWN_CODE;
+}
+
+int evaluator_code_from_id(unsigned int id, unsigned int parameter, EvaluatorCodeT* code) {
+  if (id >= IMPLEMENTATION_COUNT) return 1;
+  code->implementation = implementations[id];
+  code->parameter = parameter;
+  return 0;
+}
@@ -3,6 +3,21 @@
 
 #define TIME_SLICE_LENGTH 100
 
+//default wall time per simulated cpu cycle, in microseconds
+#ifndef SLEEP_PER_CPU_CYCLE
+#define SLEEP_PER_CPU_CYCLE 5
+#endif
+
+// How evaluations take up their cpu time
+typedef enum EvaluatorMode {
+  evaluator_sleep, //usleep, the core is free for anything else meanwhile
+  evaluator_spin, //calibrated arithmetic that keeps the core busy
+  evaluator_mode_count
+} EvaluatorModeT;
+
+// Names accepted by the evaluator setting, indexed by EvaluatorModeT
+extern char const* const evaluator_mode_names[evaluator_mode_count];
+
 typedef enum Reason {
   reason_terminated,
   reason_timeslice_ended,
@@ -24,6 +39,34 @@ typedef struct EvaluatorCode {
 // The evaluator - pretends to run some code on a CPU
 EvaluatorResultT evaluator_evaluate(EvaluatorCodeT const code, unsigned int PC);
 
+// Wall time per cpu cycle for evaluations on the calling thread
+void evaluator_set_sleep_per_cpu_cycle(unsigned int microseconds);
+// How evaluations on the calling thread take up their time, spinning
+// calibrates the kernel first if nothing has yet
+void evaluator_set_mode(EvaluatorModeT mode);
+
+// Iterations of the spin kernel per microsecond on this machine, measured
+// on the first call and kept for the rest of the process
+double evaluator_calibrate(void);
+// Keep the core busy for about nanoseconds with the spin kernel
+void evaluator_burn(unsigned long nanoseconds);
+
+//returned for code whose length is not known in advance
+#define EVALUATOR_UNKNOWN_STEPS 0xffffffffu
+
+// Steps left before code starting at PC terminates, read from the step
+// count stored in the code - EVALUATOR_UNKNOWN_STEPS if it never does
+unsigned int evaluator_remaining_steps(EvaluatorCodeT const code, unsigned int PC);
+
+//id of code whose implementation is not one of the ones below
+#define EVALUATOR_UNKNOWN_CODE 0xffffffffu
+
+// Number of the code's implementation that stays the same from one build
+// to the next, so code can be saved and loaded elsewhere - 0 for no code
+unsigned int evaluator_code_id(EvaluatorCodeT const code);
+// Code back from its id and parameter, returns 0 on success
+int evaluator_code_from_id(unsigned int id, unsigned int parameter, EvaluatorCodeT* code);
+
 // A CPU bound process that terminates after specified steps
 EvaluatorCodeT evaluator_terminates_after(unsigned int steps);
 
@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <time.h>
 
 void test_evaluator_infinite_loop() {
   printf("testing infinite loop\n");
@@ -56,10 +57,72 @@ void test_evaluator_specification_examples() {
   evaluator_evaluate(evaluator_blocking_terminates_after(5), 0);
 }
 
+void test_evaluator_remaining_steps() {
+  printf("testing remaining steps\n");
+  EvaluatorCodeT const code = evaluator_terminates_after(5);
+  unsigned int PC = 0;
+  for(unsigned int remaining = 5; remaining > 0; --remaining) {
+    assert(evaluator_remaining_steps(code, PC) == remaining);
+    PC = evaluator_evaluate(code, PC).PC;
+  }
+  assert(evaluator_remaining_steps(code, PC) == 0);
+  assert(evaluator_remaining_steps(evaluator_blocking_terminates_after(7), 3) == 4);
+  assert(evaluator_remaining_steps(evaluator_infinite_loop, 1) == EVALUATOR_UNKNOWN_STEPS);
+}
+
+void test_evaluator_code_ids() {
+  printf("testing code ids round trip\n");
+  EvaluatorCodeT const codes[] = {
+    evaluator_terminates_after(3), evaluator_infinite_loop, evaluator_blocking_terminates_after(9)
+  };
+  for (int i = 0; i < 3; i++) {
+    unsigned int const id = evaluator_code_id(codes[i]);
+    assert(id != 0 && id != EVALUATOR_UNKNOWN_CODE);
+    EvaluatorCodeT code;
+    assert(evaluator_code_from_id(id, codes[i].parameter, &code) == 0);
+    assert(code.implementation == codes[i].implementation && code.parameter == codes[i].parameter);
+  }
+  EvaluatorCodeT const none = { NULL, 0 };
+  assert(evaluator_code_id(none) == 0);
+  EvaluatorCodeT code;
+  assert(evaluator_code_from_id(1000, 0, &code) != 0);
+}
+
+static double elapsed_ms(struct timespec const* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+void test_evaluator_spin() {
+  printf("testing calibrated spinning\n");
+  double const rate = evaluator_calibrate();
+  assert(rate > 0);
+  assert(evaluator_calibrate() == rate);
+
+  //calibration keeps the fastest run, so spinning never ends early - being
+  //descheduled can only make it longer
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  evaluator_burn(20000000);
+  assert(elapsed_ms(&start) >= 15);
+
+  evaluator_set_sleep_per_cpu_cycle(10);
+  evaluator_set_mode(evaluator_spin);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  EvaluatorResultT const result = evaluator_evaluate(evaluator_infinite_loop, 0);
+  assert(elapsed_ms(&start) >= result.cpu_time * 10 * 0.75 / 1e3);
+  evaluator_set_mode(evaluator_sleep);
+  evaluator_set_sleep_per_cpu_cycle(SLEEP_PER_CPU_CYCLE);
+}
+
 int main() {
   test_evaluator_infinite_loop();
   test_evaluator_terminates_after();
   test_evaluator_blocking();
   test_evaluator_specification_examples();
+  test_evaluator_remaining_steps();
+  test_evaluator_code_ids();
+  test_evaluator_spin();
   return 0;
 }
@@ -2,27 +2,38 @@
 #include "utilities.h"
 #include "simulator.h"
 
-int terminate; //global variable to keep track of whether event source has ended 
-static pthread_t event_thread; //threads
-static pthread_mutex_t event_lock;
-
-void event_source_start(useconds_t interval) {
-  terminate = 0;
+void event_source_start(SimulatorT* simulator, useconds_t interval) {
+  EventSourceT* source = &simulator->event_source;
+  source->terminate = 0;
+  
+  //interval lives in the simulator so simulator_event can read it safely
+  source->interval = interval;
   
-  //pass interval as argument to simulator_event
-  pthread_create(&event_thread, NULL, simulator_event, &interval);
+  pthread_attr_t attr;
+  simulator_thread_attr(simulator, &attr);
+  pthread_create(&source->thread, &attr, simulator_event, simulator);
+  
+  //devices are serviced side by side, each by its own thread
+  source->device_threads = (pthread_t*)checked_malloc(simulator->device_count * sizeof(pthread_t));
+  for (int i = 0; i < simulator->device_count; i++) {
+    pthread_create(&source->device_threads[i], &attr, simulator_device, &simulator->devices[i]);
+  }
+  pthread_attr_destroy(&attr);
   
 }
 
-void event_source_stop() {
+void event_source_stop(SimulatorT* simulator) {
 
-  terminate = 1;
+  __atomic_store_n(&simulator->event_source.terminate, 1, __ATOMIC_RELEASE);
   
-  pthread_join(event_thread, NULL);
+  pthread_join(simulator->event_source.thread, NULL);
+  for (int i = 0; i < simulator->device_count; i++) {
+    pthread_join(simulator->event_source.device_threads[i], NULL);
+  }
+  checked_free(simulator->event_source.device_threads);
   
 }
 
-int check_termination(){
-  return terminate;
+int check_termination(SimulatorT* simulator){
+  return __atomic_load_n(&simulator->event_source.terminate, __ATOMIC_ACQUIRE);
 }
-
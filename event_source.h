@@ -2,9 +2,20 @@
 #define _EVENT_SOURCE_H_
 
 #include <unistd.h>
+#include <pthread.h>
 
-void event_source_start(useconds_t interval);
-void event_source_stop();
-int check_termination();
+struct Simulator;
+
+// Event source state, one per simulator
+typedef struct EventSource {
+  pthread_t thread;
+  useconds_t interval;
+  pthread_t* device_threads; //one per simulated device
+  int terminate; //whether the event source has ended
+} EventSourceT;
+
+void event_source_start(struct Simulator* simulator, useconds_t interval);
+void event_source_stop(struct Simulator* simulator);
+int check_termination(struct Simulator* simulator);
 
 #endif
@@ -0,0 +1,70 @@
+#include "logger.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define EVENTS 1000000
+#define SAMPLE 100
+
+// Process events as the simulator logs them
+void log_events(unsigned int count) {
+  for (unsigned int i = 0; i < count; i++) {
+    LOG(log_debug, log_create, "Simulator %i - Process ID: %i - %s", 1, (int)(i % 2048) + 1, "Created");
+  }
+}
+
+// The same calls built with debug compiled out
+#undef LOGGER_MIN_LEVEL
+#define LOGGER_MIN_LEVEL log_info
+void log_events_compiled_out(unsigned int count) {
+  for (unsigned int i = 0; i < count; i++) {
+    LOG(log_debug, log_create, "Simulator %i - Process ID: %i - %s", 1, (int)(i % 2048) + 1, "Created");
+  }
+}
+
+double seconds_since(struct timespec const* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Time count events with the given filter, returns ns per event
+double run(void (*log)(unsigned int), LogLevelT level, unsigned int mask, unsigned int sample,
+	   unsigned int count) {
+  logger_configure(level, mask, sample);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  log(count);
+  fflush(stdout);
+  return seconds_since(&start) * 1e9 / count;
+}
+
+int main() {
+  //written messages go nowhere, so only formatting and the write are timed
+  fflush(stdout);
+  int const console = dup(STDOUT_FILENO);
+  int const null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+  close(null);
+
+  unsigned int const all = (1u << log_category_count) - 1;
+  double const compiled_out = run(log_events_compiled_out, log_debug, all, 1, EVENTS);
+  double const level = run(log_events, log_info, all, 1, EVENTS);
+  double const category = run(log_events, log_debug, all & ~(1u << log_create), 1, EVENTS);
+  double const sampled = run(log_events, log_debug, all, SAMPLE, EVENTS);
+  double const written = run(log_events, log_debug, all, 1, EVENTS / 10);
+
+  fflush(stdout);
+  dup2(console, STDOUT_FILENO);
+  close(console);
+
+  printf("%-24s %10s\n", "setting", "ns/event");
+  printf("%-24s %10.1f\n", "compiled out", compiled_out);
+  printf("%-24s %10.1f\n", "below level", level);
+  printf("%-24s %10.1f\n", "category off", category);
+  printf("%-24s %10.1f\n", "sampled 1 in 100", sampled);
+  printf("%-24s %10.1f\n", "written", written);
+  return 0;
+}
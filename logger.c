@@ -1,7 +1,16 @@
 #include "logger.h"
 #include "utilities.h"
 
-int id;
+char const* const logger_level_names[log_level_count] = { "debug", "info", "warning", "error", "off" };
+char const* const logger_category_names[log_category_count] = {
+  "general", "create", "wait", "kill", "unblock", "pool"
+};
+
+//everything until configured
+LoggerFilterT logger_filter = { log_debug, { 1, 1, 1, 1, 1, 1 }, { 0 } };
+
+//message counter shared by every simulator in the process
+static int id;
 
 void logger_start() {
   fprintf(stdout , "Logger Started\n");
@@ -9,7 +18,18 @@ void logger_start() {
 
 void logger_stop() {
   fprintf(stdout , "Logger Closed\n");
-  id = 0;
+  __atomic_store_n(&id, 0, __ATOMIC_RELAXED);
+}
+
+void logger_configure(LogLevelT level, unsigned int mask, unsigned int sample) {
+  logger_filter.level = level;
+  for (int category = 0; category < log_category_count; category++) {
+    int const enabled = (mask >> category) & 1;
+    //only the per process events are frequent enough to sample
+    int const sampled = category != log_general && category != log_pool;
+    logger_filter.sample[category] = !enabled ? 0 : sampled && sample > 1 ? sample : 1;
+    logger_filter.seen[category] = 0;
+  }
 }
 
 void logger_write(char const* message) {
@@ -21,7 +41,7 @@ void logger_write(char const* message) {
     fprintf(stderr , "Error with gmtime_r");
   }
   
-  //printing to standard out in specified format
-  fprintf(stdout, "%i : %02d:%02d:%02d : %s\n", id, date.tm_hour , date.tm_min , date.tm_sec, message);
-  id++;
+  //printing to standard out in specified format, fprintf locks the stream
+  int const message_id = __atomic_fetch_add(&id, 1, __ATOMIC_RELAXED);
+  fprintf(stdout, "%i : %02d:%02d:%02d : %s\n", message_id, date.tm_hour , date.tm_min , date.tm_sec, message);
 }
@@ -4,8 +4,68 @@
 #include <stdio.h>
 #include <time.h>
 
+// Severity, messages below the current level are dropped before formatting
+typedef enum LogLevel {
+  log_debug, //every process event
+  log_info, //startup, pool changes and summaries
+  log_warning,
+  log_error,
+  log_off,
+  log_level_count,
+} LogLevelT;
+
+// What a message is about, each can be turned off or sampled on its own
+typedef enum LogCategory {
+  log_general,
+  log_create,
+  log_wait,
+  log_kill,
+  log_unblock,
+  log_pool, //elastic worker pool
+  log_category_count,
+} LogCategoryT;
+
+// Names accepted by the log settings, indexed by the enums above
+extern char const* const logger_level_names[log_level_count];
+extern char const* const logger_category_names[log_category_count];
+
+//calls below this level compile to nothing, e.g. -DLOGGER_MIN_LEVEL=log_info
+#ifndef LOGGER_MIN_LEVEL
+#define LOGGER_MIN_LEVEL log_debug
+#endif
+
+// Run time filter, read by every thread without locking
+typedef struct LoggerFilter {
+  LogLevelT level;
+  unsigned int sample[log_category_count]; //write 1 in sample, 0 drops the category
+  unsigned long seen[log_category_count]; //messages offered while sampling
+} LoggerFilterT;
+
+extern LoggerFilterT logger_filter;
+
+static inline int logger_enabled(LogLevelT level, LogCategoryT category) {
+  if (level < logger_filter.level) return 0;
+  unsigned int const sample = logger_filter.sample[category];
+  if (sample <= 1) return sample;
+  return __atomic_fetch_add(&logger_filter.seen[category], 1, __ATOMIC_RELAXED) % sample == 0;
+}
+
+// Format and write a message if it passes the filter, the arguments are
+// not evaluated otherwise
+#define LOG(level, category, ...) do {					\
+    if ((level) >= LOGGER_MIN_LEVEL && logger_enabled(level, category)) { \
+      char logger_message_[150];					\
+      snprintf(logger_message_, sizeof(logger_message_), __VA_ARGS__);	\
+      logger_write(logger_message_);					\
+    }									\
+  } while (0)
+
 void logger_start();
 void logger_stop();
+// Messages at level or above in the categories set in mask, with the
+// process event categories sampled 1 in sample
+void logger_configure(LogLevelT level, unsigned int mask, unsigned int sample);
+// Write unconditionally
 void logger_write(char const* message);
 
 #endif
@@ -0,0 +1,214 @@
+#include "metrics.h"
+#include "simulator.h"
+#include "utilities.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define METRICS_BUFFER_SIZE 16384
+//how often the server checks whether it should stop
+#define METRICS_POLL_MS 100
+
+typedef struct Writer {
+  char* buffer;
+  size_t size;
+  size_t used;
+} WriterT;
+
+// Append whole lines only, once one does not fit the snapshot ends before it
+static void emit(WriterT* writer, char const* format, ...) {
+  if (writer->used >= writer->size) return;
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(writer->buffer + writer->used, writer->size - writer->used, format, args);
+  va_end(args);
+  if (written < 0 || (size_t)written >= writer->size - writer->used) {
+    writer->buffer[writer->used] = '\0';
+    writer->size = writer->used;
+    return;
+  }
+  writer->used += written;
+}
+
+static void header(WriterT* writer, char const* name, char const* type, char const* help) {
+  emit(writer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+size_t metrics_format(MetricsT* server, char* buffer, size_t size) {
+  static char const* const state_names[] = { "unallocated", "ready", "running", "blocked", "terminated" };
+  WriterT writer = { buffer, size, 0 };
+
+  SimulatorMetricsT metrics;
+  simulator_metrics(server->simulator, &metrics);
+
+  header(&writer, "simulator_ready_queue_depth", "gauge", "Processes waiting in the ready queue");
+  emit(&writer, "simulator_ready_queue_depth %zu\n", metrics.ready_depth);
+  header(&writer, "simulator_event_queue_depth", "gauge", "Blocked processes waiting for an event");
+  emit(&writer, "simulator_event_queue_depth %zu\n", metrics.event_depth);
+
+  header(&writer, "simulator_processes", "gauge", "Process table entries by state");
+  for (int state = unallocated; state <= terminated; state++) {
+    emit(&writer, "simulator_processes{state=\"%s\"} %u\n", state_names[state], metrics.processes[state]);
+  }
+
+  header(&writer, "simulator_dispatches_total", "counter", "Processes evaluated by all workers");
+  emit(&writer, "simulator_dispatches_total %lu\n", metrics.dispatches);
+
+  //rate since the previous scrape, or since start for the first one
+  unsigned long const window = metrics.uptime_ns - server->last_uptime_ns;
+  double const rate = window ? (metrics.dispatches - server->last_dispatches) * 1e9 / window : 0;
+  server->last_dispatches = metrics.dispatches;
+  server->last_uptime_ns = metrics.uptime_ns;
+  header(&writer, "simulator_dispatches_per_second", "gauge", "Dispatch rate since the previous scrape");
+  emit(&writer, "simulator_dispatches_per_second %.1f\n", rate);
+
+  header(&writer, "simulator_turnaround_seconds_mean", "gauge", "Mean time from creation to exit");
+  emit(&writer, "simulator_turnaround_seconds_mean %.6f\n", metrics.mean_turnaround_ns / 1e9);
+
+  header(&writer, "simulator_fairness_index", "gauge", "Jain's index of weighted cpu share over exited processes");
+  emit(&writer, "simulator_fairness_index %.4f\n", metrics.fairness);
+
+  header(&writer, "simulator_scheduler_decision_seconds_mean", "gauge", "Mean time a call into the scheduling policy takes");
+  emit(&writer, "simulator_scheduler_decision_seconds_mean %.9f\n", metrics.sched_ns_per_decision / 1e9);
+
+  header(&writer, "simulator_scheduler_overhead_ratio", "gauge", "Time in the scheduling policy per time evaluating processes");
+  emit(&writer, "simulator_scheduler_overhead_ratio %.6f\n", metrics.overhead / 100);
+
+  header(&writer, "simulator_page_faults_total", "counter", "Steps that blocked on a page that was not resident");
+  emit(&writer, "simulator_page_faults_total %lu\n", metrics.page_faults);
+
+  header(&writer, "simulator_realtime_processes_total", "counter", "Real time processes by admission and deadline outcome");
+  emit(&writer, "simulator_realtime_processes_total{outcome=\"admitted\"} %lu\n", metrics.realtime.admitted);
+  emit(&writer, "simulator_realtime_processes_total{outcome=\"refused\"} %lu\n", metrics.realtime.refused);
+  emit(&writer, "simulator_realtime_processes_total{outcome=\"met\"} %lu\n", metrics.realtime.met);
+  emit(&writer, "simulator_realtime_processes_total{outcome=\"missed\"} %lu\n", metrics.realtime.missed);
+
+  header(&writer, "simulator_group_throttles_total", "counter", "Processes held back for running over their group's quota");
+  emit(&writer, "simulator_group_throttles_total %lu\n", metrics.throttles);
+
+  header(&writer, "simulator_workers_active", "gauge", "Workers the elastic pool lets run");
+  emit(&writer, "simulator_workers_active %i\n", metrics.active_workers);
+
+  header(&writer, "simulator_device_requests_total", "counter", "Requests each simulated device has completed");
+  for (int i = 0; i < server->simulator->device_count; i++) {
+    DeviceStatsT stats;
+    device_stats(&server->simulator->devices[i], &stats);
+    emit(&writer, "simulator_device_requests_total{device=\"%i\",kind=\"%s\"} %lu\n", i,
+	 device_kind_names[server->simulator->devices[i].kind], stats.completed);
+  }
+  header(&writer, "simulator_device_utilisation", "gauge", "Fraction of each device's capacity in use since it started");
+  for (int i = 0; i < server->simulator->device_count; i++) {
+    DeviceT* device = &server->simulator->devices[i];
+    DeviceStatsT stats;
+    device_stats(device, &stats);
+    emit(&writer, "simulator_device_utilisation{device=\"%i\",kind=\"%s\"} %.4f\n", i,
+	 device_kind_names[device->kind], device_utilisation(device, &stats, process_table_now()));
+  }
+  header(&writer, "simulator_device_queue_seconds_mean", "gauge", "Mean time requests waited for a free device slot");
+  for (int i = 0; i < server->simulator->device_count; i++) {
+    DeviceT* device = &server->simulator->devices[i];
+    DeviceStatsT stats;
+    device_stats(device, &stats);
+    emit(&writer, "simulator_device_queue_seconds_mean{device=\"%i\",kind=\"%s\"} %.9f\n", i,
+	 device_kind_names[device->kind], stats.started ? stats.queue_ns / 1e9 / stats.started : 0);
+  }
+
+  header(&writer, "simulator_worker_busy_seconds_total", "counter", "Time each worker spent evaluating");
+  for (int w = 0; w < metrics.worker_count; w++) {
+    emit(&writer, "simulator_worker_busy_seconds_total{worker=\"%i\"} %.6f\n", w + 1, metrics.workers[w].busy_ns / 1e9);
+  }
+  header(&writer, "simulator_worker_dispatches_total", "counter", "Processes evaluated by each worker");
+  for (int w = 0; w < metrics.worker_count; w++) {
+    emit(&writer, "simulator_worker_dispatches_total{worker=\"%i\"} %lu\n", w + 1, metrics.workers[w].dispatches);
+  }
+
+  header(&writer, "simulator_dispatch_latency_seconds", "summary", "Delay from ready to dispatched");
+  double const quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  for (int q = 0; q < 4; q++) {
+    emit(&writer, "simulator_dispatch_latency_seconds{quantile=\"%g\"} %.9f\n", quantiles[q],
+	 simulator_latency_percentile(&metrics, quantiles[q]) / 1e9);
+  }
+  emit(&writer, "simulator_dispatch_latency_seconds_count %lu\n", metrics.dispatches);
+
+  checked_free(metrics.workers);
+  return writer.used;
+}
+
+static void* metrics_routine(void* arg) {
+  MetricsT* server = (MetricsT*)arg;
+  char* buffer = (char*)checked_malloc(METRICS_BUFFER_SIZE);
+  struct pollfd listener = { server->socket, POLLIN, 0 };
+
+  while (!__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE)) {
+    //wake up regularly to notice metrics_stop
+    if (poll(&listener, 1, METRICS_POLL_MS) <= 0) continue;
+
+    int client = accept(server->socket, NULL, NULL);
+    if (client < 0) continue;
+
+    size_t length = metrics_format(server, buffer, METRICS_BUFFER_SIZE);
+    for (size_t sent = 0; sent < length; ) {
+      ssize_t written = write(client, buffer + sent, length - sent);
+      if (written <= 0) break;
+      sent += written;
+    }
+    close(client);
+  }
+
+  checked_free(buffer);
+  return NULL;
+}
+
+MetricsT* metrics_start(SimulatorT* simulator, char const* path) {
+  struct sockaddr_un address;
+  //a truncated name could be some other file, and it is unlinked below
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Metrics socket path %s is too long\n", path);
+    return NULL;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    perror("Failed to create metrics socket");
+    return NULL;
+  }
+
+  //replace a socket left behind by an earlier run
+  unlink(address.sun_path);
+  if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(listener, 8) != 0) {
+    perror("Failed to listen on metrics socket");
+    close(listener);
+    return NULL;
+  }
+
+  MetricsT* server = (MetricsT*)checked_malloc(sizeof(MetricsT));
+  memset(server, 0, sizeof(MetricsT));
+  server->simulator = simulator;
+  server->socket = listener;
+  strncpy(server->path, address.sun_path, sizeof(server->path));
+  pthread_create(&server->thread, NULL, metrics_routine, server);
+
+  LOG(log_info, log_general, "Simulator %i - Serving metrics on %s", simulator->id, server->path);
+  return server;
+}
+
+void metrics_stop(MetricsT* server) {
+  if (server == NULL) return;
+
+  __atomic_store_n(&server->stopping, 1, __ATOMIC_RELEASE);
+  pthread_join(server->thread, NULL);
+
+  close(server->socket);
+  unlink(server->path);
+  checked_free(server);
+}
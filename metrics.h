@@ -0,0 +1,31 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/un.h>
+
+struct Simulator;
+
+// Serves a Prometheus style text snapshot of a simulator on a unix
+// socket, one snapshot per connection, e.g. socat - UNIX-CONNECT:<path>
+typedef struct Metrics {
+  struct Simulator* simulator;
+  pthread_t thread;
+  int socket;
+  int stopping;
+  char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+  //previous scrape, used for the dispatch rate
+  unsigned long last_dispatches;
+  unsigned long last_uptime_ns;
+} MetricsT;
+
+// Returns NULL if the socket could not be opened
+MetricsT* metrics_start(struct Simulator* simulator, char const* path);
+void metrics_stop(MetricsT* metrics);
+
+// Write the current snapshot into buffer, returns the length written - one
+// too large for the buffer ends at the last whole line that fits
+size_t metrics_format(MetricsT* metrics, char* buffer, size_t size);
+
+#endif
@@ -0,0 +1,157 @@
+#include "metrics.h"
+#include "simulator.h"
+#include "logger.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define BUFFER_SIZE 16384
+
+char buffer[BUFFER_SIZE];
+
+// Value of the first sample named exactly name, labels included
+double sample(char const* text, char const* name) {
+  size_t const length = strlen(name);
+  for (char const* line = text; *line != '\0'; line = strchr(line, '\n') + 1) {
+    if (strncmp(line, name, length) == 0 && line[length] == ' ') {
+      return atof(line + length + 1);
+    }
+  }
+  assert(!"sample missing");
+  return 0;
+}
+
+// Every line is a comment or a sample of the family its TYPE line named
+void check_lines(char const* text, size_t length) {
+  assert(length == strlen(text));
+  assert(length > 0 && text[length - 1] == '\n');
+  char family[128] = "";
+  for (char const* line = text; *line != '\0'; line = strchr(line, '\n') + 1) {
+    if (strncmp(line, "# HELP ", 7) == 0) continue;
+    if (strncmp(line, "# TYPE ", 7) == 0) {
+      assert(sscanf(line + 7, "%127s", family) == 1);
+      continue;
+    }
+    assert(family[0] != '\0');
+    assert(strncmp(line, family, strlen(family)) == 0);
+    char const* value = strchr(line, ' ');
+    assert(value != NULL && value < strchr(line, '\n'));
+  }
+}
+
+void test_format() {
+  printf("testing a snapshot is well formed and adds up\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 2;
+  config.max_processes = 32;
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  ProcessIdT pids[8];
+  for (int i = 0; i < 8; i++) {
+    pids[i] = simulator_create_process(simulator, evaluator_terminates_after(3));
+  }
+  for (int i = 0; i < 8; i++) {
+    simulator_wait(simulator, pids[i]);
+  }
+  ProcessIdT const running = simulator_create_process(simulator, evaluator_infinite_loop);
+
+  MetricsT server;
+  memset(&server, 0, sizeof(server));
+  server.simulator = simulator;
+  size_t const length = metrics_format(&server, buffer, BUFFER_SIZE);
+  check_lines(buffer, length);
+
+  double processes = 0;
+  char const* const states[] = { "unallocated", "ready", "running", "blocked", "terminated" };
+  for (int state = 0; state < 5; state++) {
+    char name[64];
+    snprintf(name, sizeof(name), "simulator_processes{state=\"%s\"}", states[state]);
+    processes += sample(buffer, name);
+  }
+  assert(processes == 32);
+  //the waited for processes ran their three steps
+  double const dispatches = sample(buffer, "simulator_dispatches_total");
+  assert(dispatches >= 24);
+  assert(sample(buffer, "simulator_worker_dispatches_total{worker=\"1\"}") +
+	 sample(buffer, "simulator_worker_dispatches_total{worker=\"2\"}") == dispatches);
+  assert(sample(buffer, "simulator_dispatch_latency_seconds_count") == dispatches);
+  assert(sample(buffer, "simulator_workers_active") == 2);
+  //the rate window starts again at each scrape
+  assert(server.last_dispatches == (unsigned long)dispatches);
+  assert(server.last_uptime_ns > 0);
+
+  //too small a buffer ends on a whole line
+  char small[300];
+  size_t const cut = metrics_format(&server, small, sizeof(small));
+  assert(cut < sizeof(small));
+  assert(cut > 0 && small[cut - 1] == '\n' && small[cut] == '\0');
+  assert(strncmp(small, buffer, cut) == 0);
+  assert(metrics_format(&server, small, 1) == 0 && small[0] == '\0');
+
+  simulator_kill(simulator, running);
+  simulator_wait(simulator, running);
+  simulator_stop(simulator);
+}
+
+void test_socket() {
+  printf("testing each connection to the socket gets a snapshot\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 1;
+  config.max_processes = 8;
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/metrics.tests.%i", (int)getpid());
+  MetricsT* server = metrics_start(simulator, path);
+  assert(server != NULL);
+
+  for (int scrape = 0; scrape < 2; scrape++) {
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    assert(connect(client, (struct sockaddr*)&address, sizeof(address)) == 0);
+    size_t length = 0;
+    ssize_t got;
+    while ((got = read(client, buffer + length, BUFFER_SIZE - 1 - length)) > 0) {
+      length += got;
+    }
+    close(client);
+    buffer[length] = '\0';
+    check_lines(buffer, length);
+    assert(sample(buffer, "simulator_processes{state=\"unallocated\"}") == 8);
+  }
+
+  metrics_stop(server);
+  assert(access(path, F_OK) != 0);
+
+  //a path too long for a socket is refused, not cut short and unlinked
+  char long_path[160];
+  memset(long_path, 0, sizeof(long_path));
+  snprintf(long_path, sizeof(long_path), "/tmp/metrics.tests.%i.", (int)getpid());
+  memset(long_path + strlen(long_path), 'x', sizeof(((struct sockaddr_un*)0)->sun_path) - 1 - strlen(long_path));
+  FILE* file = fopen(long_path, "w");
+  assert(file != NULL);
+  fclose(file);
+  strcat(long_path, "sock");
+  assert(metrics_start(simulator, long_path) == NULL);
+  long_path[strlen(long_path) - 4] = '\0';
+  assert(access(long_path, F_OK) == 0);
+  unlink(long_path);
+  simulator_stop(simulator);
+}
+
+int main() {
+  //per process events would bury the test output
+  logger_configure(log_warning, ~0u, 1);
+  logger_start();
+  test_format();
+  test_socket();
+  logger_stop();
+  return 0;
+}
@@ -0,0 +1,92 @@
+#include "mpsc_queue.h"
+#include "non_blocking_queue.h"
+#include "utilities.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#define PUSHES_PER_PRODUCER 500000
+#define MAX_PRODUCERS 8
+
+MpscQueueT mpsc;
+NonBlockingQueueT locked;
+MpscNodeT* nodes;
+unsigned int producer_count;
+
+double seconds_since(struct timespec const* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void* mpsc_producer(void* arg) {
+  MpscNodeT* mine = &nodes[*(unsigned int*)arg * PUSHES_PER_PRODUCER];
+  for (unsigned int i = 0; i < PUSHES_PER_PRODUCER; i++) {
+    mpsc_queue_push(&mpsc, &mine[i]);
+  }
+  return NULL;
+}
+
+void* locked_producer(void* arg) {
+  for (unsigned int i = 0; i < PUSHES_PER_PRODUCER; i++) {
+    non_blocking_queue_push(&locked, i);
+  }
+  return NULL;
+}
+
+// Start the producers, drain on this thread and return Mops/s
+double run(void* (*producer)(void*), unsigned long (*drain)()) {
+  pthread_t threads[MAX_PRODUCERS];
+  unsigned int ids[MAX_PRODUCERS];
+  unsigned long const total = (unsigned long)producer_count * PUSHES_PER_PRODUCER;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned int i = 0; i < producer_count; i++) {
+    ids[i] = i;
+    pthread_create(&threads[i], NULL, producer, &ids[i]);
+  }
+  for (unsigned long consumed = 0; consumed < total; ) {
+    consumed += drain();
+  }
+  for (unsigned int i = 0; i < producer_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  return total / seconds_since(&start) / 1e6;
+}
+
+unsigned long drain_mpsc_pop_all() {
+  unsigned long count = 0;
+  for (MpscNodeT* node = mpsc_queue_pop_all(&mpsc); node != NULL; node = node->next) count++;
+  return count;
+}
+
+unsigned long drain_locked_pop() {
+  unsigned int value;
+  return non_blocking_queue_pop(&locked, &value) == 0;
+}
+
+unsigned long drain_locked_pop_many() {
+  unsigned int values[64];
+  return non_blocking_queue_pop_many(&locked, values, 64);
+}
+
+int main() {
+  nodes = (MpscNodeT*)checked_malloc(MAX_PRODUCERS * PUSHES_PER_PRODUCER * sizeof(MpscNodeT));
+  mpsc_queue_create(&mpsc);
+  non_blocking_queue_create(&locked);
+
+  printf("%9s %14s %14s %14s  (Mops/s)\n", "producers", "mpsc pop_all", "locked pop", "locked batch");
+  for (producer_count = 1; producer_count <= MAX_PRODUCERS; producer_count *= 2) {
+    double const lock_free = run(mpsc_producer, drain_mpsc_pop_all);
+    double const single = run(locked_producer, drain_locked_pop);
+    double const batch = run(locked_producer, drain_locked_pop_many);
+    printf("%9u %14.2f %14.2f %14.2f\n", producer_count, lock_free, single, batch);
+  }
+
+  non_blocking_queue_destroy(&locked);
+  mpsc_queue_destroy(&mpsc);
+  checked_free(nodes);
+  return 0;
+}
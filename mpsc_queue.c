@@ -0,0 +1,93 @@
+#include "mpsc_queue.h"
+#include "utilities.h"
+
+#include <assert.h>
+
+//marks a node whose producer has swapped it in but not yet linked it
+#define LINKING ((MpscNodeT*)1)
+
+void mpsc_queue_create(MpscQueueT* queue) {
+  queue->top = NULL;
+  queue->pending = NULL;
+  queue->length = 0;
+}
+
+void mpsc_queue_destroy(MpscQueueT* queue) {
+  //nodes are owned by the caller, just forget them
+  queue->top = NULL;
+  queue->pending = NULL;
+  queue->length = 0;
+}
+
+void mpsc_queue_push(MpscQueueT* queue, MpscNodeT* node) {
+  assert(node);
+  node->next = LINKING;
+
+  //count first so the length can run ahead but never below zero
+  __atomic_fetch_add(&queue->length, 1, __ATOMIC_RELAXED);
+
+  //publish the node, then link it to whatever was on top before
+  MpscNodeT* prev = __atomic_exchange_n(&queue->top, node, __ATOMIC_ACQ_REL);
+  __atomic_store_n(&node->next, prev, __ATOMIC_RELEASE);
+}
+
+// Take the pushed nodes (newest first) and return them oldest first
+static MpscNodeT* detach(MpscQueueT* queue) {
+  MpscNodeT* node = __atomic_exchange_n(&queue->top, NULL, __ATOMIC_ACQUIRE);
+  MpscNodeT* reversed = NULL;
+
+  while (node != NULL) {
+    MpscNodeT* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    //producer is between its exchange and its store
+    while (next == LINKING) {
+      cpu_relax();
+      next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    }
+    node->next = reversed;
+    reversed = node;
+    node = next;
+  }
+  return reversed;
+}
+
+MpscNodeT* mpsc_queue_pop(MpscQueueT* queue) {
+  if (queue->pending == NULL) {
+    queue->pending = detach(queue);
+    if (queue->pending == NULL) return NULL;
+  }
+
+  MpscNodeT* node = queue->pending;
+  queue->pending = node->next;
+  node->next = NULL;
+
+  __atomic_fetch_sub(&queue->length, 1, __ATOMIC_RELAXED);
+  return node;
+}
+
+MpscNodeT* mpsc_queue_pop_all(MpscQueueT* queue) {
+  MpscNodeT* chain = queue->pending;
+  MpscNodeT* fresh = detach(queue);
+  queue->pending = NULL;
+
+  //older leftovers from single pops go first
+  if (chain == NULL) {
+    chain = fresh;
+  } else {
+    MpscNodeT* last = chain;
+    while (last->next != NULL) last = last->next;
+    last->next = fresh;
+  }
+
+  size_t count = 0;
+  for (MpscNodeT* node = chain; node != NULL; node = node->next) count++;
+  __atomic_fetch_sub(&queue->length, count, __ATOMIC_RELAXED);
+  return chain;
+}
+
+int mpsc_queue_empty(MpscQueueT* queue) {
+  return queue->pending == NULL && __atomic_load_n(&queue->top, __ATOMIC_RELAXED) == NULL;
+}
+
+size_t mpsc_queue_length(MpscQueueT* queue) {
+  return __atomic_load_n(&queue->length, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,33 @@
+#ifndef _MPSC_QUEUE_H_
+#define _MPSC_QUEUE_H_
+
+#include <stddef.h>
+
+// Intrusive multi producer, single consumer queue. Producers never wait:
+// a push is one atomic exchange plus a store. The consumer detaches
+// everything pushed so far with a single exchange.
+typedef struct MpscNode {
+  struct MpscNode* next;
+} MpscNodeT;
+
+typedef struct MpscQueue {
+  MpscNodeT* top; //most recently pushed node, shared with producers
+  MpscNodeT* pending; //detached nodes in push order, consumer only
+  size_t length; //approximate, for monitoring
+} MpscQueueT;
+
+void mpsc_queue_create(MpscQueueT* queue);
+void mpsc_queue_destroy(MpscQueueT* queue);
+
+// Safe to call from any number of threads at once
+void mpsc_queue_push(MpscQueueT* queue, MpscNodeT* node);
+
+// Consumer only - remove the oldest node, NULL when empty
+MpscNodeT* mpsc_queue_pop(MpscQueueT* queue);
+// Consumer only - remove every node, returned oldest first linked by next
+MpscNodeT* mpsc_queue_pop_all(MpscQueueT* queue);
+
+int mpsc_queue_empty(MpscQueueT* queue);
+size_t mpsc_queue_length(MpscQueueT* queue);
+
+#endif
@@ -0,0 +1,135 @@
+#include "mpsc_queue.h"
+#include "utilities.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#define PRODUCERS 4
+#define PUSHES_PER_PRODUCER 200000
+
+typedef struct Item {
+  MpscNodeT node; //first member so a node pointer is an item pointer
+  unsigned int producer;
+  unsigned int sequence;
+} ItemT;
+
+void test_empty_creation() {
+  printf("testing empty creation/destruction of mpsc queues\n");
+  MpscQueueT queue;
+  mpsc_queue_create(&queue);
+  assert(mpsc_queue_empty(&queue));
+  assert(mpsc_queue_length(&queue) == 0);
+  assert(mpsc_queue_pop(&queue) == NULL);
+  assert(mpsc_queue_pop_all(&queue) == NULL);
+  mpsc_queue_destroy(&queue);
+}
+
+void test_push_pop() {
+  printf("testing push/pop keeps push order\n");
+  MpscQueueT queue;
+  mpsc_queue_create(&queue);
+  ItemT items[3];
+  for (unsigned int i = 0; i < 3; i++) {
+    items[i].sequence = i;
+    mpsc_queue_push(&queue, &items[i].node);
+  }
+  assert(mpsc_queue_length(&queue) == 3);
+  assert(((ItemT*)mpsc_queue_pop(&queue))->sequence == 0);
+
+  //push after a partial drain lands behind the leftovers
+  ItemT late;
+  late.sequence = 3;
+  mpsc_queue_push(&queue, &late.node);
+  assert(((ItemT*)mpsc_queue_pop(&queue))->sequence == 1);
+  assert(((ItemT*)mpsc_queue_pop(&queue))->sequence == 2);
+  assert(((ItemT*)mpsc_queue_pop(&queue))->sequence == 3);
+  assert(mpsc_queue_pop(&queue) == NULL);
+  assert(mpsc_queue_empty(&queue));
+  mpsc_queue_destroy(&queue);
+}
+
+void test_pop_all() {
+  printf("testing pop all detaches everything oldest first\n");
+  MpscQueueT queue;
+  mpsc_queue_create(&queue);
+  ItemT items[5];
+  for (unsigned int i = 0; i < 5; i++) {
+    items[i].sequence = i;
+    mpsc_queue_push(&queue, &items[i].node);
+  }
+  //leave some detached nodes pending before draining
+  assert(((ItemT*)mpsc_queue_pop(&queue))->sequence == 0);
+  ItemT late;
+  late.sequence = 5;
+  mpsc_queue_push(&queue, &late.node);
+
+  unsigned int expected = 1;
+  for (MpscNodeT* node = mpsc_queue_pop_all(&queue); node != NULL; node = node->next) {
+    assert(((ItemT*)node)->sequence == expected++);
+  }
+  assert(expected == 6);
+  assert(mpsc_queue_empty(&queue));
+  assert(mpsc_queue_length(&queue) == 0);
+  mpsc_queue_destroy(&queue);
+}
+
+MpscQueueT stress_queue;
+ItemT* stress_items;
+
+void* producer_routine(void* arg) {
+  unsigned int producer = *(unsigned int*)arg;
+  ItemT* items = &stress_items[producer * PUSHES_PER_PRODUCER];
+  for (unsigned int i = 0; i < PUSHES_PER_PRODUCER; i++) {
+    items[i].producer = producer;
+    items[i].sequence = i;
+    mpsc_queue_push(&stress_queue, &items[i].node);
+  }
+  return NULL;
+}
+
+void test_stress() {
+  printf("testing %i producers against one consumer\n", PRODUCERS);
+  mpsc_queue_create(&stress_queue);
+  stress_items = (ItemT*)checked_malloc(PRODUCERS * PUSHES_PER_PRODUCER * sizeof(ItemT));
+
+  pthread_t producers[PRODUCERS];
+  unsigned int ids[PRODUCERS];
+  for (unsigned int i = 0; i < PRODUCERS; i++) {
+    ids[i] = i;
+    pthread_create(&producers[i], NULL, producer_routine, &ids[i]);
+  }
+
+  //consume concurrently, alternating single pops and whole list drains
+  unsigned int next[PRODUCERS] = { 0 };
+  unsigned int consumed = 0;
+  for (unsigned long round = 0; consumed < PRODUCERS * PUSHES_PER_PRODUCER; round++) {
+    MpscNodeT* node = (round % 2) ? mpsc_queue_pop(&stress_queue) : mpsc_queue_pop_all(&stress_queue);
+    while (node != NULL) {
+      ItemT* item = (ItemT*)node;
+      //each producer's items arrive in the order it pushed them
+      assert(item->sequence == next[item->producer]);
+      next[item->producer]++;
+      consumed++;
+      node = node->next;
+    }
+  }
+
+  for (unsigned int i = 0; i < PRODUCERS; i++) {
+    pthread_join(producers[i], NULL);
+    assert(next[i] == PUSHES_PER_PRODUCER);
+  }
+  assert(mpsc_queue_empty(&stress_queue));
+  assert(mpsc_queue_length(&stress_queue) == 0);
+
+  checked_free(stress_items);
+  mpsc_queue_destroy(&stress_queue);
+}
+
+int main() {
+  test_empty_creation();
+  test_push_pop();
+  test_pop_all();
+  test_stress();
+  return 0;
+}
@@ -83,6 +83,72 @@ int non_blocking_queue_pop(NonBlockingQueueT* queue, unsigned int* value) {
   return 0;
 }
 
+void non_blocking_queue_push_many(NonBlockingQueueT* queue, unsigned int const* values, size_t n) {
+  if (n == 0) return;
+  
+  //build the chain before taking the lock
+  ListT* first = NULL;
+  ListT* last = NULL;
+  for (size_t i = 0; i < n; i++) {
+    ListT* new_node = (ListT*)checked_malloc(sizeof(ListT));
+    new_node->value = values[i];
+    new_node->succ = NULL;
+    new_node->pred = last;
+    if (last == NULL) {
+      first = new_node;
+    } else {
+      last->succ = new_node;
+    }
+    last = new_node;
+  }
+  
+  //lock mutex and splice the chain onto the rear
+  pthread_mutex_lock(&queue->lock);
+  
+  first->pred = queue->rear;
+  if (queue->rear == NULL) {
+    queue->front = first;
+  } else {
+    queue->rear->succ = first;
+  }
+  queue->rear = last;
+  
+  //unlock
+  pthread_mutex_unlock(&queue->lock);
+}
+
+size_t non_blocking_queue_pop_many(NonBlockingQueueT* queue, unsigned int* values, size_t max) {
+  if (max == 0) return 0;
+  
+  pthread_mutex_lock(&queue->lock);
+  
+  //detach up to max nodes from the front
+  ListT* chain = queue->front;
+  ListT* node = chain;
+  size_t popped = 0;
+  while (node != NULL && popped < max) {
+    values[popped++] = node->value;
+    node = node->succ;
+  }
+  
+  queue->front = node;
+  if (node == NULL) {
+    queue->rear = NULL;
+  } else {
+    node->pred = NULL;
+  }
+  
+  //unlock before freeing the detached nodes
+  pthread_mutex_unlock(&queue->lock);
+  
+  for (size_t i = 0; i < popped; i++) {
+    ListT* next = chain->succ;
+    checked_free(chain);
+    chain = next;
+  }
+  return popped;
+}
+
 int non_blocking_queue_empty(NonBlockingQueueT* queue) {
   return queue->front == NULL;
 }
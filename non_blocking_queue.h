@@ -16,6 +16,11 @@ void non_blocking_queue_destroy(NonBlockingQueueT* queue);
 void non_blocking_queue_push(NonBlockingQueueT* queue, unsigned int value);
 int non_blocking_queue_pop(NonBlockingQueueT* queue, unsigned int* value);
 
+// Push n values under a single lock acquisition
+void non_blocking_queue_push_many(NonBlockingQueueT* queue, unsigned int const* values, size_t n);
+// Move up to max values in one critical section, returns 0 when empty
+size_t non_blocking_queue_pop_many(NonBlockingQueueT* queue, unsigned int* values, size_t max);
+
 int non_blocking_queue_empty(NonBlockingQueueT* queue);
 int non_blocking_queue_length(NonBlockingQueueT* queue);
 
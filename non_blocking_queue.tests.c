@@ -101,10 +101,52 @@ void test_pop(){
   
 }
 
+void test_push_pop_many(){
+  printf("testing push many/pop many\n");
+  
+  //alloc queue
+  NonBlockingQueueT* queue = setup();
+  
+  unsigned int const values[] = { 1, 2, 3, 4, 5 };
+  non_blocking_queue_push(queue, 0);
+  non_blocking_queue_push_many(queue, values, 5);
+  non_blocking_queue_push_many(queue, values, 0);
+  
+  //check order across single and batch pushes
+  assert(non_blocking_queue_length(queue) == 6);
+  assert(queue->front->value == 0);
+  assert(queue->rear->value == 5);
+  assert(queue->rear->pred->value == 4);
+  
+  //pop fewer than queued
+  unsigned int popped[8];
+  assert(non_blocking_queue_pop_many(queue, popped, 4) == 4);
+  for (unsigned int i = 0; i < 4; i++) {
+    assert(popped[i] == i);
+  }
+  assert(queue->front->value == 4);
+  assert(queue->front->pred == NULL);
+  
+  //pop more than queued
+  assert(non_blocking_queue_pop_many(queue, popped, 8) == 2);
+  assert(popped[0] == 4);
+  assert(popped[1] == 5);
+  assert(non_blocking_queue_empty(queue));
+  assert(queue->rear == NULL);
+  
+  //queue still usable after being drained
+  non_blocking_queue_push(queue, 9);
+  assert(queue->front->value == 9);
+  assert(queue->rear->value == 9);
+  
+  teardown(queue);
+}
+
 int main() {
   test_empty_creation();
   test_push();
   test_pop_failure();
   test_pop();
+  test_push_pop_many();
   return 0;
 }
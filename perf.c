@@ -0,0 +1,191 @@
+#include "perf.h"
+#include "logger.h"
+#include "process_table.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+char const* const perf_phase_names[perf_phase_count] = {
+  "pick", "table", "evaluate", "requeue", "idle"
+};
+
+char const* const perf_counter_names[perf_counter_count] = {
+  "cycles", "instructions", "cache-misses", "context-switches"
+};
+
+static struct {
+  uint32_t type;
+  uint64_t config;
+} const events[perf_counter_count] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+//only warn once, every worker of every instance fails the same way
+static int warned;
+
+static int open_counter(PerfCounterT counter, int group) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = events[counter].type;
+  attr.config = events[counter].config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  //user space only, which is all a paranoid kernel allows - switches
+  //only ever happen in the kernel
+  if (attr.type == PERF_TYPE_HARDWARE) {
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+  }
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Current value of every opened counter, returns 0 if the group was read
+static int read_group(PerfT* perf, uint64_t* values) {
+  uint64_t buffer[1 + perf_counter_count];
+  ssize_t const expected = (1 + perf->opened) * sizeof(uint64_t);
+  if (perf->leader < 0 || read(perf->leader, buffer, sizeof(buffer)) != expected) return 1;
+  for (int c = 0; c < perf_counter_count; c++) {
+    values[c] = perf->slot[c] >= 0 ? buffer[1 + perf->slot[c]] : 0;
+  }
+  return 0;
+}
+
+void perf_open(PerfT* perf, PerfPhaseT phase) {
+  memset(perf, 0, sizeof(PerfT));
+  perf->leader = -1;
+  int missing_errno = 0;
+  char missing[64] = "";
+  for (int c = 0; c < perf_counter_count; c++) {
+    int const fd = open_counter(c, perf->leader);
+    perf->fd[c] = fd;
+    if (fd < 0) {
+      perf->slot[c] = -1;
+      missing_errno = errno;
+      snprintf(missing + strlen(missing), sizeof(missing) - strlen(missing), "%s%s",
+	       missing[0] ? ", " : "", perf_counter_names[c]);
+      continue;
+    }
+    if (perf->leader < 0) perf->leader = fd;
+    perf->slot[c] = perf->opened++;
+  }
+
+  if (missing[0] && !__atomic_exchange_n(&warned, 1, __ATOMIC_RELAXED)) {
+    LOG(log_warning, log_general, "Counters unavailable (%s): %s - phases still timed",
+	strerror(missing_errno), missing);
+  }
+
+  perf->phase = phase;
+  perf->since_ns = process_table_now();
+  if (read_group(perf, perf->since) != 0) {
+    memset(perf->since, 0, sizeof(perf->since));
+  }
+}
+
+void perf_phase(PerfT* perf, PerfPhaseT phase) {
+  uint64_t const now = process_table_now();
+  perf->ns[perf->phase] += now - perf->since_ns;
+  perf->since_ns = now;
+
+  uint64_t values[perf_counter_count];
+  if (read_group(perf, values) == 0) {
+    for (int c = 0; c < perf_counter_count; c++) {
+      perf->counts[perf->phase][c] += values[c] - perf->since[c];
+      perf->since[c] = values[c];
+    }
+  }
+  perf->phase = phase;
+  perf->markers++;
+}
+
+void perf_close(PerfT* perf) {
+  perf_phase(perf, perf->phase);
+  for (int c = 0; c < perf_counter_count; c++) {
+    if (perf->fd[c] >= 0) close(perf->fd[c]);
+    perf->fd[c] = -1;
+  }
+  perf->leader = -1;
+}
+
+int perf_available(PerfT const* perf, PerfCounterT counter) {
+  return perf->slot[counter] >= 0;
+}
+
+void perf_add(PerfT* into, PerfT const* from) {
+  for (int p = 0; p < perf_phase_count; p++) {
+    into->ns[p] += from->ns[p];
+    for (int c = 0; c < perf_counter_count; c++) {
+      into->counts[p][c] += from->counts[p][c];
+    }
+  }
+  for (int c = 0; c < perf_counter_count; c++) {
+    if (!perf_available(from, c)) into->slot[c] = -1;
+  }
+  into->markers += from->markers;
+}
+
+// Count formatted into buffer, or n/a when the counter was not open
+static char const* count(PerfT const* perf, PerfCounterT counter, uint64_t value, char* buffer, size_t size) {
+  if (!perf_available(perf, counter)) return "n/a";
+  snprintf(buffer, size, "%lu", (unsigned long)value);
+  return buffer;
+}
+
+void perf_report(int simulator_id, PerfT const* perfs, int count_threads) {
+  //threads that never opened their counters have no markers
+  PerfT total;
+  int measured = 0;
+  for (int w = 0; w < count_threads; w++) {
+    if (perfs[w].markers == 0) continue;
+    if (measured++ == 0) {
+      total = perfs[w];
+    } else {
+      perf_add(&total, &perfs[w]);
+    }
+  }
+  if (measured == 0) return;
+
+  uint64_t all_ns = 0;
+  for (int p = 0; p < perf_phase_count; p++) all_ns += total.ns[p];
+  if (all_ns == 0) return;
+
+  LOG(log_info, log_general, "Simulator %i - Phases over %i workers, %lu markers:",
+      simulator_id, measured, total.markers);
+  LOG(log_info, log_general, "Simulator %i - %-8s %6s %11s %14s %14s %5s %12s %9s",
+      simulator_id, "phase", "time%", "ms", "cycles", "instructions", "ipc", "cache-misses", "switches");
+  for (int p = 0; p < perf_phase_count; p++) {
+    uint64_t const* counts = total.counts[p];
+    char cycles[24], instructions[24], misses[24], switches[24];
+    char ipc[8] = "n/a";
+    if (perf_available(&total, perf_cycles) && perf_available(&total, perf_instructions) &&
+	counts[perf_cycles] > 0) {
+      snprintf(ipc, sizeof(ipc), "%.2f", (double)counts[perf_instructions] / counts[perf_cycles]);
+    }
+    LOG(log_info, log_general, "Simulator %i - %-8s %6.1f %11.3f %14s %14s %5s %12s %9s",
+	simulator_id, perf_phase_names[p], 100.0 * total.ns[p] / all_ns, total.ns[p] / 1e6,
+	count(&total, perf_cycles, counts[perf_cycles], cycles, sizeof(cycles)),
+	count(&total, perf_instructions, counts[perf_instructions], instructions, sizeof(instructions)),
+	ipc,
+	count(&total, perf_cache_misses, counts[perf_cache_misses], misses, sizeof(misses)),
+	count(&total, perf_context_switches, counts[perf_context_switches], switches, sizeof(switches)));
+  }
+
+  //how each worker split its time, to spot one that differs
+  for (int w = 0; w < count_threads; w++) {
+    uint64_t worker_ns = 0;
+    for (int p = 0; p < perf_phase_count; p++) worker_ns += perfs[w].ns[p];
+    if (perfs[w].markers == 0 || worker_ns == 0) continue;
+    char line[100] = "";
+    for (int p = 0; p < perf_phase_count; p++) {
+      snprintf(line + strlen(line), sizeof(line) - strlen(line), " %s %.1f%%",
+	       perf_phase_names[p], 100.0 * perfs[w].ns[p] / worker_ns);
+    }
+    LOG(log_debug, log_general, "Simulator %i - Worker %i:%s", simulator_id, w + 1, line);
+  }
+}
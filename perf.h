@@ -0,0 +1,70 @@
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Parts of a worker's loop that time and counts are charged to
+typedef enum PerfPhase {
+  perf_pick, //taking pids from the policy without waiting
+  perf_table, //reading and updating process table entries
+  perf_evaluate,
+  perf_requeue, //handing processes back to the policy, a device or the event queue
+  perf_idle, //waiting for something to run, or parked
+  perf_phase_count
+} PerfPhaseT;
+
+// Counters read at every phase change
+typedef enum PerfCounter {
+  perf_cycles,
+  perf_instructions,
+  perf_cache_misses,
+  perf_context_switches,
+  perf_counter_count
+} PerfCounterT;
+
+// Names shown in the reports
+extern char const* const perf_phase_names[perf_phase_count];
+extern char const* const perf_counter_names[perf_counter_count];
+
+// Counters of one thread. Whichever of them the kernel lets us open are
+// read together as a group, the rest are left out of the report - phase
+// times come from the clock, so something is always measured.
+typedef struct Perf {
+  int leader; //fd of the group, -1 when no counter could be opened
+  int fd[perf_counter_count];
+  int slot[perf_counter_count]; //position in a group read, -1 if unavailable
+  int opened; //counters in the group
+  PerfPhaseT phase; //what is being done since the last marker
+  uint64_t since_ns;
+  uint64_t since[perf_counter_count];
+  uint64_t ns[perf_phase_count];
+  uint64_t counts[perf_phase_count][perf_counter_count];
+  unsigned long markers;
+} PerfT;
+
+// Open counters for the calling thread, starting in phase
+void perf_open(PerfT* perf, PerfPhaseT phase);
+// Charge what is left and close the counters, the totals are kept
+void perf_close(PerfT* perf);
+
+// Charge everything since the last marker to the phase it was in, then
+// start phase. Costs a read of the group, so markers sit between steps
+// rather than inside them.
+void perf_phase(PerfT* perf, PerfPhaseT phase);
+
+// Marker that does nothing when perf is NULL
+static inline void perf_mark(PerfT* perf, PerfPhaseT phase) {
+  if (perf != NULL) perf_phase(perf, phase);
+}
+
+int perf_available(PerfT const* perf, PerfCounterT counter);
+
+// Add the totals of from into into, a counter stays available only if
+// both had it
+void perf_add(PerfT* into, PerfT const* from);
+
+// Log the phase breakdown of count threads, with their sum
+void perf_report(int simulator_id, PerfT const* perfs, int count);
+
+#endif
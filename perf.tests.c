@@ -0,0 +1,53 @@
+#include "perf.h"
+#include "process_table.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+void test_phases_are_timed() {
+  printf("testing time is charged to the phase it was spent in\n");
+  PerfT perf;
+  perf_open(&perf, perf_pick);
+  perf_phase(&perf, perf_evaluate);
+  usleep(2000);
+  perf_phase(&perf, perf_table);
+  perf_close(&perf);
+
+  assert(perf.markers == 3);
+  assert(perf.ns[perf_evaluate] >= 2000000);
+  assert(perf.ns[perf_evaluate] > perf.ns[perf_pick] + perf.ns[perf_table]);
+  assert(perf.ns[perf_requeue] == 0 && perf.ns[perf_idle] == 0);
+  //sleeping gives up the cpu, when the kernel lets us count that
+  if (perf_available(&perf, perf_context_switches)) {
+    assert(perf.counts[perf_evaluate][perf_context_switches] >= 1);
+    assert(perf.counts[perf_requeue][perf_context_switches] == 0);
+  }
+  assert(perf.leader == -1);
+}
+
+void test_totals() {
+  printf("testing totals only keep counters every thread had\n");
+  PerfT a;
+  PerfT b;
+  perf_open(&a, perf_idle);
+  perf_close(&a);
+  b = a;
+  b.slot[perf_cycles] = -1;
+  b.ns[perf_idle] = 5;
+  b.counts[perf_idle][perf_context_switches] = 7;
+  uint64_t const idle = a.ns[perf_idle];
+  uint64_t const switches = a.counts[perf_idle][perf_context_switches];
+
+  perf_add(&a, &b);
+  assert(a.ns[perf_idle] == idle + 5);
+  assert(a.counts[perf_idle][perf_context_switches] == switches + 7);
+  assert(a.markers == 2);
+  assert(!perf_available(&a, perf_cycles));
+}
+
+int main() {
+  test_phases_are_timed();
+  test_totals();
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include "priority_queue.h"
+#include "utilities.h"
+
+#include <string.h>
+
+// Join two heaps, the root with the larger key becomes the first child.
+// Ties keep a as the root so equal keys come out roughly in push order.
+static PriorityNodeT* meld(PriorityNodeT* a, PriorityNodeT* b) {
+  if (a == NULL) return b;
+  if (b == NULL) return a;
+  if (b->key < a->key) {
+    PriorityNodeT* swap = a;
+    a = b;
+    b = swap;
+  }
+  b->sibling = a->child;
+  a->child = b;
+  return a;
+}
+
+// Standard two pass combine of the children of a removed root
+static PriorityNodeT* merge_pairs(PriorityNodeT* first) {
+  //left to right, meld neighbours and stack the results
+  PriorityNodeT* paired = NULL;
+  while (first != NULL) {
+    PriorityNodeT* a = first;
+    PriorityNodeT* b = a->sibling;
+    if (b == NULL) {
+      a->sibling = paired;
+      paired = a;
+      break;
+    }
+    first = b->sibling;
+    a->sibling = NULL;
+    b->sibling = NULL;
+    PriorityNodeT* melded = meld(a, b);
+    melded->sibling = paired;
+    paired = melded;
+  }
+
+  //right to left, fold the stack into one heap
+  PriorityNodeT* result = NULL;
+  while (paired != NULL) {
+    PriorityNodeT* next = paired->sibling;
+    paired->sibling = NULL;
+    result = meld(result, paired);
+    paired = next;
+  }
+  return result;
+}
+
+static void resize(PriorityQueueT* queue, int delta) {
+  __atomic_store_n(&queue->size, queue->size + delta, __ATOMIC_RELAXED);
+}
+
+static void insert(PriorityQueueT* queue, unsigned int value, uint64_t key) {
+  PriorityNodeT* node = &queue->nodes[value - 1];
+  node->key = key;
+  node->child = NULL;
+  node->sibling = NULL;
+  queue->root = meld(queue->root, node);
+  resize(queue, 1);
+}
+
+static unsigned int take(PriorityQueueT* queue, uint64_t* key) {
+  PriorityNodeT* root = queue->root;
+  queue->root = merge_pairs(root->child);
+  root->child = NULL;
+  resize(queue, -1);
+  if (key != NULL) *key = root->key;
+  return (unsigned int)(root - queue->nodes) + 1;
+}
+
+void priority_queue_create(PriorityQueueT* queue, unsigned int capacity) {
+  queue->nodes = (PriorityNodeT*)checked_malloc(capacity * sizeof(PriorityNodeT));
+  memset(queue->nodes, 0, capacity * sizeof(PriorityNodeT));
+  queue->capacity = capacity;
+  queue->root = NULL;
+  queue->terminated = 0;
+  queue->size = 0;
+  pthread_mutex_init(&queue->lock, NULL);
+  sem_init(&queue->queue_sem, 0, 0);
+}
+
+void priority_queue_destroy(PriorityQueueT* queue) {
+  pthread_mutex_destroy(&queue->lock);
+  sem_destroy(&queue->queue_sem);
+  checked_free(queue->nodes);
+  queue->nodes = NULL;
+  queue->root = NULL;
+}
+
+void priority_queue_push(PriorityQueueT* queue, unsigned int value, uint64_t key) {
+  pthread_mutex_lock(&queue->lock);
+  insert(queue, value, key);
+  pthread_mutex_unlock(&queue->lock);
+  sem_post(&queue->queue_sem);
+}
+
+void priority_queue_push_many(PriorityQueueT* queue, unsigned int const* values, uint64_t const* keys, size_t n) {
+  if (n == 0) return;
+
+  pthread_mutex_lock(&queue->lock);
+  for (size_t i = 0; i < n; i++) {
+    insert(queue, values[i], keys[i]);
+  }
+  pthread_mutex_unlock(&queue->lock);
+
+  for (size_t i = 0; i < n; i++) {
+    sem_post(&queue->queue_sem);
+  }
+}
+
+int priority_queue_pop(PriorityQueueT* queue, unsigned int* value, uint64_t* key) {
+  return priority_queue_pop_many(queue, value, key, 1) == 0;
+}
+
+// Take the first count and up to max - 1 more, the first only by waiting
+// if wait is set
+static size_t pop_many(PriorityQueueT* queue, unsigned int* values, uint64_t* keys, size_t max, int wait) {
+  if (max == 0) return 0;
+
+  //one count per queued value, so a successful wait means one is ours
+  int waited = 0;
+  if (!wait) {
+    if (sem_trywait(&queue->queue_sem) != 0) return 0;
+    waited = 1;
+  } else if (__atomic_load_n(&queue->terminated, __ATOMIC_ACQUIRE) == 0 || priority_queue_length(queue) > 0) {
+    while (sem_wait(&queue->queue_sem) != 0) ;
+    waited = 1;
+  }
+
+  pthread_mutex_lock(&queue->lock);
+  if (queue->root == NULL) {
+    //woken by terminate, pass the wake up on to the next waiter
+    pthread_mutex_unlock(&queue->lock);
+    if (waited) sem_post(&queue->queue_sem);
+    return 0;
+  }
+
+  size_t popped = 0;
+  values[popped] = take(queue, keys ? &keys[popped] : NULL);
+  popped++;
+
+  //claim more only if their counts can be taken without waiting
+  while (popped < max && queue->root != NULL && sem_trywait(&queue->queue_sem) == 0) {
+    values[popped] = take(queue, keys ? &keys[popped] : NULL);
+    popped++;
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return popped;
+}
+
+size_t priority_queue_pop_many(PriorityQueueT* queue, unsigned int* values, uint64_t* keys, size_t max) {
+  return pop_many(queue, values, keys, max, 1);
+}
+
+size_t priority_queue_try_pop_many(PriorityQueueT* queue, unsigned int* values, uint64_t* keys, size_t max) {
+  return pop_many(queue, values, keys, max, 0);
+}
+
+int priority_queue_peek(PriorityQueueT* queue, uint64_t* key) {
+  pthread_mutex_lock(&queue->lock);
+  int const empty = queue->root == NULL;
+  if (!empty) *key = queue->root->key;
+  pthread_mutex_unlock(&queue->lock);
+  return empty;
+}
+
+int priority_queue_empty(PriorityQueueT* queue) {
+  return priority_queue_length(queue) == 0;
+}
+
+int priority_queue_length(PriorityQueueT* queue) {
+  return __atomic_load_n(&queue->size, __ATOMIC_RELAXED);
+}
+
+void priority_queue_terminate(PriorityQueueT* queue) {
+  __atomic_store_n(&queue->terminated, 1, __ATOMIC_RELEASE);
+  //each failing pop posts again, so one post wakes every waiter in turn
+  sem_post(&queue->queue_sem);
+}
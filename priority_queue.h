@@ -0,0 +1,53 @@
+#ifndef _PRIORITY_QUEUE_H_
+#define _PRIORITY_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+// Intrusive pairing heap node, one per value
+typedef struct PriorityNode {
+  uint64_t key;
+  struct PriorityNode* child; //first child
+  struct PriorityNode* sibling; //next child of the same parent
+} PriorityNodeT;
+
+// Blocking min queue of the values 1..capacity, each queued at most once.
+// Nodes are preallocated so push and pop never allocate.
+typedef struct PriorityQueue {
+  PriorityNodeT* nodes; //node of value v at nodes[v - 1]
+  unsigned int capacity;
+  PriorityNodeT* root;
+  pthread_mutex_t lock;
+  int terminated;
+  sem_t queue_sem; //one count per queued value
+  int size; //written under the lock, safe to read without it
+} PriorityQueueT;
+
+void priority_queue_create(PriorityQueueT* queue, unsigned int capacity);
+void priority_queue_destroy(PriorityQueueT* queue);
+
+void priority_queue_push(PriorityQueueT* queue, unsigned int value, uint64_t key);
+// Push n values under a single lock acquisition
+void priority_queue_push_many(PriorityQueueT* queue, unsigned int const* values, uint64_t const* keys, size_t n);
+
+// Remove the value with the smallest key, blocks while empty and returns
+// 1 once terminated and empty
+int priority_queue_pop(PriorityQueueT* queue, unsigned int* value, uint64_t* key);
+// Pop up to max values in key order, blocks until at least one is available
+// and returns 0 once terminated and empty. keys may be NULL.
+size_t priority_queue_pop_many(PriorityQueueT* queue, unsigned int* values, uint64_t* keys, size_t max);
+// Same without waiting, returns 0 if the queue is empty
+size_t priority_queue_try_pop_many(PriorityQueueT* queue, unsigned int* values, uint64_t* keys, size_t max);
+
+// Smallest queued key without removing it, returns 1 if empty
+int priority_queue_peek(PriorityQueueT* queue, uint64_t* key);
+
+int priority_queue_empty(PriorityQueueT* queue);
+int priority_queue_length(PriorityQueueT* queue);
+
+// Wake every blocked pop, they return failure once the queue is empty
+void priority_queue_terminate(PriorityQueueT* queue);
+
+#endif
@@ -0,0 +1,154 @@
+#include "priority_queue.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+PriorityQueueT queue;
+
+void test_empty_creation() {
+  printf("testing creation of an empty priority queue\n");
+  priority_queue_create(&queue, 8);
+  assert(priority_queue_empty(&queue));
+  assert(priority_queue_length(&queue) == 0);
+  uint64_t key;
+  assert(priority_queue_peek(&queue, &key) == 1);
+  priority_queue_destroy(&queue);
+}
+
+void test_key_order() {
+  printf("testing values come out in key order\n");
+  priority_queue_create(&queue, 8);
+  uint64_t const keys[] = { 50, 10, 40, 20, 30 };
+  for (unsigned int v = 1; v <= 5; v++) {
+    priority_queue_push(&queue, v, keys[v - 1]);
+  }
+  assert(priority_queue_length(&queue) == 5);
+
+  uint64_t key;
+  assert(priority_queue_peek(&queue, &key) == 0 && key == 10);
+
+  unsigned int const expected[] = { 2, 4, 5, 3, 1 };
+  for (int i = 0; i < 5; i++) {
+    unsigned int value;
+    assert(priority_queue_pop(&queue, &value, &key) == 0);
+    assert(value == expected[i]);
+    assert(key == keys[value - 1]);
+  }
+  assert(priority_queue_empty(&queue));
+  priority_queue_destroy(&queue);
+}
+
+void test_requeue() {
+  printf("testing a popped value can be pushed again\n");
+  priority_queue_create(&queue, 4);
+  priority_queue_push(&queue, 1, 5);
+  priority_queue_push(&queue, 2, 7);
+  unsigned int value;
+  uint64_t key;
+  assert(priority_queue_pop(&queue, &value, &key) == 0 && value == 1);
+  //charged past the other value, so it now comes second
+  priority_queue_push(&queue, 1, 9);
+  assert(priority_queue_pop(&queue, &value, NULL) == 0 && value == 2);
+  assert(priority_queue_pop(&queue, &value, NULL) == 0 && value == 1);
+  priority_queue_destroy(&queue);
+}
+
+void test_push_pop_many() {
+  printf("testing push many/pop many\n");
+  unsigned int const count = 1000;
+  priority_queue_create(&queue, count);
+
+  unsigned int values[1000];
+  uint64_t keys[1000];
+  srand(7);
+  for (unsigned int i = 0; i < count; i++) {
+    values[i] = i + 1;
+    keys[i] = rand() % 100; //plenty of duplicates
+  }
+  priority_queue_push_many(&queue, values, keys, count);
+  assert(priority_queue_length(&queue) == count);
+
+  //every value once, keys never decreasing
+  unsigned char seen[1000] = { 0 };
+  uint64_t last = 0;
+  unsigned int total = 0;
+  while (total < count) {
+    unsigned int popped[16];
+    uint64_t popped_keys[16];
+    size_t const n = priority_queue_pop_many(&queue, popped, popped_keys, 16);
+    assert(n > 0 && n <= 16);
+    for (size_t i = 0; i < n; i++) {
+      assert(popped_keys[i] >= last);
+      assert(popped_keys[i] == keys[popped[i] - 1]);
+      assert(!seen[popped[i] - 1]);
+      seen[popped[i] - 1] = 1;
+      last = popped_keys[i];
+    }
+    total += n;
+  }
+  assert(priority_queue_empty(&queue));
+  priority_queue_destroy(&queue);
+}
+
+void test_try_pop_many() {
+  printf("testing try pop many\n");
+  priority_queue_create(&queue, 8);
+  unsigned int values[4];
+  uint64_t keys[4];
+
+  //empty queue returns straight away
+  assert(priority_queue_try_pop_many(&queue, values, keys, 4) == 0);
+
+  unsigned int const pushed[] = { 1, 2, 3 };
+  uint64_t const pushed_keys[] = { 30, 10, 20 };
+  priority_queue_push_many(&queue, pushed, pushed_keys, 3);
+  assert(priority_queue_try_pop_many(&queue, values, keys, 2) == 2);
+  assert(values[0] == 2 && keys[0] == 10);
+  assert(values[1] == 3 && keys[1] == 20);
+
+  //the blocking pop still sees exactly the one left
+  assert(priority_queue_pop_many(&queue, values, NULL, 4) == 1);
+  assert(values[0] == 1);
+  assert(priority_queue_try_pop_many(&queue, values, keys, 4) == 0);
+  priority_queue_destroy(&queue);
+}
+
+void* consumer_routine(void* arg) {
+  unsigned int value;
+  uint64_t key;
+  assert(priority_queue_pop(&queue, &value, &key) == 0);
+  assert(value == 3 && key == 1);
+  //blocks until terminated
+  assert(priority_queue_pop(&queue, &value, &key) == 1);
+  return NULL;
+}
+
+void test_blocking_and_terminate() {
+  printf("testing pop blocks until a push and fails once terminated\n");
+  priority_queue_create(&queue, 4);
+
+  pthread_t consumer;
+  pthread_create(&consumer, NULL, consumer_routine, NULL);
+  usleep(100000);
+  priority_queue_push(&queue, 3, 1);
+  usleep(100000);
+  priority_queue_terminate(&queue);
+  pthread_join(consumer, NULL);
+
+  unsigned int values[4];
+  assert(priority_queue_pop_many(&queue, values, NULL, 4) == 0);
+  priority_queue_destroy(&queue);
+}
+
+int main() {
+  test_empty_creation();
+  test_key_order();
+  test_requeue();
+  test_push_pop_many();
+  test_try_pop_many();
+  test_blocking_and_terminate();
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "process_group.h"
+#include "utilities.h"
+
+#include <string.h>
+
+void process_group_create(ProcessGroupT* group, GroupIdT id, uint64_t quota_ns, uint64_t period_ns) {
+  memset(group, 0, sizeof(ProcessGroupT));
+  group->id = id;
+  pthread_mutex_init(&group->lock, NULL);
+  group->quota_ns = quota_ns;
+  group->period_ns = period_ns;
+  group->period_start = process_table_now();
+  mpsc_queue_create(&group->throttled);
+}
+
+void process_group_destroy(ProcessGroupT* group) {
+  mpsc_queue_destroy(&group->throttled);
+  pthread_mutex_destroy(&group->lock);
+  group->id = 0;
+}
+
+void process_group_add(ProcessGroupT* group, ProcessTableT* table, ProcessIdT pid) {
+  pthread_mutex_lock(&group->lock);
+
+  //append so members are waited for in creation order
+  ProcessIdT last = group->first ? table->group_prev[group->first - 1] : 0;
+  table->group_next[pid - 1] = 0;
+  table->group_prev[pid - 1] = last;
+  if (last) {
+    table->group_next[last - 1] = pid;
+  } else {
+    group->first = pid;
+  }
+  //the first member's prev is the last one, so appending needs no tail
+  table->group_prev[group->first - 1] = pid;
+  group->count++;
+  __atomic_store_n(&table->group[pid - 1], group->id, __ATOMIC_RELEASE);
+
+  pthread_mutex_unlock(&group->lock);
+}
+
+void process_group_remove(ProcessGroupT* group, ProcessTableT* table, ProcessIdT pid) {
+  pthread_mutex_lock(&group->lock);
+
+  ProcessIdT const next = table->group_next[pid - 1];
+  ProcessIdT const prev = table->group_prev[pid - 1];
+  if (pid == group->first) {
+    group->first = next;
+    if (next) table->group_prev[next - 1] = prev; //still the last member
+  } else {
+    table->group_next[prev - 1] = next;
+    //removing the last member makes prev the last one
+    table->group_prev[(next ? next : group->first) - 1] = prev;
+  }
+  table->group_next[pid - 1] = 0;
+  table->group_prev[pid - 1] = 0;
+  group->count--;
+  __atomic_store_n(&table->group[pid - 1], 0, __ATOMIC_RELEASE);
+
+  pthread_mutex_unlock(&group->lock);
+}
+
+ProcessIdT process_group_first(ProcessGroupT* group) {
+  pthread_mutex_lock(&group->lock);
+  ProcessIdT const first = group->first;
+  pthread_mutex_unlock(&group->lock);
+  return first;
+}
+
+ProcessIdT process_group_next(ProcessGroupT* group, ProcessTableT* table, ProcessIdT pid) {
+  pthread_mutex_lock(&group->lock);
+  ProcessIdT const next = table->group_next[pid - 1];
+  pthread_mutex_unlock(&group->lock);
+  return next;
+}
+
+ProcessIdT* process_group_members(ProcessGroupT* group, ProcessTableT* table, size_t* count) {
+  pthread_mutex_lock(&group->lock);
+  ProcessIdT* pids = (ProcessIdT*)checked_malloc((group->count > 0 ? group->count : 1) * sizeof(ProcessIdT));
+  size_t copied = 0;
+  for (ProcessIdT pid = group->first; pid != 0; pid = table->group_next[pid - 1]) {
+    pids[copied++] = pid;
+  }
+  pthread_mutex_unlock(&group->lock);
+  *count = copied;
+  return pids;
+}
+
+void process_group_charge(ProcessGroupT* group, uint64_t ns) {
+  __atomic_fetch_add(&group->used_ns, ns, __ATOMIC_RELAXED);
+}
+
+int process_group_throttled(ProcessGroupT* group) {
+  return group->quota_ns != 0 &&
+    __atomic_load_n(&group->used_ns, __ATOMIC_RELAXED) >= group->quota_ns;
+}
+
+int process_group_refill(ProcessGroupT* group, uint64_t now) {
+  if (group->quota_ns == 0 || now - group->period_start < group->period_ns) {
+    return 0;
+  }
+
+  //time over the quota is carried into the next period, so a long time
+  //slice cannot take more than its share on average
+  uint64_t const used = __atomic_load_n(&group->used_ns, __ATOMIC_RELAXED);
+  uint64_t const debt = used > group->quota_ns ? used - group->quota_ns : 0;
+  __atomic_fetch_sub(&group->used_ns, used - debt, __ATOMIC_RELAXED);
+  group->period_start = now;
+  return 1;
+}
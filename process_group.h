@@ -0,0 +1,47 @@
+#ifndef _PROCESS_GROUP_H_
+#define _PROCESS_GROUP_H_
+
+#include "process_table.h"
+#include "mpsc_queue.h"
+#include <pthread.h>
+#include <stdint.h>
+
+typedef unsigned int GroupIdT;
+
+// Processes killed and waited for together, optionally sharing a cpu
+// quota per period like a cgroup. Members are linked through the process
+// table, processes parked for running over the quota wait in throttled.
+typedef struct ProcessGroup {
+  GroupIdT id; //ids start from 1
+  pthread_mutex_t lock; //guards the member list
+  ProcessIdT first; //0 when empty
+  unsigned int count;
+  uint64_t quota_ns; //worker time per period, 0 for unlimited
+  uint64_t period_ns;
+  uint64_t used_ns; //worker time charged this period
+  uint64_t period_start;
+  MpscQueueT throttled; //linked through the process table's event nodes
+} ProcessGroupT;
+
+void process_group_create(ProcessGroupT* group, GroupIdT id, uint64_t quota_ns, uint64_t period_ns);
+// Group must be empty, its id goes back to 0
+void process_group_destroy(ProcessGroupT* group);
+
+void process_group_add(ProcessGroupT* group, ProcessTableT* table, ProcessIdT pid);
+void process_group_remove(ProcessGroupT* group, ProcessTableT* table, ProcessIdT pid);
+// Oldest member still in the group and the one after pid, 0 for none
+ProcessIdT process_group_first(ProcessGroupT* group);
+ProcessIdT process_group_next(ProcessGroupT* group, ProcessTableT* table, ProcessIdT pid);
+// Every member in order, copied under the lock into an array released with
+// checked_free - count is set to how many there are
+ProcessIdT* process_group_members(ProcessGroupT* group, ProcessTableT* table, size_t* count);
+
+// Add worker time used by a member
+void process_group_charge(ProcessGroupT* group, uint64_t ns);
+// Whether members must wait for the next period before running again
+int process_group_throttled(ProcessGroupT* group);
+// Start a new period once the current one is over, returns 1 if it did -
+// the caller then runs everything in throttled again
+int process_group_refill(ProcessGroupT* group, uint64_t now);
+
+#endif
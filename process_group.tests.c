@@ -0,0 +1,141 @@
+#include "process_group.h"
+#include "utilities.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+ProcessTableT table;
+ProcessGroupT group;
+
+// Members from first to last, returns how many were written
+unsigned int members(ProcessIdT* pids) {
+  unsigned int count = 0;
+  for (ProcessIdT pid = process_group_first(&group); pid != 0;
+       pid = process_group_next(&group, &table, pid)) {
+    pids[count++] = pid;
+  }
+  return count;
+}
+
+void test_empty_creation() {
+  printf("testing creation of an empty group\n");
+  process_table_create(&table, 8);
+  process_group_create(&group, 3, 0, 1000);
+  assert(group.id == 3);
+  assert(group.count == 0);
+  assert(process_group_first(&group) == 0);
+  assert(!process_group_throttled(&group));
+  process_group_destroy(&group);
+  assert(group.id == 0);
+  process_table_destroy(&table);
+}
+
+void test_add_remove() {
+  printf("testing members stay in order as they come and go\n");
+  process_table_create(&table, 8);
+  process_group_create(&group, 1, 0, 1000);
+  ProcessIdT pids[8];
+
+  process_group_add(&group, &table, 4);
+  process_group_add(&group, &table, 2);
+  process_group_add(&group, &table, 7);
+  process_group_add(&group, &table, 5);
+  assert(group.count == 4);
+  assert(table.group[3] == 1 && table.group[1] == 1);
+  assert(members(pids) == 4);
+  assert(pids[0] == 4 && pids[1] == 2 && pids[2] == 7 && pids[3] == 5);
+
+  //middle, last and first
+  process_group_remove(&group, &table, 2);
+  process_group_remove(&group, &table, 5);
+  assert(table.group[1] == 0);
+  assert(members(pids) == 2 && pids[0] == 4 && pids[1] == 7);
+  process_group_add(&group, &table, 1);
+  process_group_remove(&group, &table, 4);
+  assert(members(pids) == 2 && pids[0] == 7 && pids[1] == 1);
+
+  process_group_remove(&group, &table, 7);
+  process_group_remove(&group, &table, 1);
+  assert(group.count == 0);
+  assert(process_group_first(&group) == 0);
+
+  //an emptied group can be used again
+  process_group_add(&group, &table, 3);
+  assert(members(pids) == 1 && pids[0] == 3);
+  process_group_remove(&group, &table, 3);
+
+  process_group_destroy(&group);
+  process_table_destroy(&table);
+}
+
+void test_members_copy() {
+  printf("testing a copy of the members outlives changes to the group\n");
+  process_table_create(&table, 8);
+  process_group_create(&group, 1, 0, 1000);
+  size_t count;
+  ProcessIdT* copy = process_group_members(&group, &table, &count);
+  assert(count == 0);
+  checked_free(copy);
+
+  process_group_add(&group, &table, 6);
+  process_group_add(&group, &table, 3);
+  process_group_add(&group, &table, 8);
+  copy = process_group_members(&group, &table, &count);
+  assert(count == 3);
+  assert(copy[0] == 6 && copy[1] == 3 && copy[2] == 8);
+  //a member leaving and its pid joining again does not touch the copy
+  process_group_remove(&group, &table, 3);
+  process_group_add(&group, &table, 3);
+  assert(copy[0] == 6 && copy[1] == 3 && copy[2] == 8);
+  checked_free(copy);
+  copy = process_group_members(&group, &table, &count);
+  assert(count == 3 && copy[1] == 8 && copy[2] == 3);
+  checked_free(copy);
+
+  process_group_remove(&group, &table, 6);
+  process_group_remove(&group, &table, 8);
+  process_group_remove(&group, &table, 3);
+  process_group_destroy(&group);
+  process_table_destroy(&table);
+}
+
+void test_quota() {
+  printf("testing quota throttling and refill\n");
+  process_group_create(&group, 1, 100, 1000);
+  uint64_t const start = group.period_start;
+
+  process_group_charge(&group, 60);
+  assert(!process_group_throttled(&group));
+  process_group_charge(&group, 290);
+  assert(process_group_throttled(&group));
+
+  //nothing happens before the period is over
+  assert(process_group_refill(&group, start + 999) == 0);
+  assert(process_group_throttled(&group));
+
+  //the 250 over the quota carries over, still throttled for a period
+  assert(process_group_refill(&group, start + 1000) == 1);
+  assert(group.used_ns == 250);
+  assert(process_group_throttled(&group));
+  assert(process_group_refill(&group, start + 2000) == 1);
+  assert(process_group_throttled(&group));
+  assert(process_group_refill(&group, start + 3000) == 1);
+  assert(group.used_ns == 50);
+  assert(!process_group_throttled(&group));
+  process_group_destroy(&group);
+
+  //no quota never throttles or refills
+  process_group_create(&group, 1, 0, 1000);
+  process_group_charge(&group, 1000000);
+  assert(!process_group_throttled(&group));
+  assert(process_group_refill(&group, group.period_start + 5000) == 0);
+  process_group_destroy(&group);
+}
+
+int main() {
+  test_empty_creation();
+  test_add_remove();
+  test_members_copy();
+  test_quota();
+  return 0;
+}
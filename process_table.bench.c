@@ -0,0 +1,171 @@
+#include "process_table.h"
+#include "utilities.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PROCESSES (1u << 21)
+#define DISPATCHES (1u << 24)
+#define SNAPSHOTS 10
+
+// The array-of-structs layout the simulator used before the split
+typedef struct LegacyProcess {
+  int pid;
+  EvaluatorCodeT eval_code;
+  unsigned int pc;
+  int completed;
+  sem_t semaphore;
+  ProcessStateT state;
+} LegacyProcessT;
+
+// Returns -1 when counters are unavailable, e.g. inside containers
+int open_cache_miss_counter() {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+unsigned int next_pid(unsigned int* seed) {
+  //xorshift so both layouts see the same dispatch order
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return (*seed % PROCESSES) + 1;
+}
+
+void report(char const* name, size_t bytes, uint64_t elapsed, int counter) {
+  long long misses = -1;
+  if(counter >= 0 && read(counter, &misses, sizeof(misses)) != sizeof(misses)) {
+    misses = -1;
+  }
+  printf("%-8s %3zu bytes/process %6.2f ns/dispatch ", name, bytes,
+	 (double)elapsed / DISPATCHES);
+  if(misses >= 0) {
+    printf("%.3f cache misses/dispatch\n", (double)misses / DISPATCHES);
+  } else {
+    printf("cache misses unavailable\n");
+  }
+}
+
+void bench_legacy() {
+  LegacyProcessT* table = (LegacyProcessT*)checked_malloc(PROCESSES * sizeof(LegacyProcessT));
+  memset(table, 0, PROCESSES * sizeof(LegacyProcessT));
+  for(unsigned int i = 0; i < PROCESSES; i++) {
+    table[i].eval_code = evaluator_terminates_after(1000);
+    table[i].state = ready;
+  }
+
+  int counter = open_cache_miss_counter();
+  unsigned int seed = 2463534242u;
+  unsigned long long checksum = 0;
+  if(counter >= 0) ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+  uint64_t start = process_table_now();
+  for(unsigned int i = 0; i < DISPATCHES; i++) {
+    LegacyProcessT* process = &table[next_pid(&seed) - 1];
+    if(process->state == terminated) continue;
+    checksum += process->eval_code.parameter;
+    process->pc++;
+    process->state = ready;
+  }
+  uint64_t elapsed = process_table_now() - start;
+  if(counter >= 0) ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+
+  report("legacy", sizeof(LegacyProcessT), elapsed, counter);
+  if(counter >= 0) close(counter);
+  if(checksum == 0) printf("unexpected checksum\n");
+  checked_free(table);
+}
+
+void bench_split() {
+  ProcessTableT table;
+  process_table_create(&table, PROCESSES);
+  for(unsigned int pid = 1; pid <= PROCESSES; pid++) {
+    process_table_hot(&table, pid)->eval_code = evaluator_terminates_after(1000);
+    process_table_hot(&table, pid)->state = ready;
+  }
+
+  int counter = open_cache_miss_counter();
+  unsigned int seed = 2463534242u;
+  unsigned long long checksum = 0;
+  if(counter >= 0) ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+  uint64_t start = process_table_now();
+  for(unsigned int i = 0; i < DISPATCHES; i++) {
+    ProcessHotT* process = process_table_hot(&table, next_pid(&seed));
+    if(process->state == terminated) continue;
+    checksum += process->eval_code.parameter;
+    process->pc++;
+    process->state = ready;
+  }
+  uint64_t elapsed = process_table_now() - start;
+  if(counter >= 0) ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+
+  report("split", process_table_bytes_per_process(), elapsed, counter);
+  if(counter >= 0) close(counter);
+  if(checksum == 0) printf("unexpected checksum\n");
+  process_table_destroy(&table);
+}
+
+ProcessTableT snapshot_table;
+int dispatching;
+
+// A worker updating random entries the way the simulator does
+void* snapshot_dispatcher(void* arg) {
+  unsigned int seed = 2463534242u;
+  unsigned long* dispatched = (unsigned long*)arg;
+  while (__atomic_load_n(&dispatching, __ATOMIC_RELAXED)) {
+    ProcessHotT* process = process_table_hot(&snapshot_table, next_pid(&seed));
+    process_table_write_begin(process);
+    process->pc++;
+    process->state = process->state == ready ? running : ready;
+    process_table_write_end(process);
+    (*dispatched)++;
+  }
+  return NULL;
+}
+
+void bench_snapshot() {
+  process_table_create(&snapshot_table, PROCESSES);
+  for(unsigned int pid = 1; pid <= PROCESSES; pid++) {
+    process_table_hot(&snapshot_table, pid)->eval_code = evaluator_terminates_after(1000);
+    process_table_hot(&snapshot_table, pid)->state = ready;
+  }
+  ProcessSnapshotT* snapshots = (ProcessSnapshotT*)checked_malloc(PROCESSES * sizeof(ProcessSnapshotT));
+
+  unsigned long dispatched = 0;
+  dispatching = 1;
+  pthread_t dispatcher;
+  pthread_create(&dispatcher, NULL, snapshot_dispatcher, &dispatched);
+  size_t copied = 0;
+  uint64_t start = process_table_now();
+  for(int i = 0; i < SNAPSHOTS; i++) {
+    copied += process_table_snapshot(&snapshot_table, snapshots);
+  }
+  uint64_t elapsed = process_table_now() - start;
+  __atomic_store_n(&dispatching, 0, __ATOMIC_RELAXED);
+  pthread_join(dispatcher, NULL);
+
+  printf("snapshot %8.2f ms per copy of %zu processes, %.1f ns each, while a writer made %.1f M updates/s\n",
+	 elapsed / 1e6 / SNAPSHOTS, copied / SNAPSHOTS, (double)elapsed / copied, dispatched * 1e3 / elapsed);
+  checked_free(snapshots);
+  process_table_destroy(&snapshot_table);
+}
+
+int main() {
+  printf("dispatch loop over %u processes, %u random dispatches\n", PROCESSES, DISPATCHES);
+  bench_legacy();
+  bench_split();
+  bench_snapshot();
+  return 0;
+}
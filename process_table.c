@@ -0,0 +1,144 @@
+#include "process_table.h"
+#include "utilities.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// One per process array of the table
+typedef struct Column {
+  size_t offset; //of the array pointer in ProcessTableT
+  size_t element; //bytes per process
+} ColumnT;
+
+#define COLUMN(field) { offsetof(ProcessTableT, field), sizeof(*((ProcessTableT*)0)->field) }
+
+// Every per process array, so allocation, release and the memory
+// accounting all come from this one list. Each is allocated on its own,
+// the hot one first so dispatches never pull in cold data.
+static ColumnT const columns[] = {
+  COLUMN(hot),
+  COLUMN(waiter),
+  COLUMN(completed),
+  COLUMN(created),
+  COLUMN(dispatches),
+  COLUMN(ready_since),
+  COLUMN(event_node),
+  COLUMN(nice),
+  COLUMN(vruntime),
+  COLUMN(cpu_time),
+  COLUMN(deadline),
+  COLUMN(density),
+  COLUMN(group),
+  COLUMN(group_next),
+  COLUMN(group_prev),
+};
+
+#define COLUMN_COUNT (sizeof(columns) / sizeof(columns[0]))
+
+// The per process arrays sit back to back from hot to group_prev, so a
+// field added there without a line in columns stops the build
+_Static_assert(offsetof(ProcessTableT, dirty) - offsetof(ProcessTableT, hot)
+	== COLUMN_COUNT * sizeof(void*), "every per process array needs a column");
+
+static void** column(ProcessTableT* table, size_t i) {
+  return (void**)((char*)table + columns[i].offset);
+}
+
+void process_table_create(ProcessTableT* table, unsigned int size) {
+  table->size = size;
+
+  for (size_t i = 0; i < COLUMN_COUNT; i++) {
+    *column(table, i) = checked_malloc(size * columns[i].element);
+    memset(*column(table, i), 0, size * columns[i].element); // clean slate
+  }
+
+  table->dirty_words = ((size + PROCESS_TABLE_CHUNK - 1) / PROCESS_TABLE_CHUNK + 63) / 64;
+  table->dirty = (uint64_t*)checked_malloc(table->dirty_words * sizeof(uint64_t));
+  memset(table->dirty, 0, table->dirty_words * sizeof(uint64_t));
+}
+
+void process_table_destroy(ProcessTableT* table) {
+  for (size_t i = 0; i < COLUMN_COUNT; i++) {
+    checked_free(*column(table, i));
+  }
+  checked_free(table->dirty);
+  table->hot = NULL;
+  table->size = 0;
+}
+
+void process_table_clear(ProcessTableT* table, ProcessIdT pid) {
+  unsigned int const index = pid - 1;
+  //the sequence carries on, a snapshot may be reading the entry
+  ProcessHotT* process = &table->hot[index];
+  process_table_write_begin(process);
+  process->eval_code.implementation = NULL;
+  process->eval_code.parameter = 0;
+  process->pc = 0;
+  process->state = unallocated;
+  process_table_write_end(process);
+  __atomic_store_n(&table->waiter[index], 0, __ATOMIC_RELEASE);
+  table->completed[index] = 0;
+  table->created[index] = 0;
+  table->dispatches[index] = 0;
+  table->ready_since[index] = 0;
+  table->nice[index] = 0;
+  table->vruntime[index] = 0;
+  table->cpu_time[index] = 0;
+  table->deadline[index] = 0;
+  table->density[index] = 0;
+  table->group[index] = 0;
+  table->group_next[index] = 0;
+  table->group_prev[index] = 0;
+}
+
+size_t process_table_snapshot(ProcessTableT* table, ProcessSnapshotT* snapshots) {
+  size_t count = 0;
+  for (ProcessIdT pid = 1; pid <= table->size; pid++) {
+    //free entries are skipped on their state byte alone
+    if (__atomic_load_n(&table->hot[pid - 1].state, __ATOMIC_RELAXED) == unallocated) continue;
+    process_table_read(table, pid, &snapshots[count]);
+    if (snapshots[count].state != unallocated) count++;
+  }
+  return count;
+}
+
+void process_table_signal(ProcessTableT* table, ProcessIdT pid) {
+  unsigned int* word = &table->waiter[pid - 1];
+  __atomic_store_n(word, 1, __ATOMIC_RELEASE);
+  //wake every thread parked on the word
+  syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+void process_table_wait(ProcessTableT* table, ProcessIdT pid) {
+  unsigned int* word = &table->waiter[pid - 1];
+  //futex returns straight away if the word is no longer 0
+  while(__atomic_load_n(word, __ATOMIC_ACQUIRE) == 0) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+  }
+}
+
+int process_table_signalled(ProcessTableT* table, ProcessIdT pid) {
+  return __atomic_load_n(&table->waiter[pid - 1], __ATOMIC_ACQUIRE) != 0;
+}
+
+size_t process_table_hot_bytes_per_process() {
+  return sizeof(ProcessHotT);
+}
+
+size_t process_table_bytes_per_process() {
+  size_t bytes = 0;
+  for (size_t i = 0; i < COLUMN_COUNT; i++) {
+    bytes += columns[i].element;
+  }
+  return bytes;
+}
+
+uint64_t process_table_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
@@ -0,0 +1,152 @@
+#ifndef _PROCESS_TABLE_H_
+#define _PROCESS_TABLE_H_
+
+#include "evaluator.h"
+#include "mpsc_queue.h"
+#include "utilities.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int ProcessIdT;
+
+//processes per dirty bit, checkpoints copy whole chunks that changed
+#define PROCESS_TABLE_CHUNK 64
+
+typedef enum ProcessState {
+  unallocated,
+  ready,
+  running,
+  blocked,
+  terminated
+} ProcessStateT;
+
+// Hot fields - read and written on every dispatch, packed so that
+// several processes share a cache line
+typedef struct ProcessHot {
+  EvaluatorCodeT eval_code;
+  unsigned int pc; //program counter
+  unsigned char state; //ProcessStateT, stored in a byte
+  unsigned short seq; //odd while the fields above change together, in the padding
+} ProcessHotT;
+
+// Copy of a process's hot fields as they were at one moment
+typedef struct ProcessSnapshot {
+  ProcessIdT pid;
+  unsigned int pc;
+  unsigned char state; //ProcessStateT
+  EvaluatorCodeT eval_code;
+} ProcessSnapshotT;
+
+// Struct-of-arrays process store indexed by pid - 1
+typedef struct ProcessTable {
+  unsigned int size;
+  //per process arrays, hot to group_prev - each one listed in columns in process_table.c
+  ProcessHotT* hot;
+
+  //cold fields - kept out of the hot array
+  unsigned int* waiter; //futex word, non zero once the process is signalled
+  unsigned char* completed; //flag to check if process is finished
+  uint64_t* created; //creation time in nanoseconds
+  unsigned int* dispatches; //number of times the process was run
+  uint64_t* ready_since; //when the process last became ready, in nanoseconds
+  MpscNodeT* event_node; //links the process into the event queue while blocked
+  signed char* nice; //-20 to 19, lower gets a larger share under cfs
+  uint64_t* vruntime; //weighted cpu time, orders the cfs run queue
+  uint64_t* cpu_time; //simulated cpu cycles used so far
+  uint64_t* deadline; //absolute, in nanoseconds - 0 for best effort processes
+  unsigned int* density; //share of a worker reserved by admission, in parts per million
+  unsigned int* group; //process group id, 0 for none
+  ProcessIdT* group_next; //links the members of a group, 0 ends the list
+  ProcessIdT* group_prev;
+  uint64_t* dirty; //bit per chunk changed since the last checkpoint
+  unsigned int dirty_words;
+} ProcessTableT;
+
+void process_table_create(ProcessTableT* table, unsigned int size);
+void process_table_destroy(ProcessTableT* table);
+
+// Reset every field of a process entry back to unallocated - the event
+// node is left alone as it may still be linked into the event queue
+void process_table_clear(ProcessTableT* table, ProcessIdT pid);
+
+// Wake anyone waiting on the process - replaces a per process sem_t
+void process_table_signal(ProcessTableT* table, ProcessIdT pid);
+// Block until the process has been signalled
+void process_table_wait(ProcessTableT* table, ProcessIdT pid);
+// Test if the process has been signalled without blocking
+int process_table_signalled(ProcessTableT* table, ProcessIdT pid);
+
+// Memory used per resident process, across hot and cold arrays
+size_t process_table_bytes_per_process();
+size_t process_table_hot_bytes_per_process();
+
+// Monotonic clock in nanoseconds, used for the timing fields
+uint64_t process_table_now();
+
+static inline ProcessHotT* process_table_hot(ProcessTableT* table, ProcessIdT pid) {
+  return &table->hot[pid - 1];
+}
+
+// Bracket changes to more than one hot field, so readers never see half
+// of them. Only whoever owns the process writes them - the worker running
+// it, or the thread admitting or reaping it - so writers never overlap.
+// Single field transitions, like a kill, need no bracket.
+static inline void process_table_write_begin(ProcessHotT* process) {
+  __atomic_store_n(&process->seq, (unsigned short)(process->seq + 1), __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void process_table_write_end(ProcessHotT* process) {
+  __atomic_store_n(&process->seq, (unsigned short)(process->seq + 1), __ATOMIC_RELEASE);
+}
+
+// Consistent copy of the hot fields of pid without blocking its writer,
+// retrying while one is in the middle of a change
+static inline void process_table_read(ProcessTableT* table, ProcessIdT pid, ProcessSnapshotT* snapshot) {
+  ProcessHotT* process = process_table_hot(table, pid);
+  unsigned short seq;
+  do {
+    seq = __atomic_load_n(&process->seq, __ATOMIC_ACQUIRE);
+    while (seq & 1) {
+      cpu_relax();
+      seq = __atomic_load_n(&process->seq, __ATOMIC_ACQUIRE);
+    }
+    snapshot->eval_code.implementation = __atomic_load_n(&process->eval_code.implementation, __ATOMIC_RELAXED);
+    snapshot->eval_code.parameter = __atomic_load_n(&process->eval_code.parameter, __ATOMIC_RELAXED);
+    snapshot->pc = __atomic_load_n(&process->pc, __ATOMIC_RELAXED);
+    snapshot->state = __atomic_load_n(&process->state, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(&process->seq, __ATOMIC_RELAXED) != seq);
+  snapshot->pid = pid;
+}
+
+// Copy every allocated process into snapshots, which has room for the
+// whole table, returning how many there were. Each copy is consistent,
+// the table as a whole is read one entry after another.
+size_t process_table_snapshot(ProcessTableT* table, ProcessSnapshotT* snapshots);
+
+// Mark the chunk holding pid as changed since the last checkpoint
+static inline void process_table_touch(ProcessTableT* table, ProcessIdT pid) {
+  unsigned int const chunk = (pid - 1) / PROCESS_TABLE_CHUNK;
+  uint64_t* word = &table->dirty[chunk / 64];
+  uint64_t const bit = 1ull << (chunk % 64);
+  //nearly always set already, reading first keeps the line shared
+  if (!(__atomic_load_n(word, __ATOMIC_RELAXED) & bit)) {
+    __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+  }
+}
+
+// Take the dirty bits of 64 chunks starting at word * 64, clearing them
+static inline uint64_t process_table_take_dirty(ProcessTableT* table, unsigned int word) {
+  return __atomic_exchange_n(&table->dirty[word], 0, __ATOMIC_RELAXED);
+}
+
+static inline MpscNodeT* process_table_event_node(ProcessTableT* table, ProcessIdT pid) {
+  return &table->event_node[pid - 1];
+}
+
+static inline ProcessIdT process_table_event_pid(ProcessTableT* table, MpscNodeT* node) {
+  return (ProcessIdT)(node - table->event_node) + 1;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include "process_table.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+ProcessTableT table;
+
+void test_create_destroy() {
+  printf("testing creation/destruction of the process table\n");
+  process_table_create(&table, 16);
+  assert(table.size == 16);
+  for(ProcessIdT pid = 1; pid <= 16; pid++) {
+    assert(process_table_hot(&table, pid)->state == unallocated);
+    assert(!process_table_signalled(&table, pid));
+  }
+  process_table_destroy(&table);
+}
+
+void test_hot_fields_packed() {
+  printf("testing hot fields are smaller than a cache line\n");
+  assert(process_table_hot_bytes_per_process() <= 32);
+  assert(process_table_hot_bytes_per_process() < process_table_bytes_per_process());
+}
+
+void test_clear() {
+  printf("testing clear\n");
+  process_table_create(&table, 4);
+  ProcessHotT* process = process_table_hot(&table, 2);
+  process->eval_code = evaluator_terminates_after(5);
+  process->pc = 3;
+  process->state = ready;
+  table.completed[1] = 1;
+  table.dispatches[1] = 7;
+  process_table_signal(&table, 2);
+  assert(process_table_signalled(&table, 2));
+  process_table_clear(&table, 2);
+  assert(process->pc == 0);
+  assert(process->state == unallocated);
+  assert(process->eval_code.implementation == NULL);
+  assert(table.completed[1] == 0);
+  assert(table.dispatches[1] == 0);
+  assert(!process_table_signalled(&table, 2));
+  process_table_destroy(&table);
+}
+
+void* signal_routine(void* arg) {
+  // sleep to ensure the waiter blocks first
+  sleep(1);
+  process_table_signal(&table, 3);
+  return NULL;
+}
+
+void test_wait_signal() {
+  printf("testing wait blocks until signalled\n");
+  process_table_create(&table, 4);
+  pthread_t signaller;
+  pthread_create(&signaller, NULL, signal_routine, NULL);
+  process_table_wait(&table, 3);
+  assert(process_table_signalled(&table, 3));
+  pthread_join(signaller, NULL);
+  //waiting on a signalled process returns straight away
+  process_table_wait(&table, 3);
+  process_table_destroy(&table);
+}
+
+void test_dirty_chunks() {
+  printf("testing changed chunks are tracked until taken\n");
+  process_table_create(&table, 3 * PROCESS_TABLE_CHUNK);
+  assert(process_table_take_dirty(&table, 0) == 0);
+
+  process_table_touch(&table, 1);
+  process_table_touch(&table, PROCESS_TABLE_CHUNK);
+  process_table_touch(&table, 2 * PROCESS_TABLE_CHUNK + 1);
+  process_table_touch(&table, 2 * PROCESS_TABLE_CHUNK + 2);
+  assert(process_table_take_dirty(&table, 0) == 0x5);
+  assert(process_table_take_dirty(&table, 0) == 0);
+  process_table_destroy(&table);
+}
+
+int writing;
+
+// Keeps the pc of pid 2 equal to its code parameter, a torn read would
+// see them differ
+void* snapshot_writer(void* arg) {
+  ProcessHotT* process = process_table_hot(&table, 2);
+  for (unsigned int i = 1; __atomic_load_n(&writing, __ATOMIC_RELAXED); i++) {
+    process_table_write_begin(process);
+    process->pc = i;
+    process->eval_code.parameter = i;
+    process->state = i % 2 ? ready : running;
+    process_table_write_end(process);
+  }
+  return NULL;
+}
+
+void test_snapshot() {
+  printf("testing snapshots skip free entries and never see half a change\n");
+  process_table_create(&table, 4);
+  ProcessSnapshotT snapshots[4];
+  assert(process_table_snapshot(&table, snapshots) == 0);
+
+  process_table_hot(&table, 2)->eval_code = evaluator_terminates_after(1);
+  process_table_hot(&table, 2)->pc = 1;
+  process_table_hot(&table, 2)->state = ready;
+  process_table_hot(&table, 4)->eval_code = evaluator_terminates_after(7);
+  process_table_hot(&table, 4)->pc = 3;
+  process_table_hot(&table, 4)->state = blocked;
+  assert(process_table_snapshot(&table, snapshots) == 2);
+  assert(snapshots[1].pid == 4 && snapshots[1].pc == 3 && snapshots[1].state == blocked);
+  assert(snapshots[1].eval_code.parameter == 7);
+
+  writing = 1;
+  pthread_t writer;
+  pthread_create(&writer, NULL, snapshot_writer, NULL);
+  for (int i = 0; i < 100000; i++) {
+    assert(process_table_snapshot(&table, snapshots) == 2);
+    assert(snapshots[0].pid == 2);
+    assert(snapshots[0].pc == snapshots[0].eval_code.parameter);
+    assert(snapshots[0].state == (snapshots[0].pc % 2 ? ready : running));
+  }
+  __atomic_store_n(&writing, 0, __ATOMIC_RELAXED);
+  pthread_join(writer, NULL);
+
+  //clearing keeps counting, so a reader mid entry still notices
+  unsigned short const seq = process_table_hot(&table, 4)->seq;
+  process_table_clear(&table, 4);
+  assert(process_table_hot(&table, 4)->seq == (unsigned short)(seq + 2));
+  assert(process_table_snapshot(&table, snapshots) == 1);
+  process_table_destroy(&table);
+}
+
+int main() {
+  test_create_destroy();
+  test_hot_fields_packed();
+  test_clear();
+  test_wait_signal();
+  test_dirty_chunks();
+  test_snapshot();
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include "scheduler.h"
+#include "simulator.h"
+#include "blocking_queue.h"
+#include "event_source.h"
+#include "environment.h"
+#include "logger.h"
+#include "utilities.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+//processes in the recorded workload, a fifth of them long
+#ifndef BENCH_JOBS
+#define BENCH_JOBS 400
+#endif
+#define BENCH_LONG_PERCENT 20
+#define BENCH_SEED 2024
+
+//offered load as a fraction of what the workers can evaluate
+#ifndef BENCH_LOAD
+#define BENCH_LOAD 0.8
+#endif
+
+// One arrival of the workload
+typedef struct Job {
+  uint64_t offset_ns; //from the start of the run
+  EvaluatorCodeT code;
+} JobT;
+
+// State shared by the submitter and the reaper of one run
+typedef struct Replay {
+  SimulatorT* simulator;
+  JobT const* jobs;
+  BlockingQueueT pids; //created pids in order, 0 once every job is in
+} ReplayT;
+
+// Cycles the code uses from start to exit, without sleeping
+static unsigned long job_cycles(EvaluatorCodeT const code) {
+  unsigned long cycles = 0;
+  unsigned int PC = 0;
+  EvaluatorResultT result;
+  do {
+    result = code.implementation(PC, code.parameter);
+    cycles += result.cpu_time;
+    PC = result.PC;
+  } while (result.reason != reason_terminated);
+  return cycles;
+}
+
+// Mix of short and long, cpu bound and blocking processes arriving with
+// uniform jitter at the given load - generated once so every policy sees
+// exactly the same arrivals
+static void record_workload(JobT* jobs, ConfigT const* config) {
+  unsigned int seed = BENCH_SEED;
+  unsigned long cycles = 0;
+  for (int i = 0; i < BENCH_JOBS; i++) {
+    unsigned int const steps = (unsigned int)rand_r(&seed) % 100 < BENCH_LONG_PERCENT ?
+      ENVIRONMENT_LONG_JOB_STEPS : ENVIRONMENT_JOB_STEPS;
+    jobs[i].code = rand_r(&seed) % 2 ?
+      evaluator_blocking_terminates_after(steps) : evaluator_terminates_after(steps);
+    cycles += job_cycles(jobs[i].code);
+  }
+
+  //mean gap between arrivals that keeps every worker busy load of the time
+  double const service_ns = (double)cycles / BENCH_JOBS * config->sleep_per_cpu_cycle * 1000;
+  double const gap_ns = service_ns / (config->simulator_threads * BENCH_LOAD);
+  uint64_t offset = 0;
+  for (int i = 0; i < BENCH_JOBS; i++) {
+    jobs[i].offset_ns = offset;
+    offset += (uint64_t)(gap_ns * 2 * rand_r(&seed) / RAND_MAX);
+  }
+}
+
+static void* submitter(void* arg) {
+  ReplayT* replay = (ReplayT*)arg;
+  uint64_t const start = process_table_now();
+  for (int i = 0; i < BENCH_JOBS; i++) {
+    uint64_t const now = process_table_now();
+    uint64_t const due = start + replay->jobs[i].offset_ns;
+    if (due > now) {
+      struct timespec const pause = { (due - now) / 1000000000, (due - now) % 1000000000 };
+      nanosleep(&pause, NULL);
+    }
+    blocking_queue_push(&replay->pids, simulator_create_process(replay->simulator, replay->jobs[i].code));
+  }
+  blocking_queue_push(&replay->pids, 0);
+  return NULL;
+}
+
+static void* reaper(void* arg) {
+  ReplayT* replay = (ReplayT*)arg;
+  ProcessIdT pid;
+  while (blocking_queue_pop(&replay->pids, &pid) == 0 && pid != 0) {
+    simulator_wait(replay->simulator, pid);
+  }
+  return NULL;
+}
+
+// Replay the workload under one policy, the whole simulator runs unpinned
+static void bench_policy(SchedulerOpsT const* scheduler, ConfigT const* config, JobT const* jobs,
+			 SimulatorMetricsT* metrics, double* seconds) {
+  ReplayT replay = { NULL, jobs };
+  blocking_queue_create(&replay.pids);
+  replay.simulator = simulator_start_policy(config, NULL, scheduler);
+  event_source_start(replay.simulator, config->event_source_interval);
+
+  uint64_t const start = process_table_now();
+  pthread_t threads[2];
+  pthread_create(&threads[0], NULL, submitter, &replay);
+  pthread_create(&threads[1], NULL, reaper, &replay);
+  pthread_join(threads[0], NULL);
+  pthread_join(threads[1], NULL);
+  *seconds = (process_table_now() - start) / 1e9;
+
+  event_source_stop(replay.simulator);
+  simulator_metrics(replay.simulator, metrics);
+  simulator_stop(replay.simulator);
+  blocking_queue_destroy(&replay.pids);
+}
+
+int main() {
+  ConfigT config;
+  config_defaults(&config);
+
+  JobT* jobs = (JobT*)checked_malloc(BENCH_JOBS * sizeof(JobT));
+  record_workload(jobs, &config);
+
+  SimulatorMetricsT metrics[policy_count];
+  double seconds[policy_count];
+  //per process events would bury the summaries
+  logger_configure(log_info, ~0u, 1);
+  logger_start();
+  for (int p = 0; p < policy_count; p++) {
+    bench_policy(scheduler_policies[p], &config, jobs, &metrics[p], &seconds[p]);
+  }
+  logger_stop();
+
+  //side by side once the logs are out of the way
+  printf("\n%d processes, %d workers, %.0f%% load\n", BENCH_JOBS, config.simulator_threads, BENCH_LOAD * 100);
+  printf("%-8s %14s %10s %10s %14s %9s %12s\n",
+	 "policy", "processes/s", "p50_us", "p99_us", "turnaround_ms", "fairness", "ns/decision");
+  for (int p = 0; p < policy_count; p++) {
+    printf("%-8s %14.1f %10.1f %10.1f %14.3f %9.3f %12.1f\n",
+	   scheduler_policies[p]->name, metrics[p].exits / seconds[p],
+	   simulator_latency_percentile(&metrics[p], 0.5) / 1e3,
+	   simulator_latency_percentile(&metrics[p], 0.99) / 1e3,
+	   metrics[p].mean_turnaround_ns / 1e6, metrics[p].fairness, metrics[p].sched_ns_per_decision);
+    checked_free(metrics[p].workers);
+  }
+
+  checked_free(jobs);
+  return 0;
+}
@@ -0,0 +1,75 @@
+#include "scheduler.h"
+#include "simulator.h"
+#include "blocking_queue.h"
+#include "utilities.h"
+
+#include <stdio.h>
+
+// Round robin - a fifo ready queue, every runnable process gets a time
+// slice in turn
+//workers wait in the real time class above, the queue itself never blocks
+typedef struct RoundRobin {
+  BlockingQueueT queue;
+} RoundRobinT;
+
+static void* rr_create(SimulatorT* simulator) {
+  RoundRobinT* rr = (RoundRobinT*)checked_malloc(sizeof(RoundRobinT));
+  blocking_queue_create(&rr->queue);
+  return rr;
+}
+
+static void rr_destroy(void* state) {
+  RoundRobinT* rr = (RoundRobinT*)state;
+  blocking_queue_destroy(&rr->queue);
+  checked_free(rr);
+}
+
+static void rr_push(void* state, ProcessIdT const* pids, size_t n) {
+  blocking_queue_push_many(&((RoundRobinT*)state)->queue, pids, n);
+}
+
+static size_t rr_try_pick(void* state, ProcessIdT* pids, size_t max) {
+  return blocking_queue_try_pop_many(&((RoundRobinT*)state)->queue, pids, max);
+}
+
+static size_t rr_pick_next(void* state, ProcessIdT* pids, size_t max) {
+  return blocking_queue_pop_many(&((RoundRobinT*)state)->queue, pids, max);
+}
+
+static void rr_on_preempt(void* state, ProcessIdT const* pids, EvaluatorResultT const* results, size_t n) {
+  rr_push(state, pids, n);
+}
+
+static size_t rr_length(void* state) {
+  return blocking_queue_length(&((RoundRobinT*)state)->queue);
+}
+
+static void rr_terminate(void* state, int waiters) {
+  BlockingQueueT* queue = &((RoundRobinT*)state)->queue;
+  blocking_queue_terminate(queue);
+  //post to semaphore so every worker can finish
+  for (int i = 0; i < waiters; i++) {
+    sem_post(&queue->queue_sem);
+  }
+}
+
+SchedulerOpsT const scheduler_round_robin = {
+  .name = "rr",
+  .create = rr_create,
+  .destroy = rr_destroy,
+  .enqueue = rr_push,
+  .try_pick = rr_try_pick,
+  .pick_next = rr_pick_next,
+  .on_preempt = rr_on_preempt,
+  .on_block = NULL,
+  .on_wake = rr_push,
+  .on_exit = NULL,
+  .length = rr_length,
+  .terminate = rr_terminate,
+};
+
+SchedulerOpsT const* const scheduler_policies[policy_count] = {
+  &scheduler_round_robin,
+  &scheduler_cfs,
+  &scheduler_srtf,
+};
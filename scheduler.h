@@ -0,0 +1,49 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include "process_table.h"
+#include "evaluator.h"
+#include "config.h"
+#include <stddef.h>
+
+struct Simulator;
+
+// A scheduling policy - owns the runnable processes of one simulator and
+// decides which run next. The simulator calls these from its workers,
+// the event thread and process creation, so every operation must be
+// thread safe. Optional operations may be NULL.
+typedef struct SchedulerOps {
+  char const* name;
+
+  void* (*create)(struct Simulator* simulator);
+  void (*destroy)(void* state);
+
+  // Newly created processes become runnable
+  void (*enqueue)(void* state, ProcessIdT const* pids, size_t n);
+  // Up to max processes to run next, without waiting - 0 if none are runnable
+  size_t (*try_pick)(void* state, ProcessIdT* pids, size_t max);
+  // Like try_pick but blocks while none are runnable, 0 once terminated
+  size_t (*pick_next)(void* state, ProcessIdT* pids, size_t max);
+  // Processes whose time slice ended, with what they just did, runnable again
+  void (*on_preempt)(void* state, ProcessIdT const* pids, EvaluatorResultT const* results, size_t n);
+  // A process went to wait for an event (optional)
+  void (*on_block)(void* state, ProcessIdT pid, EvaluatorResultT const* result);
+  // Blocked processes whose event arrived, runnable again
+  void (*on_wake)(void* state, ProcessIdT const* pids, size_t n);
+  // A process ran to completion (optional)
+  void (*on_exit)(void* state, ProcessIdT pid, EvaluatorResultT const* result);
+
+  // Runnable processes waiting to be picked
+  size_t (*length)(void* state);
+  // Wake every blocked pick_next - at most waiters threads may be blocked
+  void (*terminate)(void* state, int waiters);
+} SchedulerOpsT;
+
+// Built in policies indexed by SchedulerPolicyT, round robin first
+extern SchedulerOpsT const* const scheduler_policies[policy_count];
+
+extern SchedulerOpsT const scheduler_round_robin;
+extern SchedulerOpsT const scheduler_cfs;
+extern SchedulerOpsT const scheduler_srtf;
+
+#endif
@@ -0,0 +1,449 @@
+#include "shard.h"
+#include "utilities.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+//ticks between refreshes of the live counters the coordinator shows
+#define SHARD_PUBLISH_TICKS 100
+
+_Static_assert(CONFIG_MAX_SHARDS <= INT16_MAX, "away holds a shard index");
+
+int shard_region_create(ShardRegionT* region, unsigned int count) {
+  size_t const stats_size = count * sizeof(ShardStatsT);
+  region->size = stats_size + (size_t)count * count * sizeof(ShardRingT);
+  int const fd = memfd_create("scheduler-shards", MFD_CLOEXEC);
+  if (fd < 0) {
+    perror("Failed to create shard memory");
+    return 1;
+  }
+  //a fresh memfd reads as zeros, so every ring starts empty
+  if (ftruncate(fd, region->size) != 0) {
+    perror("Failed to size shard memory");
+    close(fd);
+    return 1;
+  }
+  void* memory = mmap(NULL, region->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); //the mapping keeps it alive, and forked shards inherit the mapping
+  if (memory == MAP_FAILED) {
+    perror("Failed to map shard memory");
+    return 1;
+  }
+  region->count = count;
+  region->stats = (ShardStatsT*)memory;
+  region->rings = (ShardRingT*)((char*)memory + stats_size);
+  return 0;
+}
+
+void shard_region_destroy(ShardRegionT* region) {
+  munmap(region->stats, region->size);
+}
+
+static ShardRingT* ring(ShardRegionT* region, int from, int to) {
+  return &region->rings[from * region->count + to];
+}
+
+//the sender holds its send lock, so it is the only writer of the tail
+int shard_ring_push(ShardRingT* ring, ShardMessageT const* message) {
+  uint64_t const tail = ring->tail;
+  if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == SHARD_RING_SIZE) {
+    return 1;
+  }
+  ring->messages[tail % SHARD_RING_SIZE] = *message;
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+int shard_ring_full(ShardRingT* ring) {
+  return ring->tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == SHARD_RING_SIZE;
+}
+
+ShardMessageT* shard_ring_peek(ShardRingT* ring) {
+  if (ring->head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  return &ring->messages[ring->head % SHARD_RING_SIZE];
+}
+
+void shard_ring_pop(ShardRingT* ring) {
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+static int send_message(ShardT* shard, int to, ShardMessageT const* message) {
+  pthread_mutex_lock(&shard->send_lock);
+  int const failed = shard_ring_push(ring(shard->region, shard->index, to), message);
+  pthread_mutex_unlock(&shard->send_lock);
+  return failed;
+}
+
+// Ready processes of shard, counting those sent that it has yet to take in
+static unsigned long shard_load(ShardRegionT* region, unsigned int shard) {
+  unsigned long load = __atomic_load_n(&region->stats[shard].load, __ATOMIC_RELAXED);
+  for (unsigned int from = 0; from < region->count; from++) {
+    ShardRingT* in = ring(region, from, shard);
+    load += __atomic_load_n(&in->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&in->head, __ATOMIC_ACQUIRE);
+  }
+  return load;
+}
+
+// Hand over work when this shard has had a few more ready processes than
+// the least loaded one still running for several ticks
+static void balance(ShardT* shard) {
+  SimulatorT* simulator = shard->simulator;
+  ShardStatsT* stats = shard->region->stats;
+  unsigned long load = simulator->scheduler->length(simulator->scheduler_state);
+  //a shard thrashing has its processes waiting on swap rather than ready,
+  //and must not look idle to the others
+  if (simulator->swap != NULL) {
+    DeviceStatsT swap;
+    device_stats(simulator->swap, &swap);
+    load += swap.submitted - swap.completed;
+  }
+  load += shard->parked_count;
+  __atomic_store_n(&stats[shard->index].load, load, __ATOMIC_RELAXED);
+
+  int target = -1;
+  unsigned long least = load;
+  for (unsigned int i = 0; i < shard->region->count; i++) {
+    if ((int)i == shard->index || __atomic_load_n(&stats[i].stopped, __ATOMIC_ACQUIRE)) continue;
+    unsigned long const other = shard_load(shard->region, i);
+    if (other < least) {
+      least = other;
+      target = i;
+    }
+  }
+
+  //while processes sent earlier are still on their way, the loads do not
+  //show them yet and another round would overshoot
+  int in_flight = 0;
+  for (unsigned int to = 0; to < shard->region->count; to++) {
+    ShardRingT* out = ring(shard->region, shard->index, to);
+    in_flight |= __atomic_load_n(&out->head, __ATOMIC_ACQUIRE) != __atomic_load_n(&out->tail, __ATOMIC_ACQUIRE);
+  }
+  //a gap lasting a tick or two is as likely a burst, or a load not yet
+  //republished
+  if (target >= 0 && load > least + SHARD_IMBALANCE && !in_flight) {
+    shard->busier_ticks = target == shard->busier_target ? shard->busier_ticks + 1 : 1;
+    shard->busier_target = target;
+  } else {
+    shard->busier_ticks = 0;
+  }
+
+  //moving half the difference evens the two out
+  if (shard->busier_ticks >= SHARD_IMBALANCE_TICKS) {
+    __atomic_store_n(&shard->target, target, __ATOMIC_RELAXED);
+    __atomic_store_n(&shard->budget, (int)((load - least) / 2), __ATOMIC_RELEASE);
+  } else {
+    __atomic_store_n(&shard->budget, 0, __ATOMIC_RELEASE);
+  }
+}
+
+// An own process finished elsewhere, its waiter here can have it back
+static void finish_away(ShardT* shard, int from, ShardMessageT const* message) {
+  ProcessIdT const pid = message->origin_pid;
+  if (shard->away[pid - 1] != from || shard->ticket[pid - 1] != message->ticket) {
+    return; //killed here and already handed back
+  }
+  ProcessTableT* table = &shard->simulator->process_table;
+  ProcessHotT* process = process_table_hot(table, pid);
+  table->cpu_time[pid - 1] = message->cpu_time;
+  unsigned char expected = blocked;
+  process_table_write_begin(process);
+  process->pc = message->pc;
+  if (__atomic_compare_exchange_n(&process->state, &expected, terminated, 0,
+				  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    table->completed[pid - 1] = 1;
+  }
+  process_table_write_end(process);
+  __atomic_store_n(&shard->away[pid - 1], -1, __ATOMIC_RELEASE);
+  __atomic_fetch_sub(&shard->away_count, 1, __ATOMIC_RELEASE);
+  process_table_signal(table, pid);
+  simulator_progress(shard->simulator);
+}
+
+// Slot of the adopted pid index for a process of shard from
+static ProcessIdT* adopted_slot(ShardT* shard, int from, ProcessIdT origin_pid) {
+  return &shard->adopted_pid[from * shard->simulator->config.max_processes + origin_pid - 1];
+}
+
+// The origin killed a process it sent here
+static void kill_adopted(ShardT* shard, int from, ShardMessageT const* message) {
+  ProcessIdT const pid = *adopted_slot(shard, from, message->origin_pid);
+  if (pid != 0 && shard->origin[pid - 1].shard == from && shard->origin[pid - 1].ticket == message->ticket) {
+    simulator_kill(shard->simulator, pid);
+    return;
+  }
+  //not taken in yet, it never will be
+  for (unsigned int i = 0; i < shard->parked_count; i++) {
+    ShardParkedT const* parked = &shard->parked[i];
+    if (parked->from == from && parked->message.origin_pid == message->origin_pid &&
+	parked->message.ticket == message->ticket) {
+      memmove(&shard->parked[i], &shard->parked[i + 1], (shard->parked_count - i - 1) * sizeof(ShardParkedT));
+      shard->parked_count--;
+      return;
+    }
+  }
+}
+
+// Run a process sent from another shard here, returns 1 if every pid is
+// in use
+static int adopt(ShardT* shard, int from, ShardMessageT const* message) {
+  SimulatorT* simulator = shard->simulator;
+  ProcessIdT const pid = simulator_try_reserve_pid(simulator);
+  if (pid == 0) {
+    return 1;
+  }
+  EvaluatorCodeT code;
+  evaluator_code_from_id(message->code_id, message->parameter, &code);
+  //recorded before the process is runnable, so no worker passes it on again
+  shard->origin[pid - 1] = (ShardOriginT){ from, message->origin_pid, message->ticket };
+  *adopted_slot(shard, from, message->origin_pid) = pid;
+  shard->adopted_count++;
+  __atomic_fetch_add(&shard->adopted, 1, __ATOMIC_RELAXED);
+  simulator_adopt_process(simulator, pid, code, message->pc, message->created, message->nice,
+			  message->cpu_time);
+  //the senders see it straight away rather than from the next balance
+  __atomic_fetch_add(&shard->region->stats[shard->index].load, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+// Take in everything the other shards have sent
+static void receive(ShardT* shard) {
+  //migrations parked earlier first, in the order they came
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < shard->parked_count; i++) {
+    if (adopt(shard, shard->parked[i].from, &shard->parked[i].message) != 0) {
+      shard->parked[kept++] = shard->parked[i];
+    }
+  }
+  shard->parked_count = kept;
+
+  for (unsigned int from = 0; from < shard->region->count; from++) {
+    if ((int)from == shard->index) continue;
+    ShardRingT* in = ring(shard->region, from, shard->index);
+    ShardMessageT* message;
+    while ((message = shard_ring_peek(in)) != NULL) {
+      if (message->kind == shard_message_migrate) {
+	//parked until a pid frees up - a done or kill behind it may be what
+	//frees one. An origin has each of its pids away once at most, so
+	//parking never needs more than count - 1 tables of them.
+	if (adopt(shard, from, message) != 0) {
+	  shard->parked[shard->parked_count++] = (ShardParkedT){ from, *message };
+	}
+      } else if (message->kind == shard_message_done) {
+	finish_away(shard, from, message);
+      } else {
+	kill_adopted(shard, from, message);
+      }
+      shard_ring_pop(in);
+    }
+  }
+}
+
+static void push_finished(ShardT* shard, ProcessIdT pid) {
+  ProcessIdT head = __atomic_load_n(&shard->finished, __ATOMIC_RELAXED);
+  do {
+    shard->finished_next[pid - 1] = head;
+  } while (!__atomic_compare_exchange_n(&shard->finished, &head, pid, 1,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void shard_finished(ShardT* shard, ProcessIdT pid) {
+  if (shard->origin[pid - 1].shard >= 0) {
+    push_finished(shard, pid);
+  }
+}
+
+// Report adopted processes that have finished back to where they came
+// from, and release them here
+static void return_finished(ShardT* shard) {
+  SimulatorT* simulator = shard->simulator;
+  ProcessTableT* table = &simulator->process_table;
+  //the whole list is taken at once, so a pid cannot come back under us
+  ProcessIdT next = __atomic_exchange_n(&shard->finished, 0, __ATOMIC_ACQUIRE);
+  while (next != 0) {
+    ProcessIdT const pid = next;
+    next = shard->finished_next[pid - 1];
+    ShardOriginT* origin = &shard->origin[pid - 1];
+    ShardMessageT message = { 0 };
+    message.kind = shard_message_done;
+    message.origin_pid = origin->pid;
+    message.ticket = origin->ticket;
+    message.cpu_time = table->cpu_time[pid - 1];
+    message.pc = process_table_hot(table, pid)->pc;
+    if (send_message(shard, origin->shard, &message) != 0) {
+      push_finished(shard, pid); //full, next tick
+      continue;
+    }
+    //a later migration of the same process may have taken the slot
+    ProcessIdT* slot = adopted_slot(shard, origin->shard, origin->pid);
+    if (*slot == pid) *slot = 0;
+    origin->shard = -1;
+    shard->adopted_count--;
+    simulator_try_wait(simulator, pid);
+  }
+}
+
+// Pass on kills of own processes that are running elsewhere, their waiter
+// here is let go straight away
+static void forward_kills(ShardT* shard) {
+  SimulatorT* simulator = shard->simulator;
+  ProcessTableT* table = &simulator->process_table;
+  unsigned int const away_count = __atomic_load_n(&shard->away_count, __ATOMIC_ACQUIRE);
+  for (unsigned int i = 0, seen = 0; i < simulator->config.max_processes && seen < away_count; i++) {
+    int const to = __atomic_load_n(&shard->away[i], __ATOMIC_ACQUIRE);
+    if (to < 0) continue;
+    seen++;
+    ProcessIdT const pid = i + 1;
+    if (__atomic_load_n(&process_table_hot(table, pid)->state, __ATOMIC_ACQUIRE) != terminated) continue;
+    ShardMessageT message = { 0 };
+    message.kind = shard_message_kill;
+    message.origin_pid = pid;
+    message.ticket = shard->ticket[i];
+    if (send_message(shard, to, &message) != 0) continue;
+    __atomic_store_n(&shard->away[i], -1, __ATOMIC_RELEASE);
+    __atomic_fetch_sub(&shard->away_count, 1, __ATOMIC_RELEASE);
+    process_table_signal(table, pid);
+    simulator_progress(shard->simulator);
+  }
+}
+
+// Counters read by the coordinator while the shard runs
+static void publish_counters(ShardT* shard) {
+  SimulatorMetricsT metrics;
+  simulator_metrics(shard->simulator, &metrics);
+  ShardStatsT* stats = &shard->region->stats[shard->index];
+  __atomic_store_n(&stats->exits, metrics.exits, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->dispatches, metrics.dispatches, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->migrated, __atomic_load_n(&shard->migrated, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->adopted, __atomic_load_n(&shard->adopted, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+  stats->mean_turnaround_ns = metrics.mean_turnaround_ns;
+  stats->sched_ns_per_decision = metrics.sched_ns_per_decision;
+  checked_free(metrics.workers);
+}
+
+static void* shard_routine(void* arg) {
+  ShardT* shard = (ShardT*)arg;
+  for (unsigned long tick = 0; !__atomic_load_n(&shard->stopping, __ATOMIC_ACQUIRE); tick++) {
+    balance(shard);
+    receive(shard);
+    return_finished(shard);
+    forward_kills(shard);
+    if (tick % SHARD_PUBLISH_TICKS == 0) {
+      publish_counters(shard);
+    }
+    usleep(SHARD_INTERVAL_US);
+  }
+  return NULL;
+}
+
+void shard_start(ShardT* shard, ShardRegionT* region, int index, SimulatorT* simulator) {
+  unsigned int const max_processes = simulator->config.max_processes;
+  memset(shard, 0, sizeof(ShardT));
+  shard->region = region;
+  shard->index = index;
+  shard->simulator = simulator;
+  pthread_mutex_init(&shard->send_lock, NULL);
+  shard->origin = (ShardOriginT*)checked_malloc(max_processes * sizeof(ShardOriginT));
+  shard->away = (int16_t*)checked_malloc(max_processes * sizeof(int16_t));
+  shard->ticket = (uint32_t*)checked_malloc(max_processes * sizeof(uint32_t));
+  shard->adopted_pid = (ProcessIdT*)checked_malloc(region->count * max_processes * sizeof(ProcessIdT));
+  shard->finished_next = (ProcessIdT*)checked_malloc(max_processes * sizeof(ProcessIdT));
+  shard->parked = (ShardParkedT*)checked_malloc((region->count - 1) * max_processes * sizeof(ShardParkedT));
+  shard->busier_target = -1;
+  for (unsigned int i = 0; i < max_processes; i++) {
+    shard->origin[i].shard = -1;
+    shard->away[i] = -1;
+  }
+  memset(shard->ticket, 0, max_processes * sizeof(uint32_t));
+  memset(shard->adopted_pid, 0, region->count * max_processes * sizeof(ProcessIdT));
+
+  //workers look for the shard from their next pick
+  __atomic_store_n(&simulator->shard, shard, __ATOMIC_RELEASE);
+  pthread_attr_t attr;
+  simulator_thread_attr(simulator, &attr);
+  pthread_create(&shard->thread, &attr, shard_routine, shard);
+  pthread_attr_destroy(&attr);
+}
+
+void shard_stop(ShardT* shard) {
+  __atomic_store_n(&shard->stopping, 1, __ATOMIC_RELEASE);
+  pthread_join(shard->thread, NULL);
+  __atomic_store_n(&shard->simulator->shard, NULL, __ATOMIC_RELEASE);
+  pthread_mutex_destroy(&shard->send_lock);
+  checked_free(shard->origin);
+  checked_free(shard->away);
+  checked_free(shard->ticket);
+  checked_free(shard->adopted_pid);
+  checked_free(shard->finished_next);
+  checked_free(shard->parked);
+}
+
+int shard_migrate(ShardT* shard, ProcessIdT pid) {
+  if (__atomic_load_n(&shard->budget, __ATOMIC_ACQUIRE) <= 0) {
+    return 0;
+  }
+
+  //only best effort processes of this shard move, once. A member stays in
+  //its group here, but time run elsewhere would escape the group's quota.
+  SimulatorT* simulator = shard->simulator;
+  ProcessTableT* table = &simulator->process_table;
+  GroupIdT const group = __atomic_load_n(&table->group[pid - 1], __ATOMIC_ACQUIRE);
+  if (shard->origin[pid - 1].shard >= 0 || table->deadline[pid - 1] != 0 ||
+      (group != 0 && simulator->groups[group - 1].quota_ns != 0)) {
+    return 0;
+  }
+  ProcessHotT* process = process_table_hot(table, pid);
+  unsigned int const code_id = evaluator_code_id(process->eval_code);
+  if (code_id == 0 || code_id == EVALUATOR_UNKNOWN_CODE) {
+    return 0;
+  }
+  if (__atomic_fetch_sub(&shard->budget, 1, __ATOMIC_ACQ_REL) <= 0) {
+    return 0; //another worker took the last of it
+  }
+
+  int const to = __atomic_load_n(&shard->target, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&shard->send_lock);
+  ShardRingT* out = ring(shard->region, shard->index, to);
+  if (shard_ring_full(out)) {
+    pthread_mutex_unlock(&shard->send_lock);
+    return 0;
+  }
+  //the process waits here, blocked, until the other shard says it is done
+  unsigned char expected = running;
+  if (!__atomic_compare_exchange_n(&process->state, &expected, blocked, 0,
+				   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    pthread_mutex_unlock(&shard->send_lock);
+    process_table_signal(table, pid); //killed meanwhile
+    simulator_progress(shard->simulator);
+    return 1;
+  }
+
+  ShardMessageT message = { 0 };
+  message.kind = shard_message_migrate;
+  message.origin_pid = pid;
+  message.ticket = ++shard->next_ticket;
+  message.code_id = code_id;
+  message.parameter = process->eval_code.parameter;
+  message.pc = process->pc;
+  message.nice = __atomic_load_n(&table->nice[pid - 1], __ATOMIC_RELAXED);
+  message.cpu_time = table->cpu_time[pid - 1];
+  message.created = table->created[pid - 1];
+  shard->ticket[pid - 1] = message.ticket;
+  __atomic_store_n(&shard->away[pid - 1], to, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&shard->away_count, 1, __ATOMIC_RELEASE);
+  shard_ring_push(out, &message);
+  pthread_mutex_unlock(&shard->send_lock);
+
+  __atomic_fetch_add(&shard->migrated, 1, __ATOMIC_RELAXED);
+  return 1;
+}
+
+void shard_publish(ShardT* shard, double seconds) {
+  publish_counters(shard);
+  ShardStatsT* stats = &shard->region->stats[shard->index];
+  stats->seconds = seconds;
+  __atomic_store_n(&stats->stopped, 1, __ATOMIC_RELEASE);
+}
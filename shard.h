@@ -0,0 +1,140 @@
+#ifndef _SHARD_H_
+#define _SHARD_H_
+
+#include "simulator.h"
+#include <stdint.h>
+#include <pthread.h>
+
+//messages each ring holds, a power of two
+#define SHARD_RING_SIZE 1024
+//how often a shard balances and drains its rings, in microseconds
+#define SHARD_INTERVAL_US 1000
+//processes a shard must have beyond the least loaded before it
+//hands any over
+#define SHARD_IMBALANCE 4
+//ticks in a row the imbalance must last first, bursts of client
+//processes come and go quicker than a migration settles
+#define SHARD_IMBALANCE_TICKS 5
+
+// What a message between shards says
+typedef enum ShardMessageKind {
+  shard_message_migrate, //run this process from now on
+  shard_message_done, //the process you sent has terminated
+  shard_message_kill, //the process I sent has been killed here
+} ShardMessageKindT;
+
+typedef struct ShardMessage {
+  uint64_t created; //on the monotonic clock, the same in every process
+  uint64_t cpu_time; //cycles used so far
+  uint32_t origin_pid; //pid on the shard the process was created on
+  uint32_t code_id;
+  uint32_t parameter;
+  uint32_t pc;
+  uint32_t ticket; //numbers the migration, so a late reply cannot match a reused pid
+  uint8_t kind; //ShardMessageKindT
+  int8_t nice;
+  uint8_t unused[2];
+} ShardMessageT;
+
+// One way ring from one shard to another. Each end is a single thread at
+// a time, so head and tail need no more than acquire and release - they
+// work the same across processes sharing the memory.
+typedef struct ShardRing {
+  uint64_t head __attribute__((aligned(64))); //next message the receiver takes
+  uint64_t tail __attribute__((aligned(64))); //next slot the sender fills
+  ShardMessageT messages[SHARD_RING_SIZE];
+} ShardRingT;
+
+// What a shard publishes for the others and the coordinator
+typedef struct ShardStats {
+  unsigned long load; //ready or waiting on swap, read by the other shards to balance
+  unsigned long exits;
+  unsigned long dispatches;
+  unsigned long migrated; //processes handed to other shards
+  unsigned long adopted; //processes taken in from other shards
+  double mean_turnaround_ns;
+  double sched_ns_per_decision;
+  double seconds; //from start to the clients finishing
+  int finished; //its clients are done, it only runs what others send
+  int stopped; //the numbers are final
+} __attribute__((aligned(64))) ShardStatsT;
+
+// Shared memory of a sharded run, created before the shards are forked
+typedef struct ShardRegion {
+  uint32_t count;
+  ShardStatsT* stats; //one per shard
+  ShardRingT* rings; //count * count, from * count + to
+  size_t size;
+} ShardRegionT;
+
+// Where an adopted process came from
+typedef struct ShardOrigin {
+  int shard; //-1 for the shard's own processes
+  ProcessIdT pid;
+  uint32_t ticket;
+} ShardOriginT;
+
+// A migration taken off its ring while every pid was in use, so the
+// messages behind it are not held up
+typedef struct ShardParked {
+  int from;
+  ShardMessageT message;
+} ShardParkedT;
+
+// One shard, in its own process. Workers hand processes over when the
+// shard is busier than another, the shard's thread takes in what is sent
+// to it, reports back when adopted processes finish and passes on kills.
+typedef struct Shard {
+  ShardRegionT* region;
+  int index;
+  SimulatorT* simulator;
+  pthread_t thread;
+  int stopping;
+  pthread_mutex_t send_lock; //workers and the thread share the outgoing rings
+  int target; //shard migrations go to
+  int budget; //processes still to hand over to target
+  int busier_target; //least loaded shard on the last ticks
+  unsigned int busier_ticks; //ticks in a row this shard was busier than it
+  uint32_t next_ticket;
+  ShardOriginT* origin; //per pid, for adopted processes
+  ProcessIdT* adopted_pid; //per origin shard and pid, where it runs here, 0 for none
+  ProcessIdT finished; //adopted processes whose waiter was signalled, linked by finished_next
+  ProcessIdT* finished_next;
+  ShardParkedT* parked; //only the thread touches these
+  unsigned int parked_count;
+  int16_t* away; //per pid, shard an own process runs on, -1 when here
+  uint32_t* ticket; //per pid, of the migration an away process left with
+  unsigned int away_count;
+  unsigned int adopted_count; //only the thread touches it
+  unsigned long migrated;
+  unsigned long adopted;
+} ShardT;
+
+// Append a message, returns 0 if there was room. Each ring has one
+// sender and one receiver at a time.
+int shard_ring_push(ShardRingT* ring, ShardMessageT const* message);
+int shard_ring_full(ShardRingT* ring);
+// Oldest message, NULL when there is none - it stays put until pop
+ShardMessageT* shard_ring_peek(ShardRingT* ring);
+void shard_ring_pop(ShardRingT* ring);
+
+// Map the rings and statistics of count shards, returns 0 on success
+int shard_region_create(ShardRegionT* region, unsigned int count);
+void shard_region_destroy(ShardRegionT* region);
+
+// Join the region as shard index with simulator, starting its thread
+void shard_start(ShardT* shard, ShardRegionT* region, int index, SimulatorT* simulator);
+void shard_stop(ShardT* shard);
+
+// Called by a worker that has just picked pid, returns 1 if the process
+// was handed to another shard - or found killed - and must not be run
+int shard_migrate(ShardT* shard, ProcessIdT pid);
+
+// Called once the waiter of pid has been signalled, queues adopted
+// processes to be reported back to where they came from
+void shard_finished(ShardT* shard, ProcessIdT pid);
+
+// Publish the shard's final numbers for the coordinator
+void shard_publish(ShardT* shard, double seconds);
+
+#endif
@@ -0,0 +1,245 @@
+#include "shard.h"
+#include "logger.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+ShardRingT ring;
+
+ShardMessageT numbered(uint32_t ticket) {
+  ShardMessageT message = { 0 };
+  message.kind = shard_message_done;
+  message.ticket = ticket;
+  return message;
+}
+
+// Wait up to a few seconds for a counter to reach value
+int settles(unsigned int* counter, unsigned int value) {
+  for (int i = 0; i < 5000 && __atomic_load_n(counter, __ATOMIC_ACQUIRE) != value; i++) {
+    usleep(1000);
+  }
+  return __atomic_load_n(counter, __ATOMIC_ACQUIRE) == value;
+}
+
+void test_ring_full() {
+  printf("testing a ring takes its size and refuses more\n");
+  memset(&ring, 0, sizeof(ring));
+  assert(shard_ring_peek(&ring) == NULL);
+  for (uint32_t i = 0; i < SHARD_RING_SIZE; i++) {
+    assert(!shard_ring_full(&ring));
+    ShardMessageT const message = numbered(i);
+    assert(shard_ring_push(&ring, &message) == 0);
+  }
+  assert(shard_ring_full(&ring));
+  ShardMessageT const extra = numbered(SHARD_RING_SIZE);
+  assert(shard_ring_push(&ring, &extra) == 1);
+
+  //one out makes room for one more
+  assert(shard_ring_peek(&ring)->ticket == 0);
+  shard_ring_pop(&ring);
+  assert(!shard_ring_full(&ring));
+  assert(shard_ring_push(&ring, &extra) == 0);
+  for (uint32_t i = 1; i <= SHARD_RING_SIZE; i++) {
+    assert(shard_ring_peek(&ring)->ticket == i);
+    shard_ring_pop(&ring);
+  }
+  assert(shard_ring_peek(&ring) == NULL);
+}
+
+void test_ring_wrap() {
+  printf("testing messages keep their order across the end of the ring\n");
+  memset(&ring, 0, sizeof(ring));
+  ring.head = ring.tail = 3 * SHARD_RING_SIZE - 2;
+  for (uint32_t i = 0; i < 5; i++) {
+    ShardMessageT const message = numbered(i);
+    assert(shard_ring_push(&ring, &message) == 0);
+  }
+  assert(ring.tail % SHARD_RING_SIZE == 3);
+  for (uint32_t i = 0; i < 5; i++) {
+    assert(shard_ring_peek(&ring)->ticket == i);
+    shard_ring_pop(&ring);
+  }
+  assert(shard_ring_peek(&ring) == NULL);
+}
+
+void test_peek_pop() {
+  printf("testing a peeked message stays until popped\n");
+  memset(&ring, 0, sizeof(ring));
+  ShardMessageT const first = numbered(1), second = numbered(2);
+  shard_ring_push(&ring, &first);
+  shard_ring_push(&ring, &second);
+  ShardMessageT* peeked = shard_ring_peek(&ring);
+  assert(peeked->ticket == 1);
+  assert(shard_ring_peek(&ring) == peeked);
+  shard_ring_pop(&ring);
+  assert(shard_ring_peek(&ring)->ticket == 2);
+  shard_ring_pop(&ring);
+  assert(shard_ring_peek(&ring) == NULL);
+}
+
+void test_migrate_done() {
+  printf("testing processes sent to an idle shard finish at home\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 2;
+  config.max_processes = 64;
+  ShardRegionT region;
+  assert(shard_region_create(&region, 2) == 0);
+  SimulatorT* simulators[2];
+  ShardT shards[2];
+  for (int i = 0; i < 2; i++) {
+    simulators[i] = simulator_start(&config, NULL);
+    shard_start(&shards[i], &region, i, simulators[i]);
+  }
+
+  //everything starts on the first shard
+  ProcessIdT pids[48];
+  for (int i = 0; i < 48; i++) {
+    pids[i] = simulator_create_process(simulators[0], evaluator_terminates_after(20));
+  }
+  for (int i = 0; i < 48; i++) {
+    simulator_wait(simulators[0], pids[i]);
+  }
+  unsigned long const migrated = shards[0].migrated;
+  assert(migrated > 0);
+  assert(shards[1].migrated == 0);
+  assert(settles(&shards[1].adopted_count, 0));
+  assert(shards[1].adopted == migrated);
+  assert(shards[0].away_count == 0);
+  //every index slot was cleared as its process was returned
+  for (unsigned int i = 0; i < 2 * config.max_processes; i++) {
+    assert(shards[1].adopted_pid[i] == 0);
+  }
+
+  for (int i = 0; i < 2; i++) {
+    shard_stop(&shards[i]);
+    simulator_stop(simulators[i]);
+  }
+  shard_region_destroy(&region);
+}
+
+void test_kill_away() {
+  printf("testing killing processes running on another shard\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 2;
+  config.max_processes = 64;
+  ShardRegionT region;
+  assert(shard_region_create(&region, 2) == 0);
+  SimulatorT* simulators[2];
+  ShardT shards[2];
+  for (int i = 0; i < 2; i++) {
+    simulators[i] = simulator_start(&config, NULL);
+    shard_start(&shards[i], &region, i, simulators[i]);
+  }
+
+  ProcessIdT pids[32];
+  for (int i = 0; i < 32; i++) {
+    pids[i] = simulator_create_process(simulators[0], evaluator_infinite_loop);
+  }
+  for (int i = 0; i < 5000 && __atomic_load_n(&shards[0].away_count, __ATOMIC_ACQUIRE) == 0; i++) {
+    usleep(1000);
+  }
+  assert(shards[0].away_count > 0);
+
+  //the waiters here are let go and the ticket finds the copies there
+  for (int i = 0; i < 32; i++) {
+    simulator_kill(simulators[0], pids[i]);
+  }
+  for (int i = 0; i < 32; i++) {
+    simulator_wait(simulators[0], pids[i]);
+  }
+  assert(settles(&shards[0].away_count, 0));
+  assert(settles(&shards[1].adopted_count, 0));
+
+  for (int i = 0; i < 2; i++) {
+    shard_stop(&shards[i]);
+    simulator_stop(simulators[i]);
+  }
+  shard_region_destroy(&region);
+}
+
+void test_parked_migrate() {
+  printf("testing a migrate with no free pid lets the messages behind it through\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 2;
+  config.max_processes = 8;
+  ShardRegionT region;
+  assert(shard_region_create(&region, 2) == 0);
+  //this thread plays the first shard, which the second never sends to
+  region.stats[0].stopped = 1;
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  ShardT shard;
+  shard_start(&shard, &region, 1, simulator);
+
+  ProcessIdT pids[8];
+  for (int i = 0; i < 8; i++) {
+    pids[i] = simulator_create_process(simulator, evaluator_infinite_loop);
+  }
+
+  //two migrations, then a kill of the first
+  ShardRingT* in = &region.rings[0 * region.count + 1];
+  EvaluatorCodeT const code = evaluator_terminates_after(3);
+  ShardMessageT message = { 0 };
+  message.kind = shard_message_migrate;
+  message.code_id = evaluator_code_id(code);
+  message.parameter = code.parameter;
+  message.created = process_table_now();
+  for (uint32_t pid = 5; pid <= 6; pid++) {
+    message.origin_pid = pid;
+    message.ticket = pid * 10;
+    assert(shard_ring_push(in, &message) == 0);
+  }
+  ShardMessageT kill = { 0 };
+  kill.kind = shard_message_kill;
+  kill.origin_pid = 5;
+  kill.ticket = 50;
+  assert(shard_ring_push(in, &kill) == 0);
+
+  //drained behind the parked migrations, which wait for a pid
+  for (int i = 0; i < 5000 && shard_ring_peek(in) != NULL; i++) {
+    usleep(1000);
+  }
+  assert(shard_ring_peek(in) == NULL);
+  usleep(5 * SHARD_INTERVAL_US);
+  assert(shard.parked_count == 1);
+  assert(shard.parked[0].message.origin_pid == 6);
+  assert(shard.adopted == 0);
+
+  //a free pid takes the parked one in, and it is reported back when done
+  for (int i = 0; i < 8; i++) {
+    simulator_kill(simulator, pids[i]);
+    simulator_wait(simulator, pids[i]);
+  }
+  for (int i = 0; i < 5000 && __atomic_load_n(&shard.adopted, __ATOMIC_RELAXED) == 0; i++) {
+    usleep(1000);
+  }
+  assert(shard.adopted == 1);
+  assert(settles(&shard.adopted_count, 0));
+  assert(shard.parked_count == 0);
+  ShardRingT* out = &region.rings[1 * region.count + 0];
+  ShardMessageT* done = shard_ring_peek(out);
+  assert(done != NULL && done->kind == shard_message_done);
+  assert(done->origin_pid == 6 && done->ticket == 60);
+
+  shard_stop(&shard);
+  simulator_stop(simulator);
+  shard_region_destroy(&region);
+}
+
+int main() {
+  //per process events would bury the test output
+  logger_configure(log_warning, ~0u, 1);
+  logger_start();
+  test_ring_full();
+  test_ring_wrap();
+  test_peek_pop();
+  test_migrate_done();
+  test_kill_away();
+  test_parked_migrate();
+  logger_stop();
+  return 0;
+}
@@ -1,271 +1,1231 @@
 #include "simulator.h"
 #include "list.h"
-#include "non_blocking_queue.h"
+#include "mpsc_queue.h"
 #include "blocking_queue.h"
 #include "utilities.h"
 #include "logger.h"
 #include "event_source.h"
+#include "cfs.h"
+#include "checkpoint.h"
+#include "trace.h"
+#include "perf.h"
+#include "shard.h"
 #include <string.h>
 #include <unistd.h>
 
-static int* thread_ids;
-static pthread_t* threads; //threads
-static BlockingQueueT* pid_queue; //stores all initial max number of pids
-static BlockingQueueT* ready_queue; //stores all initialised process pids
-static NonBlockingQueueT* event_queue; 
-static int count; //thread_count
-static ProcessT* process_table; //process table holds all process structs
-static pthread_mutex_t table_lock;
-static int completed_process_count = 0;
+//pids a worker takes from the ready queue per lock acquisition
+#ifndef SIMULATOR_WORKER_BATCH
+#define SIMULATOR_WORKER_BATCH 4
+#endif
 
-void simulator_start(int thread_count, int max_processes) {
+//blocked pids the event thread moves to the ready queue per push
+#ifndef SIMULATOR_EVENT_BATCH
+#define SIMULATOR_EVENT_BATCH 64
+#endif
+
+//how often the event thread looks for group quota periods that are over
+#define SIMULATOR_REFILL_NS 1000000
+
+//the elastic pool is sized from what happened in the last window
+#define SIMULATOR_SCALE_NS 10000000
+//grow after this many windows in a row with more pids waiting per
+//worker, or a longer mean ready queue delay, than below
+#define SIMULATOR_GROW_WINDOWS 2
+#define SIMULATOR_GROW_DEPTH 4
+#define SIMULATOR_GROW_DELAY_NS 2000000
+//shrink after this many windows in a row with an empty ready queue and
+//the workers busy less than this percent of the time - far apart from
+//the grow thresholds so the pool does not flap between sizes
+#define SIMULATOR_SHRINK_WINDOWS 20
+#define SIMULATOR_SHRINK_BUSY_PERCENT 50
+
+//instance numbers handed out by simulator_start
+static int next_simulator_id = 1;
+
+static void complete_io(void* context, ProcessIdT const* pids, size_t count);
+static void complete_swap(void* context, ProcessIdT const* pids, size_t count);
+static SimulatorT* start(ConfigT const* config, cpu_set_t const* cpus, SchedulerOpsT const* scheduler,
+			 TraceReplayT* replay);
+
+// Create the thread of the next worker in the pool
+static void start_worker(SimulatorT* simulator) {
+  int const i = simulator->started_workers;
+  pthread_attr_t attr;
+  simulator_thread_attr(simulator, &attr);
+  pthread_create(&simulator->threads[i], &attr, simulator_routine, &simulator->workers[i]);
+  pthread_attr_destroy(&attr);
+  __atomic_store_n(&simulator->started_workers, i + 1, __ATOMIC_RELEASE);
+}
+
+SimulatorT* simulator_start(ConfigT const* config, cpu_set_t const* cpus) {
+  return simulator_start_policy(config, cpus, scheduler_policies[config->policy]);
+}
+
+SimulatorT* simulator_start_policy(ConfigT const* config, cpu_set_t const* cpus, SchedulerOpsT const* scheduler) {
+  return start(config, cpus, scheduler, NULL);
+}
+
+SimulatorT* simulator_start_replay(ConfigT const* config, cpu_set_t const* cpus, struct TraceReplay* replay) {
+  return start(config, cpus, scheduler_policies[config->policy], replay);
+}
+
+static SimulatorT* start(ConfigT const* config, cpu_set_t const* cpus, SchedulerOpsT const* scheduler,
+			 TraceReplayT* replay) {
+  
+  int const thread_count = config->max_threads > config->simulator_threads ?
+    config->max_threads : config->simulator_threads;
+  unsigned int const max_processes = config->max_processes;
+  
+  SimulatorT* simulator = (SimulatorT*)checked_malloc(sizeof(SimulatorT));
+  memset(simulator, 0, sizeof(SimulatorT));
+  simulator->id = __atomic_fetch_add(&next_simulator_id, 1, __ATOMIC_RELAXED);
+  simulator->config = *config;
+  simulator->thread_count = thread_count;
+  
+  //remember the cpu binding for every thread of this instance
+  simulator->pinned = cpus != NULL;
+  if (cpus != NULL) {
+    simulator->cpus = *cpus;
+  }
   
-  count = thread_count;
+  //init process table - hot and cold arrays
+  process_table_create(&simulator->process_table, max_processes);
   
-  //init process table - array of processT structs
-  process_table = (ProcessT*)checked_malloc(max_processes * sizeof(ProcessT));
-  memset(process_table, 0, max_processes * sizeof(ProcessT)); // clean slate
+  LOG(log_info, log_general, "Simulator %i - Process table uses %zu bytes per process (%zu hot)",
+      simulator->id, process_table_bytes_per_process(), process_table_hot_bytes_per_process());
   
-  //init blocking queues
-  pid_queue = (BlockingQueueT*)checked_malloc( sizeof(BlockingQueueT) );
-  ready_queue = (BlockingQueueT*)checked_malloc( sizeof(BlockingQueueT) );
-  event_queue = (NonBlockingQueueT*)checked_malloc( sizeof(NonBlockingQueueT) );
+  //policies count time from the start, a replay from its own
+  simulator->start_time = process_table_now();
+  if (replay != NULL) {
+    replay->start = simulator->start_time;
+  }
   
   //create each queue
-  blocking_queue_create(pid_queue);
-  blocking_queue_create(ready_queue);
-  non_blocking_queue_create(event_queue);
+  blocking_queue_create(&simulator->pid_queue);
+  simulator->best_effort = scheduler;
+  simulator->scheduler = &scheduler_edf;
+  simulator->scheduler_state = scheduler_edf.create(simulator);
+  mpsc_queue_create(&simulator->event_queue);
+  
+  //disks first, then networks, each seeded apart - swap comes last so
+  //blocking for i/o never picks it
+  simulator->io_device_count = config->disks + config->networks;
+  simulator->device_count = simulator->io_device_count + (config->frames > 0);
+  simulator->devices = (DeviceT*)checked_malloc(simulator->device_count * sizeof(DeviceT));
+  for (int i = 0; i < simulator->io_device_count; i++) {
+    int const disk = i < (int)config->disks;
+    device_create(&simulator->devices[i], disk ? device_disk : device_network,
+		  disk ? config->disk_service_us : config->network_service_us,
+		  disk ? config->disk_concurrency : config->network_concurrency,
+		  max_processes, simulator->id * 1000 + i, complete_io, simulator);
+  }
+  if (config->frames > 0) {
+    simulator->vm = (VmT*)checked_malloc(sizeof(VmT));
+    vm_create(simulator->vm, max_processes, config->working_set, config->frames);
+    simulator->swap = &simulator->devices[simulator->io_device_count];
+    device_create(simulator->swap, device_swap, config->fault_us, config->swap_concurrency,
+		  max_processes, simulator->id * 1000 + simulator->io_device_count, complete_swap, simulator);
+  }
+  
+  //every group id starts out free
+  simulator->groups = (ProcessGroupT*)checked_malloc(config->max_groups * sizeof(ProcessGroupT));
+  memset(simulator->groups, 0, config->max_groups * sizeof(ProcessGroupT));
+  blocking_queue_create(&simulator->group_queue);
+  for(unsigned int i = 0; i<config->max_groups; i++){
+    blocking_queue_push(&simulator->group_queue, i+1);
+  }
+  pthread_mutex_init(&simulator->group_lock, NULL);
   
   //init process table mutex
-  pthread_mutex_init(&table_lock, NULL);
+  pthread_mutex_init(&simulator->table_lock, NULL);
+  
+  //a waiting checkpoint goes before new batches, or it could wait forever
+  pthread_rwlockattr_t pause_attr;
+  pthread_rwlockattr_init(&pause_attr);
+  pthread_rwlockattr_setkind_np(&pause_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+  pthread_rwlock_init(&simulator->pause_lock, &pause_attr);
+  pthread_rwlockattr_destroy(&pause_attr);
+  pthread_mutex_init(&simulator->checkpoint_lock, NULL);
+  
+  //both before the workers, which record or replay from their first pick
+  if (config->trace[0] != '\0') {
+    char path[CONFIG_PATH_LENGTH + 12];
+    checkpoint_instance_path(config->trace, config, simulator->id, path, sizeof(path));
+    simulator->trace = trace_open(path, simulator);
+  }
+  simulator->replay = replay;
+  
+  //per worker counters, zeroed before the workers start
+  if (config->perf_counters) {
+    simulator->perf = (PerfT*)checked_malloc(thread_count * sizeof(PerfT));
+    memset(simulator->perf, 0, thread_count * sizeof(PerfT));
+  }
+  simulator->worker_metrics = (WorkerMetricsT*)checked_aligned_malloc(64, thread_count * sizeof(WorkerMetricsT));
+  memset(simulator->worker_metrics, 0, thread_count * sizeof(WorkerMetricsT));
   
   //unique thread ids
-  threads = (pthread_t*)checked_malloc(thread_count * sizeof(pthread_t));
-  thread_ids = (int*)checked_malloc(thread_count * sizeof(int));
+  simulator->threads = (pthread_t*)checked_malloc(thread_count * sizeof(pthread_t));
+  simulator->workers = (WorkerT*)checked_malloc(thread_count * sizeof(WorkerT));
   
   for(int i = 0; i<thread_count ; i++){
     //save thread id into array
-    thread_ids[i] = i+1; //plus 1 as ids start from 1
-    pthread_create( (&threads[i]), NULL, simulator_routine, &thread_ids[i]);
+    simulator->workers[i].simulator = simulator;
+    simulator->workers[i].id = i+1; //plus 1 as ids start from 1
+    sem_init(&simulator->workers[i].park, 0, 0);
+  }
+  sem_init(&simulator->progress, 0, 0);
+  
+  //the rest of the pool is only started under load
+  simulator->active_workers = config->simulator_threads;
+  simulator->scale.last_check = simulator->start_time;
+  simulator->scale.last_change = simulator->start_time;
+  simulator->scale.history[0].workers = config->simulator_threads;
+  simulator->scale.history_count = 1;
+  for(unsigned int i = 0; i<config->simulator_threads ; i++){
+    start_worker(simulator);
   }
   
   //populate queue with available process ids
   for(unsigned int i = 0; i<max_processes ; i++){
     ProcessIdT process_id = i+1;
-    blocking_queue_push(pid_queue,process_id);
+    blocking_queue_push(&simulator->pid_queue,process_id);
   }
   
+  return simulator;
+}
+
+void simulator_cpu_share(int instance, int instances, cpu_set_t* cpus) {
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  int const total = online > 0 ? online : 1;
+  int const share = total / instances > 0 ? total / instances : 1;
+  CPU_ZERO(cpus);
+  for (int i = 0; i < share; i++) {
+    CPU_SET((instance * share + i) % total, cpus);
+  }
+}
+
+void simulator_thread_attr(SimulatorT* simulator, pthread_attr_t* attr) {
+  pthread_attr_init(attr);
+  if (simulator->pinned) {
+    pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &simulator->cpus);
+  }
+}
+
+// Move a process between states unless it was killed in the meantime.
+// Whoever finds a killed process signals its waiter, so the pid is only
+// reused once it is out of every queue.
+static int transition(ProcessHotT* process, ProcessStateT from, ProcessStateT to) {
+  unsigned char expected = from;
+  return __atomic_compare_exchange_n(&process->state, &expected, to, 0,
+				     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// Hand a finished or killed process to its waiter - on a shard, an
+// adopted one is reported back to the shard it came from first
+static void signal_waiter(SimulatorT* simulator, ProcessIdT pid) {
+  process_table_signal(&simulator->process_table, pid);
+  simulator_progress(simulator);
+  ShardT* shard = __atomic_load_n(&simulator->shard, __ATOMIC_ACQUIRE);
+  if (shard != NULL) {
+    shard_finished(shard, pid);
+  }
+}
+
+// Single writer counters - a plain store is enough for lock free readers
+static void worker_record(unsigned long* counter, unsigned long amount) {
+  __atomic_store_n(counter, *counter + amount, __ATOMIC_RELAXED);
+}
+
+static void worker_record_double(double* counter, double amount) {
+  double const total = *counter + amount;
+  __atomic_store(counter, &total, __ATOMIC_RELAXED);
+}
+
+static unsigned int latency_bucket(uint64_t ns) {
+  unsigned int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+  return bucket < SIMULATOR_LATENCY_BUCKETS ? bucket : SIMULATOR_LATENCY_BUCKETS - 1;
+}
+
+// Count one call into the scheduling policy that started at since
+static void worker_decided(WorkerMetricsT* metrics, uint64_t since) {
+  worker_record(&metrics->decisions, 1);
+  worker_record(&metrics->sched_ns, process_table_now() - since);
 }
 
 void* simulator_routine(void *arg){
 
-  //retrieve identifier
-  int thread_id = *(int*)arg;
+  //retrieve simulator and identifier
+  WorkerT* worker = (WorkerT*)arg;
+  SimulatorT* simulator = worker->simulator;
+  int thread_id = worker->id;
   
-  char message[100];
-  snprintf(message , sizeof(message), "Thread %i has started" , thread_id);
-  logger_write(message);
+  LOG(log_debug, log_general, "Simulator %i - Thread %i has started", simulator->id, thread_id);
   
-  while(ready_queue->terminated == 0){ 
-    ProcessIdT pid;
-    
-    //break if not popped
-    if (blocking_queue_pop(ready_queue, &pid) != 0) {
-      break;
-    }
-
-    //fetch process struct
-    ProcessT* process = &process_table[pid - 1];
+  WorkerMetricsT* metrics = &simulator->worker_metrics[thread_id - 1];
+  evaluator_set_sleep_per_cpu_cycle(simulator->config.sleep_per_cpu_cycle);
+  evaluator_set_mode(simulator->config.evaluator);
+  
+  //a replaying worker only makes the calls it recorded
+  if (simulator->replay != NULL) {
+    trace_replay(simulator, thread_id, metrics);
+    return NULL;
+  }
+  
+  SchedulerOpsT const* scheduler = simulator->scheduler;
+  void* state = simulator->scheduler_state;
+  TraceT* trace = simulator->trace;
+  PerfT* perf = simulator->perf != NULL ? &simulator->perf[thread_id - 1] : NULL;
+  if (perf != NULL) perf_open(perf, perf_pick);
+  ProcessIdT batch[SIMULATOR_WORKER_BATCH];
+  ProcessIdT requeue[SIMULATOR_WORKER_BATCH];
+  EvaluatorResultT results[SIMULATOR_WORKER_BATCH];
+  
+  while(!__atomic_load_n(&simulator->stopping, __ATOMIC_ACQUIRE)){ 
     
-    //in the cases process entry has been erased
-    if (process == NULL) {
+    //a worker past the pool size parks until it grows again
+    if (thread_id > __atomic_load_n(&simulator->active_workers, __ATOMIC_ACQUIRE)) {
+      perf_mark(perf, perf_idle);
+      while (sem_wait(&worker->park) != 0) ;
       continue;
     }
     
-    //skip process if terminated
-    if(process->state == terminated){
-      continue;
+    //take a batch of pids, only the decision counts as overhead - not
+    //the time spent waiting for something to become runnable
+    perf_mark(perf, perf_pick);
+    uint64_t const picking = process_table_now();
+    size_t popped = scheduler->try_pick(state, batch, SIMULATOR_WORKER_BATCH);
+    uint64_t const tried = process_table_now();
+    if (popped == 0) {
+      //break if none popped once stopped
+      perf_mark(perf, perf_idle);
+      popped = scheduler->pick_next(state, batch, SIMULATOR_WORKER_BATCH);
+      if (popped == 0) {
+	break;
+      }
     }
+    //a decision is a pick that handed out processes - empty polls of an
+    //idle queue would swell the count and shrink its mean cost. A pick
+    //that had to wait is charged the poll before it, not the wait.
+    worker_record(&metrics->decisions, 1);
+    worker_record(&metrics->sched_ns, tried - picking);
+    trace_record(trace, trace_pick, thread_id, batch, NULL, popped);
     
-    if (process->eval_code.implementation == NULL) {
-      process->state = terminated;
-      sem_post(&process->semaphore);
-      continue;
-    }
+    size_t requeued = 0;
     
-    //run the process 
-    EvaluatorResultT result = evaluator_evaluate(process->eval_code, process->pc);
+    //a checkpoint waits for the batch rather than see it half done
+    pthread_rwlock_rdlock(&simulator->pause_lock);
     
-    if(result.reason == reason_terminated){
-      //process finished
-      process->completed = 1;
-      process->state = terminated;
-      sem_post(&process->semaphore);
+    for (size_t i = 0; i < popped; i++) {
+      ProcessIdT const pid = batch[i];
+      perf_mark(perf, perf_table);
+      
+      //fetch hot fields of the process
+      ProcessHotT* process = process_table_hot(&simulator->process_table, pid);
+      
+      //skip process if killed, it has left the queues so the waiter can reuse it
+      if(!transition(process, ready, running)){
+	signal_waiter(simulator, pid);
+	continue;
+      }
+      process_table_touch(&simulator->process_table, pid);
+      
+      if (process->eval_code.implementation == NULL) {
+	process->state = terminated;
+	signal_waiter(simulator, pid);
+	continue;
+      }
+      
+      //hold the process back until its group's next quota period
+      GroupIdT const group_id = __atomic_load_n(&simulator->process_table.group[pid - 1], __ATOMIC_ACQUIRE);
+      ProcessGroupT* group = group_id ? &simulator->groups[group_id - 1] : NULL;
+      if (group != NULL && process_group_throttled(group)) {
+	if (transition(process, running, blocked)) {
+	  __atomic_fetch_add(&simulator->throttles, 1, __ATOMIC_RELAXED);
+	  mpsc_queue_push(&group->throttled, process_table_event_node(&simulator->process_table, pid));
+	} else {
+	  signal_waiter(simulator, pid); //killed meanwhile
+	}
+	continue;
+      }
+      
+      //a busier shard hands the process to a quieter one instead
+      ShardT* shard = __atomic_load_n(&simulator->shard, __ATOMIC_ACQUIRE);
+      if (shard != NULL && shard_migrate(shard, pid)) {
+	continue;
+      }
+      
+      //time spent waiting in the ready queue
+      uint64_t const dispatched = process_table_now();
+      uint64_t const waited = dispatched - simulator->process_table.ready_since[pid - 1];
+      worker_record(&metrics->latency[latency_bucket(waited)], 1);
+      worker_record(&metrics->wait_ns, waited);
+      
+      //a step whose page is not resident faults instead of running, and
+      //runs again once swap has brought the page in and pinned it
+      int const faulted = simulator->vm != NULL && vm_touch(simulator->vm, pid, process->pc) != 0;
+      EvaluatorResultT result = { process->pc, 1, reason_blocked };
+      if (faulted) {
+	worker_record(&metrics->page_faults, 1);
+      } else {
+	//run the process 
+	perf_mark(perf, perf_evaluate);
+	result = evaluator_evaluate(process->eval_code, process->pc);
+	perf_mark(perf, perf_table);
+      }
+      simulator->process_table.dispatches[pid - 1]++;
+      simulator->process_table.cpu_time[pid - 1] += result.cpu_time;
       
-    }else if (result.reason == reason_timeslice_ended) {
-      //timeslice ended
-      process->pc = result.PC; //update process structs pc
-      process->state = ready;
-      blocking_queue_push(ready_queue, pid); //push pid back to ready queue
+      uint64_t const finished = process_table_now();
+      worker_record(&metrics->dispatches, 1);
+      worker_record(&metrics->busy_ns, finished - dispatched);
+      if (group != NULL) {
+	process_group_charge(group, finished - dispatched);
+      }
+      
+      if(result.reason == reason_terminated){
+	//process finished
+	simulator->process_table.completed[pid - 1] = 1;
+	worker_record(&metrics->exits, 1);
+	worker_record(&metrics->turnaround_ns, finished - simulator->process_table.created[pid - 1]);
+	
+	//weighted cpu cycles per millisecond in the system
+	int const nice = __atomic_load_n(&simulator->process_table.nice[pid - 1], __ATOMIC_RELAXED);
+	double const service = (double)simulator->process_table.cpu_time[pid - 1] * 1e6
+	  / (finished - simulator->process_table.created[pid - 1])
+	  * CFS_NICE_0_WEIGHT / cfs_nice_weight(nice);
+	worker_record_double(&metrics->service_sum, service);
+	worker_record_double(&metrics->service_squares, service * service);
+	perf_mark(perf, perf_requeue);
+	trace_record(trace, trace_exit, thread_id, &pid, &result, 1);
+	if (scheduler->on_exit != NULL) {
+	  uint64_t const deciding = process_table_now();
+	  scheduler->on_exit(state, pid, &result);
+	  worker_decided(metrics, deciding);
+	}
+	process->state = terminated;
+	signal_waiter(simulator, pid);
+	
+      }else if (result.reason == reason_timeslice_ended) {
+	//timeslice ended
+	simulator->process_table.ready_since[pid - 1] = finished;
+	process_table_write_begin(process);
+	process->pc = result.PC; //update process structs pc
+	int const requeueing = transition(process, running, ready);
+	process_table_write_end(process);
+	if (requeueing) {
+	  results[requeued] = result;
+	  requeue[requeued++] = pid; //push back to ready queue with the batch
+	} else {
+	  signal_waiter(simulator, pid); //killed while running
+	}
+      }
+      else if(result.reason == reason_blocked){
+	perf_mark(perf, perf_requeue);
+	trace_record(trace, trace_block, thread_id, &pid, &result, 1);
+	if (scheduler->on_block != NULL) {
+	  uint64_t const deciding = process_table_now();
+	  scheduler->on_block(state, pid, &result);
+	  worker_decided(metrics, deciding);
+	}
+	process_table_write_begin(process);
+	process->pc = result.PC;
+	int const blocking = transition(process, running, blocked);
+	process_table_write_end(process);
+	if (blocking) {
+	  //a process always uses the same device, like a file on one disk
+	  if (faulted) {
+	    device_submit(simulator->swap, &simulator->process_table, pid, finished);
+	  } else if (simulator->io_device_count > 0) {
+	    device_submit(&simulator->devices[pid % simulator->io_device_count],
+			  &simulator->process_table, pid, finished);
+	  } else {
+	    //push to event queue, no lock or allocation needed
+	    mpsc_queue_push(&simulator->event_queue, process_table_event_node(&simulator->process_table, pid));
+	  }
+	} else {
+	  signal_waiter(simulator, pid); //killed while running
+	}
+      }
     }
-    else if(result.reason == reason_blocked){
-      process->pc = result.PC; 
-      process->state = blocked; //update state
-      non_blocking_queue_push(event_queue, pid); //push to event queue
+    
+    //refill the ready queue in one go
+    perf_mark(perf, perf_requeue);
+    if (requeued > 0) {
+      uint64_t const deciding = process_table_now();
+      trace_record(trace, trace_preempt, thread_id, requeue, results, requeued);
+      scheduler->on_preempt(state, requeue, results, requeued);
+      worker_decided(metrics, deciding);
     }
+    pthread_rwlock_unlock(&simulator->pause_lock);
   }
   
   //finish thread
+  if (perf != NULL) perf_close(perf);
   return NULL;
 }
 
-void simulator_stop() {
-  
-  //terminate queues before joining 
-  blocking_queue_terminate(ready_queue);
+void simulator_stop(SimulatorT* simulator) {
   
-  //post to semaphore so sim wait can finish
-  sem_post(&ready_queue->queue_sem);
-  blocking_queue_terminate(pid_queue);
+  //stop the policy before joining, every worker blocked in a pick wakes
+  //parked workers are woken as well
+  __atomic_store_n(&simulator->stopping, 1, __ATOMIC_RELEASE);
+  int const started = __atomic_load_n(&simulator->started_workers, __ATOMIC_ACQUIRE);
+  for(int i=0; i<started; i++){
+    sem_post(&simulator->workers[i].park);
+  }
+  simulator->scheduler->terminate(simulator->scheduler_state, started);
+  blocking_queue_terminate(&simulator->pid_queue);
+  simulator_progress(simulator); //waiting clients give up once stopped
   
   //join each thread
-  for(int i=0; i<count; i++){
-    pthread_join(threads[i], NULL);
+  for(int i=0; i<started; i++){
+    pthread_join(simulator->threads[i], NULL);
+  }
+  for(int i=0; i<simulator->thread_count; i++){
+    sem_destroy(&simulator->workers[i].park);
+  }
+  sem_destroy(&simulator->progress);
+  
+  SimulatorMetricsT totals;
+  simulator_metrics(simulator, &totals);
+  LOG(log_info, log_general, "Simulator %i - %s policy, fairness index %.3f, mean turnaround %.3fms over %lu exits, %.0fns per decision",
+      simulator->id, simulator->best_effort->name, totals.fairness,
+      totals.mean_turnaround_ns / 1e6, totals.exits, totals.sched_ns_per_decision);
+  //only a spinning evaluator makes this the cost of scheduling real work
+  LOG(log_info, log_general, "Simulator %i - Scheduling overhead %.3f%% of %s evaluation time",
+      simulator->id, totals.overhead, evaluator_mode_names[simulator->config.evaluator]);
+  
+  //deadline outcomes, with how late the misses were
+  EdfStatsT const* realtime = &totals.realtime;
+  if (realtime->admitted + realtime->refused > 0) {
+    LOG(log_info, log_general, "Simulator %i - Real time: %lu admitted, %lu refused, %lu deadlines met, %lu missed",
+	simulator->id, realtime->admitted, realtime->refused, realtime->met, realtime->missed);
+    for (int b = 0; b < EDF_LATENESS_BUCKETS; b++) {
+      if (realtime->lateness[b] == 0) continue;
+      LOG(log_info, log_general, "Simulator %i - Late by under %luus: %lu",
+	  simulator->id, 1ul << b, realtime->lateness[b]);
+    }
+  }
+  checked_free(totals.workers);
+  
+  //where the workers' time went, the workers have closed their counters
+  if (simulator->perf != NULL) {
+    perf_report(simulator->id, simulator->perf, started);
+    checked_free(simulator->perf);
+  }
+  
+  //how the elastic pool was sized over time
+  if (simulator->thread_count > (int)simulator->config.simulator_threads) {
+    ScaleT* scale = &simulator->scale;
+    uint64_t const now = process_table_now();
+    double const worker_ns = scale->worker_ns + (double)simulator->active_workers * (now - scale->last_change);
+    LOG(log_info, log_pool, "Simulator %i - Worker pool: %.2f workers on average, %i started of at most %i",
+	simulator->id, worker_ns / (now - simulator->start_time), started, simulator->thread_count);
+    for (int i = 0; i < scale->history_count; i++) {
+      LOG(log_info, log_pool, "Simulator %i - Workers at %.3fs: %i",
+	  simulator->id, scale->history[i].at_ns / 1e9, scale->history[i].workers);
+    }
+  }
+  
+  //how often processes found their pages gone
+  if (simulator->vm != NULL) {
+    LOG(log_info, log_general, "Simulator %i - Virtual memory: %lu faults over %lu steps, %lu evictions from %u frames",
+	simulator->id, totals.page_faults, totals.dispatches, vm_evictions(simulator->vm), simulator->vm->frame_count);
+  }
+  
+  //how hard each device was driven and how long requests queued for it
+  for (int i = 0; i < simulator->device_count; i++) {
+    DeviceT* device = &simulator->devices[i];
+    DeviceStatsT stats;
+    device_stats(device, &stats);
+    LOG(log_info, log_general, "Simulator %i - Device %i (%s): %lu requests, %.1f%% utilised, %.3fms mean queueing, %lu most queued",
+	simulator->id, i, device_kind_names[device->kind], stats.completed,
+	device_utilisation(device, &stats, process_table_now()) * 100,
+	stats.started ? stats.queue_ns / 1e6 / stats.started : 0, stats.max_queued);
+    device_destroy(device);
   }
   
   //destroy and nullify queues
-  blocking_queue_destroy(pid_queue);
-  blocking_queue_destroy(ready_queue);
-  non_blocking_queue_destroy(event_queue);
+  blocking_queue_destroy(&simulator->pid_queue);
+  simulator->scheduler->destroy(simulator->scheduler_state);
+  mpsc_queue_destroy(&simulator->event_queue);
+  blocking_queue_destroy(&simulator->group_queue);
+  pthread_mutex_destroy(&simulator->group_lock);
   
   // Clean up allocated memory
-  checked_free(pid_queue);
-  checked_free(ready_queue);
-  checked_free(event_queue);
-  checked_free(threads);
-  checked_free(thread_ids);
-  checked_free(process_table);
-  pthread_mutex_destroy(&table_lock);
+  checked_free(simulator->threads);
+  checked_free(simulator->workers);
+  checked_free(simulator->worker_metrics);
+  checked_free(simulator->groups);
+  checked_free(simulator->devices);
+  if (simulator->vm != NULL) {
+    vm_destroy(simulator->vm);
+    checked_free(simulator->vm);
+  }
+  simulator_checkpoint_close(simulator);
+  if (simulator->trace != NULL) trace_close(simulator->trace);
+  if (simulator->replay != NULL) trace_replay_free(simulator->replay);
+  if (simulator->restored != NULL) checked_free(simulator->restored);
+  pthread_rwlock_destroy(&simulator->pause_lock);
+  pthread_mutex_destroy(&simulator->checkpoint_lock);
+  process_table_destroy(&simulator->process_table);
+  pthread_mutex_destroy(&simulator->table_lock);
+  checked_free(simulator);
  
 }
 
-ProcessIdT simulator_create_process(EvaluatorCodeT const code) {
+// Fill in a freshly allocated pid and make it runnable from pc, created
+// is 0 for now, deadline and share are 0 for best effort processes
+static ProcessIdT admit(SimulatorT* simulator, ProcessIdT pid, EvaluatorCodeT const code, unsigned int pc,
+			uint64_t created, uint64_t deadline_ns, unsigned int share, GroupIdT group) {
+  //save info about process
+  pthread_mutex_lock(&simulator->table_lock);
+  
+  ProcessHotT* process = process_table_hot(&simulator->process_table, pid);
+  process_table_write_begin(process);
+  process->eval_code = code;
+  process->pc = pc; //0 unless the process ran elsewhere before
+  process->state = ready;
+  process_table_write_end(process);
+  simulator->process_table.completed[pid - 1] = 0;
+  simulator->process_table.ready_since[pid - 1] = process_table_now();
+  simulator->process_table.created[pid - 1] = created ? created : simulator->process_table.ready_since[pid - 1];
+  simulator->process_table.deadline[pid - 1] = deadline_ns ? simulator->process_table.created[pid - 1] + deadline_ns : 0;
+  simulator->process_table.density[pid - 1] = share;
+  process_table_touch(&simulator->process_table, pid);
+  
+  pthread_mutex_unlock(&simulator->table_lock);
+  
+  //join the group before the first dispatch is charged
+  if (group != 0) {
+    process_group_add(&simulator->groups[group - 1], &simulator->process_table, pid);
+  }
+  
+  //hand the initialised process to the scheduling policy
+  trace_record_create(simulator->trace, pid, code, simulator->process_table.deadline[pid - 1]);
+  simulator->scheduler->enqueue(simulator->scheduler_state, &pid, 1);
+  
+  formatted_logger(simulator, log_create, pid, "Created");
+  
+  return pid;
+}
+
+ProcessIdT simulator_create_process(SimulatorT* simulator, EvaluatorCodeT const code) {
   ProcessIdT pid;
   
   //if no available ids then return -1
-  if(blocking_queue_pop(pid_queue,&pid) != 0){
+  if(blocking_queue_pop(&simulator->pid_queue,&pid) != 0){
     return -1;
   }
   
-  //save info about process
-  pthread_mutex_lock(&table_lock);
+  return admit(simulator, pid, code, 0, 0, 0, 0, 0);
+}
+
+ProcessIdT simulator_try_create_process(SimulatorT* simulator, EvaluatorCodeT const code) {
+  ProcessIdT pid;
   
-  ProcessT* process = &process_table[pid - 1]; 
-  process->pid = pid;
-  process->eval_code = code;
-  process->pc = 0; //pc always set to 0 when initialising process
-  process->completed = 0;
-  process->state = ready;
+  //every pid is in use, the caller retries later
+  if(blocking_queue_try_pop(&simulator->pid_queue,&pid) != 0){
+    return 0;
+  }
   
-  pthread_mutex_unlock(&table_lock);
+  return admit(simulator, pid, code, 0, 0, 0, 0, 0);
+}
+
+ProcessIdT simulator_try_reserve_pid(SimulatorT* simulator) {
+  ProcessIdT pid;
+  if(blocking_queue_try_pop(&simulator->pid_queue,&pid) != 0){
+    return 0;
+  }
+  return pid;
+}
+
+void simulator_adopt_process(SimulatorT* simulator, ProcessIdT pid, EvaluatorCodeT const code, unsigned int pc,
+			     uint64_t created, int nice, uint64_t cpu_time) {
+  //cfs weighs the process by its nice value from the first enqueue
+  simulator->process_table.nice[pid - 1] = nice;
+  simulator->process_table.cpu_time[pid - 1] = cpu_time;
+  admit(simulator, pid, code, pc, created, 0, 0, 0);
+}
+
+// Reserve a share of the workers for code, 0 if it does not fit
+static unsigned int admit_realtime(SimulatorT* simulator, EvaluatorCodeT const code,
+				   unsigned int deadline_us, unsigned int period_us) {
+  EdfT* edf = (EdfT*)simulator->scheduler_state;
+  unsigned int const steps = evaluator_remaining_steps(code, 0);
+  if (steps == EVALUATOR_UNKNOWN_STEPS) {
+    __atomic_fetch_add(&edf->stats.refused, 1, __ATOMIC_RELAXED);
+    return 0;
+  }
   
-  //init the semaphore
-  sem_init(&process->semaphore, 0, 0);
+  //no step uses more than a full time slice
+  uint64_t const runtime_ns = (uint64_t)steps * TIME_SLICE_LENGTH * simulator->config.sleep_per_cpu_cycle * 1000;
+  return edf_admit(edf, runtime_ns, deadline_us * 1000ull, period_us * 1000ull);
+}
+
+ProcessIdT simulator_create_realtime_process(SimulatorT* simulator, EvaluatorCodeT const code,
+					     unsigned int deadline_us, unsigned int period_us) {
+  unsigned int const share = admit_realtime(simulator, code, deadline_us, period_us);
+  if (share == 0) {
+    return 0;
+  }
   
-  //add initialised process id to ready queue
-  blocking_queue_push(ready_queue, pid);
+  ProcessIdT pid;
+  if(blocking_queue_pop(&simulator->pid_queue,&pid) != 0){
+    edf_release((EdfT*)simulator->scheduler_state, share);
+    return -1;
+  }
   
-  formatted_logger(pid , "Created");
+  return admit(simulator, pid, code, 0, 0, deadline_us * 1000ull, share, 0);
+}
+
+ProcessIdT simulator_try_create_realtime_process(SimulatorT* simulator, EvaluatorCodeT const code,
+						 unsigned int deadline_us, unsigned int period_us) {
+  return simulator_try_create_realtime_process_in_group(simulator, 0, code, deadline_us, period_us);
+}
+
+ProcessIdT simulator_try_create_realtime_process_in_group(SimulatorT* simulator, GroupIdT group,
+							  EvaluatorCodeT const code,
+							  unsigned int deadline_us, unsigned int period_us) {
+  unsigned int const share = admit_realtime(simulator, code, deadline_us, period_us);
+  if (share == 0) {
+    return 0;
+  }
   
-  return pid;
+  ProcessIdT pid;
+  if(blocking_queue_try_pop(&simulator->pid_queue,&pid) != 0){
+    edf_release((EdfT*)simulator->scheduler_state, share);
+    return 0;
+  }
   
+  return admit(simulator, pid, code, 0, 0, deadline_us * 1000ull, share, group);
 }
 
-void simulator_wait(ProcessIdT pid) {
-  //retrieve from pcb
-  ProcessT* process = &process_table[pid - 1];
+ProcessIdT simulator_create_process_in_group(SimulatorT* simulator, GroupIdT group, EvaluatorCodeT const code) {
+  ProcessIdT pid;
+  if(blocking_queue_pop(&simulator->pid_queue,&pid) != 0){
+    return -1;
+  }
   
-  // Log that we are waiting for the process
-  formatted_logger(pid,"Waiting to finish");
+  return admit(simulator, pid, code, 0, 0, 0, 0, group);
+}
+
+ProcessIdT simulator_try_create_process_in_group(SimulatorT* simulator, GroupIdT group, EvaluatorCodeT const code) {
+  ProcessIdT pid;
+  if(blocking_queue_try_pop(&simulator->pid_queue,&pid) != 0){
+    return 0;
+  }
   
-  //wait for process to finish
-  pthread_mutex_lock(&table_lock);
+  return admit(simulator, pid, code, 0, 0, 0, 0, group);
+}
+
+// Release a finished pid for reuse
+static void reap(SimulatorT* simulator, ProcessIdT pid) {
+  pthread_rwlock_rdlock(&simulator->pause_lock);
   
-  if (process->state == terminated) {
-    pthread_mutex_unlock(&table_lock);
-    
-    // directly clean up the terminated process without waiting
-    sem_destroy(&process->semaphore);
-    memset(process, 0, sizeof(ProcessT));
-    return;
+  //leave the group so waiting for it moves on
+  GroupIdT const group = simulator->process_table.group[pid - 1];
+  if (group != 0) {
+    process_group_remove(&simulator->groups[group - 1], &simulator->process_table, pid);
   }
   
-  //post in the case ready queue is terminated
-  if(ready_queue->terminated == 1)
+  //give back what admission reserved for a real time process
+  unsigned int const share = simulator->process_table.density[pid - 1];
+  if (share > 0) {
+    edf_release((EdfT*)simulator->scheduler_state, share);
+  }
+  
+  //its frames go to whoever faults next
+  if (simulator->vm != NULL) {
+    vm_release(simulator->vm, pid);
+  }
+  
+  //clear entry in process table
+  process_table_clear(&simulator->process_table, pid);
+  process_table_touch(&simulator->process_table, pid);
+  pthread_rwlock_unlock(&simulator->pause_lock);
+  
+  //reuse pid by adding back to pid queue
+  blocking_queue_push(&simulator->pid_queue, pid);
+  simulator_progress(simulator);
+}
+
+void simulator_wait(SimulatorT* simulator, ProcessIdT pid) {
+  // Log that we are waiting for the process
+  formatted_logger(simulator, log_wait, pid, "Waiting to finish");
+  
+  //wait for process to finish
+  pthread_mutex_lock(&simulator->table_lock);
+  
+  //post in the case the simulator is stopping
+  if(__atomic_load_n(&simulator->stopping, __ATOMIC_ACQUIRE))
   {
-    sem_post(&process->semaphore);
+    process_table_signal(&simulator->process_table, pid);
   }
   
-  pthread_mutex_unlock(&table_lock);
+  pthread_mutex_unlock(&simulator->table_lock);
   
   //wait for process to terminate
-  sem_wait(&process->semaphore);
+  process_table_wait(&simulator->process_table, pid);
   
-  sem_destroy(&process->semaphore);
+  reap(simulator, pid);
+}
+
+int simulator_try_wait(SimulatorT* simulator, ProcessIdT pid) {
+  //a stopped simulator will never finish the process
+  if (!process_table_signalled(&simulator->process_table, pid) &&
+      !__atomic_load_n(&simulator->stopping, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
   
-  //clear entry in process table
-  memset(process, 0, sizeof(ProcessT));
+  reap(simulator, pid);
+  return 1;
+}
+
+void simulator_progress(SimulatorT* simulator) {
+  __atomic_fetch_add(&simulator->progress_count, 1, __ATOMIC_SEQ_CST);
+  //a post for each thread asleep, one that has not gone to sleep yet
+  //sees the count move instead
+  for (int sleepers = __atomic_load_n(&simulator->progress_sleepers, __ATOMIC_SEQ_CST); sleepers > 0; sleepers--) {
+    sem_post(&simulator->progress);
+  }
+}
+
+unsigned int simulator_progress_seen(SimulatorT* simulator) {
+  return __atomic_load_n(&simulator->progress_count, __ATOMIC_SEQ_CST);
+}
+
+void simulator_wait_progress(SimulatorT* simulator, unsigned int seen, BlockingQueueWaitT const* wait,
+			     unsigned int* spin_budget, BlockingQueueStatsT* stats) {
+  __atomic_fetch_add(&simulator->progress_sleepers, 1, __ATOMIC_SEQ_CST);
+  //posts meant for an earlier wait may be left over, so check the count
+  while (__atomic_load_n(&simulator->progress_count, __ATOMIC_SEQ_CST) == seen) {
+    blocking_queue_wait_on(&simulator->progress, wait, spin_budget, stats);
+  }
+  __atomic_fetch_sub(&simulator->progress_sleepers, 1, __ATOMIC_SEQ_CST);
+}
+
+void simulator_kill(SimulatorT* simulator, ProcessIdT pid) {
+
+  ProcessHotT* process = process_table_hot(&simulator->process_table, pid);
   
-  //reuse pid by adding back to pid queue
-  blocking_queue_push(pid_queue, pid);
+  pthread_mutex_lock(&simulator->table_lock);
+  
+  //set state unless already terminated, the worker or event thread that
+  //next sees the process signals the waiter
+  unsigned char state = __atomic_load_n(&process->state, __ATOMIC_ACQUIRE);
+  while(state != terminated && state != unallocated){
+    if(__atomic_compare_exchange_n(&process->state, &state, terminated, 0,
+				   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+      process_table_touch(&simulator->process_table, pid);
+      formatted_logger(simulator, log_kill, pid, "Killed");
+      break;
+    }
+  }
+  
+  pthread_mutex_unlock(&simulator->table_lock);
+  
+}
+
+// Make a blocked process ready, returns 0 if it was killed meanwhile
+// and has been handed to its waiter instead
+static int unblock(SimulatorT* simulator, ProcessIdT pid) {
+  simulator->process_table.ready_since[pid - 1] = process_table_now();
+  process_table_touch(&simulator->process_table, pid);
+  if (transition(process_table_hot(&simulator->process_table, pid), blocked, ready)) {
+    formatted_logger(simulator, log_unblock, pid, "Moved to ready queue");
+    return 1;
+  }
+  signal_waiter(simulator, pid); //killed while blocked
+  return 0;
+}
+
+// Make a detached list of blocked processes runnable again, a batch at
+// a time
+static void wake_all(SimulatorT* simulator, MpscNodeT* node) {
+  ProcessIdT pids[SIMULATOR_EVENT_BATCH];
+  size_t popped = 0;
+  
+  pthread_rwlock_rdlock(&simulator->pause_lock);
+  while (node != NULL) {
+    MpscNodeT* next = node->next;
+    ProcessIdT const pid = process_table_event_pid(&simulator->process_table, node);
+    if (unblock(simulator, pid)) {
+      pids[popped++] = pid;
+    }
+    
+    //move to ready queue to be evaluated, a batch at a time
+    if (popped == SIMULATOR_EVENT_BATCH || (next == NULL && popped > 0)) {
+      trace_record(simulator->trace, trace_wake, 0, pids, NULL, popped);
+      simulator->scheduler->on_wake(simulator->scheduler_state, pids, popped);
+      popped = 0;
+    }
+    node = next;
+  }
+  pthread_rwlock_unlock(&simulator->pause_lock);
+}
+
+// Hand the processes a device has finished with to the scheduler, called
+// from the device's thread
+static void complete_io(void* context, ProcessIdT const* pids, size_t count) {
+  SimulatorT* simulator = (SimulatorT*)context;
+  ProcessIdT woken[DEVICE_COMPLETION_BATCH];
+  size_t ready = 0;
+  pthread_rwlock_rdlock(&simulator->pause_lock);
+  for (size_t i = 0; i < count; i++) {
+    if (unblock(simulator, pids[i])) {
+      woken[ready++] = pids[i];
+    }
+  }
+  if (ready > 0) {
+    trace_record(simulator->trace, trace_wake, 0, woken, NULL, ready);
+    simulator->scheduler->on_wake(simulator->scheduler_state, woken, ready);
+  }
+  pthread_rwlock_unlock(&simulator->pause_lock);
+}
+
+// Map the pages swap has loaded and let their processes run - a process
+// whose page finds every frame pinned goes back to wait for one
+static void complete_swap(void* context, ProcessIdT const* pids, size_t count) {
+  SimulatorT* simulator = (SimulatorT*)context;
+  ProcessIdT loaded[DEVICE_COMPLETION_BATCH];
+  size_t ready = 0;
+  uint64_t const now = process_table_now();
+  for (size_t i = 0; i < count; i++) {
+    ProcessHotT* process = process_table_hot(&simulator->process_table, pids[i]);
+    //killed processes go straight on to their waiter
+    if (__atomic_load_n(&process->state, __ATOMIC_ACQUIRE) == blocked &&
+	vm_load(simulator->vm, pids[i], process->pc) != 0) {
+      device_submit(simulator->swap, &simulator->process_table, pids[i], now);
+      continue;
+    }
+    loaded[ready++] = pids[i];
+  }
+  if (ready > 0) {
+    complete_io(simulator, loaded, ready);
+  }
+}
+
+// Start new quota periods, letting throttled processes run again
+static void refill_groups(SimulatorT* simulator) {
+  uint64_t const now = process_table_now();
+  if (now < simulator->next_refill) return;
+  simulator->next_refill = now + SIMULATOR_REFILL_NS;
+  
+  pthread_mutex_lock(&simulator->group_lock);
+  for (unsigned int i = 0; i < simulator->config.max_groups; i++) {
+    ProcessGroupT* group = &simulator->groups[i];
+    if (group->id != 0 && process_group_refill(group, now)) {
+      wake_all(simulator, mpsc_queue_pop_all(&group->throttled));
+    }
+  }
+  pthread_mutex_unlock(&simulator->group_lock);
+}
+
+GroupIdT simulator_create_group(SimulatorT* simulator, unsigned int quota_us, unsigned int period_us) {
+  GroupIdT group;
+  if(blocking_queue_try_pop(&simulator->group_queue, &group) != 0){
+    return 0;
+  }
+  
+  pthread_mutex_lock(&simulator->group_lock);
+  process_group_create(&simulator->groups[group - 1], group, quota_us * 1000ull, period_us * 1000ull);
+  pthread_mutex_unlock(&simulator->group_lock);
+  return group;
+}
+
+void simulator_destroy_group(SimulatorT* simulator, GroupIdT group) {
+  pthread_mutex_lock(&simulator->group_lock);
+  process_group_destroy(&simulator->groups[group - 1]);
+  pthread_mutex_unlock(&simulator->group_lock);
+  blocking_queue_push(&simulator->group_queue, group);
+  simulator_progress(simulator);
+}
+
+void simulator_group_add(SimulatorT* simulator, GroupIdT group, ProcessIdT pid) {
+  process_group_add(&simulator->groups[group - 1], &simulator->process_table, pid);
+}
+
+void simulator_kill_group(SimulatorT* simulator, GroupIdT group) {
+  ProcessGroupT* members = &simulator->groups[group - 1];
+  //walking the links while killing would follow a member released and
+  //reused part way, so take the list in one go
+  size_t count;
+  ProcessIdT* pids = process_group_members(members, &simulator->process_table, &count);
+  for (size_t i = 0; i < count; i++) {
+    //skip any released since, the pid may belong to someone else by now
+    if (__atomic_load_n(&simulator->process_table.group[pids[i] - 1], __ATOMIC_ACQUIRE) == group) {
+      simulator_kill(simulator, pids[i]);
+    }
+  }
+  checked_free(pids);
+  
+  //throttled members would otherwise only be noticed next period
+  wake_all(simulator, mpsc_queue_pop_all(&members->throttled));
+}
+
+void simulator_wait_group(SimulatorT* simulator, GroupIdT group) {
+  ProcessIdT pid;
+  while ((pid = process_group_first(&simulator->groups[group - 1])) != 0) {
+    simulator_wait(simulator, pid);
+  }
 }
 
-void simulator_kill(ProcessIdT pid) {
+int simulator_try_wait_group(SimulatorT* simulator, GroupIdT group) {
+  ProcessGroupT* members = &simulator->groups[group - 1];
+  ProcessIdT pid = process_group_first(members);
+  while (pid != 0) {
+    //read the next member before pid is released
+    ProcessIdT const next = process_group_next(members, &simulator->process_table, pid);
+    if (!simulator_try_wait(simulator, pid)) {
+      return 0;
+    }
+    pid = next;
+  }
+  return 1;
+}
 
-  ProcessT* process = &process_table[pid - 1];
+void simulator_set_nice(SimulatorT* simulator, ProcessIdT pid, int nice) {
+  //read by the worker when it next charges the process
+  signed char const clamped = nice < -20 ? -20 : nice > 19 ? 19 : nice;
+  trace_record_nice(simulator->trace, pid, clamped);
+  __atomic_store_n(&simulator->process_table.nice[pid - 1], clamped, __ATOMIC_RELAXED);
+  process_table_touch(&simulator->process_table, pid);
+}
+
+// Grow the pool when work queues up and shrink it when workers sit idle,
+// one worker per window
+static void scale_pool(SimulatorT* simulator) {
+  ScaleT* scale = &simulator->scale;
+  int const minimum = simulator->config.simulator_threads;
+  uint64_t const now = process_table_now();
+  if (simulator->thread_count == minimum || now - scale->last_check < SIMULATOR_SCALE_NS) return;
+  uint64_t const window = now - scale->last_check;
+  scale->last_check = now;
+  
+  //totals since the previous window, read racily like simulator_metrics
+  unsigned long dispatches = 0;
+  unsigned long wait_ns = 0;
+  unsigned long busy_ns = 0;
+  for (int w = 0; w < simulator->thread_count; w++) {
+    dispatches += __atomic_load_n(&simulator->worker_metrics[w].dispatches, __ATOMIC_RELAXED);
+    wait_ns += __atomic_load_n(&simulator->worker_metrics[w].wait_ns, __ATOMIC_RELAXED);
+    busy_ns += __atomic_load_n(&simulator->worker_metrics[w].busy_ns, __ATOMIC_RELAXED);
+  }
+  unsigned long const dispatched = dispatches - scale->dispatches;
+  double const delay = dispatched ? (double)(wait_ns - scale->wait_ns) / dispatched : 0;
+  double const busy = (double)(busy_ns - scale->busy_ns) * 100;
+  scale->dispatches = dispatches;
+  scale->wait_ns = wait_ns;
+  scale->busy_ns = busy_ns;
   
-  pthread_mutex_lock(&table_lock);
+  int const active = simulator->active_workers;
+  size_t const depth = simulator->scheduler->length(simulator->scheduler_state);
+  int const grow = depth > (size_t)active * SIMULATOR_GROW_DEPTH || delay > SIMULATOR_GROW_DELAY_NS;
+  int const idle = depth == 0 && busy < (double)window * active * SIMULATOR_SHRINK_BUSY_PERCENT;
+  scale->busy_windows = grow ? scale->busy_windows + 1 : 0;
+  scale->idle_windows = idle ? scale->idle_windows + 1 : 0;
   
-  if(process->state != terminated){ //check not already terminated
-    //set state 
-    process->state = terminated;
-    formatted_logger(pid , "Killed");
+  int target = active;
+  if (scale->busy_windows >= SIMULATOR_GROW_WINDOWS && active < simulator->thread_count) {
+    target = active + 1;
+  } else if (scale->idle_windows >= SIMULATOR_SHRINK_WINDOWS && active > minimum) {
+    target = active - 1;
   }
+  if (target == active) return;
   
-  pthread_mutex_unlock(&table_lock);
+  //both counts start again, so every change waits out a full streak
+  scale->busy_windows = 0;
+  scale->idle_windows = 0;
+  scale->worker_ns += (double)active * (now - scale->last_change);
+  scale->last_change = now;
+  if (scale->history_count < SIMULATOR_SCALE_HISTORY) {
+    scale->history[scale->history_count].at_ns = now - simulator->start_time;
+    scale->history[scale->history_count].workers = target;
+    scale->history_count++;
+  }
+  
+  __atomic_store_n(&simulator->active_workers, target, __ATOMIC_RELEASE);
+  if (target > active) {
+    //reuse a parked worker before starting a new thread
+    if (target > simulator->started_workers) {
+      start_worker(simulator);
+    } else {
+      sem_post(&simulator->workers[target - 1].park);
+    }
+  }
   
+  LOG(log_info, log_pool, "Simulator %i - Workers %i -> %i, %zu ready, %.3fms mean delay",
+      simulator->id, active, target, depth, delay / 1e6);
+}
+
+// Write the periodic checkpoint when one is due
+static void save_checkpoint(SimulatorT* simulator) {
+  if (simulator->config.checkpoint[0] == '\0') return;
+  uint64_t const now = process_table_now();
+  if (now < simulator->next_checkpoint) return;
+  simulator->next_checkpoint = now + simulator->config.checkpoint_ms * 1000000ull;
+  
+  char path[CONFIG_PATH_LENGTH + 12];
+  checkpoint_instance_path(simulator->config.checkpoint, &simulator->config, simulator->id, path, sizeof(path));
+  simulator_checkpoint(simulator, path);
 }
 
 void* simulator_event(void *arg) {
-  useconds_t interval = *(useconds_t *)arg;
+  SimulatorT* simulator = (SimulatorT*)arg;
+  useconds_t interval = simulator->event_source.interval;
+  
+  //creations and wakes of a replay, what is left below finds nothing to do
+  if (simulator->replay != NULL) {
+    trace_replay(simulator, 0, NULL);
+  }
   
   //check event source is not terminated
-  while(!check_termination()){
+  while(!check_termination(simulator)){
     
     usleep(interval);
-    ProcessIdT pid;
     
-    //use non blocking queue as we're checking every interval
-    int result = non_blocking_queue_pop(event_queue, &pid);
+    //detach every blocked process in one atomic operation
+    wake_all(simulator, mpsc_queue_pop_all(&simulator->event_queue));
+    refill_groups(simulator);
+    scale_pool(simulator);
+    save_checkpoint(simulator);
+  }
+  
+  return NULL;
+}
+
+void* simulator_device(void* arg) {
+  DeviceT* device = (DeviceT*)arg;
+  SimulatorT* simulator = (SimulatorT*)device->context;
+  useconds_t const interval = simulator->event_source.interval;
+  
+  while (!check_termination(simulator)) {
+    uint64_t const now = process_table_now();
+    uint64_t const next = device_service(device, &simulator->process_table, now);
     
-    //in the case queue is empty 
-    if(result != 0){
-      continue;
+    //sleep until the next request finishes, looking for new ones at
+    //least every event source interval
+    useconds_t sleep = interval;
+    if (next != 0 && next > now && (next - now) / 1000 < sleep) {
+      sleep = (next - now) / 1000;
     }
-    
-    formatted_logger(pid, "Moved to ready queue");
-    
-    //move to ready queue to be evaluated
-    blocking_queue_push(ready_queue,pid);
-    
+    if (sleep > 0) usleep(sleep);
   }
   
   return NULL;
 }
 
-void formatted_logger(int id , const char* message)
-{
-  char log_msg[100];
-  snprintf(log_msg, sizeof(log_msg), "Process ID: %i - %s", id,message);
-  logger_write(log_msg);
+void simulator_metrics(SimulatorT* simulator, SimulatorMetricsT* metrics) {
+  memset(metrics, 0, sizeof(SimulatorMetricsT));
+  metrics->ready_depth = simulator->scheduler->length(simulator->scheduler_state);
+  metrics->event_depth = mpsc_queue_length(&simulator->event_queue);
+  metrics->uptime_ns = process_table_now() - simulator->start_time;
+  
+  //states are single bytes, read racily rather than stalling the table
+  for (unsigned int i = 0; i < simulator->process_table.size; i++) {
+    unsigned char state = __atomic_load_n(&simulator->process_table.hot[i].state, __ATOMIC_RELAXED);
+    if (state <= terminated) metrics->processes[state]++;
+  }
+  
+  int const count = simulator->thread_count;
+  double sum = 0;
+  double squares = 0;
+  double turnaround = 0;
+  unsigned long decisions = 0;
+  unsigned long sched_ns = 0;
+  unsigned long busy_ns = 0;
+  metrics->worker_count = count;
+  metrics->active_workers = __atomic_load_n(&simulator->active_workers, __ATOMIC_RELAXED);
+  metrics->workers = (WorkerMetricsT*)checked_aligned_malloc(64, count * sizeof(WorkerMetricsT));
+  for (int w = 0; w < count; w++) {
+    WorkerMetricsT* copy = &metrics->workers[w];
+    copy->dispatches = __atomic_load_n(&simulator->worker_metrics[w].dispatches, __ATOMIC_RELAXED);
+    copy->busy_ns = __atomic_load_n(&simulator->worker_metrics[w].busy_ns, __ATOMIC_RELAXED);
+    copy->wait_ns = __atomic_load_n(&simulator->worker_metrics[w].wait_ns, __ATOMIC_RELAXED);
+    for (int b = 0; b < SIMULATOR_LATENCY_BUCKETS; b++) {
+      copy->latency[b] = __atomic_load_n(&simulator->worker_metrics[w].latency[b], __ATOMIC_RELAXED);
+    }
+    copy->exits = __atomic_load_n(&simulator->worker_metrics[w].exits, __ATOMIC_RELAXED);
+    copy->turnaround_ns = __atomic_load_n(&simulator->worker_metrics[w].turnaround_ns, __ATOMIC_RELAXED);
+    copy->decisions = __atomic_load_n(&simulator->worker_metrics[w].decisions, __ATOMIC_RELAXED);
+    copy->sched_ns = __atomic_load_n(&simulator->worker_metrics[w].sched_ns, __ATOMIC_RELAXED);
+    copy->page_faults = __atomic_load_n(&simulator->worker_metrics[w].page_faults, __ATOMIC_RELAXED);
+    __atomic_load(&simulator->worker_metrics[w].service_sum, &copy->service_sum, __ATOMIC_RELAXED);
+    __atomic_load(&simulator->worker_metrics[w].service_squares, &copy->service_squares, __ATOMIC_RELAXED);
+    //what a restored simulator had done before shows up as the first worker's
+    if (w == 0) {
+      simulator_worker_metrics_add(copy, &simulator->carried);
+    }
+    turnaround += copy->turnaround_ns;
+    decisions += copy->decisions;
+    sched_ns += copy->sched_ns;
+    busy_ns += copy->busy_ns;
+    metrics->dispatches += copy->dispatches;
+    metrics->exits += copy->exits;
+    metrics->page_faults += copy->page_faults;
+    sum += copy->service_sum;
+    squares += copy->service_squares;
+  }
+  
+  metrics->mean_turnaround_ns = metrics->exits ? turnaround / metrics->exits : 0;
+  metrics->sched_ns_per_decision = decisions ? (double)sched_ns / decisions : 0;
+  metrics->overhead = busy_ns ? 100.0 * sched_ns / busy_ns : 0;
+  edf_stats((EdfT*)simulator->scheduler_state, &metrics->realtime);
+  metrics->throttles = __atomic_load_n(&simulator->throttles, __ATOMIC_RELAXED);
+  
+  //jain's index, (sum x)^2 / (n * sum x^2)
+  metrics->fairness = squares > 0 ? sum * sum / (metrics->exits * squares) : 1;
+}
+
+void simulator_snapshot(SimulatorT* simulator, SimulatorSnapshotT* snapshot) {
+  //the table never changes size, so one buffer always fits
+  if (snapshot->processes == NULL) {
+    snapshot->processes = (ProcessSnapshotT*)checked_malloc(simulator->process_table.size * sizeof(ProcessSnapshotT));
+  }
+  snapshot->taken_ns = process_table_now() - simulator->start_time;
+  snapshot->count = process_table_snapshot(&simulator->process_table, snapshot->processes);
+}
+
+void simulator_snapshot_free(SimulatorSnapshotT* snapshot) {
+  if (snapshot->processes != NULL) checked_free(snapshot->processes);
+  snapshot->processes = NULL;
+  snapshot->count = 0;
+}
+
+void simulator_worker_metrics_add(WorkerMetricsT* into, WorkerMetricsT const* from) {
+  into->dispatches += from->dispatches;
+  into->exits += from->exits;
+  into->busy_ns += from->busy_ns;
+  into->wait_ns += from->wait_ns;
+  into->turnaround_ns += from->turnaround_ns;
+  into->decisions += from->decisions;
+  into->sched_ns += from->sched_ns;
+  into->page_faults += from->page_faults;
+  for (int b = 0; b < SIMULATOR_LATENCY_BUCKETS; b++) {
+    into->latency[b] += from->latency[b];
+  }
+  into->service_sum += from->service_sum;
+  into->service_squares += from->service_squares;
+}
+
+unsigned long simulator_latency_percentile(SimulatorMetricsT const* metrics, double fraction) {
+  unsigned long total = 0;
+  unsigned long buckets[SIMULATOR_LATENCY_BUCKETS] = { 0 };
+  for (int w = 0; w < metrics->worker_count; w++) {
+    for (int b = 0; b < SIMULATOR_LATENCY_BUCKETS; b++) {
+      buckets[b] += metrics->workers[w].latency[b];
+      total += metrics->workers[w].latency[b];
+    }
+  }
+  if (total == 0) return 0;
+  
+  //report the upper bound of the bucket holding the percentile
+  unsigned long const target = (unsigned long)(fraction * total);
+  unsigned long seen = 0;
+  for (int b = 0; b < SIMULATOR_LATENCY_BUCKETS; b++) {
+    seen += buckets[b];
+    if (seen > target) return 1ul << b;
+  }
+  return 1ul << (SIMULATOR_LATENCY_BUCKETS - 1);
 }
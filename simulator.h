@@ -4,36 +4,246 @@
 #include "evaluator.h"
 #include <stddef.h>
 #include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
 #include "blocking_queue.h"
+#include "mpsc_queue.h"
+#include "process_table.h"
+#include "event_source.h"
+#include "config.h"
+#include "scheduler.h"
+#include "edf.h"
+#include "process_group.h"
+#include "device.h"
+#include "logger.h"
+#include "perf.h"
+#include "vm.h"
 
-typedef unsigned int ProcessIdT;
-
-typedef enum ProcessState {
-  unallocated,
-  ready,
-  running,
-  blocked,
-  terminated
-} ProcessStateT;
-
-typedef struct Process {
-  int pid;
-  EvaluatorCodeT eval_code; 
-  unsigned int pc; //program counter
-  int completed;  //flag to check if process is finished 
-  sem_t semaphore; 
-  ProcessStateT state;
-}ProcessT;
-
-void simulator_start(int threads, int max_processes);
-void simulator_stop();
-
-ProcessIdT simulator_create_process(EvaluatorCodeT const code);
-void simulator_wait(ProcessIdT pid);
-void simulator_kill(ProcessIdT pid);
+//power of two nanosecond buckets for dispatch latency
+#define SIMULATOR_LATENCY_BUCKETS 40
+
+//worker count changes remembered for the report at stop
+#define SIMULATOR_SCALE_HISTORY 256
+
+// Counters owned by one worker - only that worker writes them
+typedef struct WorkerMetrics {
+  unsigned long dispatches;
+  unsigned long exits; //processes that ran to completion
+  unsigned long busy_ns; //time spent evaluating processes
+  unsigned long wait_ns; //ready to dispatch delay, summed over dispatches
+  unsigned long turnaround_ns; //creation to exit, summed over exits
+  unsigned long decisions; //calls into the scheduling policy, picks only when they handed out processes
+  unsigned long sched_ns; //time spent in those calls, blocking picks excluded
+  unsigned long page_faults; //steps that blocked on a page instead of running
+  unsigned long latency[SIMULATOR_LATENCY_BUCKETS]; //ready to dispatch delay
+  //weighted cpu share of each exited process, for the fairness index
+  double service_sum;
+  double service_squares;
+} __attribute__((aligned(64))) WorkerMetricsT;
+
+// Snapshot aggregated on demand without taking any simulator lock
+typedef struct SimulatorMetrics {
+  size_t ready_depth;
+  size_t event_depth;
+  unsigned int processes[terminated + 1]; //indexed by ProcessStateT
+  unsigned long dispatches;
+  unsigned long exits;
+  unsigned long uptime_ns;
+  double mean_turnaround_ns; //creation to exit, over exited processes
+  double fairness; //jain's index of weighted cpu share over exited processes, 1 is perfectly fair
+  double sched_ns_per_decision; //mean cost of a call into the scheduling policy
+  double overhead; //time in the scheduling policy per time evaluating, in percent
+  EdfStatsT realtime; //admission and deadline outcomes of real time processes
+  unsigned long throttles; //processes parked for running over their group's quota
+  unsigned long page_faults;
+  int worker_count;
+  int active_workers; //workers the elastic pool currently lets run
+  WorkerMetricsT* workers; //copy per worker, release with checked_free
+} SimulatorMetricsT;
+
+// Copy of the live processes taken without stopping the workers
+typedef struct SimulatorSnapshot {
+  uint64_t taken_ns; //when the copy started, from the simulator's start
+  size_t count;
+  ProcessSnapshotT* processes; //kept for the next snapshot, release with simulator_snapshot_free
+} SimulatorSnapshotT;
+
+struct Simulator;
+struct Checkpoint;
+struct Trace;
+struct TraceReplay;
+struct Shard;
+
+// Argument handed to each worker thread
+typedef struct Worker {
+  struct Simulator* simulator;
+  int id; //ids start from 1
+  sem_t park; //posted when the pool grows back past this worker
+} WorkerT;
+
+// One change of the worker count
+typedef struct ScaleEvent {
+  uint64_t at_ns; //since the simulator started
+  int workers;
+} ScaleEventT;
+
+// State of the elastic pool, only the event thread touches it
+typedef struct Scale {
+  uint64_t last_check;
+  unsigned long dispatches; //totals at the last check
+  unsigned long wait_ns;
+  unsigned long busy_ns;
+  int busy_windows; //consecutive checks over the grow threshold
+  int idle_windows; //consecutive checks under the shrink threshold
+  uint64_t last_change;
+  double worker_ns; //active workers integrated over time, up to last_change
+  int history_count;
+  ScaleEventT history[SIMULATOR_SCALE_HISTORY];
+} ScaleT;
+
+// Everything one simulator instance owns - instances share nothing, so
+// several can run side by side in one process
+typedef struct Simulator {
+  int id; //instance number, shown in log messages
+  ConfigT config; //copy of the settings it was started with
+  ProcessTableT process_table; //struct of arrays, hot fields kept apart
+  pthread_mutex_t table_lock;
+  BlockingQueueT pid_queue; //stores all initial max number of pids
+  SchedulerOpsT const* scheduler; //real time class, owns the runnable pids
+  void* scheduler_state; //EdfT
+  SchedulerOpsT const* best_effort; //policy for processes without a deadline
+  int stopping; //set once simulator_stop has begun
+  MpscQueueT event_queue; //workers push blocked processes, event thread pops
+  DeviceT* devices; //disks then networks, blocked processes go here when there are any
+  int device_count; //including swap
+  int io_device_count; //disks and networks, swap follows them
+  VmT* vm; //NULL without virtual memory
+  DeviceT* swap; //faulting processes wait here for their page
+  struct Shard* shard; //NULL unless this is one shard of a sharded run
+  ProcessGroupT* groups; //group id - 1 indexed, id 0 when not in use
+  BlockingQueueT group_queue; //group ids not in use
+  pthread_mutex_t group_lock; //held while groups are created, destroyed or refilled
+  uint64_t next_refill; //when the event thread next looks for a new quota period
+  unsigned long throttles; //processes parked over their group quota
+  EventSourceT event_source;
+  int thread_count; //most workers the pool may grow to
+  int started_workers; //threads created so far
+  int active_workers; //workers allowed to run, the rest are parked
+  ScaleT scale;
+  pthread_t* threads;
+  WorkerT* workers;
+  WorkerMetricsT* worker_metrics; //one cache line aligned entry per worker
+  WorkerMetricsT carried; //totals a restored simulator started from
+  pthread_rwlock_t pause_lock; //read while changing processes, written to checkpoint
+  pthread_mutex_t checkpoint_lock; //one checkpoint at a time
+  struct Checkpoint* checkpoint; //file of the last checkpoint, NULL before the first
+  uint64_t next_checkpoint; //when the event thread next takes one
+  ProcessIdT* restored; //processes brought back by simulator_restore
+  unsigned int restored_count;
+  struct Trace* trace; //policy calls are recorded here when not NULL
+  struct TraceReplay* replay; //recorded calls replayed instead of running processes
+  PerfT* perf; //counters per worker, NULL unless perf-counters is set
+  sem_t progress; //posted for each client thread asleep in simulator_wait_progress
+  unsigned int progress_count; //moves whenever a waiting client may get further
+  int progress_sleepers;
+  uint64_t start_time;
+  int pinned; //whether threads are bound to cpus
+  cpu_set_t cpus;
+} SimulatorT;
+
+// cpus may be NULL to leave the threads unpinned
+SimulatorT* simulator_start(ConfigT const* config, cpu_set_t const* cpus);
+// Same, with a best effort policy other than the configured built in one
+SimulatorT* simulator_start_policy(ConfigT const* config, cpu_set_t const* cpus, SchedulerOpsT const* scheduler);
+// Start a simulator whose workers and event thread make the calls of a
+// recorded trace, see trace_replay_config - it frees the replay on stop
+SimulatorT* simulator_start_replay(ConfigT const* config, cpu_set_t const* cpus, struct TraceReplay* replay);
+void simulator_stop(SimulatorT* simulator);
+
+ProcessIdT simulator_create_process(SimulatorT* simulator, EvaluatorCodeT const code);
+void simulator_wait(SimulatorT* simulator, ProcessIdT pid);
+// Non blocking versions for clients that cannot block their thread -
+// create returns 0 when every pid is in use, wait returns 1 once the
+// process has finished and its pid has been released
+ProcessIdT simulator_try_create_process(SimulatorT* simulator, EvaluatorCodeT const code);
+int simulator_try_wait(SimulatorT* simulator, ProcessIdT pid);
+// Those clients sleep between tries once none of them can get further. A
+// process finishing, a pid or group being freed or the simulator stopping
+// calls simulator_progress, which wakes them. Take the count before
+// trying, then wait for it to move past - spinning, yielding then parking
+// as an idle worker does.
+void simulator_progress(SimulatorT* simulator);
+unsigned int simulator_progress_seen(SimulatorT* simulator);
+void simulator_wait_progress(SimulatorT* simulator, unsigned int seen, BlockingQueueWaitT const* wait,
+			     unsigned int* spin_budget, BlockingQueueStatsT* stats);
+// Real time processes must finish within deadline_us of being created and
+// are run earliest deadline first, ahead of every best effort process.
+// period_us is the shortest time between two such processes of the same
+// task. Admission reserves the code's worst case cpu time over the
+// shorter of the two and returns 0 when the workers cannot fit it in, as
+// well as for code that never terminates - the try version also returns
+// 0 when every pid is in use.
+ProcessIdT simulator_create_realtime_process(SimulatorT* simulator, EvaluatorCodeT const code,
+					     unsigned int deadline_us, unsigned int period_us);
+ProcessIdT simulator_try_create_realtime_process(SimulatorT* simulator, EvaluatorCodeT const code,
+						 unsigned int deadline_us, unsigned int period_us);
+void simulator_kill(SimulatorT* simulator, ProcessIdT pid);
+// Take a free pid for simulator_adopt_process, 0 when every pid is in use
+ProcessIdT simulator_try_reserve_pid(SimulatorT* simulator);
+// Take in a best effort process that ran on another shard as the reserved
+// pid, carrying on from pc - created is on the monotonic clock every
+// process shares
+void simulator_adopt_process(SimulatorT* simulator, ProcessIdT pid, EvaluatorCodeT const code, unsigned int pc,
+			     uint64_t created, int nice, uint64_t cpu_time);
+
+// Process groups are killed and waited for with one call. quota_us of
+// worker time per period_us is shared by the members, which are held back
+// until the next period once it is used up - 0 for no quota. Returns 0
+// when every group is in use. A group is destroyed once empty.
+GroupIdT simulator_create_group(SimulatorT* simulator, unsigned int quota_us, unsigned int period_us);
+void simulator_destroy_group(SimulatorT* simulator, GroupIdT group);
+ProcessIdT simulator_create_process_in_group(SimulatorT* simulator, GroupIdT group, EvaluatorCodeT const code);
+ProcessIdT simulator_try_create_process_in_group(SimulatorT* simulator, GroupIdT group, EvaluatorCodeT const code);
+// Real time process that is a member from the start, 0 when refused or no
+// pid is free
+ProcessIdT simulator_try_create_realtime_process_in_group(SimulatorT* simulator, GroupIdT group,
+							  EvaluatorCodeT const code,
+							  unsigned int deadline_us, unsigned int period_us);
+// Move a process created outside any group into one
+void simulator_group_add(SimulatorT* simulator, GroupIdT group, ProcessIdT pid);
+void simulator_kill_group(SimulatorT* simulator, GroupIdT group);
+// Wait for every member and release their pids, leaving the group empty
+void simulator_wait_group(SimulatorT* simulator, GroupIdT group);
+// Non blocking version, releases finished members and returns 1 once empty
+int simulator_try_wait_group(SimulatorT* simulator, GroupIdT group);
+// Change the share of cpu a process gets under cfs, -20 (most) to 19 (least)
+void simulator_set_nice(SimulatorT* simulator, ProcessIdT pid, int nice);
 void *simulator_event(void *arg);
+// Services one DeviceT until the event source stops
+void *simulator_device(void *arg);
 void *simulator_routine(void *arg);
 void print_evaluator_result(EvaluatorResultT result);
-void formatted_logger(int id, const char* message);
+// Log a process event, nothing is formatted unless the filter lets it through
+#define formatted_logger(simulator, category, pid, message)		\
+  LOG(log_debug, category, "Simulator %i - Process ID: %i - %s", (simulator)->id, (int)(pid), message)
+
+// Give instance its own slice of the online cpus, wrapping when there are
+// more instances than cpus
+void simulator_cpu_share(int instance, int instances, cpu_set_t* cpus);
+
+// Attributes for threads that belong to the simulator, applying its cpu
+// binding - destroy with pthread_attr_destroy
+void simulator_thread_attr(SimulatorT* simulator, pthread_attr_t* attr);
+
+void simulator_metrics(SimulatorT* simulator, SimulatorMetricsT* metrics);
+// Copy the state and pc of every live process, each consistent on its own.
+// Start from a zeroed snapshot - taking another reuses its buffer, so a
+// monitor can poll a large table without allocating.
+void simulator_snapshot(SimulatorT* simulator, SimulatorSnapshotT* snapshot);
+void simulator_snapshot_free(SimulatorSnapshotT* snapshot);
+// Add every counter of from into into
+void simulator_worker_metrics_add(WorkerMetricsT* into, WorkerMetricsT const* from);
+// Latency below which the given fraction of dispatches fall, in nanoseconds
+unsigned long simulator_latency_percentile(SimulatorMetricsT const* metrics, double fraction);
 
 #endif
@@ -0,0 +1,174 @@
+#include "simulator.h"
+#include "event_source.h"
+#include "logger.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STEPS 41
+
+void test_snapshot_while_running() {
+  printf("testing snapshots of a running simulator reuse their buffer and never see half a change\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 2;
+  config.max_processes = 64;
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  event_source_start(simulator, config.event_source_interval);
+
+  ProcessIdT looping[16];
+  ProcessIdT blocking[16];
+  for (int i = 0; i < 16; i++) {
+    looping[i] = simulator_create_process(simulator, evaluator_infinite_loop);
+    blocking[i] = simulator_create_process(simulator, evaluator_blocking_terminates_after(STEPS));
+  }
+
+  SimulatorSnapshotT snapshot;
+  memset(&snapshot, 0, sizeof(snapshot));
+  simulator_snapshot(simulator, &snapshot);
+  ProcessSnapshotT* const buffer = snapshot.processes;
+  assert(buffer != NULL);
+  uint64_t taken = snapshot.taken_ns;
+  unsigned int last_pc[64 + 1] = { 0 };
+  for (int round = 0; round < 200; round++) {
+    simulator_snapshot(simulator, &snapshot);
+    assert(snapshot.processes == buffer);
+    assert(snapshot.taken_ns >= taken);
+    taken = snapshot.taken_ns;
+    assert(snapshot.count <= 32);
+    for (size_t i = 0; i < snapshot.count; i++) {
+      ProcessSnapshotT const* process = &snapshot.processes[i];
+      assert(process->pid >= 1 && process->pid <= 64);
+      assert(process->state != unallocated);
+      if (evaluator_code_id(process->eval_code) == evaluator_code_id(evaluator_infinite_loop)) {
+	assert(process->pc < 2);
+	continue;
+      }
+      //a blocking process only moves forwards, and blocks on odd steps
+      assert(process->eval_code.parameter == STEPS);
+      assert(process->pc <= STEPS);
+      assert(process->pc >= last_pc[process->pid]);
+      last_pc[process->pid] = process->pc;
+      if (process->state == blocked) {
+	assert(process->pc % 2 == 1);
+      }
+    }
+    usleep(500);
+  }
+
+  for (int i = 0; i < 16; i++) {
+    simulator_kill(simulator, looping[i]);
+  }
+  for (int i = 0; i < 16; i++) {
+    simulator_wait(simulator, looping[i]);
+    simulator_wait(simulator, blocking[i]);
+  }
+  //every process was released, the buffer is still the same
+  simulator_snapshot(simulator, &snapshot);
+  assert(snapshot.processes == buffer);
+  assert(snapshot.count == 0);
+  simulator_snapshot_free(&snapshot);
+  assert(snapshot.processes == NULL);
+
+  event_source_stop(simulator);
+  simulator_stop(simulator);
+}
+
+// Wait up to a few seconds for the pool to reach workers
+int pool_reaches(SimulatorT* simulator, int workers) {
+  for (int i = 0; i < 5000 && __atomic_load_n(&simulator->active_workers, __ATOMIC_ACQUIRE) != workers; i++) {
+    usleep(1000);
+  }
+  return __atomic_load_n(&simulator->active_workers, __ATOMIC_ACQUIRE) == workers;
+}
+
+// Every change moves one worker, in the given direction, a window or more apart
+void check_steps(ScaleT const* scale, int from, int to, int direction) {
+  for (int i = from + 1; i <= to; i++) {
+    assert(scale->history[i].workers == scale->history[i - 1].workers + direction);
+    assert(scale->history[i].at_ns - scale->history[i - 1].at_ns >= 10000000);
+  }
+}
+
+void test_pool_scales() {
+  printf("testing the pool grows a worker at a time under load and shrinks back when idle\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 1;
+  config.max_threads = 4;
+  config.max_processes = 64;
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  event_source_start(simulator, config.event_source_interval);
+  assert(simulator->active_workers == 1);
+  assert(simulator->scale.history_count == 1 && simulator->scale.history[0].workers == 1);
+
+  //far more runnable than one worker gets through
+  ProcessIdT pids[48];
+  for (int i = 0; i < 48; i++) {
+    pids[i] = simulator_create_process(simulator, evaluator_infinite_loop);
+  }
+  assert(pool_reaches(simulator, 4));
+  ScaleT const* scale = &simulator->scale;
+  assert(scale->history_count == 4);
+  check_steps(scale, 0, 3, 1);
+
+  //a steady load neither grows past the limit nor lets a worker go
+  usleep(300000);
+  assert(simulator->active_workers == 4);
+  assert(scale->history_count == 4);
+
+  for (int i = 0; i < 48; i++) {
+    simulator_kill(simulator, pids[i]);
+  }
+  for (int i = 0; i < 48; i++) {
+    simulator_wait(simulator, pids[i]);
+  }
+  //idle for long enough it goes back down to the configured size, no further
+  assert(pool_reaches(simulator, 1));
+  assert(scale->history_count == 7);
+  check_steps(scale, 3, 6, -1);
+  usleep(300000);
+  assert(simulator->active_workers == 1);
+  assert(scale->history_count == 7);
+
+  event_source_stop(simulator);
+  simulator_stop(simulator);
+}
+
+void test_fixed_pool() {
+  printf("testing a pool without a larger limit never scales\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 2;
+  config.max_processes = 64;
+  SimulatorT* simulator = simulator_start(&config, NULL);
+  event_source_start(simulator, config.event_source_interval);
+  ProcessIdT pids[48];
+  for (int i = 0; i < 48; i++) {
+    pids[i] = simulator_create_process(simulator, evaluator_infinite_loop);
+  }
+  usleep(100000);
+  assert(simulator->active_workers == 2);
+  assert(simulator->scale.history_count == 1);
+  for (int i = 0; i < 48; i++) {
+    simulator_kill(simulator, pids[i]);
+  }
+  for (int i = 0; i < 48; i++) {
+    simulator_wait(simulator, pids[i]);
+  }
+  event_source_stop(simulator);
+  simulator_stop(simulator);
+}
+
+int main() {
+  //per process events would bury the test output
+  logger_configure(log_warning, ~0u, 1);
+  logger_start();
+  test_snapshot_while_running();
+  test_pool_scales();
+  test_fixed_pool();
+  logger_stop();
+  return 0;
+}
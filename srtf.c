@@ -0,0 +1,90 @@
+#include "srtf.h"
+#include "scheduler.h"
+#include "simulator.h"
+#include "utilities.h"
+
+//keys are in 1/1024ths of a step so aging moves jobs smoothly
+#define SRTF_KEY_SCALE 1024
+
+void srtf_create(SrtfT* srtf, ProcessTableT* table, unsigned int aging_us, uint64_t start) {
+  priority_queue_create(&srtf->queue, table->size);
+  srtf->table = table;
+  srtf->start = start;
+  srtf->aging_us = aging_us > 0 ? aging_us : 1;
+}
+
+void srtf_destroy(SrtfT* srtf) {
+  priority_queue_destroy(&srtf->queue);
+}
+
+uint64_t srtf_key(SrtfT* srtf, EvaluatorCodeT const code, unsigned int PC, uint64_t ready_since) {
+  unsigned int remaining = evaluator_remaining_steps(code, PC);
+  if (remaining > SRTF_MAX_STEPS) remaining = SRTF_MAX_STEPS;
+
+  //a later arrival needs fewer steps left to go first, which is the same
+  //as ageing everyone already waiting
+  uint64_t const since = ready_since > srtf->start ? ready_since - srtf->start : 0;
+  uint64_t const waited = since * SRTF_KEY_SCALE / (srtf->aging_us * 1000ull);
+  return waited + (uint64_t)remaining * SRTF_KEY_SCALE;
+}
+
+// Key each process by the work it has left and queue it
+static void push(SrtfT* srtf, ProcessIdT const* pids, size_t n) {
+  uint64_t keys[n];
+  for (size_t i = 0; i < n; i++) {
+    ProcessHotT* process = process_table_hot(srtf->table, pids[i]);
+    keys[i] = srtf_key(srtf, process->eval_code, process->pc, srtf->table->ready_since[pids[i] - 1]);
+  }
+  priority_queue_push_many(&srtf->queue, pids, keys, n);
+}
+
+static void* policy_create(SimulatorT* simulator) {
+  SrtfT* srtf = (SrtfT*)checked_malloc(sizeof(SrtfT));
+  srtf_create(srtf, &simulator->process_table, simulator->config.aging_us, simulator->start_time);
+  return srtf;
+}
+
+static void policy_destroy(void* state) {
+  srtf_destroy((SrtfT*)state);
+  checked_free(state);
+}
+
+//one at a time, a shorter job may arrive while this one runs
+static size_t policy_try_pick(void* state, ProcessIdT* pids, size_t max) {
+  return priority_queue_try_pop_many(&((SrtfT*)state)->queue, pids, NULL, 1);
+}
+
+static size_t policy_pick_next(void* state, ProcessIdT* pids, size_t max) {
+  return priority_queue_pop_many(&((SrtfT*)state)->queue, pids, NULL, 1);
+}
+
+static void policy_on_preempt(void* state, ProcessIdT const* pids, EvaluatorResultT const* results, size_t n) {
+  push((SrtfT*)state, pids, n);
+}
+
+static void policy_requeue(void* state, ProcessIdT const* pids, size_t n) {
+  push((SrtfT*)state, pids, n);
+}
+
+static size_t policy_length(void* state) {
+  return priority_queue_length(&((SrtfT*)state)->queue);
+}
+
+static void policy_terminate(void* state, int waiters) {
+  priority_queue_terminate(&((SrtfT*)state)->queue);
+}
+
+SchedulerOpsT const scheduler_srtf = {
+  .name = "srtf",
+  .create = policy_create,
+  .destroy = policy_destroy,
+  .enqueue = policy_requeue,
+  .try_pick = policy_try_pick,
+  .pick_next = policy_pick_next,
+  .on_preempt = policy_on_preempt,
+  .on_block = NULL,
+  .on_wake = policy_requeue,
+  .on_exit = NULL,
+  .length = policy_length,
+  .terminate = policy_terminate,
+};
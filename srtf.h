@@ -0,0 +1,32 @@
+#ifndef _SRTF_H_
+#define _SRTF_H_
+
+#include "priority_queue.h"
+#include "process_table.h"
+#include "evaluator.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//code that never terminates is ranked as if it had this many steps left
+#define SRTF_MAX_STEPS 1000
+
+// Shortest remaining time first run queue. A process is keyed by the
+// steps it has left minus one step for every aging interval it has been
+// waiting, so long jobs move forward and cannot starve. Used through
+// scheduler_srtf.
+typedef struct Srtf {
+  PriorityQueueT queue;
+  ProcessTableT* table; //code and pc of every process
+  uint64_t start; //keys count time from here, in nanoseconds - the simulator's start
+  unsigned int aging_us; //waiting this long is worth one step
+} SrtfT;
+
+void srtf_create(SrtfT* srtf, ProcessTableT* table, unsigned int aging_us, uint64_t start);
+void srtf_destroy(SrtfT* srtf);
+
+// Run queue key for code about to run from PC, which became ready at
+// ready_since - taken from the process table rather than the clock, so a
+// replayed trace gets the keys it was recorded with
+uint64_t srtf_key(SrtfT* srtf, EvaluatorCodeT const code, unsigned int PC, uint64_t ready_since);
+
+#endif
@@ -0,0 +1,112 @@
+#include "srtf.h"
+#include "scheduler.h"
+#include "simulator.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MS 1000000ull
+
+SimulatorT simulator;
+ProcessTableT* table;
+void* srtf;
+
+// Just what the policy reads of a simulator, a step of aging per millisecond
+void setup() {
+  memset(&simulator, 0, sizeof(simulator));
+  config_defaults(&simulator.config);
+  simulator.config.aging_us = 1000;
+  simulator.start_time = 1000 * MS;
+  process_table_create(&simulator.process_table, 16);
+  table = &simulator.process_table;
+  srtf = scheduler_srtf.create(&simulator);
+}
+
+void teardown() {
+  scheduler_srtf.destroy(srtf);
+  process_table_destroy(&simulator.process_table);
+}
+
+// Make pid ready at the given time from the start, pc steps into code
+void make_ready(ProcessIdT pid, EvaluatorCodeT const code, unsigned int pc, uint64_t at) {
+  ProcessHotT* process = process_table_hot(table, pid);
+  process->eval_code = code;
+  process->pc = pc;
+  process->state = ready;
+  table->ready_since[pid - 1] = simulator.start_time + at;
+}
+
+void picks(ProcessIdT const* expected, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    //one at a time however many are asked for
+    ProcessIdT picked[4];
+    assert(scheduler_srtf.try_pick(srtf, picked, 4) == 1);
+    assert(picked[0] == expected[i]);
+  }
+  assert(scheduler_srtf.length(srtf) == 0);
+}
+
+void test_keys() {
+  printf("testing keys count steps left plus a step per aging interval\n");
+  setup();
+  SrtfT* state = (SrtfT*)srtf;
+  EvaluatorCodeT const code = evaluator_terminates_after(50);
+  uint64_t const start = simulator.start_time;
+  assert(srtf_key(state, code, 0, start) == srtf_key(state, code, 10, start) + 10 * 1024);
+  //a millisecond later is worth a step, half of one half a step
+  assert(srtf_key(state, code, 0, start + MS) == srtf_key(state, code, 0, start) + 1024);
+  assert(srtf_key(state, code, 0, start + MS / 2) == srtf_key(state, code, 0, start) + 512);
+  //ready before the start counts from it
+  assert(srtf_key(state, code, 0, start - MS) == srtf_key(state, code, 0, start));
+  //code that never ends is as long as the longest known job
+  assert(srtf_key(state, evaluator_infinite_loop, 0, start) ==
+	 srtf_key(state, evaluator_terminates_after(SRTF_MAX_STEPS), 0, start));
+  assert(srtf_key(state, evaluator_terminates_after(5 * SRTF_MAX_STEPS), 0, start) ==
+	 srtf_key(state, evaluator_infinite_loop, 0, start));
+  teardown();
+}
+
+void test_shortest_first() {
+  printf("testing processes ready together go by the steps they have left\n");
+  setup();
+  make_ready(1, evaluator_terminates_after(50), 0, 0);
+  make_ready(2, evaluator_terminates_after(5), 0, 0);
+  make_ready(3, evaluator_infinite_loop, 0, 0);
+  make_ready(4, evaluator_terminates_after(50), 47, 0);
+  ProcessIdT const pids[] = { 1, 2, 3, 4 };
+  scheduler_srtf.enqueue(srtf, pids, 4);
+  ProcessIdT const expected[] = { 4, 2, 1, 3 };
+  picks(expected, 4);
+  teardown();
+}
+
+void test_aging() {
+  printf("testing a long wait lets a long job overtake later short ones\n");
+  setup();
+  //50 steps from the start, ahead of 5 steps from 50ms on but not from 40ms
+  make_ready(1, evaluator_terminates_after(50), 0, 0);
+  make_ready(2, evaluator_terminates_after(5), 0, 40 * MS);
+  make_ready(3, evaluator_terminates_after(5), 0, 50 * MS);
+  ProcessIdT const pids[] = { 3, 1, 2 };
+  scheduler_srtf.enqueue(srtf, pids, 3);
+  ProcessIdT const expected[] = { 2, 1, 3 };
+  picks(expected, 3);
+
+  //requeued after running, its key counts from when it was ready again
+  make_ready(1, evaluator_terminates_after(50), 10, 60 * MS);
+  make_ready(2, evaluator_terminates_after(5), 0, 90 * MS);
+  EvaluatorResultT const results[] = { { 10, 1, reason_timeslice_ended } };
+  scheduler_srtf.on_preempt(srtf, pids + 1, results, 1);
+  scheduler_srtf.on_wake(srtf, pids + 2, 1);
+  ProcessIdT const again[] = { 2, 1 };
+  picks(again, 2);
+  teardown();
+}
+
+int main() {
+  test_keys();
+  test_shortest_first();
+  test_aging();
+  return 0;
+}
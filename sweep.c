@@ -0,0 +1,175 @@
+#include "sweep.h"
+#include "simulator.h"
+#include "environment.h"
+#include "event_source.h"
+#include "utilities.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// One configuration of the grid and what it measured
+typedef struct SweepPoint {
+  ConfigT config;
+  cpu_set_t cpus;
+  unsigned long exits;
+  unsigned long dispatches;
+  double seconds;
+  unsigned long p50_ns;
+  unsigned long p99_ns;
+  double turnaround_ns;
+  double fairness;
+  double sched_ns; //per decision
+  double overhead; //percent of evaluation time
+} SweepPointT;
+
+void sweep_create(SweepT* sweep, ConfigT const* base) {
+  memset(sweep, 0, sizeof(SweepT));
+  sweep->base = *base;
+}
+
+int sweep_add_axis(SweepT* sweep, char const* spec) {
+  if (sweep->axis_count == SWEEP_MAX_AXES) {
+    fprintf(stderr, "At most %i sweep axes\n", SWEEP_MAX_AXES);
+    return 1;
+  }
+
+  char const* equals = strchr(spec, '=');
+  if (equals == NULL || equals == spec || equals - spec >= SWEEP_VALUE_LENGTH) {
+    fprintf(stderr, "Expected key=value,value,... for sweep, got %s\n", spec);
+    return 1;
+  }
+
+  SweepAxisT* axis = &sweep->axes[sweep->axis_count];
+  memset(axis, 0, sizeof(SweepAxisT));
+  memcpy(axis->key, spec, equals - spec);
+
+  //each value must be accepted by the setting it sweeps
+  ConfigT scratch = sweep->base;
+  char const* value = equals + 1;
+  while (1) {
+    char const* comma = strchr(value, ',');
+    size_t const length = comma ? (size_t)(comma - value) : strlen(value);
+    if (length == 0 || length >= SWEEP_VALUE_LENGTH || axis->count == SWEEP_MAX_VALUES) {
+      fprintf(stderr, "Invalid sweep values for %s\n", axis->key);
+      return 1;
+    }
+    memcpy(axis->values[axis->count], value, length);
+    if (config_set(&scratch, axis->key, axis->values[axis->count]) != 0) {
+      return 1;
+    }
+    axis->count++;
+    if (comma == NULL) break;
+    value = comma + 1;
+  }
+
+  sweep->axis_count++;
+  return 0;
+}
+
+int sweep_point_count(SweepT const* sweep) {
+  int count = 1;
+  for (int a = 0; a < sweep->axis_count; a++) {
+    count *= sweep->axes[a].count;
+  }
+  return count;
+}
+
+// Value index of axis for point, the last axis varies fastest
+static int axis_value(SweepT const* sweep, int point, int axis) {
+  for (int a = sweep->axis_count - 1; a > axis; a--) {
+    point /= sweep->axes[a].count;
+  }
+  return point % sweep->axes[axis].count;
+}
+
+static void* sweep_point_routine(void* arg) {
+  SweepPointT* point = (SweepPointT*)arg;
+  ConfigT const* config = &point->config;
+  uint64_t const start = process_table_now();
+
+  SimulatorT* simulator = simulator_start(config, &point->cpus);
+  event_source_start(simulator, config->event_source_interval);
+  EnvironmentT* environment = environment_start(simulator);
+  environment_stop(environment);
+  point->seconds = (process_table_now() - start) / 1e9;
+  event_source_stop(simulator);
+
+  SimulatorMetricsT metrics;
+  simulator_metrics(simulator, &metrics);
+  point->exits = metrics.exits;
+  point->dispatches = metrics.dispatches;
+  point->p50_ns = simulator_latency_percentile(&metrics, 0.5);
+  point->p99_ns = simulator_latency_percentile(&metrics, 0.99);
+  point->turnaround_ns = metrics.mean_turnaround_ns;
+  point->fairness = metrics.fairness;
+  point->sched_ns = metrics.sched_ns_per_decision;
+  point->overhead = metrics.overhead;
+  checked_free(metrics.workers);
+
+  simulator_stop(simulator);
+  return NULL;
+}
+
+int sweep_run(SweepT* sweep, FILE* out) {
+  int const count = sweep_point_count(sweep);
+
+  //by default enough points to keep every cpu busy with the base thread count,
+  //never more at once than there are points
+  int parallel = sweep->parallel > (unsigned int)count ? count : (int)sweep->parallel;
+  if (parallel < 1) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    parallel = online / (long)sweep->base.simulator_threads;
+    if (parallel < 1) parallel = 1;
+  }
+
+  SweepPointT* points = (SweepPointT*)checked_malloc(count * sizeof(SweepPointT));
+  pthread_t* threads = (pthread_t*)checked_malloc(parallel * sizeof(pthread_t));
+
+  for (int p = 0; p < count; p++) {
+    memset(&points[p], 0, sizeof(SweepPointT));
+    points[p].config = sweep->base;
+    //a point is a single simulator, nothing else listens on the socket
+    points[p].config.instances = 1;
+    points[p].config.metrics_socket[0] = '\0';
+    for (int a = 0; a < sweep->axis_count; a++) {
+      config_set(&points[p].config, sweep->axes[a].key, sweep->axes[a].values[axis_value(sweep, p, a)]);
+    }
+  }
+
+  //run in waves, splitting the cpus between the points of a wave
+  for (int first = 0; first < count; first += parallel) {
+    int const wave = count - first < parallel ? count - first : parallel;
+    for (int i = 0; i < wave; i++) {
+      simulator_cpu_share(i, wave, &points[first + i].cpus);
+      pthread_create(&threads[i], NULL, sweep_point_routine, &points[first + i]);
+    }
+    for (int i = 0; i < wave; i++) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  //one row per point, swept settings first
+  for (int a = 0; a < sweep->axis_count; a++) {
+    fprintf(out, "%-20s ", sweep->axes[a].key);
+  }
+  fprintf(out, "%10s %12s %10s %14s %12s %12s %14s %9s %9s %10s\n",
+	  "exits", "dispatches", "seconds", "processes/s", "p50_us", "p99_us", "turnaround_ms", "fairness", "sched_ns",
+	  "overhead%");
+  for (int p = 0; p < count; p++) {
+    for (int a = 0; a < sweep->axis_count; a++) {
+      fprintf(out, "%-20s ", sweep->axes[a].values[axis_value(sweep, p, a)]);
+    }
+    SweepPointT const* point = &points[p];
+    fprintf(out, "%10lu %12lu %10.3f %14.1f %12.1f %12.1f %14.3f %9.3f %9.1f %10.3f\n",
+	    point->exits, point->dispatches, point->seconds,
+	    point->seconds > 0 ? point->exits / point->seconds : 0,
+	    point->p50_ns / 1e3, point->p99_ns / 1e3, point->turnaround_ns / 1e6, point->fairness,
+	    point->sched_ns, point->overhead);
+  }
+  fflush(out);
+
+  checked_free(threads);
+  checked_free(points);
+  return 0;
+}
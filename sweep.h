@@ -0,0 +1,37 @@
+#ifndef _SWEEP_H_
+#define _SWEEP_H_
+
+#include "config.h"
+#include <stdio.h>
+
+#define SWEEP_MAX_AXES 8
+#define SWEEP_MAX_VALUES 16
+#define SWEEP_VALUE_LENGTH 32
+
+// One swept setting and the values it takes
+typedef struct SweepAxis {
+  char key[SWEEP_VALUE_LENGTH];
+  int count;
+  char values[SWEEP_MAX_VALUES][SWEEP_VALUE_LENGTH];
+} SweepAxisT;
+
+// A grid of configurations - every combination of the axis values
+// applied on top of the base settings
+typedef struct Sweep {
+  ConfigT base;
+  int axis_count;
+  SweepAxisT axes[SWEEP_MAX_AXES];
+  unsigned int parallel; //points run at once, each on its own share of the cpus - 0 picks one from the cpu count
+} SweepT;
+
+void sweep_create(SweepT* sweep, ConfigT const* base);
+
+// Add an axis written as key=value,value,... returns 0 on success
+int sweep_add_axis(SweepT* sweep, char const* spec);
+
+int sweep_point_count(SweepT const* sweep);
+
+// Run every point and write one row per point to out, returns 0 on success
+int sweep_run(SweepT* sweep, FILE* out);
+
+#endif
@@ -0,0 +1,89 @@
+#include "sweep.h"
+#include "logger.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+void test_axes() {
+  printf("testing sweep axes take only values their setting accepts\n");
+  ConfigT config;
+  config_defaults(&config);
+  SweepT sweep;
+  sweep_create(&sweep, &config);
+  assert(sweep_point_count(&sweep) == 1);
+
+  assert(sweep_add_axis(&sweep, "threads=1,2,4") == 0);
+  assert(sweep.axis_count == 1 && sweep.axes[0].count == 3);
+  assert(strcmp(sweep.axes[0].key, "threads") == 0 && strcmp(sweep.axes[0].values[2], "4") == 0);
+  assert(sweep_add_axis(&sweep, "policy=rr,cfs") == 0);
+  assert(sweep_point_count(&sweep) == 6);
+
+  //a rejected axis is not added
+  assert(sweep_add_axis(&sweep, "threads") != 0);
+  assert(sweep_add_axis(&sweep, "=1,2") != 0);
+  assert(sweep_add_axis(&sweep, "threads=") != 0);
+  assert(sweep_add_axis(&sweep, "threads=1,,2") != 0);
+  assert(sweep_add_axis(&sweep, "threads=1,2,") != 0);
+  assert(sweep_add_axis(&sweep, "threads=1,0") != 0);
+  assert(sweep_add_axis(&sweep, "policy=rr,fifo") != 0);
+  assert(sweep_add_axis(&sweep, "no-such-setting=1") != 0);
+  assert(sweep_add_axis(&sweep, "threads=1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17") != 0);
+  assert(sweep_add_axis(&sweep, "threads=123456789012345678901234567890123") != 0);
+  assert(sweep.axis_count == 2 && sweep_point_count(&sweep) == 6);
+
+  while (sweep.axis_count < SWEEP_MAX_AXES) {
+    assert(sweep_add_axis(&sweep, "disks=0") == 0);
+  }
+  assert(sweep_add_axis(&sweep, "disks=0") != 0);
+  assert(sweep_point_count(&sweep) == 6);
+}
+
+void test_rows() {
+  printf("testing a sweep writes a row per point, the last axis varying fastest\n");
+  ConfigT config;
+  config_defaults(&config);
+  config.simulator_threads = 1;
+  config.environment_threads = 1;
+  config.environment_clients = 1;
+  config.iterations = 1;
+  config.batch_size = 1;
+  config.sleep_per_cpu_cycle = 0;
+  SweepT sweep;
+  sweep_create(&sweep, &config);
+  assert(sweep_add_axis(&sweep, "policy=rr,cfs") == 0);
+  assert(sweep_add_axis(&sweep, "max-processes=64,128,256") == 0);
+  //more at once than there are points runs them all in one wave
+  sweep.parallel = 100;
+
+  FILE* out = tmpfile();
+  assert(out != NULL);
+  assert(sweep_run(&sweep, out) == 0);
+  rewind(out);
+  char line[512];
+  assert(fgets(line, sizeof(line), out) != NULL);
+  assert(strncmp(line, "policy", 6) == 0);
+  char const* const policies[] = { "rr", "rr", "rr", "cfs", "cfs", "cfs" };
+  char const* const processes[] = { "64", "128", "256", "64", "128", "256" };
+  for (int p = 0; p < 6; p++) {
+    assert(fgets(line, sizeof(line), out) != NULL);
+    char policy[32], max_processes[32];
+    unsigned long exits;
+    assert(sscanf(line, "%31s %31s %lu", policy, max_processes, &exits) == 3);
+    assert(strcmp(policy, policies[p]) == 0);
+    assert(strcmp(max_processes, processes[p]) == 0);
+    assert(exits > 0);
+  }
+  assert(fgets(line, sizeof(line), out) == NULL);
+  fclose(out);
+}
+
+int main() {
+  //per process events would bury the test output
+  logger_configure(log_warning, ~0u, 1);
+  logger_start();
+  test_axes();
+  test_rows();
+  logger_stop();
+  return 0;
+}
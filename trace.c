@@ -0,0 +1,509 @@
+#include "trace.h"
+#include "utilities.h"
+#include "logger.h"
+
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static char const magic[8] = "SIMTRCE";
+
+_Static_assert(sizeof(TraceEventT) == 40, "trace events must keep their layout");
+
+char const* const trace_kind_names[trace_kind_count] = {
+  "create", "pick", "preempt", "block", "wake", "exit", "nice"
+};
+
+static unsigned long next_trace_id = 1;
+
+// Lane of the calling thread in the trace it last recorded to
+static __thread unsigned long lane_trace;
+static __thread TraceLaneT* lane;
+
+static void write_events(int fd, TraceEventT const* events, size_t count) {
+  size_t const bytes = count * sizeof(TraceEventT);
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t const written = write(fd, (char const*)events + done, bytes - done);
+    if (written < 0) {
+      perror("Failed to write trace");
+      break;
+    }
+    done += written;
+  }
+}
+
+// Write out every buffered event of a lane
+static void flush(TraceLaneT* lane) {
+  write_events(lane->fd, lane->events, lane->count);
+  lane->count = 0;
+}
+
+TraceT* trace_open(char const* path, SimulatorT* simulator) {
+  ConfigT const* config = &simulator->config;
+  int const fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("Failed to open trace");
+    return NULL;
+  }
+
+  TraceHeaderT header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = TRACE_VERSION;
+  header.workers = config->max_threads > config->simulator_threads ?
+    config->max_threads : config->simulator_threads;
+  header.max_processes = config->max_processes;
+  header.policy = config->policy;
+  if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+    perror("Failed to write trace");
+    close(fd);
+    return NULL;
+  }
+
+  TraceT* trace = (TraceT*)checked_malloc(sizeof(TraceT));
+  trace->fd = fd;
+  snprintf(trace->path, sizeof(trace->path), "%s", path);
+  trace->id = __atomic_fetch_add(&next_trace_id, 1, __ATOMIC_RELAXED);
+  pthread_mutex_init(&trace->lanes_lock, NULL);
+  trace->lanes = NULL;
+  trace->lane_count = 0;
+  trace->table = &simulator->process_table;
+  trace->start = simulator->start_time;
+  return trace;
+}
+
+// Lane of the calling thread, added on its first call
+static TraceLaneT* own_lane(TraceT* trace) {
+  if (lane_trace == trace->id) return lane;
+
+  TraceLaneT* added = (TraceLaneT*)checked_malloc(sizeof(TraceLaneT));
+  added->count = 0;
+  added->cursor = 0;
+  pthread_mutex_lock(&trace->lanes_lock);
+  //named after the trace, but gone as soon as it is open
+  char path[CONFIG_PATH_LENGTH + 24];
+  snprintf(path, sizeof(path), "%s.%i", trace->path, trace->lane_count++);
+  added->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (added->fd < 0) {
+    perror("Failed to open trace");
+  } else {
+    unlink(path);
+  }
+  added->next = trace->lanes;
+  trace->lanes = added;
+  pthread_mutex_unlock(&trace->lanes_lock);
+
+  lane_trace = trace->id;
+  lane = added;
+  return added;
+}
+
+// Make at least n events of the lane available from its cursor, reading
+// on from the spill file - returns how many there are
+static size_t refill(TraceLaneT* lane, size_t n) {
+  size_t available = lane->count - lane->cursor;
+  if (available >= n) return available;
+  memmove(lane->events, &lane->events[lane->cursor], available * sizeof(TraceEventT));
+  lane->cursor = 0;
+  size_t done = available * sizeof(TraceEventT);
+  size_t const bytes = TRACE_BUFFER * sizeof(TraceEventT);
+  while (done < bytes) {
+    ssize_t const got = read(lane->fd, (char*)lane->events + done, bytes - done);
+    if (got <= 0) break;
+    done += got;
+  }
+  lane->count = done / sizeof(TraceEventT);
+  return lane->count;
+}
+
+void trace_close(TraceT* trace) {
+  //read every lane back from the start
+  for (TraceLaneT* each = trace->lanes; each != NULL; each = each->next) {
+    flush(each);
+    lseek(each->fd, 0, SEEK_SET);
+  }
+
+  //repeatedly take the earliest call at the head of a lane, renumbered
+  TraceEventT* merged = (TraceEventT*)checked_malloc(TRACE_BUFFER * sizeof(TraceEventT));
+  size_t count = 0;
+  uint64_t tick = 0;
+  for (;;) {
+    TraceLaneT* earliest = NULL;
+    for (TraceLaneT* each = trace->lanes; each != NULL; each = each->next) {
+      if (refill(each, 1) == 0) continue;
+      //a whole call at the head, partial ones were cut short by a failed write
+      size_t const batch = each->events[each->cursor].batch;
+      if (batch == 0 || refill(each, batch) < batch) {
+	each->cursor = each->count;
+	continue;
+      }
+      if (earliest == NULL || each->events[each->cursor].tick < earliest->events[earliest->cursor].tick) {
+	earliest = each;
+      }
+    }
+    if (earliest == NULL) break;
+
+    size_t const batch = earliest->events[earliest->cursor].batch;
+    if (count + batch > TRACE_BUFFER) {
+      write_events(trace->fd, merged, count);
+      count = 0;
+    }
+    for (size_t i = 0; i < batch; i++) {
+      merged[count] = earliest->events[earliest->cursor++];
+      merged[count++].tick = tick++;
+    }
+  }
+  write_events(trace->fd, merged, count);
+  checked_free(merged);
+  close(trace->fd);
+
+  while (trace->lanes != NULL) {
+    TraceLaneT* next = trace->lanes->next;
+    if (trace->lanes->fd >= 0) close(trace->lanes->fd);
+    checked_free(trace->lanes);
+    trace->lanes = next;
+  }
+  pthread_mutex_destroy(&trace->lanes_lock);
+  checked_free(trace);
+}
+
+// Next event in the lane of the calling thread
+static TraceEventT* append(TraceT* trace, TraceLaneT* lane, uint64_t now, TraceKindT kind, int worker, ProcessIdT pid) {
+  if (lane->count == TRACE_BUFFER) {
+    flush(lane);
+  }
+  TraceEventT* event = &lane->events[lane->count++];
+  memset(event, 0, sizeof(TraceEventT));
+  event->tick = now - trace->start;
+  uint64_t const ready_since = trace->table->ready_since[pid - 1];
+  event->ready_ns = ready_since > trace->start ? ready_since - trace->start : 0;
+  event->pid = pid;
+  event->worker = worker;
+  event->kind = kind;
+  event->batch = 1;
+  return event;
+}
+
+void trace_record(TraceT* trace, TraceKindT kind, int worker, ProcessIdT const* pids,
+		  EvaluatorResultT const* results, size_t n) {
+  if (trace == NULL || n == 0) return;
+  TraceLaneT* lane = own_lane(trace);
+  uint64_t const now = process_table_now();
+  for (size_t i = 0; i < n; i++) {
+    TraceEventT* event = append(trace, lane, now, kind, worker, pids[i]);
+    event->batch = i == 0 ? n : 0;
+    if (results != NULL) {
+      event->pc = results[i].PC;
+      event->cpu_time = results[i].cpu_time;
+    }
+  }
+}
+
+void trace_record_create(TraceT* trace, ProcessIdT pid, EvaluatorCodeT const code, uint64_t deadline) {
+  if (trace == NULL) return;
+  TraceEventT* event = append(trace, own_lane(trace), process_table_now(), trace_create, 0, pid);
+  event->pc = code.parameter;
+  event->value = (int8_t)evaluator_code_id(code); //unknown code reads back as -1
+  //deadlines are set in whole microseconds after creation
+  if (deadline != 0) {
+    event->deadline_us = (deadline - trace->table->created[pid - 1]) / 1000;
+  }
+}
+
+void trace_record_nice(TraceT* trace, ProcessIdT pid, int nice) {
+  if (trace == NULL) return;
+  append(trace, own_lane(trace), process_table_now(), trace_nice, 0, pid)->value = nice;
+}
+
+TraceReplayT* trace_load(char const* path) {
+  int const fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror("Failed to open trace");
+    return NULL;
+  }
+  struct stat status;
+  TraceHeaderT header;
+  char const* problem = NULL;
+  if (fstat(fd, &status) != 0 || read(fd, &header, sizeof(header)) != sizeof(header)) {
+    problem = "is too short";
+  } else if (memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    problem = "is not a trace";
+  } else if (header.version != TRACE_VERSION) {
+    problem = "has another version";
+  } else if (header.workers == 0 || header.policy >= policy_count) {
+    problem = "has a bad header";
+  }
+  if (problem != NULL) {
+    fprintf(stderr, "Trace %s %s\n", path, problem);
+    close(fd);
+    return NULL;
+  }
+
+  //a run that died part way leaves a partial event at the end
+  size_t const count = (status.st_size - sizeof(header)) / sizeof(TraceEventT);
+  TraceReplayT* replay = (TraceReplayT*)checked_malloc(sizeof(TraceReplayT));
+  memset(replay, 0, sizeof(TraceReplayT));
+  replay->header = header;
+  replay->turns = (TraceTurnT*)checked_malloc((header.workers + 1) * sizeof(TraceTurnT));
+  memset(replay->turns, 0, (header.workers + 1) * sizeof(TraceTurnT));
+  replay->events = (TraceEventT*)checked_malloc((count > 0 ? count : 1) * sizeof(TraceEventT));
+  size_t const bytes = count * sizeof(TraceEventT);
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t const got = read(fd, (char*)replay->events + done, bytes - done);
+    if (got <= 0) break;
+    done += got;
+  }
+  close(fd);
+
+  //events must be complete calls in tick order, from workers the pool has
+  for (size_t i = 0; i < count && problem == NULL; i++) {
+    TraceEventT const* event = &replay->events[i];
+    if (event->tick != i || event->kind >= trace_kind_count || event->worker > header.workers ||
+	event->pid == 0 || event->pid > header.max_processes) {
+      problem = "is corrupt";
+    } else if (event->batch > 0 && i + event->batch > count) {
+      problem = "ends part way through a call";
+    }
+  }
+  if (done < bytes || problem != NULL) {
+    fprintf(stderr, "Trace %s %s\n", path, problem != NULL ? problem : "could not be read");
+    trace_replay_free(replay);
+    return NULL;
+  }
+  replay->count = count;
+  replay->done = count == 0;
+  return replay;
+}
+
+void trace_replay_free(TraceReplayT* replay) {
+  if (replay->turns != NULL) checked_free(replay->turns);
+  checked_free(replay->events);
+  checked_free(replay);
+}
+
+void trace_replay_config(TraceReplayT const* replay, ConfigT* config) {
+  config->simulator_threads = replay->header.workers;
+  config->max_threads = 0;
+  config->max_processes = replay->header.max_processes;
+  config->policy = replay->header.policy;
+  config->disks = 0;
+  config->networks = 0;
+  config->frames = 0;
+  config->checkpoint[0] = '\0';
+  config->trace[0] = '\0';
+}
+
+// Results of a call as the worker had them
+static void results_of(TraceEventT const* events, size_t n, ProcessIdT* pids, EvaluatorResultT* results) {
+  for (size_t i = 0; i < n; i++) {
+    pids[i] = events[i].pid;
+    results[i].PC = events[i].pc;
+    results[i].cpu_time = events[i].cpu_time;
+    results[i].reason = events[i].kind == trace_exit ? reason_terminated :
+      events[i].kind == trace_block ? reason_blocked : reason_timeslice_ended;
+  }
+}
+
+// Make one recorded call of n events
+static void replay_call(SimulatorT* simulator, TraceEventT const* events, size_t n) {
+  TraceReplayT* replay = simulator->replay;
+  SchedulerOpsT const* scheduler = simulator->scheduler;
+  void* state = simulator->scheduler_state;
+  ProcessTableT* table = &simulator->process_table;
+  ProcessIdT pids[n];
+  EvaluatorResultT results[n];
+  results_of(events, n, pids, results);
+
+  switch (events[0].kind) {
+  case trace_create: {
+    ProcessIdT const pid = pids[0];
+    ProcessHotT* process = process_table_hot(table, pid);
+    process_table_clear(table, pid);
+    process_table_write_begin(process);
+    if (evaluator_code_from_id((uint8_t)events[0].value, events[0].pc, &process->eval_code) != 0) {
+      process->eval_code.implementation = NULL;
+      process->eval_code.parameter = events[0].pc;
+    }
+    process->state = ready;
+    process_table_write_end(process);
+    table->created[pid - 1] = replay->start + events[0].ready_ns;
+    table->ready_since[pid - 1] = table->created[pid - 1];
+    if (events[0].deadline_us != 0) {
+      table->deadline[pid - 1] = table->created[pid - 1] + events[0].deadline_us * 1000ull;
+    }
+    scheduler->enqueue(state, pids, 1);
+    break;
+  }
+  case trace_pick: {
+    //the policy has seen the same calls so far, so it should agree
+    ProcessIdT picked[n];
+    size_t const got = scheduler->try_pick(state, picked, n);
+    int same = got == n;
+    for (size_t i = 0; i < got && same; i++) {
+      same = picked[i] == pids[i];
+    }
+    if (!same && replay->diverged++ == 0) {
+      size_t differs = 0;
+      while (differs < got && picked[differs] == pids[differs]) differs++;
+      replay->first_divergence = events[0].tick;
+      replay->divergence_worker = events[0].worker;
+      replay->divergence_batch = n;
+      replay->divergence_got = got;
+      replay->divergence_recorded = pids[differs < n ? differs : 0];
+      replay->divergence_picked = differs < got ? picked[differs] : 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+      process_table_hot(table, pids[i])->state = running;
+      table->dispatches[pids[i] - 1]++;
+    }
+    break;
+  }
+  case trace_preempt:
+    for (size_t i = 0; i < n; i++) {
+      ProcessHotT* process = process_table_hot(table, pids[i]);
+      table->ready_since[pids[i] - 1] = replay->start + events[i].ready_ns;
+      process_table_write_begin(process);
+      process->pc = results[i].PC;
+      process->state = ready;
+      process_table_write_end(process);
+      table->cpu_time[pids[i] - 1] += results[i].cpu_time;
+    }
+    scheduler->on_preempt(state, pids, results, n);
+    break;
+  case trace_block: {
+    ProcessHotT* process = process_table_hot(table, pids[0]);
+    table->cpu_time[pids[0] - 1] += results[0].cpu_time;
+    if (scheduler->on_block != NULL) {
+      scheduler->on_block(state, pids[0], &results[0]);
+    }
+    process_table_write_begin(process);
+    process->pc = results[0].PC;
+    process->state = blocked;
+    process_table_write_end(process);
+    break;
+  }
+  case trace_wake:
+    for (size_t i = 0; i < n; i++) {
+      table->ready_since[pids[i] - 1] = replay->start + events[i].ready_ns;
+      process_table_hot(table, pids[i])->state = ready;
+    }
+    scheduler->on_wake(state, pids, n);
+    break;
+  case trace_exit:
+    table->cpu_time[pids[0] - 1] += results[0].cpu_time;
+    table->completed[pids[0] - 1] = 1;
+    if (scheduler->on_exit != NULL) {
+      scheduler->on_exit(state, pids[0], &results[0]);
+    }
+    process_table_hot(table, pids[0])->state = terminated;
+    break;
+  case trace_nice:
+    table->nice[pids[0] - 1] = events[0].value;
+    break;
+  }
+}
+
+// Policy calls made by workers, the same counters as when running live
+static void decided(WorkerMetricsT* metrics, TraceKindT kind, size_t n, uint64_t since) {
+  if (metrics == NULL) return;
+  uint64_t const now = process_table_now();
+  __atomic_store_n(&metrics->decisions, metrics->decisions + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&metrics->sched_ns, metrics->sched_ns + (now - since), __ATOMIC_RELAXED);
+  if (kind == trace_pick) {
+    __atomic_store_n(&metrics->dispatches, metrics->dispatches + n, __ATOMIC_RELAXED);
+  } else if (kind == trace_exit) {
+    __atomic_store_n(&metrics->exits, metrics->exits + 1, __ATOMIC_RELAXED);
+  }
+}
+
+// Wait on a futex word while it holds value, for at most timeout when given
+static void futex_wait(uint32_t* word, uint32_t value, struct timespec const* timeout) {
+  syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t* word) {
+  syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// Wait until the call at index is next, returns 0 if the simulator stopped first
+static int wait_turn(SimulatorT* simulator, TraceTurnT* turn, size_t index) {
+  TraceReplayT* replay = simulator->replay;
+  struct timespec const timeout = { 0, TRACE_REPLAY_SLEEP_NS };
+  for (int spins = 0; ; spins++) {
+    uint32_t const seen = __atomic_load_n(&turn->turn, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&replay->cursor, __ATOMIC_SEQ_CST) == index) return 1;
+    if (__atomic_load_n(&simulator->stopping, __ATOMIC_ACQUIRE)) return 0;
+    if (spins < TRACE_REPLAY_SPINS) {
+      cpu_relax();
+      continue;
+    }
+    //the thread ahead wakes the parked one whose call comes next - the
+    //timeout only lets a stop through
+    __atomic_store_n(&turn->parked, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&replay->cursor, __ATOMIC_SEQ_CST) != index) {
+      futex_wait(&turn->turn, seen, &timeout);
+    }
+    __atomic_store_n(&turn->parked, 0, __ATOMIC_RELAXED);
+  }
+}
+
+// Move the cursor past a call and wake whoever makes the next one
+static void pass_turn(TraceReplayT* replay, size_t next) {
+  __atomic_store_n(&replay->cursor, next, __ATOMIC_SEQ_CST);
+  if (next == replay->count) {
+    __atomic_store_n(&replay->done, 1, __ATOMIC_RELEASE);
+    futex_wake(&replay->done);
+    return;
+  }
+  TraceTurnT* turn = &replay->turns[replay->events[next].worker];
+  __atomic_fetch_add(&turn->turn, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&turn->parked, __ATOMIC_SEQ_CST)) {
+    futex_wake(&turn->turn);
+  }
+}
+
+void trace_replay(SimulatorT* simulator, int worker, WorkerMetricsT* metrics) {
+  TraceReplayT* replay = simulator->replay;
+  TraceTurnT* turn = &replay->turns[worker];
+  for (size_t i = 0; i < replay->count; i++) {
+    TraceEventT const* event = &replay->events[i];
+    if (event->worker != worker || event->batch == 0) continue;
+
+    //wait for every earlier call, each thread keeps its own calls in order
+    if (!wait_turn(simulator, turn, i)) return;
+
+    uint64_t const calling = process_table_now();
+    replay_call(simulator, event, event->batch);
+    decided(metrics, event->kind, event->batch, calling);
+    pass_turn(replay, i + event->batch);
+  }
+}
+
+void trace_replay_wait(SimulatorT* simulator) {
+  TraceReplayT* replay = simulator->replay;
+  while (!__atomic_load_n(&replay->done, __ATOMIC_ACQUIRE)) {
+    futex_wait(&replay->done, 0, NULL);
+  }
+
+  uint64_t const elapsed = process_table_now() - simulator->start_time;
+  LOG(log_info, log_general, "Simulator %i - Replayed %zu events on %u workers in %.3fms (%.0f events/s)",
+      simulator->id, replay->count, replay->header.workers, elapsed / 1e6, replay->count / (elapsed / 1e9));
+  if (replay->diverged > 0) {
+    LOG(log_warning, log_general, "Simulator %i - First divergence at tick %lu on worker %u: %u of %u pids picked",
+	simulator->id, (unsigned long)replay->first_divergence, replay->divergence_worker,
+	replay->divergence_got, replay->divergence_batch);
+    LOG(log_warning, log_general, "Simulator %i - Recorded pid %u where the policy picked %u",
+	simulator->id, replay->divergence_recorded, replay->divergence_picked);
+    LOG(log_warning, log_general, "Simulator %i - %lu picks diverged, the policy's state drifts after the first",
+	simulator->id, replay->diverged);
+  } else {
+    LOG(log_info, log_general, "Simulator %i - Every pick matched the trace", simulator->id);
+  }
+}
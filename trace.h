@@ -0,0 +1,134 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "simulator.h"
+#include <stdint.h>
+#include <pthread.h>
+
+#define TRACE_VERSION 1
+//events a thread collects before they are written out
+#define TRACE_BUFFER 4096
+//checks of the cursor a replaying thread makes before it sleeps
+#define TRACE_REPLAY_SPINS 1000
+//longest sleep of a replaying thread before it looks for a stop
+#define TRACE_REPLAY_SLEEP_NS 10000000
+
+// Calls into the scheduling policy that are recorded
+typedef enum TraceKind {
+  trace_create, //enqueue of a new process
+  trace_pick, //pids handed to a worker
+  trace_preempt,
+  trace_block,
+  trace_wake,
+  trace_exit,
+  trace_nice, //not a call, but cfs reads it on the next charge
+  trace_kind_count
+} TraceKindT;
+
+// Names of the kinds, indexed by TraceKindT
+extern char const* const trace_kind_names[trace_kind_count];
+
+// One pid of one call - a call of n pids writes n events with consecutive
+// ticks, the first saying how many there are
+typedef struct TraceEvent {
+  uint64_t tick; //logical time, every event has the next one - until merged, when the call was made
+  uint64_t ready_ns; //when the process last became ready, from the simulator's start
+  uint32_t pid;
+  uint32_t pc; //after the step, the code parameter on creation
+  uint32_t cpu_time;
+  uint32_t deadline_us; //creation only, relative to it - 0 for best effort
+  uint16_t batch; //events in the call on its first event, 0 on the rest
+  uint16_t worker; //0 for threads outside the pool
+  uint8_t kind; //TraceKindT
+  int8_t value; //evaluator code id on creation, the nice value for trace_nice
+  uint16_t unused;
+} TraceEventT;
+
+// Start of the file, the events follow in tick order
+typedef struct TraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t workers; //pool size the trace was recorded with
+  uint32_t max_processes;
+  uint32_t policy; //SchedulerPolicyT of best effort processes
+} TraceHeaderT;
+
+// Calls of one recording thread, in the order it made them
+typedef struct TraceLane {
+  struct TraceLane* next;
+  int fd; //unlinked spill file
+  size_t count; //buffered events
+  size_t cursor; //next buffered event to merge, once read back
+  TraceEventT events[TRACE_BUFFER];
+} TraceLaneT;
+
+// Trace being recorded. Every thread logs its calls to a lane of its own
+// with the time it made them, and the lanes are merged in time order on
+// close - so nothing is shared on the way to the policy. Calls that
+// overlapped in time may come out in either order.
+typedef struct Trace {
+  int fd;
+  char path[CONFIG_PATH_LENGTH + 12];
+  unsigned long id; //tells apart the traces a thread has recorded to
+  pthread_mutex_t lanes_lock; //only taken for the first call of a thread
+  TraceLaneT* lanes;
+  int lane_count;
+  ProcessTableT* table;
+  uint64_t start; //origin of the times, the simulator's start
+} TraceT;
+
+// Where a replaying thread sleeps until its next call comes up
+typedef struct TraceTurn {
+  uint32_t turn; //futex word, bumped when the thread's next call is due
+  uint32_t parked; //set while the thread sleeps on it
+} TraceTurnT;
+
+// Trace being replayed
+typedef struct TraceReplay {
+  TraceHeaderT header;
+  TraceEventT* events;
+  size_t count;
+  size_t cursor; //index of the next event, advanced by the thread replaying it
+  TraceTurnT* turns; //one per worker, 0 for the event thread
+  uint32_t done; //futex word, set once the cursor reaches the end
+  uint64_t start; //origin of the times, the replaying simulator's start
+  unsigned long diverged; //picks where the policy chose other pids than recorded
+  //the first of them - after it the policy's queues no longer match the
+  //recording, so later picks are not expected to agree either
+  uint64_t first_divergence;
+  uint16_t divergence_worker;
+  uint16_t divergence_batch; //pids recorded
+  uint16_t divergence_got; //pids the policy handed out
+  ProcessIdT divergence_recorded; //first pid recorded and picked where they differ
+  ProcessIdT divergence_picked; //0 when the policy ran out first
+} TraceReplayT;
+
+// Start recording the calls of simulator to path, returns NULL if the
+// file cannot be written
+TraceT* trace_open(char const* path, SimulatorT* simulator);
+// Merge the lanes into the file and close it, once no thread records
+void trace_close(TraceT* trace);
+
+// Log a call of n pids, results may be NULL - calls that hand pids to the
+// policy are logged before they are made, picks after
+void trace_record(TraceT* trace, TraceKindT kind, int worker, ProcessIdT const* pids,
+		  EvaluatorResultT const* results, size_t n);
+void trace_record_create(TraceT* trace, ProcessIdT pid, EvaluatorCodeT const code, uint64_t deadline);
+void trace_record_nice(TraceT* trace, ProcessIdT pid, int nice);
+
+// Read a recorded trace, NULL if it cannot be used
+TraceReplayT* trace_load(char const* path);
+void trace_replay_free(TraceReplayT* replay);
+// Settings that make a simulator match the one recorded - no devices,
+// checkpoints or further tracing
+void trace_replay_config(TraceReplayT const* replay, ConfigT* config);
+
+// Make the calls recorded by worker, 0 for the event thread, each once
+// every earlier event has been replayed. Only the policy calls are made:
+// results come from the trace, so nothing is evaluated, and neither the
+// worker loop nor the event thread runs - only the policy's work is timed.
+void trace_replay(SimulatorT* simulator, int worker, WorkerMetricsT* metrics);
+// Wait until every event has been replayed and report how it went
+void trace_replay_wait(SimulatorT* simulator);
+
+#endif
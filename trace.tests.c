@@ -0,0 +1,150 @@
+#include "trace.h"
+#include "event_source.h"
+#include "logger.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define RECORDERS 4
+#define CALLS 3000
+
+char path[64];
+SimulatorT simulator;
+TraceT* trace;
+
+// Just what recording reads of a simulator
+void setup() {
+  snprintf(path, sizeof(path), "/tmp/trace.tests.%i", (int)getpid());
+  memset(&simulator, 0, sizeof(simulator));
+  config_defaults(&simulator.config);
+  simulator.config.simulator_threads = RECORDERS;
+  simulator.config.max_processes = 16;
+  simulator.config.policy = policy_round_robin;
+  process_table_create(&simulator.process_table, 16);
+  simulator.start_time = process_table_now();
+  trace = trace_open(path, &simulator);
+  assert(trace != NULL);
+}
+
+void teardown() {
+  process_table_destroy(&simulator.process_table);
+  unlink(path);
+}
+
+// Calls of two pids numbered through cpu_time, more than a lane buffers
+void* record_calls(void* arg) {
+  int const worker = (int)(long)arg;
+  ProcessIdT const pids[2] = { worker, worker + RECORDERS };
+  for (uint32_t i = 0; i < CALLS; i++) {
+    EvaluatorResultT const results[2] = { { 0, i, reason_timeslice_ended }, { 0, i, reason_timeslice_ended } };
+    trace_record(trace, trace_preempt, worker, pids, results, 2);
+  }
+  return NULL;
+}
+
+void test_lanes_merge() {
+  printf("testing calls from many threads merge whole and in each thread's order\n");
+  setup();
+  pthread_t threads[RECORDERS];
+  for (long i = 0; i < RECORDERS; i++) {
+    pthread_create(&threads[i], NULL, record_calls, (void*)(i + 1));
+  }
+  for (int i = 0; i < RECORDERS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  trace_close(trace);
+
+  //the ticks are checked on load
+  TraceReplayT* replay = trace_load(path);
+  assert(replay != NULL);
+  assert(replay->count == RECORDERS * CALLS * 2);
+  uint32_t next[RECORDERS + 1] = { 0 };
+  for (size_t i = 0; i < replay->count; i += 2) {
+    TraceEventT const* event = &replay->events[i];
+    assert(event->batch == 2 && event[1].batch == 0);
+    assert(event->worker >= 1 && event->worker <= RECORDERS);
+    assert(event[1].worker == event->worker);
+    assert(event->pid == event->worker && event[1].pid == event->worker + RECORDERS);
+    assert(event->cpu_time == next[event->worker]++);
+  }
+  for (int worker = 1; worker <= RECORDERS; worker++) {
+    assert(next[worker] == CALLS);
+  }
+  trace_replay_free(replay);
+  teardown();
+}
+
+void* record_one(void* arg) {
+  ProcessIdT const pid = (ProcessIdT)(long)arg;
+  trace_record(trace, trace_wake, 0, &pid, NULL, 1);
+  return NULL;
+}
+
+void test_time_order() {
+  printf("testing lanes merge in the order the calls were made\n");
+  setup();
+  //one call on another thread, one here and one on a third
+  pthread_t thread;
+  pthread_create(&thread, NULL, record_one, (void*)1l);
+  pthread_join(thread, NULL);
+  trace_record_nice(trace, 2, 5);
+  pthread_create(&thread, NULL, record_one, (void*)3l);
+  pthread_join(thread, NULL);
+  trace_close(trace);
+
+  TraceReplayT* replay = trace_load(path);
+  assert(replay != NULL);
+  assert(replay->count == 3);
+  assert(replay->events[0].pid == 1 && replay->events[0].kind == trace_wake);
+  assert(replay->events[1].pid == 2 && replay->events[1].kind == trace_nice);
+  assert(replay->events[1].value == 5);
+  assert(replay->events[2].pid == 3 && replay->events[2].kind == trace_wake);
+  trace_replay_free(replay);
+  teardown();
+}
+
+void test_divergence() {
+  printf("testing replay reports the first pick the policy disagrees with\n");
+  setup();
+  //round robin hands out the first created first, the trace says otherwise
+  EvaluatorCodeT const code = evaluator_terminates_after(1);
+  trace_record_create(trace, 1, code, 0);
+  trace_record_create(trace, 2, code, 0);
+  ProcessIdT const picked = 2;
+  trace_record(trace, trace_pick, 3, &picked, NULL, 1);
+  trace_close(trace);
+
+  TraceReplayT* replay = trace_load(path);
+  assert(replay != NULL && replay->count == 3);
+  ConfigT config;
+  config_defaults(&config);
+  trace_replay_config(replay, &config);
+  assert(config.simulator_threads == RECORDERS);
+  SimulatorT* replaying = simulator_start_replay(&config, NULL, replay);
+  event_source_start(replaying, config.event_source_interval);
+  trace_replay_wait(replaying);
+  assert(replay->cursor == 3);
+  assert(replay->diverged == 1);
+  assert(replay->first_divergence == 2);
+  assert(replay->divergence_worker == 3);
+  assert(replay->divergence_batch == 1 && replay->divergence_got == 1);
+  assert(replay->divergence_recorded == 2);
+  assert(replay->divergence_picked == 1);
+  event_source_stop(replaying);
+  simulator_stop(replaying);
+  teardown();
+}
+
+int main() {
+  //the replay report would bury the test output
+  logger_configure(log_error, ~0u, 1);
+  logger_start();
+  test_lanes_merge();
+  test_time_order();
+  test_divergence();
+  logger_stop();
+  return 0;
+}
@@ -0,0 +1,251 @@
+#include "unrolled_list.h"
+#include "utilities.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+_Static_assert(sizeof(UnrolledBlockT) == UNROLLED_LIST_BLOCK_SIZE, "block must fill its alignment");
+_Static_assert(UNROLLED_LIST_BLOCK_VALUES % 8 == 0, "blocks are compared eight values at a time");
+
+//a block under this many values after a remove merges into a neighbour
+#define UNROLLED_LIST_MERGE_BELOW (UNROLLED_LIST_BLOCK_VALUES / 2)
+
+// Bit i set when values[i] of block equals value, for i within its values
+typedef unsigned int (*MatchT)(UnrolledBlockT const* block, unsigned int value);
+
+// Index one past the last value of block
+static unsigned int block_end(UnrolledBlockT const* block) {
+  return block->start + block->count;
+}
+
+// Bit i set for each values[i] in use
+static unsigned int live(UnrolledBlockT const* block) {
+  return ((1u << block_end(block)) - 1) & ~((1u << block->start) - 1);
+}
+
+static unsigned int match_scalar(UnrolledBlockT const* block, unsigned int value) {
+  unsigned int mask = 0;
+  for (unsigned int i = block->start; i < block_end(block); i++) {
+    mask |= (unsigned int)(block->values[i] == value) << i;
+  }
+  return mask;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+//lanes outside start and count hold stale values, they are compared and masked off
+__attribute__((target("sse2")))
+static unsigned int match_sse2(UnrolledBlockT const* block, unsigned int value) {
+  __m128i const needle = _mm_set1_epi32((int)value);
+  unsigned int mask = 0;
+  for (int i = 0; i < UNROLLED_LIST_BLOCK_VALUES; i += 4) {
+    __m128i const values = _mm_load_si128((__m128i const*)&block->values[i]);
+    mask |= (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(values, needle))) << i;
+  }
+  return mask & live(block);
+}
+
+__attribute__((target("avx2")))
+static unsigned int match_avx2(UnrolledBlockT const* block, unsigned int value) {
+  __m256i const needle = _mm256_set1_epi32((int)value);
+  unsigned int mask = 0;
+  for (int i = 0; i < UNROLLED_LIST_BLOCK_VALUES; i += 8) {
+    __m256i const values = _mm256_load_si256((__m256i const*)&block->values[i]);
+    mask |= (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(values, needle))) << i;
+  }
+  return mask & live(block);
+}
+#endif
+
+static MatchT matcher;
+
+// Widest compare the cpu has, picked on first use
+static MatchT match_function() {
+  MatchT match = __atomic_load_n(&matcher, __ATOMIC_RELAXED);
+  if (match != NULL) return match;
+  match = match_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    match = match_avx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    match = match_sse2;
+  }
+#endif
+  __atomic_store_n(&matcher, match, __ATOMIC_RELAXED);
+  return match;
+}
+
+static UnrolledBlockT* alloc_block() {
+  UnrolledBlockT* block = (UnrolledBlockT*)checked_aligned_malloc(UNROLLED_LIST_BLOCK_SIZE, sizeof(UnrolledBlockT));
+  block->pred = NULL;
+  block->succ = NULL;
+  block->start = 0;
+  block->count = 0;
+  return block;
+}
+
+// Link a new empty block between pred and succ, either may be NULL at the ends
+static UnrolledBlockT* insert_block(UnrolledListT* list, UnrolledBlockT* pred, UnrolledBlockT* succ) {
+  UnrolledBlockT* block = alloc_block();
+  block->pred = pred;
+  block->succ = succ;
+  if (pred != NULL) pred->succ = block; else list->first = block;
+  if (succ != NULL) succ->pred = block; else list->last = block;
+  return block;
+}
+
+static void remove_block(UnrolledListT* list, UnrolledBlockT* block) {
+  if (block->pred != NULL) block->pred->succ = block->succ; else list->first = block->succ;
+  if (block->succ != NULL) block->succ->pred = block->pred; else list->last = block->pred;
+  checked_free(block);
+}
+
+UnrolledListT* unrolled_list_create() {
+  UnrolledListT* list = (UnrolledListT*)checked_malloc(sizeof(UnrolledListT));
+  list->first = NULL;
+  list->last = NULL;
+  list->length = 0;
+  return list;
+}
+
+void unrolled_list_destroy(UnrolledListT* list) {
+  assert(list);
+  while (list->first != NULL) {
+    remove_block(list, list->first);
+  }
+  checked_free(list);
+}
+
+// Move the values of block so they start at start
+static void move_values(UnrolledBlockT* block, unsigned int start) {
+  memmove(&block->values[start], &block->values[block->start], block->count * sizeof(unsigned int));
+  block->start = start;
+}
+
+void unrolled_list_prepend(UnrolledListT* list, unsigned int value) {
+  assert(list);
+  UnrolledBlockT* block = list->first;
+  if (block == NULL || block->count == UNROLLED_LIST_BLOCK_VALUES) {
+    //filled from the back, so the prepends after this one move nothing
+    block = insert_block(list, NULL, block);
+    block->start = UNROLLED_LIST_BLOCK_VALUES;
+  } else if (block->start == 0) {
+    move_values(block, UNROLLED_LIST_BLOCK_VALUES - block->count);
+  }
+  block->values[--block->start] = value;
+  block->count++;
+  list->length++;
+}
+
+void unrolled_list_append(UnrolledListT* list, unsigned int value) {
+  assert(list);
+  UnrolledBlockT* block = list->last;
+  if (block == NULL || block->count == UNROLLED_LIST_BLOCK_VALUES) {
+    block = insert_block(list, block, NULL);
+  } else if (block_end(block) == UNROLLED_LIST_BLOCK_VALUES) {
+    move_values(block, 0);
+  }
+  block->values[block_end(block)] = value;
+  block->count++;
+  list->length++;
+}
+
+// Move the values of succ onto the end of block and unlink succ
+static void merge(UnrolledListT* list, UnrolledBlockT* block, UnrolledBlockT* succ) {
+  if (block_end(block) + succ->count > UNROLLED_LIST_BLOCK_VALUES) {
+    move_values(block, 0);
+  }
+  memcpy(&block->values[block_end(block)], &succ->values[succ->start], succ->count * sizeof(unsigned int));
+  block->count += succ->count;
+  remove_block(list, succ);
+}
+
+void unrolled_list_remove(UnrolledListT* list, unsigned int* value) {
+  assert(list);
+  assert(value);
+  UnrolledBlockT* block = (UnrolledBlockT*)((uintptr_t)value & ~(uintptr_t)(UNROLLED_LIST_BLOCK_SIZE - 1));
+  unsigned int const index = value - block->values;
+  assert(index >= block->start && index < block_end(block));
+  //close the gap from whichever side has fewer values, nothing moves at the ends
+  unsigned int const before = index - block->start;
+  unsigned int const after = block_end(block) - 1 - index;
+  if (before < after) {
+    if (before > 0) memmove(&block->values[block->start + 1], &block->values[block->start], before * sizeof(unsigned int));
+    block->start++;
+  } else if (after > 0) {
+    memmove(&block->values[index], &block->values[index + 1], after * sizeof(unsigned int));
+  }
+  block->count--;
+  list->length--;
+
+  if (block->count == 0) {
+    remove_block(list, block);
+  } else if (block->count < UNROLLED_LIST_MERGE_BELOW) {
+    if (block->pred != NULL && block->pred->count + block->count <= UNROLLED_LIST_BLOCK_VALUES) {
+      merge(list, block->pred, block);
+    } else if (block->succ != NULL && block->count + block->succ->count <= UNROLLED_LIST_BLOCK_VALUES) {
+      merge(list, block, block->succ);
+    }
+  }
+}
+
+int unrolled_list_empty(UnrolledListT* list) {
+  return list->length == 0;
+}
+
+size_t unrolled_list_length(UnrolledListT* list) {
+  assert(list);
+  return list->length;
+}
+
+unsigned int* unrolled_list_find_first(UnrolledListT* list, unsigned int value) {
+  assert(list);
+  MatchT const match = match_function();
+  for (UnrolledBlockT* block = list->first; block != NULL; block = block->succ) {
+    unsigned int const mask = match(block, value);
+    if (mask != 0) return &block->values[__builtin_ctz(mask)];
+  }
+  return NULL;
+}
+
+unsigned int* unrolled_list_find_last(UnrolledListT* list, unsigned int value) {
+  assert(list);
+  MatchT const match = match_function();
+  for (UnrolledBlockT* block = list->last; block != NULL; block = block->pred) {
+    unsigned int const mask = match(block, value);
+    if (mask != 0) return &block->values[31 - __builtin_clz(mask)];
+  }
+  return NULL;
+}
+
+unsigned int unrolled_list_pop_front(UnrolledListT* list) {
+  assert(list);
+  assert(!unrolled_list_empty(list));
+  unsigned int* front = &list->first->values[list->first->start];
+  unsigned int const value = *front;
+  unrolled_list_remove(list, front);
+  return value;
+}
+
+unsigned int unrolled_list_pop_back(UnrolledListT* list) {
+  assert(list);
+  assert(!unrolled_list_empty(list));
+  unsigned int* back = &list->last->values[block_end(list->last) - 1];
+  unsigned int const value = *back;
+  unrolled_list_remove(list, back);
+  return value;
+}
+
+void unrolled_list_for_each(UnrolledListT* list, void (*action)(unsigned int*)) {
+  assert(list);
+  for (UnrolledBlockT* block = list->first; block != NULL; block = block->succ) {
+    for (unsigned int i = block->start; i < block_end(block); i++) {
+      action(&block->values[i]);
+    }
+  }
+}
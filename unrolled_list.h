@@ -0,0 +1,68 @@
+#ifndef _UNROLLED_LIST_H_
+#define _UNROLLED_LIST_H_
+
+#include <stddef.h>
+
+//values per block, the rest of its 128 bytes is the header
+#define UNROLLED_LIST_BLOCK_VALUES 24
+//blocks are aligned to their size, so a value's block is found from its address
+#define UNROLLED_LIST_BLOCK_SIZE 128
+
+// A run of consecutive values of the list, in order from values[start]
+typedef struct UnrolledBlock {
+  struct UnrolledBlock* pred;
+  struct UnrolledBlock* succ;
+  unsigned int start; //popping the front moves this on rather than the values
+  unsigned int count;
+  //values start on a 32 byte boundary for aligned vector loads
+  unsigned int values[UNROLLED_LIST_BLOCK_VALUES] __attribute__((aligned(32)));
+} __attribute__((aligned(UNROLLED_LIST_BLOCK_SIZE))) UnrolledBlockT;
+
+// The list of ListT stored in blocks, so walking it touches two cache
+// lines per 24 values instead of one per value, and searches compare a
+// vector at a time. Values found are returned by address, which stays
+// valid until the list is next changed.
+typedef struct UnrolledList {
+  UnrolledBlockT* first;
+  UnrolledBlockT* last;
+  size_t length;
+} UnrolledListT;
+
+// Construct an empty list
+UnrolledListT* unrolled_list_create();
+// Destroy a list and free all its memory
+void unrolled_list_destroy(UnrolledListT* list);
+
+// Prepend value to the front of the list
+void unrolled_list_prepend(UnrolledListT* list, unsigned int value);
+
+// Append value to the end of the list
+void unrolled_list_append(UnrolledListT* list, unsigned int value);
+
+// Remove the value at the address returned by a find, the values on the
+// shorter side of it move to fill the gap and a block left under half full
+// merges with a neighbour that has room
+void unrolled_list_remove(UnrolledListT* list, unsigned int* value);
+
+// Test if the list is empty in constant time
+int unrolled_list_empty(UnrolledListT* list);
+
+// The list length in constant time
+size_t unrolled_list_length(UnrolledListT* list);
+
+// Find the first occurrence, NULL if absent
+unsigned int* unrolled_list_find_first(UnrolledListT* list, unsigned int value);
+
+// Find the last occurrence, NULL if absent
+unsigned int* unrolled_list_find_last(UnrolledListT* list, unsigned int value);
+
+// Remove the first element - undefined if absent
+unsigned int unrolled_list_pop_front(UnrolledListT* list);
+
+// Remove the last element - undefined if absent
+unsigned int unrolled_list_pop_back(UnrolledListT* list);
+
+// Run action on each element of the list
+void unrolled_list_for_each(UnrolledListT* list, void (*action)(unsigned int*));
+
+#endif
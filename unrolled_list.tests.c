@@ -0,0 +1,252 @@
+#include "unrolled_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+void test_empty_creation_destruction() {
+  printf("testing empty creation/destruction\n");
+  UnrolledListT* list = unrolled_list_create();
+  assert(unrolled_list_empty(list));
+  assert(unrolled_list_length(list) == 0);
+  assert(!unrolled_list_find_first(list, 0));
+  assert(!unrolled_list_find_last(list, 0));
+  unrolled_list_destroy(list);
+}
+
+void test_prepend_append() {
+  printf("testing prepend and append across blocks\n");
+  UnrolledListT* list = unrolled_list_create();
+  unsigned int const count = 5 * UNROLLED_LIST_BLOCK_VALUES + 3;
+  for (unsigned int i = 0; i < count; i++) {
+    unrolled_list_append(list, 1000 + i);
+    unrolled_list_prepend(list, 999 - i);
+  }
+  assert(unrolled_list_length(list) == 2 * count);
+  for (unsigned int i = 1000 - count; i < 1000 + count; i++) {
+    assert(unrolled_list_pop_front(list) == i);
+  }
+  assert(unrolled_list_empty(list));
+  assert(list->first == NULL && list->last == NULL);
+  unrolled_list_destroy(list);
+}
+
+void test_find() {
+  printf("testing find\n");
+  UnrolledListT* list = unrolled_list_create();
+  unrolled_list_prepend(list, 101);
+  unrolled_list_prepend(list, 202);
+  unrolled_list_prepend(list, 101);
+
+  unsigned int* first = unrolled_list_find_first(list, 101);
+  assert(first && *first == 101);
+  unsigned int* last = unrolled_list_find_last(list, 101);
+  assert(last && *last == 101);
+  assert(first != last);
+  assert(!unrolled_list_find_first(list, 303));
+  assert(!unrolled_list_find_last(list, 303));
+  unrolled_list_destroy(list);
+}
+
+void test_find_every_position() {
+  printf("testing find at every position of several blocks\n");
+  UnrolledListT* list = unrolled_list_create();
+  unsigned int const count = 3 * UNROLLED_LIST_BLOCK_VALUES + 7;
+  for (unsigned int i = 0; i < count; i++) {
+    unrolled_list_append(list, i % 50);
+  }
+  for (unsigned int value = 0; value < 50; value++) {
+    unsigned int* first = unrolled_list_find_first(list, value);
+    unsigned int* last = unrolled_list_find_last(list, value);
+    assert(first && *first == value);
+    assert(last && *last == value);
+    //the last copy is the only one when value appears once
+    assert((first == last) == (value + 50 >= count));
+  }
+  assert(!unrolled_list_find_first(list, 50));
+  unrolled_list_destroy(list);
+
+  //values past the count of a block are stale, never found
+  list = unrolled_list_create();
+  for (unsigned int i = 1; i <= 5; i++) {
+    unrolled_list_append(list, i);
+  }
+  assert(unrolled_list_pop_back(list) == 5);
+  assert(!unrolled_list_find_first(list, 5));
+  assert(!unrolled_list_find_last(list, 5));
+  unrolled_list_destroy(list);
+}
+
+void test_remove() {
+  printf("testing remove\n");
+  UnrolledListT* list = unrolled_list_create();
+  unrolled_list_prepend(list, 101);
+  unrolled_list_prepend(list, 202);
+  unrolled_list_prepend(list, 101);
+
+  unrolled_list_remove(list, unrolled_list_find_first(list, 101));
+  assert(unrolled_list_length(list) == 2);
+  assert(unrolled_list_find_first(list, 101) == unrolled_list_find_last(list, 101));
+  unrolled_list_remove(list, unrolled_list_find_last(list, 101));
+  assert(!unrolled_list_find_first(list, 101));
+  assert(unrolled_list_pop_front(list) == 202);
+  assert(unrolled_list_empty(list));
+  unrolled_list_destroy(list);
+}
+
+void test_remove_emptying_block() {
+  printf("testing remove of a block's last value\n");
+  UnrolledListT* list = unrolled_list_create();
+  for (unsigned int i = 0; i < 2 * UNROLLED_LIST_BLOCK_VALUES + 1; i++) {
+    unrolled_list_append(list, i);
+  }
+  //the middle block empties and is unlinked
+  for (unsigned int i = UNROLLED_LIST_BLOCK_VALUES; i < 2 * UNROLLED_LIST_BLOCK_VALUES; i++) {
+    unrolled_list_remove(list, unrolled_list_find_first(list, i));
+  }
+  assert(unrolled_list_length(list) == UNROLLED_LIST_BLOCK_VALUES + 1);
+  assert(list->first->succ == list->last && list->last->pred == list->first);
+  assert(unrolled_list_pop_back(list) == 2 * UNROLLED_LIST_BLOCK_VALUES);
+  assert(unrolled_list_pop_back(list) == UNROLLED_LIST_BLOCK_VALUES - 1);
+  unrolled_list_destroy(list);
+}
+
+void test_pop() {
+  printf("testing pop\n");
+  UnrolledListT* list = unrolled_list_create();
+  unrolled_list_append(list, 101);
+  unrolled_list_append(list, 202);
+  unrolled_list_append(list, 303);
+  assert(unrolled_list_pop_front(list) == 101);
+  assert(unrolled_list_length(list) == 2);
+  assert(unrolled_list_pop_back(list) == 303);
+  assert(unrolled_list_length(list) == 1);
+  unrolled_list_destroy(list);
+}
+
+void increment(unsigned int* value) {
+  (*value)++;
+}
+
+void test_for_each() {
+  printf("testing for each\n");
+  UnrolledListT* list = unrolled_list_create();
+  for (unsigned int i = 0; i < 2 * UNROLLED_LIST_BLOCK_VALUES; i++) {
+    unrolled_list_append(list, i);
+  }
+  unrolled_list_for_each(list, increment);
+  for (unsigned int i = 0; i < 2 * UNROLLED_LIST_BLOCK_VALUES; i++) {
+    assert(unrolled_list_pop_front(list) == i + 1);
+  }
+  unrolled_list_destroy(list);
+}
+
+void test_pop_front_keeps_addresses() {
+  printf("testing pop front leaves the rest of its block in place\n");
+  UnrolledListT* list = unrolled_list_create();
+  for (unsigned int i = 0; i < UNROLLED_LIST_BLOCK_VALUES; i++) {
+    unrolled_list_append(list, i);
+  }
+  unsigned int* const last = unrolled_list_find_first(list, UNROLLED_LIST_BLOCK_VALUES - 1);
+  for (unsigned int i = 0; i < UNROLLED_LIST_BLOCK_VALUES - 1; i++) {
+    assert(unrolled_list_pop_front(list) == i);
+    assert(unrolled_list_find_first(list, UNROLLED_LIST_BLOCK_VALUES - 1) == last);
+    //popped values are stale, never found
+    assert(unrolled_list_find_last(list, i) == NULL);
+  }
+  //room freed at the front is prepended into, at the back appended into
+  unrolled_list_prepend(list, 1000);
+  unrolled_list_append(list, 1001);
+  assert(list->first == list->last);
+  assert(unrolled_list_pop_front(list) == 1000);
+  assert(unrolled_list_pop_front(list) == UNROLLED_LIST_BLOCK_VALUES - 1);
+  assert(unrolled_list_pop_front(list) == 1001);
+  assert(unrolled_list_empty(list));
+  unrolled_list_destroy(list);
+}
+
+void test_merge() {
+  printf("testing sparse neighbouring blocks merge\n");
+  UnrolledListT* list = unrolled_list_create();
+  for (unsigned int i = 0; i < 3 * UNROLLED_LIST_BLOCK_VALUES; i++) {
+    unrolled_list_append(list, i);
+  }
+  //thin the first two blocks until they fit in one
+  for (unsigned int i = 0; i < 3 * UNROLLED_LIST_BLOCK_VALUES / 2; i++) {
+    if (i % 3 != 0) unrolled_list_remove(list, unrolled_list_find_first(list, i));
+  }
+  for (unsigned int i = 3 * UNROLLED_LIST_BLOCK_VALUES / 2; i < 2 * UNROLLED_LIST_BLOCK_VALUES; i++) {
+    unrolled_list_remove(list, unrolled_list_find_first(list, i));
+  }
+  UnrolledBlockT* block = list->first;
+  assert(block->succ == list->last && block->count == UNROLLED_LIST_BLOCK_VALUES / 2);
+  assert(list->last->count == UNROLLED_LIST_BLOCK_VALUES);
+  for (unsigned int i = 0; i < 3 * UNROLLED_LIST_BLOCK_VALUES / 2; i += 3) {
+    assert(unrolled_list_pop_front(list) == i);
+  }
+  assert(unrolled_list_length(list) == UNROLLED_LIST_BLOCK_VALUES);
+  unrolled_list_destroy(list);
+}
+
+// Apply random operations to the list and an array alike, checking they agree
+void test_against_array() {
+  printf("testing random operations against an array\n");
+  UnrolledListT* list = unrolled_list_create();
+  unsigned int expected[4096];
+  unsigned int length = 0;
+  unsigned int next = 0;
+  srand(47);
+  for (int step = 0; step < 100000; step++) {
+    int const operation = rand() % 6;
+    if (operation == 0 && length < 4096) {
+      memmove(&expected[1], &expected[0], length * sizeof(unsigned int));
+      expected[0] = next;
+      unrolled_list_prepend(list, next++);
+      length++;
+    } else if (operation == 1 && length < 4096) {
+      expected[length++] = next;
+      unrolled_list_append(list, next++);
+    } else if (operation == 2 && length > 0) {
+      assert(unrolled_list_pop_front(list) == expected[0]);
+      memmove(&expected[0], &expected[1], --length * sizeof(unsigned int));
+    } else if (operation == 3 && length > 0) {
+      assert(unrolled_list_pop_back(list) == expected[--length]);
+    } else if (operation >= 4 && length > 0) {
+      unsigned int const index = rand() % length;
+      unsigned int* found = operation == 4 ? unrolled_list_find_first(list, expected[index])
+					   : unrolled_list_find_last(list, expected[index]);
+      assert(found != NULL && *found == expected[index]);
+      unrolled_list_remove(list, found);
+      memmove(&expected[index], &expected[index + 1], (length - index - 1) * sizeof(unsigned int));
+      length--;
+    }
+    assert(unrolled_list_length(list) == length);
+  }
+
+  //in order, with every block in use
+  unsigned int index = 0;
+  for (UnrolledBlockT* block = list->first; block != NULL; block = block->succ) {
+    assert(block->count > 0 && block->start + block->count <= UNROLLED_LIST_BLOCK_VALUES);
+    for (unsigned int i = 0; i < block->count; i++) {
+      assert(block->values[block->start + i] == expected[index++]);
+    }
+  }
+  assert(index == length);
+  unrolled_list_destroy(list);
+}
+
+int main() {
+  test_empty_creation_destruction();
+  test_prepend_append();
+  test_find();
+  test_find_every_position();
+  test_remove();
+  test_remove_emptying_block();
+  test_pop();
+  test_for_each();
+  test_pop_front_keeps_addresses();
+  test_merge();
+  test_against_array();
+  return 0;
+}
@@ -12,3 +12,9 @@ void checked_free(void* addr) {
   assert(addr);
   free(addr);
 }
+
+void* checked_aligned_malloc(size_t alignment, size_t size) {
+  void* result = NULL;
+  if(posix_memalign(&result, alignment, size) != 0) abort();
+  return result;
+}
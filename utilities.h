@@ -5,5 +5,16 @@
 
 void* checked_malloc(size_t size);
 void checked_free(void* addr);
+// Alignment must be a power of two, release with checked_free
+void* checked_aligned_malloc(size_t alignment, size_t size);
+
+// Hint to the CPU that we are in a spin loop
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
 
 #endif
@@ -0,0 +1,135 @@
+#include "vm.h"
+#include "utilities.h"
+
+#include <assert.h>
+#include <string.h>
+
+void vm_create(VmT* vm, unsigned int max_processes, unsigned int working_set, unsigned int frames) {
+  assert(working_set > 0 && frames > 0);
+  size_t const entries = (size_t)max_processes * working_set;
+  vm->working_set = working_set;
+  vm->frame_count = frames;
+  vm->pages = (uint32_t*)checked_malloc(entries * sizeof(uint32_t));
+  memset(vm->pages, 0, entries * sizeof(uint32_t));
+  vm->frames = (uint32_t*)checked_malloc(frames * sizeof(uint32_t));
+  memset(vm->frames, 0, frames * sizeof(uint32_t));
+  vm->referenced = (unsigned char*)checked_malloc(frames);
+  memset(vm->referenced, 0, frames);
+  vm->pinned = (unsigned char*)checked_malloc(frames);
+  memset(vm->pinned, 0, frames);
+  pthread_mutex_init(&vm->lock, NULL);
+
+  //every frame starts out free, handed out lowest first
+  vm->free = (uint32_t*)checked_malloc(frames * sizeof(uint32_t));
+  for (unsigned int i = 0; i < frames; i++) {
+    vm->free[i] = frames - 1 - i;
+  }
+  vm->free_count = frames;
+  vm->hand = 0;
+  vm->evictions = 0;
+}
+
+void vm_destroy(VmT* vm) {
+  pthread_mutex_destroy(&vm->lock);
+  checked_free(vm->pages);
+  checked_free(vm->frames);
+  checked_free(vm->referenced);
+  checked_free(vm->pinned);
+  checked_free(vm->free);
+}
+
+// A frame for a new page, evicting the first unpinned one the hand finds
+// that has not been touched since it last came round - the caller holds
+// the lock. Returns frame_count when every frame is pinned.
+static uint32_t take_frame(VmT* vm) {
+  if (vm->free_count > 0) {
+    return vm->free[--vm->free_count];
+  }
+  //every frame is in use, so the hand only ever passes mapped ones - the
+  //first lap clears every reference, the second finds any unpinned frame
+  for (unsigned int step = 0; step < 2 * vm->frame_count; step++) {
+    uint32_t const frame = vm->hand;
+    vm->hand = vm->hand + 1 == vm->frame_count ? 0 : vm->hand + 1;
+    if (__atomic_load_n(&vm->pinned[frame], __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    if (__atomic_load_n(&vm->referenced[frame], __ATOMIC_RELAXED)) {
+      __atomic_store_n(&vm->referenced[frame], 0, __ATOMIC_RELAXED);
+      continue;
+    }
+    __atomic_store_n(&vm->pages[vm->frames[frame] - 1], 0, __ATOMIC_RELAXED);
+    vm->evictions++;
+    return frame;
+  }
+  return vm->frame_count;
+}
+
+int vm_touch(VmT* vm, ProcessIdT pid, unsigned int pc) {
+  size_t const entry = (size_t)(pid - 1) * vm->working_set + vm_page_of(pc, vm->working_set);
+  uint32_t const mapped = __atomic_load_n(&vm->pages[entry], __ATOMIC_ACQUIRE);
+  if (mapped == 0) {
+    return 1;
+  }
+  //nearly always set already, reading first keeps the lines shared
+  if (!__atomic_load_n(&vm->referenced[mapped - 1], __ATOMIC_RELAXED)) {
+    __atomic_store_n(&vm->referenced[mapped - 1], 1, __ATOMIC_RELAXED);
+  }
+  if (__atomic_load_n(&vm->pinned[mapped - 1], __ATOMIC_RELAXED)) {
+    __atomic_store_n(&vm->pinned[mapped - 1], 0, __ATOMIC_RELEASE);
+  }
+  return 0;
+}
+
+int vm_load(VmT* vm, ProcessIdT pid, unsigned int pc) {
+  size_t const entry = (size_t)(pid - 1) * vm->working_set + vm_page_of(pc, vm->working_set);
+  pthread_mutex_lock(&vm->lock);
+  uint32_t frame = vm->pages[entry];
+  if (frame != 0) {
+    //already mapped, only the pin is missing
+    __atomic_store_n(&vm->pinned[frame - 1], 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&vm->lock);
+    return 0;
+  }
+  frame = take_frame(vm);
+  if (frame == vm->frame_count) {
+    pthread_mutex_unlock(&vm->lock);
+    return 1;
+  }
+  vm->frames[frame] = entry + 1;
+  __atomic_store_n(&vm->referenced[frame], 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&vm->pinned[frame], 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&vm->pages[entry], frame + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&vm->lock);
+  return 0;
+}
+
+void vm_release(VmT* vm, ProcessIdT pid) {
+  uint32_t* pages = &vm->pages[(size_t)(pid - 1) * vm->working_set];
+  pthread_mutex_lock(&vm->lock);
+  for (unsigned int page = 0; page < vm->working_set; page++) {
+    if (pages[page] == 0) continue;
+    uint32_t const frame = pages[page] - 1;
+    vm->frames[frame] = 0;
+    __atomic_store_n(&vm->referenced[frame], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&vm->pinned[frame], 0, __ATOMIC_RELAXED);
+    vm->free[vm->free_count++] = frame;
+    __atomic_store_n(&pages[page], 0, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&vm->lock);
+}
+
+unsigned int vm_resident(VmT* vm, ProcessIdT pid) {
+  uint32_t const* pages = &vm->pages[(size_t)(pid - 1) * vm->working_set];
+  unsigned int resident = 0;
+  for (unsigned int page = 0; page < vm->working_set; page++) {
+    resident += __atomic_load_n(&pages[page], __ATOMIC_RELAXED) != 0;
+  }
+  return resident;
+}
+
+unsigned long vm_evictions(VmT* vm) {
+  pthread_mutex_lock(&vm->lock);
+  unsigned long const evictions = vm->evictions;
+  pthread_mutex_unlock(&vm->lock);
+  return evictions;
+}
@@ -0,0 +1,56 @@
+#ifndef _VM_H_
+#define _VM_H_
+
+#include "process_table.h"
+#include <stdint.h>
+#include <pthread.h>
+
+// Simulated virtual memory. Every process has a working set of the same
+// number of pages and touches one of them per step, the physical frames
+// are shared by all processes and reclaimed with the clock algorithm.
+// A touch of a resident page is two array reads. A fault blocks the
+// process while swap loads the page, which is only mapped once the load
+// finishes and stays pinned until the process next touches it - so every
+// load lets at least one step run, however hard the frames are contended.
+typedef struct Vm {
+  unsigned int working_set; //pages per process
+  unsigned int frame_count;
+  uint32_t* pages; //page table, working_set entries per pid - frame + 1, 0 when not resident
+  uint32_t* frames; //page table entry + 1 of the page in each frame, 0 when free
+  unsigned char* referenced; //per frame, set by touches and cleared as the hand passes
+  unsigned char* pinned; //per frame, loaded for a process that has not touched it yet
+  pthread_mutex_t lock; //held to map and unmap pages, never to touch resident ones
+  uint32_t* free; //frames given back by exited processes, taken before the hand moves
+  unsigned int free_count;
+  unsigned int hand; //next frame the clock looks at
+  unsigned long evictions;
+} VmT;
+
+void vm_create(VmT* vm, unsigned int max_processes, unsigned int working_set, unsigned int frames);
+void vm_destroy(VmT* vm);
+
+// Page of its working set a process touches at pc - most steps stay in
+// the hottest quarter, the rest walk the whole set
+static inline unsigned int vm_page_of(unsigned int pc, unsigned int working_set) {
+  uint32_t const hash = pc * 2654435761u;
+  unsigned int const hot = working_set / 4 ? working_set / 4 : 1;
+  return (hash >> 30) != 0 ? (hash >> 8) % hot : pc % working_set;
+}
+
+// Touch the page pid uses at pc, returns 0 if it was resident and 1 if
+// it faulted and has to be loaded
+int vm_touch(VmT* vm, ProcessIdT pid, unsigned int pc);
+
+// Map the page pid uses at pc once swap has loaded it, pinned until that
+// touch - returns 1 if every frame is pinned and the load must wait
+int vm_load(VmT* vm, ProcessIdT pid, unsigned int pc);
+
+// Give back every frame of pid, once it has exited
+void vm_release(VmT* vm, ProcessIdT pid);
+
+// Pages of pid that are resident
+unsigned int vm_resident(VmT* vm, ProcessIdT pid);
+
+unsigned long vm_evictions(VmT* vm);
+
+#endif
@@ -0,0 +1,179 @@
+#include "vm.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+// Smallest pc whose step touches page
+unsigned int pc_for_page(unsigned int page, unsigned int working_set) {
+  unsigned int pc = 0;
+  while (vm_page_of(pc, working_set) != page) pc++;
+  return pc;
+}
+
+// Fault pid's page at pc, have swap load it and run the step
+void fault_in(VmT* vm, ProcessIdT pid, unsigned int pc) {
+  assert(vm_touch(vm, pid, pc) == 1);
+  assert(vm_load(vm, pid, pc) == 0);
+  assert(vm_touch(vm, pid, pc) == 0);
+}
+
+void test_page_of() {
+  printf("testing pages stay in the working set, mostly the hot quarter\n");
+  unsigned int hot = 0;
+  for (unsigned int pc = 0; pc < 4000; pc++) {
+    unsigned int const page = vm_page_of(pc, 16);
+    assert(page < 16);
+    assert(page == vm_page_of(pc, 16));
+    hot += page < 4;
+  }
+  assert(hot > 2800);
+  assert(vm_page_of(12345, 1) == 0);
+}
+
+void test_fault_then_hit() {
+  printf("testing a page faults once and is then resident\n");
+  VmT vm;
+  vm_create(&vm, 4, 8, 16);
+  unsigned int const pc = pc_for_page(5, 8);
+  assert(vm_resident(&vm, 2) == 0);
+  assert(vm_touch(&vm, 2, pc) == 1);
+  //nothing is mapped until swap has loaded it
+  assert(vm_touch(&vm, 2, pc) == 1);
+  assert(vm_resident(&vm, 2) == 0);
+  assert(vm_load(&vm, 2, pc) == 0);
+  assert(vm_touch(&vm, 2, pc) == 0);
+  assert(vm_resident(&vm, 2) == 1);
+  //another process has its own copy of the page
+  fault_in(&vm, 3, pc);
+  assert(vm_resident(&vm, 2) == 1 && vm_resident(&vm, 3) == 1);
+  assert(vm_evictions(&vm) == 0);
+  vm_destroy(&vm);
+}
+
+void test_clock_second_chance() {
+  printf("testing the clock evicts the first frame not touched since it last passed\n");
+  VmT vm;
+  vm_create(&vm, 4, 4, 2);
+  unsigned int const pc = pc_for_page(0, 4);
+
+  fault_in(&vm, 1, pc); //frame 0
+  fault_in(&vm, 2, pc); //frame 1
+  assert(vm_touch(&vm, 1, pc) == 0);
+
+  //both were touched, the hand clears them and comes back to frame 0
+  fault_in(&vm, 3, pc);
+  assert(vm_evictions(&vm) == 1);
+  assert(vm_resident(&vm, 1) == 0);
+  assert(vm_resident(&vm, 2) == 1 && vm_resident(&vm, 3) == 1);
+
+  //frame 1 was passed without a touch since, it goes next
+  fault_in(&vm, 1, pc);
+  assert(vm_evictions(&vm) == 2);
+  assert(vm_resident(&vm, 2) == 0);
+  assert(vm_resident(&vm, 1) == 1 && vm_resident(&vm, 3) == 1);
+  vm_destroy(&vm);
+}
+
+void test_release() {
+  printf("testing released frames are reused before anything is evicted\n");
+  VmT vm;
+  vm_create(&vm, 4, 4, 2);
+  unsigned int const pc = pc_for_page(0, 4);
+  unsigned int const other = pc_for_page(2, 4);
+  fault_in(&vm, 1, pc);
+  fault_in(&vm, 1, other);
+  assert(vm_resident(&vm, 1) == 2);
+
+  vm_release(&vm, 1);
+  assert(vm_resident(&vm, 1) == 0);
+  fault_in(&vm, 2, pc);
+  fault_in(&vm, 3, pc);
+  assert(vm_evictions(&vm) == 0);
+  //the process comes back to nothing resident
+  fault_in(&vm, 1, pc);
+  assert(vm_evictions(&vm) == 1);
+  vm_destroy(&vm);
+}
+
+void test_pinned_until_touched() {
+  printf("testing a loaded page stays until its process touches it\n");
+  VmT vm;
+  vm_create(&vm, 8, 4, 4);
+  unsigned int const pc = pc_for_page(0, 4);
+  for (ProcessIdT pid = 1; pid <= 8; pid++) {
+    assert(vm_touch(&vm, pid, pc) == 1);
+  }
+  //swap loads every page before any process runs again
+  for (ProcessIdT pid = 1; pid <= 4; pid++) {
+    assert(vm_load(&vm, pid, pc) == 0);
+  }
+  for (ProcessIdT pid = 5; pid <= 8; pid++) {
+    assert(vm_load(&vm, pid, pc) == 1);
+  }
+  assert(vm_evictions(&vm) == 0);
+  for (ProcessIdT pid = 1; pid <= 4; pid++) {
+    assert(vm_resident(&vm, pid) == 1);
+    assert(vm_touch(&vm, pid, pc) == 0);
+  }
+  //touched pages can go again
+  for (ProcessIdT pid = 5; pid <= 8; pid++) {
+    assert(vm_load(&vm, pid, pc) == 0);
+    assert(vm_touch(&vm, pid, pc) == 0);
+  }
+  assert(vm_evictions(&vm) == 4);
+  vm_destroy(&vm);
+}
+
+#define PROGRESS_PROCESSES 32
+#define PROGRESS_STEPS 200
+
+void test_progress_under_pressure() {
+  printf("testing processes keep running when faults come faster than swap loads\n");
+  VmT vm;
+  vm_create(&vm, PROGRESS_PROCESSES, 16, 8);
+  unsigned int pc[PROGRESS_PROCESSES] = { 0 };
+  int waiting[PROGRESS_PROCESSES] = { 0 };
+  //swap requests in the order they were made, retried at the back
+  ProcessIdT swap[PROGRESS_PROCESSES];
+  unsigned int head = 0;
+  unsigned int queued = 0;
+  unsigned int finished = 0;
+  unsigned long rounds = 0;
+
+  while (finished < PROGRESS_PROCESSES) {
+    assert(++rounds < 1000000);
+    //every process that can runs a step or faults
+    for (ProcessIdT pid = 1; pid <= PROGRESS_PROCESSES; pid++) {
+      if (waiting[pid - 1] || pc[pid - 1] == PROGRESS_STEPS) continue;
+      if (vm_touch(&vm, pid, pc[pid - 1]) == 0) {
+	finished += ++pc[pid - 1] == PROGRESS_STEPS;
+	if (pc[pid - 1] == PROGRESS_STEPS) vm_release(&vm, pid);
+      } else {
+	waiting[pid - 1] = 1;
+	swap[(head + queued++) % PROGRESS_PROCESSES] = pid;
+      }
+    }
+    //but swap only loads one page per round
+    if (queued > 0) {
+      ProcessIdT const pid = swap[head];
+      head = (head + 1) % PROGRESS_PROCESSES;
+      queued--;
+      if (vm_load(&vm, pid, pc[pid - 1]) == 0) {
+	waiting[pid - 1] = 0;
+      } else {
+	swap[(head + queued++) % PROGRESS_PROCESSES] = pid;
+      }
+    }
+  }
+  vm_destroy(&vm);
+}
+
+int main() {
+  test_page_of();
+  test_fault_then_hit();
+  test_clock_second_chance();
+  test_release();
+  test_pinned_until_touched();
+  test_progress_under_pressure();
+  return 0;
+}